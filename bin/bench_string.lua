@@ -0,0 +1,112 @@
+#!/usr/bin/env lua
+
+--
+--	bench_string.lua - Benchmark for tek.lib.string
+--	Written by agent <agent at local>
+--	See copyright notice in COPYRIGHT
+--
+--	Usage: bench_string.lua [size in bytes [number of operations]]
+--
+--	Initializes a string object with random text, then times random
+--	reads, insertions, substrings, erasures and metadata changes. The
+--	digest at the end depends only on the arguments and can be used to
+--	compare the results of different implementations.
+--
+
+local String = require "tek.lib.string"
+local clock = os.clock
+local concat = table.concat
+local random = math.random
+
+local size = tonumber(arg[1]) or 1048576
+local numops = tonumber(arg[2]) or 1000
+
+-------------------------------------------------------------------------------
+
+local function report(name, t, n)
+	print(("%-24s %10.2f us/op"):format(name, (clock() - t) * 1e6 / n))
+end
+
+local function randomtext(size)
+	local alpha = "abcdefghijklmnopqrstuvwxyz \n\t"
+	local t = { }
+	for i = 1, size do
+		local c = random(1, #alpha)
+		t[i] = alpha:sub(c, c)
+	end
+	-- a few multibyte characters, so that the text is not plain ASCII:
+	for i = 1001, size - 1, 4096 do
+		t[i] = "\195\164"
+		t[i + 1] = ""
+	end
+	return concat(t)
+end
+
+-------------------------------------------------------------------------------
+
+math.randomseed(42)
+local text = randomtext(size)
+local s = String.new()
+local sum = 0
+
+local t = clock()
+s:set(text)
+local len = s:len()
+print(("set %d bytes (%d characters): %.1f ms"):format(size, len,
+	(clock() - t) * 1e3))
+
+t = clock()
+for i = 1, numops do
+	sum = sum + s:getval(random(1, len))
+end
+report("getval (packed)", t, numops)
+
+t = clock()
+for i = 1, numops do
+	s:insert("xy", random(1, len + 1))
+	len = len + 2
+end
+report("insert", t, numops)
+
+t = clock()
+for i = 1, numops do
+	sum = sum + s:getval(random(1, len))
+end
+report("getval", t, numops)
+
+t = clock()
+local p = len
+for i = 1, numops * 10 do
+	sum = sum + s:getval(p)
+	p = p - 1
+end
+report("getval (backwards)", t, numops * 10)
+
+t = clock()
+for i = 1, numops do
+	local p0 = random(1, len - 100)
+	sum = sum + #s:sub(p0, p0 + 79)
+end
+report("sub (80 characters)", t, numops)
+
+t = clock()
+for i = 1, numops do
+	local p0 = random(1, len - 10)
+	s:erase(p0, p0 + random(0, 2))
+	len = s:len()
+end
+report("erase", t, numops)
+
+t = clock()
+for i = 1, numops do
+	local p0 = random(1, len - 10)
+	s:setmetadata(random(0, 4), p0, p0 + 5)
+end
+report("setmetadata", t, numops)
+
+local h = 5381
+text = s:get()
+for i = 1, #text do
+	h = (h * 33 + text:byte(i)) % 4294967296
+end
+print(("length %d, digest %08x, checksum %d"):format(len, h, sum))
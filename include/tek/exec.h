@@ -248,7 +248,7 @@ typedef TTASKENTRY void (*TTASKFUNC)(struct TTask *task);
 #define TTask_MemManager	(TEXECTAGS_ + 2)
 /* Task's heap memmanager */
 #define TTask_HeapMemManager (TEXECTAGS_ + 3)
-/* Message memory manager */
+/* Message memory manager, used by TAllocMsg() in the task */
 #define TTask_MsgMemManager	(TEXECTAGS_ + 4)
 /* Lock to a currentdir */
 #define TTask_CurrentDir	(TEXECTAGS_ + 5)
@@ -262,6 +262,8 @@ typedef TTASKENTRY void (*TTASKFUNC)(struct TTask *task);
 #define TMsgPort_Hook		(TEXECTAGS_ + 9)
 /* Ptr to user/init data */
 #define TTask_InitData		(TEXECTAGS_ + 10)
+/* Msgport with lock-free queueing, see TMSGPORTF_LOCKFREE */
+#define TMsgPort_LockFree	(TEXECTAGS_ + 11)
 
 /*****************************************************************************/
 /*
@@ -392,8 +394,11 @@ struct TModInitNode
 #define TMMT_Tracking	0x00000008
 /* Thread-safety on top of a parent MemManager */
 #define TMMT_TaskSafe	0x00000100
-/* Msg allocator on parent msg MemManager */
+/* Msg allocator on parent msg MemManager; when created with
+** TCreateMemManager(), freed messages are recycled, see TTask_MsgMemManager */
 #define TMMT_Message	0x00000200
+/* Put MemManager on top of a size-class slab allocator */
+#define TMMT_Slab		0x00000010
 /* Bounds checking on top of parent MemManager */
 #define TMMT_Debug		0x00000400
 
@@ -415,6 +420,12 @@ struct TModInitNode
 #define	TPool_AutoAdapt		(TEXECTAGS_ + 69)
 #define TPool_Static		(TEXECTAGS_ + 70)
 #define TPool_StaticSize	(TEXECTAGS_ + 71)
+/* Slab mmu: size of chunks taken from the parent */
+#define TSlab_ChunkSize		(TEXECTAGS_ + 72)
+/* Slab mmu: largest allocation served from size classes */
+#define TSlab_MaxSize		(TEXECTAGS_ + 73)
+/* Msg mmu: number of freed messages kept per size class */
+#define TMsgPool_MaxFree	(TEXECTAGS_ + 74)
 
 /*
 **	Tags for module scanning
@@ -423,6 +434,32 @@ struct TModInitNode
 #define TExec_ModuleName	(TEXECTAGS_ + 80)
 #define TExec_ModulePrefix	(TEXECTAGS_ + 81)
 
+/*
+**	Tags for TGetLockStats()
+*/
+
+/* Number of times the lock was obtained, TUINT * */
+#define TLock_Acquires		(TEXECTAGS_ + 88)
+/* Number of times the lock was held by another task, TUINT * */
+#define TLock_Contended		(TEXECTAGS_ + 89)
+/* Time spent waiting for the lock, TTIME * */
+#define TLock_WaitTime		(TEXECTAGS_ + 90)
+/* Reset statistics after querying them */
+#define TLock_Reset			(TEXECTAGS_ + 91)
+
+/*
+**	Tags for TGetMsgPoolStats()
+*/
+
+/* Number of allocations served from free lists, TUINT * */
+#define TMsgPool_Hits		(TEXECTAGS_ + 92)
+/* Number of allocations passed on to the parent, TUINT * */
+#define TMsgPool_Misses		(TEXECTAGS_ + 93)
+/* Number of messages not yet freed, TUINT * */
+#define TMsgPool_Pending	(TEXECTAGS_ + 94)
+/* Reset statistics after querying them */
+#define TMsgPool_Reset		(TEXECTAGS_ + 95)
+
 /*****************************************************************************/
 /*
 **	Message status, as returned by TExecSendMsg().
@@ -223,4 +223,13 @@
 #define TFreeTask(msg) \
 	(*(((TMODCALL void(**)(TAPTR,struct TTask *))(TExecBase))[-81]))(TExecBase,task)
 
+#define TGetLockStats(lock,tags) \
+	(*(((TMODCALL TUINT(**)(TAPTR,struct TLock *,TTAGITEM *))(TExecBase))[-82]))(TExecBase,lock,tags)
+
+#define TGetMsgPoolStats(mmu,tags) \
+	(*(((TMODCALL TUINT(**)(TAPTR,struct TMemManager *,TTAGITEM *))(TExecBase))[-83]))(TExecBase,mmu,tags)
+
+#define TGetMsgs(port,list,max) \
+	(*(((TMODCALL TUINT(**)(TAPTR,struct TMsgPort *,struct TList *,TUINT))(TExecBase))[-84]))(TExecBase,port,list,max)
+
 #endif /* _TEK_INLINE_EXEC_H */
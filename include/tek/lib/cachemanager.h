@@ -12,6 +12,23 @@
 /* msg to query interface from a cache manager: */
 #define CacheManagerMsgQueryIFace	(TMSG_USER + 0)
 
+/* default budget of a cache manager, in bytes: */
+#define CACHEMANAGER_DEF_MAXBYTES	1000000
+
+/*
+**	Tags for cachemanager_create(), setattrs and getattrs. The counters are
+**	read-only and retrieved as pointers to TSIZE.
+*/
+#define TCACHETAGS_					(TTAG_USER + 0x680)
+#define CacheManager_MaxBytes		(TCACHETAGS_ + 0) /* budget; 0=unlimited */
+#define CacheManager_AllocBytes		(TCACHETAGS_ + 1) /* bytes in use */
+#define CacheManager_PeakBytes		(TCACHETAGS_ + 2) /* highest bytes in use */
+#define CacheManager_NumItems		(TCACHETAGS_ + 3) /* number of items */
+#define CacheManager_NumRecords		(TCACHETAGS_ + 4) /* number of keys */
+#define CacheManager_Hits			(TCACHETAGS_ + 5) /* lookups found */
+#define CacheManager_Misses			(TCACHETAGS_ + 6) /* lookups not found */
+#define CacheManager_Evictions		(TCACHETAGS_ + 7) /* items evicted */
+
 struct CacheItem
 {
 	struct TNode node; /* linkage to cachemanager */
@@ -28,8 +45,19 @@ struct CacheManagerIFace
 	void (*free)(struct THandle *, TAPTR mem);
 	void (*additem)(struct THandle *, struct CacheItem *item);
 	void (*remitem)(struct THandle *, struct CacheItem *item);
+	/* remove key, without destroying its value: */
+	void (*rem)(struct THandle *, TUINT8 *key, TSIZE len, TUINT hval);
+	/* mark item as most recently used, count a hit: */
+	void (*touch)(struct THandle *, struct CacheItem *item);
+	/* count a lookup that was not found: */
+	void (*miss)(struct THandle *);
+	void (*setattrs)(struct THandle *, TTAGITEM *tags);
+	void (*getattrs)(struct THandle *, TTAGITEM *tags);
+	/* exclusive access for a sequence of calls, may be nested: */
+	void (*lock)(struct THandle *);
+	void (*unlock)(struct THandle *);
 };
 
-TLIBAPI struct THandle *cachemanager_create(TAPTR TExecBase);
+TLIBAPI struct THandle *cachemanager_create(TAPTR TExecBase, TTAGITEM *tags);
 
 #endif /* _TEK_LIB_CACHEMANAGER_H */
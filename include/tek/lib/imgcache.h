@@ -10,12 +10,20 @@
 #include <tek/lib/cachemanager.h>
 #include <tek/lib/pixconv.h>
 
+/* largest tile created by merging adjacent tiles, in pixels: */
+#define IMGCACHE_MERGE_MAXPIXELS	65536
+
 struct ImageCacheRecord
 {
 	struct THandle handle; /* linkage to cache manager */
 	struct TList list; /* list of rectangle nodes */
+	struct ImageCacheNode *root; /* tree of rectangle nodes, by y0, x0 */
 	struct CacheManagerIFace *iface;
+	TUINT seed; /* for node priorities */
 	TINT numitems;
+	TBOOL busy; /* being stored to, do not destroy when empty */
+	TUINT hashvalue;
+	TSIZE keylen; /* key follows the record */
 };
 
 struct ImageCacheNode
@@ -26,11 +34,16 @@ struct ImageCacheNode
 	TINT x0, y0, x1, y1; /* rectangle normalized by orig x/y */
 	TUINT8 *buf; /* cached buffer */
 	TUINT pixels; /* number of pixels */
+	struct ImageCacheNode *left, *right; /* treap linkage */
+	struct ImageCacheNode *link; /* for collecting query results */
+	TUINT prio; /* treap priority */
+	TINT maxy1; /* greatest y1 in subtree */
 };
 
 struct ImageCacheState
 {
 	struct ImageCacheRecord *cr;
+	struct THandle *cache;
 	struct CacheManagerIFace *cacheiface;
 	TUINT hashvalue;
 	struct TVPixBuf src, dst;
@@ -42,5 +55,7 @@ struct ImageCacheState
 
 TLIBAPI TINT imgcache_lookup(struct ImageCacheState *cs, struct TVImageCacheRequest *creq, TINT x, TINT y, TINT w, TINT h);
 TLIBAPI TINT imgcache_store(struct ImageCacheState *cs, struct TVImageCacheRequest *creq);
+/* the cache is locked from imgcache_lookup() until imgcache_unlock(): */
+TLIBAPI void imgcache_unlock(struct ImageCacheState *cs);
 
 #endif /* _TEK_LIB_IMGCACHE_H */
@@ -10,6 +10,10 @@
 #include <tek/mod/visual.h>
 
 typedef TUINT8 *(TLIBTRANSFORM) (struct TVPixBuf *src, TINT x, TINT y, void *data);
+typedef void (TLIBROWCONV) (TUINT8 *dst, TUINT8 *src, TINT w);
+
+TLIBAPI TLIBROWCONV *pixconv_getrowconv(TUINT sfmt, TUINT dfmt, TBOOL alpha,
+	TBOOL swap_byteorder);
 
 TLIBAPI TINT pixconv_transform_convert(struct TVPixBuf *src, struct TVPixBuf *dst,
 	TINT x0, TINT y0, TINT x1, TINT y1, TINT sx, TINT sy, TBOOL alpha, 
@@ -19,6 +23,10 @@ TLIBAPI TINT pixconv_convert(struct TVPixBuf *src, struct TVPixBuf *dst,
 	TINT x0, TINT y0, TINT x1, TINT y1, TINT sx, TINT sy, TBOOL alpha, 
 	TBOOL swap_byteorder);
 
+TLIBAPI TINT pixconv_rotate_convert(struct TVPixBuf *src, struct TVPixBuf *dst,
+	TINT x0, TINT y0, TINT x1, TINT y1, TINT sx, TINT sy, TINT rot,
+	TINT dw, TINT dh);
+
 TLIBAPI void pixconv_writealpha(TUINT8 *dbuf, TUINT8 *sbuf, TINT w, TUINT dfmt, 
 	TINT r, TINT g, TINT b);
 
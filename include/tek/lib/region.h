@@ -40,10 +40,32 @@ struct RectList
 	TINT rl_NumNodes;
 };
 
+/* array of rectangles in y-x banded order, see region.c: */
+struct RectBands
+{
+	RECTINT *rb_Rects;
+	TINT rb_NumRects;
+	TINT rb_MaxRects;
+};
+
+#define REGION_NUMBANDS 4
+
+struct RectSlab;
+
 struct RectPool
 {
+	/* free rect nodes: */
 	struct RectList p_Rects;
 	struct TExecBase *p_ExecBase;
+	/* work buffers for region operations: */
+	struct RectBands p_Bands[REGION_NUMBANDS];
+	/* slabs from which rect nodes are allocated: */
+	struct RectSlab *p_Slabs;
+	/* statistics (read-only): */
+	TINT p_NumSlabs;	/* number of slabs allocated */
+	TINT p_NumNodes;	/* total number of nodes in slabs */
+	TINT p_NumLive;		/* number of nodes in use */
+	TINT p_MaxLive;		/* high-water mark of nodes in use */
 };
 
 struct Region
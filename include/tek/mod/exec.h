@@ -119,6 +119,69 @@ struct TMemPool
 	TUINT16 tpl_Flags;
 };
 
+/*****************************************************************************/
+/*
+**	Size-class slab allocator
+*/
+
+/* Number of size classes, in steps of sizeof(union TMemNode) */
+#define TSLAB_NUMCLASSES	32
+
+struct TMemSlab
+{
+	/* Exec object handle */
+	struct THandle tsl_Handle;
+	/* List of chunks */
+	struct TList tsl_Chunks;
+	/* Parent allocator */
+	TAPTR tsl_MemManager;
+	/* Size of chunks */
+	TSIZE tsl_ChunkSize;
+	/* Largest allocation served from size classes */
+	TSIZE tsl_MaxSize;
+	/* Unused rest of the current chunk */
+	TINT8 *tsl_Bump;
+	TINT8 *tsl_BumpEnd;
+	/* Free list per size class */
+	union TMemNode *tsl_Free[TSLAB_NUMCLASSES];
+};
+
+/*****************************************************************************/
+/*
+**	Recycling message allocator
+**	Freed messages of up to TMSGPOOL_NUMCLASSES granules are kept in free
+**	lists per size class, and taken from there by the next allocation of
+**	the same class. The allocator stays alive until all of its messages
+**	have been freed.
+*/
+
+/* Number of size classes, in steps of sizeof(union TMemManagerInfo) */
+#define TMSGPOOL_NUMCLASSES	32
+
+struct TMsgPool
+{
+	/* Exec object handle */
+	struct THandle tmpl_Handle;
+	/* Parent message memory manager */
+	struct TMemManager *tmpl_MemManager;
+	/* Locking for free lists and counters */
+	struct THALObject tmpl_Lock;
+	/* Free list per size class */
+	TAPTR tmpl_Free[TMSGPOOL_NUMCLASSES];
+	/* Number of entries per free list */
+	TUINT16 tmpl_NumFree[TMSGPOOL_NUMCLASSES];
+	/* Maximum number of entries per free list */
+	TUINT tmpl_MaxFree;
+	/* Allocations not yet returned */
+	TUINT tmpl_Pending;
+	/* Allocations served from the free lists */
+	TUINT tmpl_Hits;
+	/* Allocations passed on to the parent */
+	TUINT tmpl_Misses;
+	/* Set when destroyed with allocations pending */
+	TBOOL tmpl_Closed;
+};
+
 /*****************************************************************************/
 /*
 **	Locking object
@@ -133,11 +196,17 @@ struct TLock
 	/* HAL locking object */
 	struct THALObject tlk_HLock;
 	/* Current owner */
-	struct TTask *tlk_Owner;
+	struct TTask * volatile tlk_Owner;
 	/* Recursion counter */
 	TUINT16 tlk_NestCount;
 	/* Number of waiters */
-	TUINT16 tlk_WaitCount;
+	volatile TUINT16 tlk_WaitCount;
+	/* Adaptive number of spins before waiting */
+	TUINT16 tlk_Spin;
+	/* Statistics, see TGetLockStats() */
+	TUINT tlk_Acquires;
+	TUINT tlk_Contended;
+	TTIME tlk_WaitTime;
 };
 
 /*
@@ -172,8 +241,19 @@ struct TMsgPort
 	struct THook *tmp_Hook;
 	/* Signal to appear in sigtask */
 	TUINT tmp_Signal;
+	/* Port flags, see below */
+	TUINT tmp_Flags;
+	/* Lock-free ports: messages pushed by senders, newest first */
+	struct TNode * volatile tmp_Inbox;
 };
 
+/*
+**	Port flags
+*/
+
+/* Senders queue without locking, only the sigtask may access tmp_MsgList */
+#define TMSGPORTF_LOCKFREE	0x0001
+
 /*****************************************************************************/
 /*
 **	Memory manager
@@ -371,6 +451,9 @@ struct TTask
 
 	/* Basetask initdata */
 	TAPTR tsk_InitData;
+
+	/* Memory manager for TAllocMsg(), or TNULL */
+	struct TMemManager *tsk_MsgMemManager;
 };
 
 /*
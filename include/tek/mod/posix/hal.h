@@ -18,6 +18,25 @@
 #include <sys/time.h>
 #include <tek/mod/time.h>
 
+/*
+**	On Linux, signal state is an atomic word, and waiting and waking use
+**	futexes. Define HAL_POSIX_NO_FUTEX to use a mutex and condvar instead.
+*/
+
+#if defined(__linux__) && defined(__GNUC__) && !defined(HAL_POSIX_NO_FUTEX)
+#define HAL_POSIX_FUTEX
+#endif
+
+/*
+**	With compiler support for thread-local storage, each thread caches
+**	its HALThread, saving the pthread_getspecific() lookup in the calls
+**	concerning the calling task. Define HAL_POSIX_NO_TLS to disable.
+*/
+
+#if defined(__GNUC__) && !defined(HAL_POSIX_NO_TLS)
+#define HAL_POSIX_TLS
+#endif
+
 /*****************************************************************************/
 
 struct HALSpecific
@@ -42,9 +61,14 @@ struct HALThread
 	void *hth_Data;						/* Task data ptr */
 	void (*hth_Function)(struct TTask *);	/* Task function */
 	TAPTR hth_HALBase;					/* HAL module base ptr */
+#if defined(HAL_POSIX_FUTEX)
+	volatile TUINT hth_SigState;		/* Signal state, futex word */
+	volatile TUINT hth_SigWait;			/* Nonzero while waiting */
+#else
 	pthread_mutex_t hth_SigMutex;		/* Signal mutex */
 	pthread_cond_t hth_SigCond;			/* Signal conditional */
 	TUINT hth_SigState;					/* Signal state */
+#endif
 };
 
 struct HALModule
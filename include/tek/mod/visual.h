@@ -91,6 +91,16 @@ typedef TTAG TVPEN;
 #define TVisual_ExtraArgs			(TVISTAGS_ + 0x119)
 #define TVisual_HaveWindowManager	(TVISTAGS_ + 0x11a)
 #define TVisual_WindowHints			(TVISTAGS_ + 0x11b)
+#define TVisual_CmdBuffer			(TVISTAGS_ + 0x11c)
+#define TVisual_Buffer				(TVISTAGS_ + 0x11d)
+#define TVisual_OrigX				(TVISTAGS_ + 0x11e)
+#define TVisual_OrigY				(TVISTAGS_ + 0x11f)
+#define TVisual_Strip				(TVISTAGS_ + 0x120)
+#define TVisual_HaveStrips			(TVISTAGS_ + 0x121)
+
+/* Values for TVisual_Strip, buffer is repeated by the display: */
+#define TVSTRIP_ROW					1	/* one row, for all rows */
+#define TVSTRIP_COLUMN				2	/* one column, for all columns */
 
 /* Tagged rendering: */
 
@@ -148,6 +158,10 @@ struct TVRequest
 		struct { TAPTR Window; TINT Rect[4]; } Flush;
 		struct { TAPTR Window; TUINT Type; TAPTR Data; TSIZE Length; } GetSelection;
 		struct { TAPTR Window; TUINT Type; TAPTR Data; TSIZE Length; } SetSelection;
+		struct { TAPTR Window; struct TList Commands; TINT Num; } Batch;
+		struct { TAPTR Window; TAPTR Buf; TINT Width; TINT Height;
+			TINT TotWidth; TTAGITEM *Tags; TAPTR Handle; } AllocBuffer;
+		struct { TAPTR Handle; } FreeBuffer;
 	} tvr_Op;
 };
 
@@ -184,6 +198,9 @@ struct TVRequest
 #define TVCMD_FLUSH			0x101e
 #define TVCMD_GETSELECTION	0x101f
 #define TVCMD_SETSELECTION	0x1020
+#define TVCMD_BATCH			0x1021
+#define TVCMD_ALLOCBUFFER	0x1022
+#define TVCMD_FREEBUFFER	0x1023
 #define TVCMD_EXTENDED		0x2000
 
 /*****************************************************************************/
@@ -233,4 +233,13 @@
 #define TExecFreeTask(exec,task) \
 	(*(((TMODCALL void(**)(TAPTR,struct TTask *))(exec))[-81]))(exec,task)
 
+#define TExecGetLockStats(exec,lock,tags) \
+	(*(((TMODCALL TUINT(**)(TAPTR,struct TLock *,TTAGITEM *))(exec))[-82]))(exec,lock,tags)
+
+#define TExecGetMsgPoolStats(exec,mmu,tags) \
+	(*(((TMODCALL TUINT(**)(TAPTR,struct TMemManager *,TTAGITEM *))(exec))[-83]))(exec,mmu,tags)
+
+#define TExecGetMsgs(exec,port,list,max) \
+	(*(((TMODCALL TUINT(**)(TAPTR,struct TMsgPort *,struct TList *,TUINT))(exec))[-84]))(exec,port,list,max)
+
 #endif /* _TEK_STDCALL_EXEC_H */
@@ -68,4 +68,7 @@
 #define THALScanModules(hal,prefix,hook) \
 	(*(((TMODCALL TBOOL(**)(TAPTR,TSTRPTR,struct THook *))(hal))[-28]))(hal,prefix,hook)
 
+#define THALGetSysTime(hal,time) \
+	(*(((TMODCALL void(**)(TAPTR,TTIME *))(hal))[-29]))(hal,time)
+
 #endif /* _TEK_STDCALL_HAL_H */
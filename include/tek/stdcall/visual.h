@@ -112,4 +112,13 @@
 #define TVisualSetSelection(visual,sel,len,tags) \
 	(*(((TMODCALL TINT(**)(TAPTR,TSTRPTR,TSIZE,TTAGITEM *))(visual))[-43]))(visual,sel,len,tags)
 
+#define TVisualFlush(visual,display) \
+	(*(((TMODCALL void(**)(TAPTR,TBOOL))(visual))[-44]))(visual,display)
+
+#define TVisualAllocBuffer(visual,buf,w,h,totw,tags) \
+	(*(((TMODCALL TAPTR(**)(TAPTR,TAPTR,TINT,TINT,TINT,TTAGITEM *))(visual))[-45]))(visual,buf,w,h,totw,tags)
+
+#define TVisualFreeBuffer(visual,handle) \
+	(*(((TMODCALL void(**)(TAPTR,TAPTR))(visual))[-46]))(visual,handle)
+
 #endif /* _TEK_STDCALL_VISUAL_H */
@@ -0,0 +1,203 @@
+/*
+**	teklib/src/bench/exec_ports.c - Message port benchmark
+**
+**	Written by agent <agent at local>
+**	See copyright notice in teklib/COPYRIGHT
+**
+**	One or more producer tasks keep a window of messages in flight to a
+**	port of the main task, which replies them. The number of round trips
+**	per second is measured for ports with and without TMsgPort_LockFree,
+**	with one and with three producers.
+**
+**	Usage: exec_ports [iterations per producer]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <tek/teklib.h>
+#include <tek/proto/hal.h>
+#include <tek/proto/exec.h>
+#include <tek/inline/exec.h>
+
+#define BENCH_DEFITER	400000
+#define BENCH_WINDOW	64
+
+struct Bench
+{
+	struct TMsgPort *port;
+	TBOOL lockfree;
+	TINT numiter;
+	TINT errors;
+};
+
+static const struct TInitModule bench_initmodules[] =
+{
+	{"hal", tek_init_hal, TNULL, 0},
+	{"exec", tek_init_exec, TNULL, 0},
+	{ TNULL, TNULL, TNULL, 0 }
+};
+
+/*****************************************************************************/
+
+static double bench_elapsed(struct TExecBase *TExecBase, TTIME *t0)
+{
+	TTIME t;
+	TGetSystemTime(&t);
+	TSubTime(&t, t0);
+	return (double) t.tdt_Int64 / 1000000;
+}
+
+/*****************************************************************************/
+/*
+**	producer: send the window, then resend each message as it returns
+*/
+
+static void bench_producer(struct TTask *task)
+{
+	struct TExecBase *TExecBase = TGetExecBase(task);
+	struct Bench *bench = TGetTaskData(task);
+	TTAGITEM tags[2];
+	struct TMsgPort *rport;
+	TINT sent = 0, back = 0;
+
+	tags[0].tti_Tag = TMsgPort_LockFree;
+	tags[0].tti_Value = (TTAG) bench->lockfree;
+	tags[1].tti_Tag = TTAG_DONE;
+	rport = TCreatePort(tags);
+	if (rport == TNULL)
+		return;
+
+	while (sent < BENCH_WINDOW && sent < bench->numiter)
+	{
+		TINT *msg = TAllocMsg(sizeof(TINT) * 2);
+		if (msg == TNULL)
+			break;
+		msg[0] = sent++;
+		TPutMsg(bench->port, rport, msg);
+	}
+
+	while (back < sent)
+	{
+		TINT *msg;
+		TWaitPort(rport);
+		while ((msg = TGetMsg(rport)))
+		{
+			back++;
+			if (msg[1] != msg[0] + 1)
+				bench->errors++;
+			if (sent < bench->numiter)
+			{
+				msg[0] = sent++;
+				TPutMsg(bench->port, rport, msg);
+			}
+			else
+				TFree(msg);
+		}
+	}
+
+	TDestroy((struct THandle *) rport);
+}
+
+static THOOKENTRY TTAG bench_producerfunc(struct THook *hook, TAPTR obj,
+	TTAG msg)
+{
+	switch (msg)
+	{
+		case TMSG_INITTASK:
+			return TTRUE;
+		case TMSG_RUNTASK:
+			bench_producer(obj);
+			break;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	run one configuration, returns the number of round trips per second
+*/
+
+static double bench_run(struct TExecBase *TExecBase, TINT numprod,
+	TBOOL lockfree, TINT numiter)
+{
+	struct Bench bench;
+	struct TTask *prod[3];
+	struct THook hook;
+	TTAGITEM tags[2];
+	TTIME t0;
+	TINT i, got = 0;
+	double t;
+
+	tags[0].tti_Tag = TMsgPort_LockFree;
+	tags[0].tti_Value = (TTAG) lockfree;
+	tags[1].tti_Tag = TTAG_DONE;
+	bench.port = TCreatePort(tags);
+	bench.lockfree = lockfree;
+	bench.numiter = numiter;
+	bench.errors = 0;
+	if (bench.port == TNULL)
+		return 0;
+
+	tags[0].tti_Tag = TTask_UserData;
+	tags[0].tti_Value = (TTAG) &bench;
+	TInitHook(&hook, bench_producerfunc, TNULL);
+
+	TGetSystemTime(&t0);
+	for (i = 0; i < numprod; ++i)
+	{
+		prod[i] = TCreateTask(&hook, tags);
+		if (prod[i] == TNULL)
+			break;
+	}
+	numprod = i;
+	while (got < numprod * numiter)
+	{
+		TINT *msg;
+		TWaitPort(bench.port);
+		while ((msg = TGetMsg(bench.port)))
+		{
+			msg[1] = msg[0] + 1;
+			TReplyMsg(msg);
+			got++;
+		}
+	}
+	for (i = 0; i < numprod; ++i)
+		TDestroy((struct THandle *) prod[i]);
+	t = bench_elapsed(TExecBase, &t0);
+
+	TDestroy((struct THandle *) bench.port);
+	if (bench.errors)
+		printf("*** %d replies corrupted\n", (int) bench.errors);
+	return t > 0 ? got / t : 0;
+}
+
+/*****************************************************************************/
+
+int main(int argc, char **argv)
+{
+	TINT numiter = argc > 1 ? atoi(argv[1]) : BENCH_DEFITER;
+	TTAGITEM tags[2];
+	struct TTask *task;
+
+	tags[0].tti_Tag = TExecBase_ModInit;
+	tags[0].tti_Value = (TTAG) bench_initmodules;
+	tags[1].tti_Tag = TTAG_DONE;
+	task = TEKCreate(tags);
+	if (task)
+	{
+		struct TExecBase *TExecBase = TGetExecBase(task);
+		TINT numprod;
+		printf("%d round trips per producer, window %d\n",
+			(int) numiter, BENCH_WINDOW);
+		for (numprod = 1; numprod <= 3; numprod += 2)
+		{
+			printf("%d producer(s), locked:    %10.0f round trips/s\n",
+				(int) numprod, bench_run(TExecBase, numprod, TFALSE, numiter));
+			printf("%d producer(s), lock-free: %10.0f round trips/s\n",
+				(int) numprod, bench_run(TExecBase, numprod, TTRUE, numiter));
+		}
+		TDestroy((struct THandle *) task);
+		return EXIT_SUCCESS;
+	}
+	return EXIT_FAILURE;
+}
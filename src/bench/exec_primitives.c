@@ -0,0 +1,100 @@
+/*
+**	teklib/src/bench/exec_primitives.c - Exec primitives microbenchmark
+**
+**	Written by agent <agent at local>
+**	See copyright notice in teklib/COPYRIGHT
+**
+**	Measures the cost of frequently used exec functions, called in a
+**	loop by a single task. Most of them look up the calling thread in
+**	the HAL. To compare with the lookup through the pthread key only,
+**	rebuild the libraries with CFLAGS=-DHAL_POSIX_NO_TLS.
+**
+**	Usage: exec_primitives [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <tek/teklib.h>
+#include <tek/proto/hal.h>
+#include <tek/proto/exec.h>
+#include <tek/inline/exec.h>
+
+#define BENCH_DEFITER	2000000
+
+/* time a statement, print nanoseconds per iteration: */
+#define BENCH_LOOP(name, stmt) \
+do { \
+	TTIME t0; TINT i; \
+	TGetSystemTime(&t0); \
+	for (i = 0; i < numiter; ++i) { stmt; } \
+	printf("%-20s %8.1f ns\n", name, \
+		bench_elapsed(TExecBase, &t0) * 1e9 / numiter); \
+} while (0)
+
+static const struct TInitModule bench_initmodules[] =
+{
+	{"hal", tek_init_hal, TNULL, 0},
+	{"exec", tek_init_exec, TNULL, 0},
+	{ TNULL, TNULL, TNULL, 0 }
+};
+
+/*****************************************************************************/
+
+static double bench_elapsed(struct TExecBase *TExecBase, TTIME *t0)
+{
+	TTIME t;
+	TGetSystemTime(&t);
+	TSubTime(&t, t0);
+	return (double) t.tdt_Int64 / 1000000;
+}
+
+/*****************************************************************************/
+
+static void bench_run(struct TExecBase *TExecBase, TINT numiter)
+{
+	struct TTask *self = TFindTask(TNULL);
+	struct TLock *lock = TCreateLock(TNULL);
+	struct TMsgPort *port = TCreatePort(TNULL);
+	TAPTR msg = TAllocMsg(16);
+
+	if (lock && port && msg)
+	{
+		BENCH_LOOP("TFindTask", TFindTask(TNULL));
+		BENCH_LOOP("TLock/TUnlock", TLock(lock); TUnlock(lock));
+		BENCH_LOOP("TPutMsg/TGetMsg",
+			TPutMsg(port, TNULL, msg); TGetMsg(port));
+		BENCH_LOOP("TSignal/TWait",
+			TSignal(self, TTASK_SIG_USER); TWait(TTASK_SIG_USER));
+		BENCH_LOOP("TSetSignal", TSetSignal(0, TTASK_SIG_USER));
+		BENCH_LOOP("TAlloc/TFree", TFree(TAlloc(TNULL, 64)));
+		BENCH_LOOP("TAllocMsg/TFree", TFree(TAllocMsg(64)));
+	}
+	else
+		printf("*** out of resources\n");
+
+	TFree(msg);
+	TDestroy((struct THandle *) port);
+	TDestroy((struct THandle *) lock);
+}
+
+/*****************************************************************************/
+
+int main(int argc, char **argv)
+{
+	TINT numiter = argc > 1 ? atoi(argv[1]) : BENCH_DEFITER;
+	TTAGITEM tags[2];
+	struct TTask *task;
+
+	tags[0].tti_Tag = TExecBase_ModInit;
+	tags[0].tti_Value = (TTAG) bench_initmodules;
+	tags[1].tti_Tag = TTAG_DONE;
+	task = TEKCreate(tags);
+	if (task)
+	{
+		printf("%d iterations per primitive\n", (int) numiter);
+		bench_run(TGetExecBase(task), numiter);
+		TDestroy((struct THandle *) task);
+		return EXIT_SUCCESS;
+	}
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,152 @@
+/*
+**	teklib/src/bench/exec_signals.c - Task signal benchmark
+**
+**	Written by agent <agent at local>
+**	See copyright notice in teklib/COPYRIGHT
+**
+**	Measures a TSignal()/TWait() round trip between two tasks, the cost
+**	of TSignal() when the receiver is not waiting, and checks that a
+**	timed wait without signals returns after its timeout. To compare
+**	with the condvar implementation, rebuild the libraries with
+**	CFLAGS=-DHAL_POSIX_NO_FUTEX.
+**
+**	Usage: exec_signals [round trips]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <tek/teklib.h>
+#include <tek/proto/hal.h>
+#include <tek/proto/exec.h>
+#include <tek/inline/exec.h>
+
+#define BENCH_DEFITER	200000
+#define BENCH_TIMEOUT	20000	/* microseconds */
+#define BENCH_SIG_IDLE	0x100	/* a signal nobody waits for */
+
+struct Bench
+{
+	struct TTask *maintask;
+	TINT numiter;
+};
+
+static const struct TInitModule bench_initmodules[] =
+{
+	{"hal", tek_init_hal, TNULL, 0},
+	{"exec", tek_init_exec, TNULL, 0},
+	{ TNULL, TNULL, TNULL, 0 }
+};
+
+/*****************************************************************************/
+
+static double bench_elapsed(struct TExecBase *TExecBase, TTIME *t0)
+{
+	TTIME t;
+	TGetSystemTime(&t);
+	TSubTime(&t, t0);
+	return (double) t.tdt_Int64 / 1000000;
+}
+
+/*****************************************************************************/
+/*
+**	partner: answer each signal, then wait for the abort signal
+*/
+
+static THOOKENTRY TTAG bench_partnerfunc(struct THook *hook, TAPTR obj,
+	TTAG msg)
+{
+	switch (msg)
+	{
+		case TMSG_INITTASK:
+			return TTRUE;
+		case TMSG_RUNTASK:
+		{
+			struct TExecBase *TExecBase = TGetExecBase(obj);
+			struct Bench *bench = TGetTaskData(obj);
+			TINT i;
+			for (i = 0; i < bench->numiter; ++i)
+			{
+				TWait(TTASK_SIG_USER);
+				TSignal(bench->maintask, TTASK_SIG_USER);
+			}
+			TWait(TTASK_SIG_ABORT);
+			break;
+		}
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+
+static void bench_run(struct TExecBase *TExecBase, TINT numiter)
+{
+	struct Bench bench;
+	struct THook hook;
+	struct TTask *partner;
+	TTAGITEM tags[2];
+	TTIME t0, timeout;
+	TUINT sig;
+	TINT i;
+	double t;
+
+	bench.maintask = TFindTask(TNULL);
+	bench.numiter = numiter;
+	tags[0].tti_Tag = TTask_UserData;
+	tags[0].tti_Value = (TTAG) &bench;
+	tags[1].tti_Tag = TTAG_DONE;
+	TInitHook(&hook, bench_partnerfunc, TNULL);
+	partner = TCreateTask(&hook, tags);
+	if (partner == TNULL)
+	{
+		printf("*** cannot create task\n");
+		return;
+	}
+
+	TGetSystemTime(&t0);
+	for (i = 0; i < numiter; ++i)
+	{
+		TSignal(partner, TTASK_SIG_USER);
+		TWait(TTASK_SIG_USER);
+	}
+	t = bench_elapsed(TExecBase, &t0);
+	printf("round trip:           %8.2f us\n", t * 1e6 / numiter);
+
+	TGetSystemTime(&t0);
+	for (i = 0; i < numiter * 5; ++i)
+		TSignal(bench.maintask, BENCH_SIG_IDLE);
+	t = bench_elapsed(TExecBase, &t0);
+	TSetSignal(0, BENCH_SIG_IDLE);
+	printf("TSignal, no waiter:   %8.1f ns\n", t * 1e9 / (numiter * 5));
+
+	timeout.tdt_Int64 = BENCH_TIMEOUT;
+	TGetSystemTime(&t0);
+	sig = TWaitTime(&timeout, BENCH_SIG_IDLE);
+	t = bench_elapsed(TExecBase, &t0);
+	printf("timed wait %d ms:     %8.1f ms%s\n", BENCH_TIMEOUT / 1000,
+		t * 1e3, sig ? " *** signalled" : "");
+
+	TSignal(partner, TTASK_SIG_ABORT);
+	TDestroy((struct THandle *) partner);
+}
+
+/*****************************************************************************/
+
+int main(int argc, char **argv)
+{
+	TINT numiter = argc > 1 ? atoi(argv[1]) : BENCH_DEFITER;
+	TTAGITEM tags[2];
+	struct TTask *task;
+
+	tags[0].tti_Tag = TExecBase_ModInit;
+	tags[0].tti_Value = (TTAG) bench_initmodules;
+	tags[1].tti_Tag = TTAG_DONE;
+	task = TEKCreate(tags);
+	if (task)
+	{
+		printf("%d round trips\n", (int) numiter);
+		bench_run(TGetExecBase(task), numiter);
+		TDestroy((struct THandle *) task);
+		return EXIT_SUCCESS;
+	}
+	return EXIT_FAILURE;
+}
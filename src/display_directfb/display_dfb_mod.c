@@ -454,6 +454,15 @@ dfb_docmd(DFBDISPLAY *inst, struct TVRequest *req)
 		case TVCMD_SETCLIPRECT: dfb_setcliprect(inst, req); break;
 		case TVCMD_UNSETCLIPRECT: dfb_unsetcliprect(inst, req); break;
 		case TVCMD_DRAWBUFFER: dfb_drawbuffer(inst, req); break;
+		case TVCMD_ALLOCBUFFER: /* not supported */ break;
+		case TVCMD_BATCH:
+		{
+			struct TNode *next,
+				*node = req->tvr_Op.Batch.Commands.tlh_Head.tln_Succ;
+			for (; (next = node->tln_Succ); node = next)
+				dfb_docmd(inst, (struct TVRequest *) node);
+			break;
+		}
 		default:
 			TDBPRINTF(TDB_ERROR,("Unknown command code: %d\n",
 			req->tvr_Req.io_Command));
@@ -269,10 +269,13 @@ static void rfb_openvisual(struct rfb_Display *mod, struct TVRequest *req)
 	v->rfbw_FGPen = TVPEN_UNDEFINED;
 
 	region_init(&mod->rfb_RectPool, &v->rfbw_DirtyRegion, TNULL);
+	region_init(&mod->rfb_RectPool, &v->rfbw_Layers, TNULL);
 
 	/* add window on top of window stack: */
 	TLock(mod->rfb_Lock);
 	TAddHead(&mod->rfb_VisualList, &v->rfbw_Node);
+	rfb_invalidatelayers(mod);
+	v->rfbw_LayersGen = mod->rfb_LayersGen - 1;
 	rfb_focuswindow(mod, v);
 	if (v->rfbw_InputMask & TITYPE_INTERVAL)
 		mod->rfb_NumInterval++;
@@ -315,6 +318,7 @@ static void rfb_closevisual(struct rfb_Display *mod, struct TVRequest *req)
 		mod->rfb_FocusWindow = TNULL;
 
 	TRemove(&v->rfbw_Node);
+	rfb_invalidatelayers(mod);
 
 	if (v->rfbw_InputMask & TITYPE_INTERVAL)
 		mod->rfb_NumInterval--;
@@ -350,6 +354,7 @@ static void rfb_closevisual(struct rfb_Display *mod, struct TVRequest *req)
 	TUnlock(mod->rfb_Lock);
 
 	region_free(&mod->rfb_RectPool, &v->rfbw_DirtyRegion);
+	region_free(&mod->rfb_RectPool, &v->rfbw_Layers);
 
 	TFree(v);
 
@@ -696,19 +701,61 @@ static void rfb_drawbuffer(struct rfb_Display *mod, struct TVRequest *req)
 	TINT w = req->tvr_Op.DrawBuffer.RRect[2];
 	TINT h = req->tvr_Op.DrawBuffer.RRect[3];
 
+	struct rfb_Buffer *buf = (struct rfb_Buffer *)
+		TGetTag(tags, TVisual_Buffer, TNULL);
+	if (buf)
+	{
+		/* registered buffer, tiled from the given origin: */
+		TINT rect[4];
+		TINT ox = TGetTag(tags, TVisual_OrigX, x) + v->rfbw_WinRect.r[0];
+		TINT oy = TGetTag(tags, TVisual_OrigY, y) + v->rfbw_WinRect.r[1];
+
+		rect[0] = x + v->rfbw_WinRect.r[0];
+		rect[1] = y + v->rfbw_WinRect.r[1];
+		rect[2] = rect[0] + w - 1;
+		rect[3] = rect[1] + h - 1;
+		fbp_drawtiles(mod, v, &buf->pixbuf, buf->width, buf->height, rect,
+			ox, oy, buf->alpha);
+		return;
+	}
+
 	src.tpb_Data = req->tvr_Op.DrawBuffer.Buf;
 	src.tpb_Format = TGetTag(tags, TVisual_PixelFormat, TVPIXFMT_A8R8G8B8);
 	src.tpb_BytesPerLine = req->tvr_Op.DrawBuffer.TotWidth *
 		TVPIXFMT_BYTES_PER_PIXEL(src.tpb_Format);
 	TBOOL alpha = TGetTag(tags, TVisual_AlphaChannel, TFALSE);
+	TINT strip = TGetTag(tags, TVisual_Strip, 0);
+
+	if (strip)
+	{
+		/* a single row or column, repeated: */
+		TINT rect[4];
+
+		if (!src.tpb_Data)
+			return;
+		rect[0] = x + v->rfbw_WinRect.r[0];
+		rect[1] = y + v->rfbw_WinRect.r[1];
+		rect[2] = rect[0] + w - 1;
+		rect[3] = rect[1] + h - 1;
+		if (strip == TVSTRIP_COLUMN)
+		{
+			src.tpb_BytesPerLine = TVPIXFMT_BYTES_PER_PIXEL(src.tpb_Format);
+			fbp_drawcolumn(mod, v, &src, rect);
+		}
+		else
+		{
+			src.tpb_BytesPerLine = 0;
+			fbp_drawbuffer(mod, v, &src, rect, alpha);
+		}
+		return;
+	}
 
 #if defined(RFB_PIXMAP_CACHE)
+	struct ImageCacheState cstate;
 	struct TVImageCacheRequest *creq = (struct TVImageCacheRequest *)
 		TGetTag(tags, TVisual_CacheRequest, TNULL);
 	if (creq)
 	{
-		struct ImageCacheState cstate;
-
 		cstate.src = src;
 		cstate.dst.tpb_Format = alpha ?
 			src.tpb_Format : mod->rfb_PixBuf.tpb_Format;
@@ -722,16 +769,84 @@ static void rfb_drawbuffer(struct rfb_Display *mod, struct TVRequest *req)
 	}
 #endif
 
-	if (!src.tpb_Data)
+	if (src.tpb_Data)
+	{
+		TINT rect[4];
+
+		rect[0] = x + v->rfbw_WinRect.r[0];
+		rect[1] = y + v->rfbw_WinRect.r[1];
+		rect[2] = rect[0] + w - 1;
+		rect[3] = rect[1] + h - 1;
+		fbp_drawbuffer(mod, v, &src, rect, alpha);
+	}
+
+#if defined(RFB_PIXMAP_CACHE)
+	/* src may point into the cache until here: */
+	if (creq)
+		imgcache_unlock(&cstate);
+#endif
+}
+
+/*****************************************************************************/
+
+static void rfb_allocbuffer(struct rfb_Display *mod, struct TVRequest *req)
+{
+	TAPTR TExecBase = TGetExecBase(mod);
+	TTAGITEM *tags = req->tvr_Op.AllocBuffer.Tags;
+	TINT w = req->tvr_Op.AllocBuffer.Width;
+	TINT h = req->tvr_Op.AllocBuffer.Height;
+	TBOOL alpha = TGetTag(tags, TVisual_AlphaChannel, TFALSE);
+	struct TVPixBuf src;
+	struct rfb_Buffer *buf;
+	TUINT dfmt;
+	TSIZE bpp, size;
+
+	req->tvr_Op.AllocBuffer.Handle = TNULL;
+	src.tpb_Data = req->tvr_Op.AllocBuffer.Buf;
+	if (src.tpb_Data == TNULL || w <= 0 || h <= 0)
 		return;
+	src.tpb_Format = TGetTag(tags, TVisual_PixelFormat, TVPIXFMT_A8R8G8B8);
+	src.tpb_BytesPerLine = req->tvr_Op.AllocBuffer.TotWidth *
+		TVPIXFMT_BYTES_PER_PIXEL(src.tpb_Format);
 
-	TINT rect[4];
+	/* keep pixels with alpha in their format, like the image cache does: */
+	dfmt = alpha ? src.tpb_Format : mod->rfb_PixBuf.tpb_Format;
+	bpp = TVPIXFMT_BYTES_PER_PIXEL(dfmt);
+	/* reject unknown formats and sizes that overflow: */
+	if (bpp == 0 || (TSIZE) w > 0x7fffffff / bpp ||
+		(TSIZE) h > ((TSIZE) -1 - sizeof(struct rfb_Buffer)) / (w * bpp))
+		return;
+	size = sizeof(struct rfb_Buffer) + (TSIZE) w * h * bpp;
+	buf = TAlloc(mod->rfb_MemMgr, size);
+	if (buf == TNULL)
+		return;
+	memset(&buf->handle, 0, sizeof buf->handle);
+	buf->handle.thn_Owner = mod;
+	buf->pixbuf.tpb_Data = (TUINT8 *) (buf + 1);
+	buf->pixbuf.tpb_Format = dfmt;
+	buf->pixbuf.tpb_BytesPerLine = w * bpp;
+	buf->width = w;
+	buf->height = h;
+	buf->alpha = alpha;
+	if (pixconv_convert(&src, &buf->pixbuf, 0, 0, w - 1, h - 1, 0, 0,
+		TFALSE, TFALSE))
+	{
+		TFree(buf);
+		return;
+	}
+	TAddTail(&mod->rfb_BufferList, &buf->handle.thn_Node);
+	req->tvr_Op.AllocBuffer.Handle = buf;
+}
+
+/*****************************************************************************/
+
+static void rfb_freebuffer(struct rfb_Display *mod, struct TVRequest *req)
+{
+	TAPTR TExecBase = TGetExecBase(mod);
+	struct rfb_Buffer *buf = req->tvr_Op.FreeBuffer.Handle;
 
-	rect[0] = x + v->rfbw_WinRect.r[0];
-	rect[1] = y + v->rfbw_WinRect.r[1];
-	rect[2] = rect[0] + w - 1;
-	rect[3] = rect[1] + h - 1;
-	fbp_drawbuffer(mod, v, &src, rect, alpha);
+	TRemove(&buf->handle.thn_Node);
+	TFree(buf);
 }
 
 /*****************************************************************************/
@@ -796,6 +911,7 @@ static void rfb_movewindow(struct rfb_Display *mod, struct rfb_Window *v,
 
 	/* remove the window from window stack */
 	TRemove(&v->rfbw_Node);
+	rfb_invalidatelayers(mod);
 
 	TBOOL res = TFALSE;
 
@@ -842,11 +958,15 @@ static void rfb_movewindow(struct rfb_Display *mod, struct rfb_Window *v,
 	if (predv)
 	{
 		TInsert(&mod->rfb_VisualList, &v->rfbw_Node, &predv->rfbw_Node);
+		rfb_invalidatelayers(mod);
 		if (res)
 			rbp_move_expose(mod, v, predv, dx, dy);
 	}
 	else
+	{
 		TAddHead(&mod->rfb_VisualList, &v->rfbw_Node);
+		rfb_invalidatelayers(mod);
+	}
 
 	struct RectPool *pool = &mod->rfb_RectPool;
 	struct Region R;
@@ -1142,6 +1262,7 @@ static void rfb_setattrs(struct rfb_Display *mod, struct TVRequest *req)
 						TLock(mod->rfb_Lock);
 						TRemove(&v->rfbw_Node);
 						TAddHead(&mod->rfb_VisualList, &v->rfbw_Node);
+						rfb_invalidatelayers(mod);
 						TUnlock(mod->rfb_Lock);
 						rfb_damage(mod, v->rfbw_ScreenRect.r, TNULL);
 					}
@@ -1416,6 +1537,12 @@ LOCAL void rfb_docmd(struct rfb_Display *mod, struct TVRequest *req)
 		case TVCMD_DRAWBUFFER:
 			rfb_drawbuffer(mod, req);
 			break;
+		case TVCMD_ALLOCBUFFER:
+			rfb_allocbuffer(mod, req);
+			break;
+		case TVCMD_FREEBUFFER:
+			rfb_freebuffer(mod, req);
+			break;
 		case TVCMD_FLUSH:
 			rfb_flush(mod, req);
 			break;
@@ -865,6 +865,92 @@ LOCAL void fbp_drawbuffer(struct rfb_Display *mod, struct rfb_Window *v,
 	region_free(&mod->rfb_RectPool, &R);
 }
 
+/*****************************************************************************/
+/*
+**	Fill rect from a single column in src, repeating each of its pixels
+**	across the row.
+*/
+
+LOCAL void fbp_drawcolumn(struct rfb_Display *mod, struct rfb_Window *v,
+	struct TVPixBuf *src, TINT rect[4])
+{
+	struct Region R;
+
+	if (!rfb_getlayermask(mod, &R, v->rfbw_ClipRect.r, v, 0, 0))
+		return;
+	region_andrect(&mod->rfb_RectPool, &R, rect, 0, 0);
+	TUINT dfmt = v->rfbw_PixBuf.tpb_Format;
+	TINT bpp = TVPIXFMT_BYTES_PER_PIXEL(dfmt);
+	struct TNode *next, *node = R.rg_Rects.rl_List.tlh_Head.tln_Succ;
+
+	for (; (next = node->tln_Succ); node = next)
+	{
+		struct RectNode *r = (struct RectNode *) node;
+		TINT x0 = r->rn_Rect[0];
+		TINT y0 = r->rn_Rect[1];
+		TINT x1 = r->rn_Rect[2];
+		TINT y1 = r->rn_Rect[3];
+		TUINT8 *buf = TVPB_GETADDRESS(&v->rfbw_PixBuf, x0, y0);
+		TINT y;
+
+		rfb_markdirty(mod, v, r->rn_Rect);
+		pixconv_convert(src, &v->rfbw_PixBuf, x0, y0, x0, y1, 0,
+			y0 - rect[1], 0, 0);
+		if (x1 > x0)
+			for (y = y0; y <= y1; y++, buf += v->rfbw_PixBuf.tpb_BytesPerLine)
+				pixconv_line_set(buf + bpp, dfmt, x1 - x0,
+					pixconv_getpixel(buf, dfmt));
+	}
+	region_free(&mod->rfb_RectPool, &R);
+}
+
+/*****************************************************************************/
+/*
+**	Fill rect with tiles of size tw * th from src, with the upper left edge
+**	of a tile at ox, oy. Buffers in device format are copied row by row.
+*/
+
+LOCAL void fbp_drawtiles(struct rfb_Display *mod, struct rfb_Window *v,
+	struct TVPixBuf *src, TINT tw, TINT th, TINT rect[4], TINT ox, TINT oy,
+	TBOOL alpha)
+{
+	struct Region R;
+
+	if (!rfb_getlayermask(mod, &R, v->rfbw_ClipRect.r, v, 0, 0))
+		return;
+	region_andrect(&mod->rfb_RectPool, &R, rect, 0, 0);
+	struct TNode *next, *node = R.rg_Rects.rl_List.tlh_Head.tln_Succ;
+
+	for (; (next = node->tln_Succ); node = next)
+	{
+		struct RectNode *r = (struct RectNode *) node;
+		TINT x0 = r->rn_Rect[0];
+		TINT y0 = r->rn_Rect[1];
+		TINT x1 = r->rn_Rect[2];
+		TINT y1 = r->rn_Rect[3];
+		TINT x, y, sx, sy, dw, dh;
+
+		rfb_markdirty(mod, v, r->rn_Rect);
+		sy = (y0 - oy) % th;
+		if (sy < 0)
+			sy += th;
+		for (y = y0; y <= y1; y += dh, sy = 0)
+		{
+			dh = TMIN(y1 - y + 1, th - sy);
+			sx = (x0 - ox) % tw;
+			if (sx < 0)
+				sx += tw;
+			for (x = x0; x <= x1; x += dw, sx = 0)
+			{
+				dw = TMIN(x1 - x + 1, tw - sx);
+				pixconv_convert(src, &v->rfbw_PixBuf, x, y, x + dw - 1,
+					y + dh - 1, sx, sy, alpha, 0);
+			}
+		}
+	}
+	region_free(&mod->rfb_RectPool, &R);
+}
+
 /*****************************************************************************/
 
 LOCAL void fbp_doexpose(struct rfb_Display *mod, struct rfb_Window *v,
@@ -768,9 +768,45 @@ LOCAL TINT rfb_hosttextsize(struct rfb_Display *mod, TAPTR font, TSTRPTR text,
 **  - a pen to color the text
 **
 ** NOTES:
-**  - the text is clipped against v->rfbw_UserClipRect[4]
+**  - the text is clipped against v->rfbw_ClipRect[4]
+**  - the glyphs are first composed into a single coverage mask, which is
+**    then blended and marked dirty once per rectangle of the layer mask
 */
 
+static TBOOL rfb_gettextbuf(struct rfb_Display *mod, TSIZE size)
+{
+	if (size > mod->rfb_TextBufSize)
+	{
+		TAPTR TExecBase = TGetExecBase(mod);
+		TFree(mod->rfb_TextBuf);
+		mod->rfb_TextBuf = TAlloc(mod->rfb_MemMgr, size);
+		mod->rfb_TextBufSize = mod->rfb_TextBuf ? size : 0;
+	}
+	return mod->rfb_TextBuf != TNULL;
+}
+
+static void rfb_composeglyph(TUINT8 *mask, TINT *ext, FTC_SBit sbit,
+	TINT gx, TINT gy)
+{
+	TINT mw = ext[2] - ext[0] + 1;
+	TINT x0 = TMAX(gx, ext[0]);
+	TINT y0 = TMAX(gy, ext[1]);
+	TINT x1 = TMIN(gx + sbit->width - 1, ext[2]);
+	TINT y1 = TMIN(gy + sbit->height - 1, ext[3]);
+	TINT x, y;
+
+	for (y = y0; y <= y1; ++y)
+	{
+		TUINT8 *s = sbit->buffer + (y - gy) * sbit->pitch + (x0 - gx);
+		TUINT8 *d = mask + (y - ext[1]) * mw + (x0 - ext[0]);
+
+		/* overlapping glyphs keep the stronger coverage */
+		for (x = 0; x <= x1 - x0; ++x)
+			if (s[x] > d[x])
+				d[x] = s[x];
+	}
+}
+
 LOCAL TVOID rfb_hostdrawtext(struct rfb_Display *mod, struct rfb_Window *v,
 	TSTRPTR text, TINT len, TINT posx, TINT posy, TVPEN fgpen)
 {
@@ -778,12 +814,7 @@ LOCAL TVOID rfb_hostdrawtext(struct rfb_Display *mod, struct rfb_Window *v,
 		return;
 	struct rfb_FontNode *myface = v->rfbw_CurrentFont;
 
-	if (!myface)
-		return;
-
-	struct Region R;
-
-	if (!rfb_getlayermask(mod, &R, v->rfbw_ClipRect.r, v, 0, 0))
+	if (!myface || v->rfbw_ClipRect.r[0] < 0)
 		return;
 
 	struct rfb_Pen *textpen = (struct rfb_Pen *) fgpen;
@@ -794,6 +825,9 @@ LOCAL TVOID rfb_hostdrawtext(struct rfb_Display *mod, struct rfb_Window *v,
 	TUINT tr = (textpen->rgb >> 16) & 0xff;
 	TUINT tg = (textpen->rgb >> 8) & 0xff;
 	TUINT tb = textpen->rgb & 0xff;
+	TBOOL empty = TTRUE;
+	TINT ext[4];
+	TINT x = posx;
 	int i = 0;
 	int c;
 
@@ -802,6 +836,8 @@ LOCAL TVOID rfb_hostdrawtext(struct rfb_Display *mod, struct rfb_Window *v,
 	imgtype.height = myface->pxsize;
 	imgtype.flags = FT_LOAD_DEFAULT | FT_LOAD_RENDER;
 
+	/* determine the extent of the glyph run: */
+
 	utf8initreader(&rd, (const unsigned char *) text, -1);
 
 	while (i++ < len && (c = utf8read(&rd)) > 0)
@@ -813,50 +849,85 @@ LOCAL TVOID rfb_hostdrawtext(struct rfb_Display *mod, struct rfb_Window *v,
 				&sbit, NULL))
 			continue;
 
-		struct
+		if (sbit->width > 0 && sbit->height > 0)
 		{
-			int x, y;
-		} pen;
+			TINT gx = x + sbit->left;
+			TINT gy = posy + asc - sbit->top;
+
+			if (empty)
+			{
+				ext[0] = gx;
+				ext[1] = gy;
+				ext[2] = gx + sbit->width - 1;
+				ext[3] = gy + sbit->height - 1;
+				empty = TFALSE;
+			}
+			else
+			{
+				ext[0] = TMIN(ext[0], gx);
+				ext[1] = TMIN(ext[1], gy);
+				ext[2] = TMAX(ext[2], gx + sbit->width - 1);
+				ext[3] = TMAX(ext[3], gy + sbit->height - 1);
+			}
+		}
+		x += sbit->xadvance;
+	}
 
-		pen.x = posx + sbit->left;
-		pen.y = posy + asc - sbit->top;
-		posx += sbit->xadvance;
+	if (empty || !region_intersect(ext, v->rfbw_ClipRect.r))
+		return;
 
-		struct TNode *next, *node = R.rg_Rects.rl_List.tlh_Head.tln_Succ;
+	TINT mw = ext[2] - ext[0] + 1;
+	TINT mh = ext[3] - ext[1] + 1;
 
-		for (; (next = node->tln_Succ); node = next)
-		{
-			struct RectNode *rn = (struct RectNode *) node;
-			TINT *r = rn->rn_Rect;
+	if (!rfb_gettextbuf(mod, (TSIZE) mw * mh))
+		return;
+
+	struct Region R;
 
-			rfb_markdirty(mod, v, r);
+	if (!rfb_getlayermask(mod, &R, ext, v, 0, 0))
+		return;
+
+	/* compose the coverage mask. glyphs are looked up again, as cached
+	** bitmaps are only guaranteed to be valid until the next lookup: */
+
+	TUINT8 *mask = mod->rfb_TextBuf;
 
-			int y;
-			int cx = 0, cy = 0;
-			int cw = sbit->width;
-			int ch = sbit->height;
+	memset(mask, 0, (size_t) mw * mh);
+	utf8initreader(&rd, (const unsigned char *) text, -1);
+	x = posx;
+	i = 0;
+
+	while (i++ < len && (c = utf8read(&rd)) > 0)
+	{
+		FTC_SBit sbit;
+		FT_UInt gindex =
+			FTC_CMapCache_Lookup(mod->rfb_FTCCMapCache, myface, -1, c);
+		if (FTC_SBitCache_Lookup(mod->rfb_FTCSBitCache, &imgtype, gindex,
+				&sbit, NULL))
+			continue;
+		rfb_composeglyph(mask, ext, sbit, x + sbit->left,
+			posy + asc - sbit->top);
+		x += sbit->xadvance;
+	}
 
-			/* clipping tests */
-			if (r[0] > pen.x)
-				cx = r[0] - pen.x;
+	/* blend the mask and mark dirty once per rectangle: */
 
-			if (r[1] > pen.y)
-				cy = r[1] - pen.y;
+	struct TNode *next, *node = R.rg_Rects.rl_List.tlh_Head.tln_Succ;
 
-			if (r[2] < pen.x + sbit->width)
-				cw -= (pen.x + sbit->width) - r[2] - 1;
+	for (; (next = node->tln_Succ); node = next)
+	{
+		struct RectNode *rn = (struct RectNode *) node;
+		TINT *r = rn->rn_Rect;
+		TINT y;
 
-			if (r[3] < pen.y + sbit->height)
-				ch -= (pen.y + sbit->height) - r[3] - 1;
+		rfb_markdirty(mod, v, r);
+		for (y = r[1]; y <= r[3]; ++y)
+		{
+			TUINT8 *sbuf = mask + (y - ext[1]) * mw + (r[0] - ext[0]);
+			TUINT8 *dbuf = TVPB_GETADDRESS(&v->rfbw_PixBuf, r[0], y);
 
-			for (y = cy; y < ch; y++)
-			{
-				TUINT8 *sbuf = sbit->buffer + y * sbit->width + cx;
-				TUINT8 *dbuf =
-					TVPB_GETADDRESS(&v->rfbw_PixBuf, cx + pen.x, y + pen.y);
-				pixconv_writealpha(dbuf, sbuf, cw - cx,
-					v->rfbw_PixBuf.tpb_Format, tr, tg, tb);
-			}
+			pixconv_writealpha(dbuf, sbuf, r[2] - r[0] + 1,
+				v->rfbw_PixBuf.tpb_Format, tr, tg, tb);
 		}
 	}
 
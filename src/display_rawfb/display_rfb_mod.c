@@ -6,8 +6,10 @@
 **	See copyright notice in teklib/COPYRIGHT
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include <tek/inline/exec.h>
+#include <tek/mod/exec.h>
 #include <tek/lib/imgload.h>
 #include <tek/mod/display.h>
 
@@ -356,6 +358,25 @@ static TINT rfb_cmdrectaffected(struct rfb_Display *mod, struct TVRequest *req,
 	return region_intersect(result, v->rfbw_ClipRect.r);
 }
 
+static TBOOL rfb_runcmd(struct rfb_Display *mod, struct TVRequest *req,
+	TBOOL checkrect)
+{
+	if (checkrect)
+	{
+		TINT arec[4];
+		TINT res = rfb_cmdrectaffected(mod, req, arec, TTRUE);
+
+		if (res < 0 || (res > 0 &&
+				REGION_OVERLAPRECT(mod->rfb_PtrBackBuffer.rect, arec)))
+		{
+			rfb_restoreptrbg(mod);
+			checkrect = TFALSE;
+		}
+	}
+	rfb_docmd(mod, req);
+	return checkrect;
+}
+
 /*****************************************************************************/
 /*
 **	AllocReq/FreeReq
@@ -433,6 +454,215 @@ LOCAL void rfb_putbackmsg(struct rfb_Display *mod, TIMSG *msg)
 	TUnlock(mod->rfb_InstanceLock);
 }
 
+/*****************************************************************************/
+/*
+**	Flush workers: The conversions of a flush are collected as jobs, and
+**	the display task and the worker tasks take jobs until none are left.
+*/
+
+static void rfb_dojob(struct rfb_Display *mod, struct rfb_FlushJob *job)
+{
+	if (mod->rfb_JobsRotate)
+	{
+		/* the device buffer in its unrotated geometry: */
+		struct TVPixBuf dev = *job->dst;
+
+		dev.tpb_BytesPerLine = mod->rfb_finfo.line_length;
+		if (pixconv_rotate_convert(job->src, &dev, job->x0, job->y0,
+			job->x1, job->y1, job->sx, job->sy, mod->rfb_rotation,
+			mod->rfb_vinfo.xres, mod->rfb_vinfo.yres))
+			pixconv_transform_convert(job->src, job->dst, job->x0, job->y0,
+				job->x1, job->y1, job->sx, job->sy, TFALSE, TFALSE,
+				rfb_address_rotate, mod);
+	}
+	else
+		pixconv_convert(job->src, job->dst, job->x0, job->y0,
+			job->x1, job->y1, job->sx, job->sy, TFALSE, TFALSE);
+}
+
+static void rfb_dojobs(struct rfb_Display *mod)
+{
+	TAPTR TExecBase = TGetExecBase(mod);
+
+	for (;;)
+	{
+		struct rfb_FlushJob *job;
+
+		TLock(mod->rfb_JobLock);
+		job = mod->rfb_NextJob < mod->rfb_NumJobs ?
+			&mod->rfb_Jobs[mod->rfb_NextJob++] : TNULL;
+		TUnlock(mod->rfb_JobLock);
+		if (job == TNULL)
+			break;
+		rfb_dojob(mod, job);
+	}
+}
+
+static void rfb_workertask(struct TTask *task)
+{
+	TAPTR TExecBase = TGetExecBase(task);
+	struct rfb_Worker *w = TGetTaskData(task);
+	struct rfb_Display *mod = w->mod;
+
+	while (!(TWait(TTASK_SIG_ABORT | TTASK_SIG_USER) & TTASK_SIG_ABORT))
+	{
+		TBOOL done;
+
+		rfb_dojobs(mod);
+		TLock(mod->rfb_JobLock);
+		done = --mod->rfb_WorkersBusy == 0;
+		TUnlock(mod->rfb_JobLock);
+		if (done)
+			TSignal(mod->rfb_FlushTask, mod->rfb_JobDoneSignal);
+	}
+}
+
+static THOOKENTRY TTAG rfb_workerdispatch(struct THook *hook,
+	TAPTR obj, TTAG msg)
+{
+	switch (msg)
+	{
+		case TMSG_INITTASK:
+			return TTRUE;
+		case TMSG_RUNTASK:
+			rfb_workertask(obj);
+			break;
+	}
+	return 0;
+}
+
+static void rfb_initworkers(struct rfb_Display *mod)
+{
+	TAPTR TExecBase = TGetExecBase(mod);
+	TINT i, n = RFB_DEF_WORKERS;
+	char *env = getenv("RAWFB_WORKERS");
+	struct THook hook;
+
+	if (env)
+		n = atoi(env);
+	n = TCLAMP(0, n, RFB_MAX_WORKERS);
+	if (n == 0)
+		return;
+	mod->rfb_FlushTask = TFindTask(TNULL);
+	mod->rfb_JobLock = TCreateLock(TNULL);
+	mod->rfb_JobDoneSignal = TAllocSignal(0);
+	if (mod->rfb_JobLock == TNULL || mod->rfb_JobDoneSignal == 0)
+		return;
+	TInitHook(&hook, rfb_workerdispatch, TNULL);
+	for (i = 0; i < n; ++i)
+	{
+		struct rfb_Worker *w = &mod->rfb_Workers[i];
+		TTAGITEM tags[2];
+
+		tags[0].tti_Tag = TTask_UserData;
+		tags[0].tti_Value = (TTAG) w;
+		tags[1].tti_Tag = TTAG_DONE;
+		w->mod = mod;
+		w->task = TCreateTask(&hook, tags);
+		if (w->task == TNULL)
+			break;
+	}
+	mod->rfb_NumWorkers = i;
+	TDBPRINTF(TDB_INFO, ("%d flush workers\n", i));
+}
+
+static void rfb_exitworkers(struct rfb_Display *mod)
+{
+	TAPTR TExecBase = TGetExecBase(mod);
+	TINT i;
+
+	for (i = 0; i < mod->rfb_NumWorkers; ++i)
+	{
+		TSignal(mod->rfb_Workers[i].task, TTASK_SIG_ABORT);
+		TDestroy((struct THandle *) mod->rfb_Workers[i].task);
+	}
+	mod->rfb_NumWorkers = 0;
+	if (mod->rfb_JobDoneSignal)
+		TFreeSignal(mod->rfb_JobDoneSignal);
+	TDestroy((struct THandle *) mod->rfb_JobLock);
+	TFree(mod->rfb_Jobs);
+}
+
+static void rfb_addjobs(struct rfb_Display *mod, struct TVPixBuf *src,
+	struct TVPixBuf *dst, TINT x0, TINT y0, TINT x1, TINT y1, TINT sx,
+	TINT sy)
+{
+	/* split into bands of rows, so that large rects are shared: */
+	TINT h = y1 - y0 + 1;
+	TINT n = TMIN(mod->rfb_NumWorkers + 1, h / RFB_JOB_MINROWS);
+	TINT i, y;
+
+	if (n < 1)
+		n = 1;
+	if (mod->rfb_NumWorkers > 0 && mod->rfb_NumJobs + n > mod->rfb_MaxJobs)
+	{
+		TAPTR TExecBase = TGetExecBase(mod);
+		TINT max = (mod->rfb_NumJobs + n) * 2;
+		TSIZE size = max * sizeof(struct rfb_FlushJob);
+		struct rfb_FlushJob *jobs = mod->rfb_Jobs ?
+			TRealloc(mod->rfb_Jobs, size) : TAlloc(mod->rfb_MemMgr, size);
+
+		if (jobs)
+		{
+			mod->rfb_Jobs = jobs;
+			mod->rfb_MaxJobs = max;
+		}
+	}
+	if (mod->rfb_NumJobs + n > mod->rfb_MaxJobs)
+	{
+		/* no workers or out of memory, convert right away: */
+		struct rfb_FlushJob job = { src, dst, x0, y0, x1, y1, sx, sy };
+
+		rfb_dojob(mod, &job);
+		return;
+	}
+	for (i = 0, y = y0; i < n; ++i)
+	{
+		struct rfb_FlushJob *job = &mod->rfb_Jobs[mod->rfb_NumJobs++];
+		TINT y2 = y0 + h * (i + 1) / n;
+
+		job->src = src;
+		job->dst = dst;
+		job->x0 = x0;
+		job->y0 = y;
+		job->x1 = x1;
+		job->y1 = y2 - 1;
+		job->sx = sx;
+		job->sy = sy + (y - y0);
+		y = y2;
+	}
+}
+
+static void rfb_runjobs(struct rfb_Display *mod, TSIZE numpixels)
+{
+	TAPTR TExecBase = TGetExecBase(mod);
+	TINT i, n = mod->rfb_NumWorkers;
+
+	if (mod->rfb_NumJobs == 0)
+		return;
+	mod->rfb_NextJob = 0;
+	if (numpixels < RFB_JOB_MINPIXELS)
+		n = 0;
+	n = TMIN(n, mod->rfb_NumJobs - 1);
+	if (n > 0)
+	{
+		TSetSignal(0, mod->rfb_JobDoneSignal);
+		mod->rfb_WorkersBusy = n;
+		for (i = 0; i < n; ++i)
+			TSignal(mod->rfb_Workers[i].task, TTASK_SIG_USER);
+	}
+	rfb_dojobs(mod);
+	while (n > 0)
+	{
+		TLock(mod->rfb_JobLock);
+		n = mod->rfb_WorkersBusy;
+		TUnlock(mod->rfb_JobLock);
+		if (n > 0)
+			TWait(mod->rfb_JobDoneSignal);
+	}
+	mod->rfb_NumJobs = 0;
+}
+
 /*****************************************************************************/
 
 static void rfb_exittask(struct rfb_Display *mod)
@@ -440,11 +670,14 @@ static void rfb_exittask(struct rfb_Display *mod)
 	TAPTR TExecBase = TGetExecBase(mod);
 	struct TNode *imsg, *node, *next;
 
+	rfb_exitworkers(mod);
+
 #if defined(ENABLE_LINUXFB)
 	rfb_linux_exit(mod);
 #endif
 
 	TFree(mod->rfb_PtrBackBuffer.data);
+	TFree(mod->rfb_TextBuf);
 	if (mod->rfb_Flags & RFBFL_PTR_ALLOCATED)
 		TFree(mod->rfb_PtrImage.tpb_Data);
 
@@ -452,6 +685,10 @@ static void rfb_exittask(struct rfb_Display *mod)
 	while ((imsg = TRemHead(&mod->rfb_IMsgPool)))
 		TFree(imsg);
 
+	/* free registered buffers: */
+	while ((node = TRemHead(&mod->rfb_BufferList)))
+		TFree(node);
+
 	/* close all fonts */
 	node = mod->rfb_FontManager.openfonts.tlh_Head.tln_Succ;
 	for (; (next = node->tln_Succ); node = next)
@@ -492,6 +729,9 @@ static TBOOL rfb_inittask(struct TTask *task)
 		/* list of all open visuals: */
 		TInitList(&mod->rfb_VisualList);
 
+		/* list of registered buffers: */
+		TInitList(&mod->rfb_BufferList);
+
 		/* init fontmanager and default font */
 		TInitList(&mod->rfb_FontManager.openfonts);
 
@@ -537,6 +777,8 @@ static TBOOL rfb_inittask(struct TTask *task)
 				break;
 		}
 
+		rfb_initworkers(mod);
+
 		TDBPRINTF(TDB_TRACE, ("Instance init successful\n"));
 		return TTRUE;
 	}
@@ -550,6 +792,8 @@ static void rfb_runtask(struct TTask *task)
 	TAPTR TExecBase = TGetExecBase(task);
 	struct rfb_Display *mod = TGetTaskData(task);
 	struct TVRequest *req;
+	struct TList reqlist;
+	struct TNode *reqnode;
 	TUINT sig = 0;
 
 	TTIME intt = { 20000 };
@@ -573,23 +817,23 @@ static void rfb_runtask(struct TTask *task)
 		if (sig & cmdportsignal)
 		{
 			TBOOL checkrect = mod->rfb_Flags & RFBFL_PTR_VISIBLE;
-			TINT arec[4];
 
-			while ((req = TGetMsg(cmdport)))
+			TInitList(&reqlist);
+			TGetMsgs(cmdport, &reqlist, 0);
+			while ((reqnode = TRemHead(&reqlist)))
 			{
-				if (checkrect)
+				req = TGETMSGBODY(reqnode);
+				if (req->tvr_Req.io_Command == TVCMD_BATCH)
 				{
-					TINT res = rfb_cmdrectaffected(mod, req, arec, TTRUE);
-
-					if (res < 0 || (res > 0 &&
-							REGION_OVERLAPRECT(mod->rfb_PtrBackBuffer.rect,
-								arec)))
-					{
-						rfb_restoreptrbg(mod);
-						checkrect = TFALSE;
-					}
+					/* commands of a batch are not replied individually */
+					struct TNode *next,
+						*node = req->tvr_Op.Batch.Commands.tlh_Head.tln_Succ;
+					for (; (next = node->tln_Succ); node = next)
+						checkrect = rfb_runcmd(mod, (struct TVRequest *) node,
+							checkrect);
 				}
-				rfb_docmd(mod, req);
+				else
+					checkrect = rfb_runcmd(mod, req, checkrect);
 				TReplyMsg(req);
 			}
 		}
@@ -1018,6 +1262,9 @@ static TAPTR rfb_modopen(struct rfb_Display *mod, TTAGITEM *tags)
 
 		if (p)
 			*((TBOOL *) p) = TFALSE;
+		p = TGetTag(tags, TVisual_HaveStrips, TNULL);
+		if (p)
+			*((TBOOL *) p) = TTRUE;
 		return mod;
 	}
 	return TNULL;
@@ -1157,6 +1404,30 @@ LOCAL TBOOL rfb_getlayers(struct rfb_Display *mod, struct Region *A,
 
 /*****************************************************************************/
 
+/*
+**	the region covered by the windows above a window is cached in the
+**	window, and rebuilt only after the window stack or the geometry of a
+**	window has changed, see rfb_invalidatelayers()
+*/
+
+LOCAL void rfb_invalidatelayers(struct rfb_Display *mod)
+{
+	mod->rfb_LayersGen++;
+}
+
+static struct Region *rfb_getcachedlayers(struct rfb_Display *mod,
+	struct rfb_Window *v)
+{
+	if (v->rfbw_LayersGen != mod->rfb_LayersGen)
+	{
+		region_free(&mod->rfb_RectPool, &v->rfbw_Layers);
+		if (!rfb_getlayers(mod, &v->rfbw_Layers, v, 0, 0))
+			return TNULL;
+		v->rfbw_LayersGen = mod->rfb_LayersGen;
+	}
+	return &v->rfbw_Layers;
+}
+
 LOCAL TBOOL rfb_getlayermask(struct rfb_Display *mod, struct Region *A,
 	TINT *crect, struct rfb_Window *v, TINT dx, TINT dy)
 {
@@ -1169,12 +1440,22 @@ LOCAL TBOOL rfb_getlayermask(struct rfb_Display *mod, struct Region *A,
 	if (v->rfbw_Flags & RFBWFL_BACKBUFFER)
 		return TTRUE;
 	TBOOL success = TFALSE;
-	struct Region L;
 
-	if (rfb_getlayers(mod, &L, v, dx, dy))
+	if (dx == 0 && dy == 0)
 	{
-		success = region_subregion(pool, A, &L);
-		region_free(pool, &L);
+		struct Region *L = rfb_getcachedlayers(mod, v);
+
+		success = L && region_subregion(pool, A, L);
+	}
+	else
+	{
+		struct Region L;
+
+		if (rfb_getlayers(mod, &L, v, dx, dy))
+		{
+			success = region_subregion(pool, A, &L);
+			region_free(pool, &L);
+		}
 	}
 	if (!success)
 		region_free(pool, A);
@@ -1335,6 +1616,7 @@ LOCAL void rfb_setwinrect(struct rfb_Display *mod, struct rfb_Window *v)
 		y = v->rfbw_ScreenRect.r[1];
 	}
 	REGION_RECT_SET(&v->rfbw_WinRect, x, y, x + w - 1, y + h - 1);
+	rfb_invalidatelayers(mod);
 }
 
 /*****************************************************************************/
@@ -1393,8 +1675,10 @@ LOCAL void rfb_flush_clients(struct rfb_Display *mod, TBOOL also_external)
 {
 	TAPTR TExecBase = mod->rfb_ExecBase;
 	struct RectPool *pool = &mod->rfb_RectPool;
+	TSIZE numpixels = 0;
 
 	/* flush windows to buffer */
+	mod->rfb_JobsRotate = TFALSE;
 
 	/* screen mask: */
 	struct Rect s;
@@ -1429,8 +1713,9 @@ LOCAL void rfb_flush_clients(struct rfb_Display *mod, TBOOL also_external)
 					TINT x1 = r->rn_Rect[2];
 					TINT y1 = r->rn_Rect[3];
 
-					pixconv_convert(&v->rfbw_PixBuf, &mod->rfb_PixBuf,
-						x0, y0, x1, y1, x0 - sx, y0 - sy, TFALSE, TFALSE);
+					rfb_addjobs(mod, &v->rfbw_PixBuf, &mod->rfb_PixBuf,
+						x0, y0, x1, y1, x0 - sx, y0 - sy);
+					numpixels += (x1 - x0 + 1) * (y1 - y0 + 1);
 
 					region_orrect(pool, &mod->rfb_DirtyRegion, r->rn_Rect,
 						TTRUE);
@@ -1444,6 +1729,8 @@ LOCAL void rfb_flush_clients(struct rfb_Display *mod, TBOOL also_external)
 		}
 		region_free(pool, &S);
 	}
+	/* the dirty rects of windows are disjoint on the screen: */
+	rfb_runjobs(mod, numpixels);
 
 	/* flush buffer to device(s) */
 	if (mod->rfb_Flags & RFBFL_DIRTY)
@@ -1458,6 +1745,8 @@ LOCAL void rfb_flush_clients(struct rfb_Display *mod, TBOOL also_external)
 		/* flush to sub pixbuf: */
 		if (mod->rfb_Flags & RFBFL_BUFFER_DEVICE || mod->rfb_rotation)
 		{
+			numpixels = 0;
+			mod->rfb_JobsRotate = mod->rfb_rotation != 0;
 			node = D->rg_Rects.rl_List.tlh_Head.tln_Succ;
 			for (; (next = node->tln_Succ); node = next)
 			{
@@ -1467,14 +1756,11 @@ LOCAL void rfb_flush_clients(struct rfb_Display *mod, TBOOL also_external)
 				TINT x1 = r->rn_Rect[2];
 				TINT y1 = r->rn_Rect[3];
 
-				if (!mod->rfb_rotation)
-					pixconv_convert(&mod->rfb_PixBuf, &mod->rfb_DevBuf,
-						x0, y0, x1, y1, x0, y0, TFALSE, TFALSE);
-				else
-					pixconv_transform_convert(&mod->rfb_PixBuf, &mod->rfb_DevBuf,
-						x0, y0, x1, y1, x0, y0, TFALSE, TFALSE,
-						rfb_address_rotate, mod);
+				rfb_addjobs(mod, &mod->rfb_PixBuf, &mod->rfb_DevBuf,
+					x0, y0, x1, y1, x0, y0);
+				numpixels += (x1 - x0 + 1) * (y1 - y0 + 1);
 			}
+			rfb_runjobs(mod, numpixels);
 		}
 
 		/* flush to sub device: */
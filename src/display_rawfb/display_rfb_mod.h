@@ -75,6 +75,17 @@
 
 #define RFB_DIRTY_ALIGN         7
 
+/* number of flush worker tasks, default and env RAWFB_WORKERS, and max.: */
+#ifndef RFB_DEF_WORKERS
+#define RFB_DEF_WORKERS         0
+#endif
+#ifndef RFB_MAX_WORKERS
+#define RFB_MAX_WORKERS         16
+#endif
+/* min. number of rows per job, min. number of pixels to use workers: */
+#define RFB_JOB_MINROWS         16
+#define RFB_JOB_MINPIXELS       (64 * 1024)
+
 /*****************************************************************************/
 
 #if defined(ENABLE_LINUXFB)
@@ -97,6 +108,19 @@ struct RawKey
 
 #endif /* defined(ENABLE_LINUXFB) */
 
+/* conversion of a rectangle performed during a flush: */
+struct rfb_FlushJob
+{
+	struct TVPixBuf *src, *dst;
+	TINT x0, y0, x1, y1, sx, sy;
+};
+
+struct rfb_Worker
+{
+	struct TTask *task;
+	struct rfb_Display *mod;
+};
+
 struct rfb_BackBuffer
 {
 	TUINT8 *data;
@@ -206,6 +230,9 @@ struct rfb_Display
 	/* list of all visuals: */
 	struct TList rfb_VisualList;
 
+	/* list of buffers registered with TVisualAllocBuffer(): */
+	struct TList rfb_BufferList;
+
 	struct RectPool rfb_RectPool;
 
 	/* pixel buffer exposed to drawing functions: */
@@ -228,6 +255,9 @@ struct rfb_Display
 	FTC_CMapCache rfb_FTCCMapCache;
 	FTC_SBitCache rfb_FTCSBitCache;
 	struct rfb_FontManager rfb_FontManager;
+	/* coverage mask for composing text: */
+	TUINT8 *rfb_TextBuf;
+	TSIZE rfb_TextBufSize;
 
 	TINT rfb_MouseX;
 	TINT rfb_MouseY;
@@ -237,6 +267,9 @@ struct rfb_Display
 
 	struct Region rfb_DirtyRegion;
 
+	/* incremented when the window stack or a window's geometry changes: */
+	TUINT rfb_LayersGen;
+
 	struct rfb_Window *rfb_FocusWindow;
 
 	struct TVPixBuf rfb_PtrImage;
@@ -244,6 +277,21 @@ struct rfb_Display
 	TINT rfb_MouseHotX, rfb_MouseHotY;
 	struct rfb_BackBuffer rfb_PtrBackBuffer;
 
+	/* flush workers, see rfb_flush_clients(): */
+	struct rfb_Worker rfb_Workers[RFB_MAX_WORKERS];
+	TINT rfb_NumWorkers;
+	/* jobs of the current flush phase, next job to be taken: */
+	struct rfb_FlushJob *rfb_Jobs;
+	TINT rfb_NumJobs, rfb_MaxJobs, rfb_NextJob;
+	/* jobs use the rotating address function: */
+	TBOOL rfb_JobsRotate;
+	/* number of workers busy with the current phase: */
+	TINT rfb_WorkersBusy;
+	/* protects next job and busy count, signal for phase completion: */
+	struct TLock *rfb_JobLock;
+	TUINT rfb_JobDoneSignal;
+	struct TTask *rfb_FlushTask;
+
 #if defined(ENABLE_VNCSERVER)
 	rfbScreenInfoPtr rfb_RFBScreen;
 	TAPTR rfb_VNCTask;
@@ -316,6 +364,10 @@ struct rfb_Window
 	TINT rfbw_MaxHeight;
 
 	struct Region rfbw_DirtyRegion;
+
+	/* cached region covered by the windows above, see rfb_getlayermask(): */
+	struct Region rfbw_Layers;
+	TUINT rfbw_LayersGen;
 };
 
 struct rfb_Pen
@@ -324,6 +376,15 @@ struct rfb_Pen
 	TUINT32 rgb;
 };
 
+/* buffer registered with TVisualAllocBuffer(), held in a drawable format: */
+struct rfb_Buffer
+{
+	struct THandle handle;
+	struct TVPixBuf pixbuf;
+	TINT width, height;
+	TBOOL alpha;
+};
+
 struct rfb_attrdata
 {
 	struct rfb_Display *mod;
@@ -346,6 +407,11 @@ LOCAL void fbp_drawtriangle(struct rfb_Display *mod, struct rfb_Window *v,
 	TINT x0, TINT y0, TINT x1, TINT y1, TINT x2, TINT y2, struct rfb_Pen *pen);
 LOCAL void fbp_drawbuffer(struct rfb_Display *mod, struct rfb_Window *v,
 	struct TVPixBuf *src, TINT rect[4], TBOOL alpha);
+LOCAL void fbp_drawcolumn(struct rfb_Display *mod, struct rfb_Window *v,
+	struct TVPixBuf *src, TINT rect[4]);
+LOCAL void fbp_drawtiles(struct rfb_Display *mod, struct rfb_Window *v,
+	struct TVPixBuf *src, TINT tw, TINT th, TINT rect[4], TINT ox, TINT oy,
+	TBOOL alpha);
 LOCAL void fbp_doexpose(struct rfb_Display *mod, struct rfb_Window *v,
 	struct Region *L, struct THook *exposehook);
 LOCAL TBOOL fbp_copyarea_int(struct rfb_Display *mod, struct rfb_Window *v,
@@ -368,6 +434,7 @@ LOCAL TBOOL rfb_getlayers(struct rfb_Display *mod, struct Region *A,
 	struct rfb_Window *v, TINT dx, TINT dy);
 LOCAL TBOOL rfb_getlayermask(struct rfb_Display *mod, struct Region *A,
 	TINT *crect, struct rfb_Window *v, TINT dx, TINT dy);
+LOCAL void rfb_invalidatelayers(struct rfb_Display *mod);
 LOCAL TBOOL rfb_damage(struct rfb_Display *mod, TINT drect[],
 	struct rfb_Window *v);
 LOCAL void rfb_markdirty(struct rfb_Display *mod, struct rfb_Window *v,
@@ -611,6 +611,17 @@ static void fb_docmd(WINDISPLAY *mod, struct TVRequest *req)
 		case TVCMD_SETSELECTION:
 			fb_setselection(mod, req);
 			break;
+		case TVCMD_ALLOCBUFFER:
+			/* not supported, the handle remains TNULL */
+			break;
+		case TVCMD_BATCH:
+		{
+			struct TNode *next,
+				*node = req->tvr_Op.Batch.Commands.tlh_Head.tln_Succ;
+			for (; (next = node->tln_Succ); node = next)
+				fb_docmd(mod, (struct TVRequest *) node);
+			break;
+		}
 		default:
 			TDBPRINTF(TDB_INFO,("Unknown command code: %08x\n",
 			req->tvr_Req.io_Command));
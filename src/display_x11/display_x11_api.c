@@ -1434,14 +1434,48 @@ static void x11_drawbuffer(struct X11Display *mod, struct TVRequest *req)
 	src.tpb_Format = TGetTag(tags, TVisual_PixelFormat, TVPIXFMT_A8R8G8B8);
 	src.tpb_BytesPerLine = req->tvr_Op.DrawBuffer.TotWidth *
 		TVPIXFMT_BYTES_PER_PIXEL(src.tpb_Format);
+	TINT strip = TGetTag(tags, TVisual_Strip, 0);
+
+	if (strip)
+	{
+		/* a single row or column, repeated: */
+		TINT bpp, yy;
+		if (!src.tpb_Data || !x11_getdrawimage(mod, v, w, h, &dst.tpb_Data,
+				&dst.tpb_BytesPerLine))
+			return;
+		dst.tpb_Format = v->pixfmt;
+		if (strip == TVSTRIP_ROW)
+		{
+			src.tpb_BytesPerLine = 0;
+			pixconv_convert(&src, &dst, 0, 0, w - 1, h - 1, 0, 0, 0, 
+				mod->x11_Flags & X11FL_SWAPBYTEORDER);
+		}
+		else
+		{
+			src.tpb_BytesPerLine = TVPIXFMT_BYTES_PER_PIXEL(src.tpb_Format);
+			pixconv_convert(&src, &dst, 0, 0, 0, h - 1, 0, 0, 0, 
+				mod->x11_Flags & X11FL_SWAPBYTEORDER);
+			bpp = TVPIXFMT_BYTES_PER_PIXEL(dst.tpb_Format);
+			if (w > 1)
+				for (yy = 0; yy < h; ++yy)
+				{
+					TUINT8 *p = dst.tpb_Data + yy * dst.tpb_BytesPerLine;
+					pixconv_line_set(p + bpp, dst.tpb_Format, w - 1,
+						pixconv_getpixel(p, dst.tpb_Format));
+				}
+		}
+		x11_putimage(mod, v, req, x, y, w, h);
+		return;
+	}
 
 #if defined(X11_PIXMAP_CACHE)
+	struct ImageCacheState cstate;
 	struct TVImageCacheRequest *creq = (struct TVImageCacheRequest *)
 		TGetTag(tags, TVisual_CacheRequest, TNULL);
-	if (creq && v->pixfmt != TVPIXFMT_UNDEFINED)
+	if (v->pixfmt == TVPIXFMT_UNDEFINED)
+		creq = TNULL;
+	if (creq)
 	{
-		struct ImageCacheState cstate;
-
 		cstate.src = src;
 		cstate.dst.tpb_Format = v->pixfmt;
 		cstate.convert = pixconv_convert;
@@ -1454,14 +1488,23 @@ static void x11_drawbuffer(struct X11Display *mod, struct TVRequest *req)
 	}
 #endif
 
-	if (!src.tpb_Data || !x11_getdrawimage(mod, v, w, h, &dst.tpb_Data,
-			&dst.tpb_BytesPerLine))
-		return;
+	TBOOL draw = src.tpb_Data && x11_getdrawimage(mod, v, w, h,
+		&dst.tpb_Data, &dst.tpb_BytesPerLine);
+	if (draw)
+	{
+		dst.tpb_Format = v->pixfmt;
+		pixconv_convert(&src, &dst, 0, 0, w - 1, h - 1, 0, 0, 0, 
+			mod->x11_Flags & X11FL_SWAPBYTEORDER);
+	}
 
-	dst.tpb_Format = v->pixfmt;
-	pixconv_convert(&src, &dst, 0, 0, w - 1, h - 1, 0, 0, 0, 
-		mod->x11_Flags & X11FL_SWAPBYTEORDER);
-	x11_putimage(mod, v, req, x, y, w, h);
+#if defined(X11_PIXMAP_CACHE)
+	/* src may point into the cache until here: */
+	if (creq)
+		imgcache_unlock(&cstate);
+#endif
+
+	if (draw)
+		x11_putimage(mod, v, req, x, y, w, h);
 }
 
 /*****************************************************************************/
@@ -1630,6 +1673,17 @@ LOCAL void x11_docmd(struct X11Display *inst, struct TVRequest *req)
 		case TVCMD_SETSELECTION:
 			/* not implemented on X11 */
 			break;
+		case TVCMD_ALLOCBUFFER:
+			/* not supported, the handle remains TNULL */
+			break;
+		case TVCMD_BATCH:
+		{
+			struct TNode *next,
+				*node = req->tvr_Op.Batch.Commands.tlh_Head.tln_Succ;
+			for (; (next = node->tln_Succ); node = next)
+				x11_docmd(inst, (struct TVRequest *) node);
+			break;
+		}
 		default:
 			TDBPRINTF(TDB_ERROR, ("Unknown command code: %d\n",
 					req->tvr_Req.io_Command));
@@ -12,6 +12,7 @@
 
 #include "display_x11_mod.h"
 #include <tek/inline/exec.h>
+#include <tek/mod/exec.h>
 
 static TBOOL x11_getimsg(struct X11Display *mod, struct X11Window *v,
 	TIMSG ** msgptr, TUINT type)
@@ -582,6 +583,9 @@ LOCAL void x11_taskfunc(struct TTask *task)
 	TUINT sig = 0;
 	fd_set rset;
 	struct TVRequest *req;
+	/* requests taken from the port, but not yet processed */
+	struct TList reqlist;
+	struct TNode *reqnode;
 	TIMSG *imsg;
 	char buf[256];
 	struct timeval tv, *ptv;
@@ -599,6 +603,7 @@ LOCAL void x11_taskfunc(struct TTask *task)
 
 	TDBPRINTF(TDB_INFO, ("Device instance running\n"));
 
+	TInitList(&reqlist);
 	TGetSystemTime(&nowt);
 	nextt = nowt;
 	TAddTime(&nextt, &intt);
@@ -635,11 +640,14 @@ LOCAL void x11_taskfunc(struct TTask *task)
 			}
 		}
 
-		if (sig & cmdportsignal)
+		if ((sig & cmdportsignal) || !TISLISTEMPTY(&reqlist))
 		{
+			if (sig & cmdportsignal)
+				TGetMsgs(cmdport, &reqlist, 0);
 			while (inst->x11_RequestInProgress == TNULL &&
-				(req = TGetMsg(cmdport)))
+				(reqnode = TRemHead(&reqlist)))
 			{
+				req = TGETMSGBODY(reqnode);
 				x11_docmd(inst, req);
 				if (inst->x11_RequestInProgress)
 					break;
@@ -722,5 +730,8 @@ LOCAL void x11_taskfunc(struct TTask *task)
 
 	TDBPRINTF(TDB_INFO, ("Device instance exit\n"));
 
+	while ((reqnode = TRemHead(&reqlist)))
+		TDropMsg(TGETMSGBODY(reqnode));
+
 	x11_exitinstance(inst);
 }
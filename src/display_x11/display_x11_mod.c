@@ -339,7 +339,12 @@ static TAPTR x11_modopen(struct X11Display *mod, TTAGITEM *tags)
 		mod->x11_RefCount++;
 	TUnlock(mod->x11_Lock);
 	if (success)
+	{
+		/* Attributes that can be queried during open: */
+		TTAG p = TGetTag(tags, TVisual_HaveStrips, TNULL);
+		if (p) *((TBOOL *) p) = TTRUE;
 		return mod;
+	}
 	return TNULL;
 }
 
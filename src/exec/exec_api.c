@@ -330,12 +330,17 @@ EXPORT TAPTR exec_GetHALBase(struct TExecBase *TExecBase)
 /*****************************************************************************/
 /*
 **	mem = exec_AllocMsg(exec, size)
-**	Allocate message memory
+**	Allocate message memory, from the calling task's message memory
+**	manager if it has one
 */
 
 EXPORT TAPTR exec_AllocMsg(struct TExecBase *TExecBase, TSIZE size)
 {
-	return TAlloc(&TExecBase->texb_MsgMemManager, size);
+	struct TTask *self = THALFindSelf(TExecBase->texb_HALBase);
+	struct TMemManager *mmu = self->tsk_MsgMemManager;
+	if (mmu == TNULL)
+		mmu = &TExecBase->texb_MsgMemManager;
+	return TAlloc(mmu, size);
 }
 
 /*****************************************************************************/
@@ -346,7 +351,7 @@ EXPORT TAPTR exec_AllocMsg(struct TExecBase *TExecBase, TSIZE size)
 
 EXPORT TAPTR exec_AllocMsg0(struct TExecBase *TExecBase, TSIZE size)
 {
-	TAPTR mem = TAlloc(&TExecBase->texb_MsgMemManager, size);
+	TAPTR mem = exec_AllocMsg(TExecBase, size);
 	if (mem)
 		TFillMem(mem, size, 0);
 	return mem;
@@ -423,15 +428,36 @@ EXPORT TINT exec_WaitIO(struct TExecBase *TExecBase, struct TIORequest *ioreq)
 	{
 		struct TMsgPort *replyport = ioreq->io_ReplyPort;
 
-		while (status != (TMSG_STATUS_REPLIED | TMSGF_QUEUED))
+		if (replyport->tmp_Flags & TMSGPORTF_LOCKFREE)
 		{
-			THALWait(hal, replyport->tmp_Signal);
-			status = msg->tmsg_Flags;
+			/* The sender clears tln_Pred and sets the status before
+			pushing the message, and signals after pushing it */
+			for (;;)
+			{
+				if (status == (TMSG_STATUS_REPLIED | TMSGF_QUEUED))
+				{
+					EXEC_BARRIER();
+					exec_drainport(replyport);
+					if (msg->tmsg_Node.tln_Pred)
+						break;
+				}
+				THALWait(hal, replyport->tmp_Signal);
+				status = msg->tmsg_Flags;
+			}
+			TREMOVE((struct TNode *) msg);
 		}
+		else
+		{
+			while (status != (TMSG_STATUS_REPLIED | TMSGF_QUEUED))
+			{
+				THALWait(hal, replyport->tmp_Signal);
+				status = msg->tmsg_Flags;
+			}
 
-		THALLock(hal, &replyport->tmp_Lock);
-		TREMOVE((struct TNode *) msg);
-		THALUnlock(hal, &replyport->tmp_Lock);
+			THALLock(hal, &replyport->tmp_Lock);
+			TREMOVE((struct TNode *) msg);
+			THALUnlock(hal, &replyport->tmp_Lock);
+		}
 
 		msg->tmsg_Flags = 0;
 	}
@@ -520,19 +546,165 @@ EXPORT TAPTR exec_CreateLock(struct TExecBase *TExecBase, TTAGITEM *tags)
 /*****************************************************************************/
 /*
 **	exec_Lock(exec, lock)
+**	With atomics, an uncontended lock is obtained by setting tlk_Owner
+**	with a compare-and-swap. A contended lock is spun on for a number of
+**	rounds adapting to how long it took to get it by spinning before,
+**	then the task queues itself in tlk_Waiters under the HAL lock and
+**	waits until the lock is passed to it. Statistics are updated while
+**	the lock is held.
 */
 
+static void exec_locktime(struct TExecBase *TExecBase, TTIME *t)
+{
+	/* read the clock directly, without a time request */
+	THALGetSysTime(TExecBase->texb_HALBase, t);
+}
+
+#if defined(EXEC_LOCKFREE)
+
+EXPORT void exec_Lock(struct TExecBase *TExecBase, struct TLock *lock)
+{
+	TAPTR hal = TExecBase->texb_HALBase;
+	struct TTask *waiter = THALFindSelf(hal);
+	struct TLockWait request;
+	TTIME t0, t1;
+	TINT i, maxspin;
+
+	if (lock->tlk_Owner == waiter)
+	{
+		lock->tlk_NestCount++;
+		return;
+	}
+
+	if (EXEC_CAS(&lock->tlk_Owner, TNULL, waiter))
+	{
+		lock->tlk_NestCount = 1;
+		lock->tlk_Acquires++;
+		return;
+	}
+
+	maxspin = TMIN(EXEC_LOCK_MAXSPIN, lock->tlk_Spin * 2 + 10);
+	for (i = 0; i < maxspin; ++i)
+	{
+		EXEC_PAUSE();
+		if (lock->tlk_Owner == TNULL &&
+			EXEC_CAS(&lock->tlk_Owner, TNULL, waiter))
+		{
+			lock->tlk_NestCount = 1;
+			lock->tlk_Acquires++;
+			lock->tlk_Contended++;
+			lock->tlk_Spin += (i - lock->tlk_Spin) / 8;
+			return;
+		}
+	}
+
+	/* the wait is measured from before queueing */
+	exec_locktime(TExecBase, &t0);
+	request.tlr_Task = waiter;
+	THALLock(hal, &lock->tlk_HLock);
+	TAddTail(&lock->tlk_Waiters, &request.tlr_Node);
+	lock->tlk_WaitCount++;
+	/* pairs with the barrier in exec_Unlock() after releasing */
+	EXEC_BARRIER();
+	if (EXEC_CAS(&lock->tlk_Owner, TNULL, waiter))
+	{
+		TREMOVE(&request.tlr_Node);
+		lock->tlk_WaitCount--;
+		THALUnlock(hal, &lock->tlk_HLock);
+		lock->tlk_NestCount = 1;
+	}
+	else
+	{
+		THALUnlock(hal, &lock->tlk_HLock);
+		/* wait for the lock to be passed to us */
+		THALWait(hal, TTASK_SIG_SINGLE);
+	}
+
+	lock->tlk_Acquires++;
+	lock->tlk_Contended++;
+	/* spinning did not pay off */
+	lock->tlk_Spin -= lock->tlk_Spin / 8;
+	exec_locktime(TExecBase, &t1);
+	if (t0.tdt_Int64 && t1.tdt_Int64 > t0.tdt_Int64)
+		lock->tlk_WaitTime.tdt_Int64 += t1.tdt_Int64 - t0.tdt_Int64;
+}
+
+/*****************************************************************************/
+/*
+**	exec_Unlock(exec, lock)
+*/
+
+static void exec_passlock(TAPTR hal, struct TLock *lock)
+{
+	/* pass the lock to the first waiter; called with the HAL lock held */
+	struct TLockWait *request =
+		(struct TLockWait *) TRemHead(&lock->tlk_Waiters);
+	lock->tlk_WaitCount--;
+	lock->tlk_NestCount = 1;
+	THALSignal(hal, &request->tlr_Task->tsk_Thread, TTASK_SIG_SINGLE);
+}
+
+EXPORT void exec_Unlock(struct TExecBase *TExecBase, struct TLock *lock)
+{
+	TAPTR hal = TExecBase->texb_HALBase;
+
+	if (--lock->tlk_NestCount > 0)
+		return;
+
+	if (lock->tlk_WaitCount == 0)
+	{
+		EXEC_BARRIER();
+		lock->tlk_Owner = TNULL;
+		/* a waiter may have queued itself before seeing the release */
+		EXEC_BARRIER();
+		if (lock->tlk_WaitCount == 0)
+			return;
+		THALLock(hal, &lock->tlk_HLock);
+		if (lock->tlk_WaitCount > 0)
+		{
+			struct TLockWait *request =
+				(struct TLockWait *) TFIRSTNODE(&lock->tlk_Waiters);
+			if (EXEC_CAS(&lock->tlk_Owner, TNULL, request->tlr_Task))
+				exec_passlock(hal, lock);
+			/* else the new owner will pass it on when unlocking */
+		}
+		THALUnlock(hal, &lock->tlk_HLock);
+		return;
+	}
+
+	THALLock(hal, &lock->tlk_HLock);
+	if (lock->tlk_WaitCount > 0)
+	{
+		struct TLockWait *request =
+			(struct TLockWait *) TFIRSTNODE(&lock->tlk_Waiters);
+		lock->tlk_Owner = request->tlr_Task;
+		exec_passlock(hal, lock);
+	}
+	else
+		lock->tlk_Owner = TNULL;
+	THALUnlock(hal, &lock->tlk_HLock);
+}
+
+#else /* defined(EXEC_LOCKFREE) */
+
 EXPORT void exec_Lock(struct TExecBase *TExecBase, struct TLock *lock)
 {
 	TAPTR hal = TExecBase->texb_HALBase;
 	struct TTask *waiter = THALFindSelf(hal);
 	struct TLockWait request;
+	TTIME t0, t1;
 	request.tlr_Task = waiter;
+	/* the wait is measured from before queueing */
+	if (lock->tlk_Owner && lock->tlk_Owner != waiter)
+		exec_locktime(TExecBase, &t0);
+	else
+		t0.tdt_Int64 = 0;
 	THALLock(hal, &lock->tlk_HLock);
 	if (lock->tlk_Owner == TNULL)
 	{
 		lock->tlk_Owner = waiter;
 		lock->tlk_NestCount++;
+		lock->tlk_Acquires++;
 		THALUnlock(hal, &lock->tlk_HLock);
 	}
 	else if (lock->tlk_Owner == waiter)
@@ -546,6 +718,11 @@ EXPORT void exec_Lock(struct TExecBase *TExecBase, struct TLock *lock)
 		lock->tlk_WaitCount++;
 		THALUnlock(hal, &lock->tlk_HLock);
 		THALWait(hal, TTASK_SIG_SINGLE);
+		exec_locktime(TExecBase, &t1);
+		lock->tlk_Acquires++;
+		lock->tlk_Contended++;
+		if (t0.tdt_Int64 && t1.tdt_Int64 > t0.tdt_Int64)
+			lock->tlk_WaitTime.tdt_Int64 += t1.tdt_Int64 - t0.tdt_Int64;
 	}
 }
 
@@ -576,6 +753,53 @@ EXPORT void exec_Unlock(struct TExecBase *TExecBase, struct TLock *lock)
 	THALUnlock(hal, &lock->tlk_HLock);
 }
 
+#endif /* defined(EXEC_LOCKFREE) */
+
+/*****************************************************************************/
+/*
+**	num = exec_GetLockStats(exec, lock, tags)
+**	Query the statistics of a lock: the number of times it was obtained,
+**	how many of these found it held by another task, and the total time
+**	spent waiting for it. The lock is not obtained for the query, so the
+**	values can be slightly behind while it is in use. Returns the number
+**	of attributes queried. With TLock_Reset, the counters are cleared
+**	while the lock is held, as they are updated only by its owner.
+*/
+
+EXPORT TUINT exec_GetLockStats(struct TExecBase *TExecBase,
+	struct TLock *lock, TTAGITEM *tags)
+{
+	TUINT n = 0;
+	TUINT *p;
+	TTIME *t;
+	if (lock == TNULL)
+		return 0;
+	if ((p = (TUINT *) TGetTag(tags, TLock_Acquires, TNULL)))
+	{
+		*p = lock->tlk_Acquires;
+		n++;
+	}
+	if ((p = (TUINT *) TGetTag(tags, TLock_Contended, TNULL)))
+	{
+		*p = lock->tlk_Contended;
+		n++;
+	}
+	if ((t = (TTIME *) TGetTag(tags, TLock_WaitTime, TNULL)))
+	{
+		*t = lock->tlk_WaitTime;
+		n++;
+	}
+	if (TGetTag(tags, TLock_Reset, TFALSE))
+	{
+		exec_Lock(TExecBase, lock);
+		lock->tlk_Acquires = 0;
+		lock->tlk_Contended = 0;
+		lock->tlk_WaitTime.tdt_Int64 = 0;
+		exec_Unlock(TExecBase, lock);
+	}
+	return n;
+}
+
 /*****************************************************************************/
 /*
 **	port = exec_CreatePort(execbase, tags)
@@ -608,6 +832,10 @@ EXPORT struct TMsgPort *exec_CreatePort(struct TExecBase *TExecBase,
 		{
 			port->tmp_Hook = 
 				(struct THook *) TGetTag(tags, TMsgPort_Hook, TNULL);
+#if defined(EXEC_LOCKFREE)
+			if (TGetTag(tags, TMsgPort_LockFree, TFALSE))
+				port->tmp_Flags |= TMSGPORTF_LOCKFREE;
+#endif
 			/* overwrite destructor */
 			port->tmp_Handle.thn_Hook.thk_Entry = exec_destroyuserport;
 			return port;
@@ -630,13 +858,23 @@ EXPORT TAPTR exec_WaitPort(struct TExecBase *TExecBase, struct TMsgPort *port)
 	{
 		TAPTR hal = TExecBase->texb_HALBase;
 		TDBASSERT(99, THALFindSelf(hal) == port->tmp_SigTask);
+		TBOOL lockfree = port->tmp_Flags & TMSGPORTF_LOCKFREE;
 		for (;;)
 		{
-			THALLock(hal, &port->tmp_Lock);
-			node = port->tmp_MsgList.tlh_Head.tln_Succ;
+			if (lockfree)
+			{
+				if (TISLISTEMPTY(&port->tmp_MsgList))
+					exec_drainport(port);
+				node = port->tmp_MsgList.tlh_Head.tln_Succ;
+			}
+			else
+			{
+				THALLock(hal, &port->tmp_Lock);
+				node = port->tmp_MsgList.tlh_Head.tln_Succ;
+				THALUnlock(hal, &port->tmp_Lock);
+			}
 			if (node->tln_Succ == TNULL)
 				node = TNULL;
-			THALUnlock(hal, &port->tmp_Lock);
 			if (node)
 				break;
 			THALWait(hal, port->tmp_Signal);
@@ -659,9 +897,21 @@ EXPORT TAPTR exec_GetMsg(struct TExecBase *TExecBase, struct TMsgPort *port)
 	{
 		struct TMessage *msg;
 		TAPTR hal = TExecBase->texb_HALBase;
-		THALLock(hal, &port->tmp_Lock);
-		msg = (struct TMessage *) TRemHead(&port->tmp_MsgList);
-		THALUnlock(hal, &port->tmp_Lock);
+		if (port->tmp_Flags & TMSGPORTF_LOCKFREE)
+		{
+			msg = (struct TMessage *) TRemHead(&port->tmp_MsgList);
+			if (msg == TNULL)
+			{
+				exec_drainport(port);
+				msg = (struct TMessage *) TRemHead(&port->tmp_MsgList);
+			}
+		}
+		else
+		{
+			THALLock(hal, &port->tmp_Lock);
+			msg = (struct TMessage *) TRemHead(&port->tmp_MsgList);
+			THALUnlock(hal, &port->tmp_Lock);
+		}
 		if (msg)
 		{
 			if (!(msg->tmsg_Flags & TMSGF_QUEUED))
@@ -675,6 +925,71 @@ EXPORT TAPTR exec_GetMsg(struct TExecBase *TExecBase, struct TMsgPort *port)
 	return TNULL;
 }
 
+/*****************************************************************************/
+/*
+**	num = exec_GetMsgs(exec, port, list, max)
+**	Move up to max pending messages, or all if max is 0, from a message
+**	port to the tail of a list, taking the port's lock only once. The
+**	nodes in the list are the messages' headers, use TGETMSGBODY() to get
+**	the message bodies. Returns the number of messages moved.
+*/
+
+EXPORT TUINT exec_GetMsgs(struct TExecBase *TExecBase, struct TMsgPort *port,
+	struct TList *list, TUINT max)
+{
+	TUINT num = 0;
+	if (port && list)
+	{
+		TAPTR hal = TExecBase->texb_HALBase;
+		struct TList *msglist = &port->tmp_MsgList;
+		struct TNode *first, *last = TNULL;
+
+		if (port->tmp_Flags & TMSGPORTF_LOCKFREE)
+			exec_drainport(port);
+		else
+			THALLock(hal, &port->tmp_Lock);
+
+		/* detach the leading messages */
+		first = msglist->tlh_Head.tln_Succ;
+		if (first->tln_Succ)
+		{
+			if (max == 0)
+				last = msglist->tlh_Tail.tln_Pred;
+			else
+				for (last = first; --max > 0 && last->tln_Succ->tln_Succ;
+					last = last->tln_Succ);
+			msglist->tlh_Head.tln_Succ = last->tln_Succ;
+			last->tln_Succ->tln_Pred = &msglist->tlh_Head;
+		}
+
+		if (!(port->tmp_Flags & TMSGPORTF_LOCKFREE))
+			THALUnlock(hal, &port->tmp_Lock);
+
+		if (last)
+		{
+			struct TNode *node = first;
+			first->tln_Pred = list->tlh_Tail.tln_Pred;
+			list->tlh_Tail.tln_Pred->tln_Succ = first;
+			last->tln_Succ = &list->tlh_Tail;
+			list->tlh_Tail.tln_Pred = last;
+			for (;;)
+			{
+				struct TMessage *msg = (struct TMessage *) node;
+				if (!(msg->tmsg_Flags & TMSGF_QUEUED))
+					TDBPRINTF(TDB_ERROR,("got msg with TMSGF_QUEUED not set\n"));
+				msg->tmsg_Flags &= ~TMSGF_QUEUED;
+				num++;
+				if (node == last)
+					break;
+				node = node->tln_Succ;
+			}
+		}
+	}
+	else
+		TDBPRINTF(TDB_INFO,("port/list=TNULL\n"));
+	return num;
+}
+
 /*****************************************************************************/
 /*
 **	exec_PutMsg(exec, port, replyport, msg)
@@ -692,14 +1007,7 @@ EXPORT void exec_PutMsg(struct TExecBase *TExecBase, struct TMsgPort *port,
 		msg->tmsg_RPort = replyport;
 		msg->tmsg_Sender = THALFindSelf(hal);
 
-		THALLock(hal, &port->tmp_Lock);
-		TAddTail(&port->tmp_MsgList, (struct TNode *) msg);
-		msg->tmsg_Flags = TMSGF_SENT | TMSGF_QUEUED;
-		if (port->tmp_Hook)
-			TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
-		THALUnlock(hal, &port->tmp_Lock);
-
-		THALSignal(hal, &port->tmp_SigTask->tsk_Thread, port->tmp_Signal);
+		exec_queuemsg(TExecBase, port, msg, TMSGF_SENT | TMSGF_QUEUED);
 	}
 	else
 		TDBPRINTF(TDB_WARN,("port/msg=TNULL\n"));
@@ -1004,13 +1312,19 @@ EXPORT void exec_InsertMsg(struct TExecBase *TExecBase, struct TMsgPort *port,
 	struct TMessage *msg = TGETMSGPTR(mem);
 	struct TMessage *predmsg = predmem ? TGETMSGPTR(predmem) : TNULL;
 
-	THALLock(TExecBase->texb_HALBase, &port->tmp_Lock);
+	TBOOL lockfree = port->tmp_Flags & TMSGPORTF_LOCKFREE;
+
+	if (lockfree)
+		exec_drainport(port);
+	else
+		THALLock(TExecBase->texb_HALBase, &port->tmp_Lock);
 	if (predmsg)
 		TInsert(&port->tmp_MsgList, &msg->tmsg_Node, &predmsg->tmsg_Node);
 	else
 		TAddTail(&port->tmp_MsgList, &msg->tmsg_Node);
 
-	THALUnlock(TExecBase->texb_HALBase, &port->tmp_Lock);
+	if (!lockfree)
+		THALUnlock(TExecBase->texb_HALBase, &port->tmp_Lock);
 
 	msg->tmsg_Flags = status | TMSGF_QUEUED;
 }
@@ -1025,7 +1339,11 @@ EXPORT void exec_RemoveMsg(struct TExecBase *TExecBase, struct TMsgPort *port,
 	TAPTR mem)
 {
 	struct TMessage *msg = TGETMSGPTR(mem);
-	THALLock(TExecBase->texb_HALBase, &port->tmp_Lock);
+	TBOOL lockfree = port->tmp_Flags & TMSGPORTF_LOCKFREE;
+	if (lockfree)
+		exec_drainport(port);
+	else
+		THALLock(TExecBase->texb_HALBase, &port->tmp_Lock);
 	#ifdef TDEBUG
 	{
 		struct TNode *next, *node = port->tmp_MsgList.tlh_Head.tln_Succ;
@@ -1044,7 +1362,8 @@ EXPORT void exec_RemoveMsg(struct TExecBase *TExecBase, struct TMsgPort *port,
 	}
 	#endif
 	TREMOVE(&msg->tmsg_Node);
-	THALUnlock(TExecBase->texb_HALBase, &port->tmp_Lock);
+	if (!lockfree)
+		THALUnlock(TExecBase->texb_HALBase, &port->tmp_Lock);
 }
 
 /*****************************************************************************/
@@ -617,6 +617,8 @@ static struct TTask *exec_createtask(TEXECBASE *TExecBase, struct THook *hook,
 						(struct TModule *) TExecBase;
 					newtask->tsk_UserData =
 						(TAPTR) TGetTag(tags, TTask_UserData, TNULL);
+					newtask->tsk_MsgMemManager = (struct TMemManager *)
+						TGetTag(tags, TTask_MsgMemManager, TNULL);
 					newtask->tsk_SigFree = ~((TUINT) TTASK_SIG_RESERVED);
 					newtask->tsk_SigUsed = TTASK_SIG_RESERVED;
 					newtask->tsk_Status = TTASK_INITIALIZING;
@@ -13,6 +13,13 @@
 
 static const union TMemMsg msg_destroy = { TMMSG_DESTROY };
 
+static struct TMemSlab *exec_createslab(struct TExecBase *TExecBase,
+	TAPTR parent, struct TTagItem *tags);
+static struct TMsgPool *exec_createmsgpool(struct TExecBase *TExecBase,
+	struct TMemManager *parent, struct TTagItem *tags);
+static THOOKENTRY TTAG exec_mmu_msgpool(struct THook *hook, TAPTR obj,
+	TTAG m);
+
 /*****************************************************************************/
 /*
 **	mmu = exec_CreateMemManager(exec, allocator, mmutype, tags)
@@ -46,6 +53,18 @@ exec_destroymmu_and_allocator(struct THook *hook, TAPTR obj, TTAG msg)
 	return 0;
 }
 
+static THOOKENTRY TTAG
+exec_destroymmu_deferred(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	if (msg == TMSG_DESTROY)
+	{
+		/* the MM frees itself when its last allocation is returned */
+		struct TMemManager *mmu = obj;
+		TCALLHOOKPKT(&mmu->tmm_Hook, mmu, (TTAG) &msg_destroy);
+	}
+	return 0;
+}
+
 static THOOKENTRY TTAG
 exec_destroymmu_and_free(struct THook *hook, TAPTR obj, TTAG msg)
 {
@@ -71,7 +90,21 @@ exec_CreateMemManager(struct TExecBase *TExecBase, TAPTR allocator,
 		TBOOL success = TTRUE;
 		TAPTR staticmem = TNULL;
 
-		if ((mmutype & TMMT_Pooled) && allocator == TNULL)
+		if (mmutype & TMMT_Slab)
+		{
+			/* Create a MM based on a slab, taking chunks from allocator */
+			allocator = exec_createslab(TExecBase, allocator, tags);
+			destructor = exec_destroymmu_and_allocator;
+			success = allocator != TNULL;
+		}
+		else if (mmutype == TMMT_Message)
+		{
+			/* Create a recycling message MM on top of a message MM */
+			allocator = exec_createmsgpool(TExecBase, allocator, tags);
+			destructor = exec_destroymmu_deferred;
+			success = allocator != TNULL;
+		}
+		else if ((mmutype & TMMT_Pooled) && allocator == TNULL)
 		{
 			/* Create a MM based on an internal pooled allocator */
 			allocator = TCreatePool(tags);
@@ -127,6 +160,8 @@ exec_CreateMemManager(struct TExecBase *TExecBase, TAPTR allocator,
 			}
 		}
 
+		if ((mmutype & TMMT_Slab) || mmutype == TMMT_Message)
+			TDESTROY(allocator);
 		TFree(staticmem);
 		TFree(mmu);
 	}
@@ -941,6 +976,257 @@ static THOOKENTRY TTAG exec_mmu_msg(struct THook *hook, TAPTR obj, TTAG m)
 	return 0;
 }
 
+/*****************************************************************************/
+/*
+**	Recycling message allocator -
+**	Takes messages from a parent message allocator and keeps them in free
+**	lists per size class when they are freed. The link of a free message
+**	is stored in its memory manager info, the parent's header in front of
+**	it remains untouched. Messages can be freed by any task, and outlive
+**	the MM's destruction; it is freed along with the last of them.
+*/
+
+#define TMSGPOOL_GRANULE	sizeof(union TMemManagerInfo)
+#define TMSGPOOL_DEF_MAXFREE	64
+
+static THOOKENTRY TTAG
+exec_destroymsgpool(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	if (msg == TMSG_DESTROY)
+	{
+		struct TMsgPool *pool = obj;
+		struct TExecBase *TExecBase = TGetExecBase(pool);
+		THALDestroyLock(TExecBase->texb_HALBase, &pool->tmpl_Lock);
+		TFree(pool);
+	}
+	return 0;
+}
+
+static struct TMsgPool *
+exec_createmsgpool(struct TExecBase *TExecBase, struct TMemManager *parent,
+	struct TTagItem *tags)
+{
+	struct TMsgPool *pool = TAlloc(TNULL, sizeof(struct TMsgPool));
+	if (pool)
+	{
+		TFillMem(pool, sizeof(struct TMsgPool), 0);
+		if (THALInitLock(TExecBase->texb_HALBase, &pool->tmpl_Lock))
+		{
+			TUINT maxfree = (TUINT) TGetTag(tags, TMsgPool_MaxFree,
+				(TTAG) TMSGPOOL_DEF_MAXFREE);
+			pool->tmpl_Handle.thn_Owner = (struct TModule *) TExecBase;
+			pool->tmpl_Handle.thn_Hook.thk_Entry = exec_destroymsgpool;
+			pool->tmpl_MemManager = parent ? parent :
+				&TExecBase->texb_MsgMemManager;
+			pool->tmpl_MaxFree = TMIN(maxfree, 0xffff);
+			return pool;
+		}
+		TFree(pool);
+	}
+	return TNULL;
+}
+
+static TAPTR exec_msgpoolparent(struct TMsgPool *pool, TAPTR mem, TSIZE size)
+{
+	struct TMemManager *parent = pool->tmpl_MemManager;
+	union TMemMsg msg;
+	if (mem)
+	{
+		msg.tmmsg_Type = TMMSG_FREE;
+		msg.tmmsg_Free.tmmsg_Ptr = mem;
+		msg.tmmsg_Free.tmmsg_Size = size;
+	}
+	else
+	{
+		msg.tmmsg_Type = TMMSG_ALLOC;
+		msg.tmmsg_Alloc.tmmsg_Size = size;
+	}
+	return (TAPTR) TCALLHOOKPKT(&parent->tmm_Hook, parent, (TTAG) &msg);
+}
+
+static TAPTR exec_mmu_msgpoolalloc(struct TMemManager *mmu, TSIZE size)
+{
+	struct TExecBase *TExecBase = (TEXECBASE *) TGetExecBase(mmu);
+	TAPTR hal = TExecBase->texb_HALBase;
+	struct TMsgPool *pool = mmu->tmm_Allocator;
+	TSIZE c = (size + TMSGPOOL_GRANULE - 1) / TMSGPOOL_GRANULE;
+	TAPTR mem = TNULL;
+
+	THALLock(hal, &pool->tmpl_Lock);
+	if (c < TMSGPOOL_NUMCLASSES)
+	{
+		size = c * TMSGPOOL_GRANULE;
+		mem = pool->tmpl_Free[c];
+		if (mem)
+		{
+			pool->tmpl_Free[c] = *(TAPTR *) mem;
+			pool->tmpl_NumFree[c]--;
+			pool->tmpl_Hits++;
+		}
+	}
+	if (mem == TNULL)
+		pool->tmpl_Misses++;
+	pool->tmpl_Pending++;
+	THALUnlock(hal, &pool->tmpl_Lock);
+
+	if (mem)
+	{
+		/* reinitialize as the parent would */
+		struct TMessage *msg = (struct TMessage *) mem - 1;
+		msg->tmsg_RPort = TNULL;
+		msg->tmsg_Flags = TMSG_STATUS_FAILED;
+	}
+	else
+	{
+		mem = exec_msgpoolparent(pool, TNULL, size);
+		if (mem == TNULL)
+		{
+			THALLock(hal, &pool->tmpl_Lock);
+			pool->tmpl_Pending--;
+			THALUnlock(hal, &pool->tmpl_Lock);
+		}
+	}
+	return mem;
+}
+
+static void exec_mmu_msgpoolfree(struct TMemManager *mmu, TINT8 *mem,
+	TSIZE size)
+{
+	struct TExecBase *TExecBase = (TEXECBASE *) TGetExecBase(mmu);
+	TAPTR hal = TExecBase->texb_HALBase;
+	struct TMsgPool *pool = mmu->tmm_Allocator;
+	TSIZE c = (size + TMSGPOOL_GRANULE - 1) / TMSGPOOL_GRANULE;
+	TBOOL last;
+
+	THALLock(hal, &pool->tmpl_Lock);
+	pool->tmpl_Pending--;
+	if (c < TMSGPOOL_NUMCLASSES)
+	{
+		size = c * TMSGPOOL_GRANULE;
+		if (!pool->tmpl_Closed && pool->tmpl_NumFree[c] < pool->tmpl_MaxFree)
+		{
+			*(TAPTR *) mem = pool->tmpl_Free[c];
+			pool->tmpl_Free[c] = mem;
+			pool->tmpl_NumFree[c]++;
+			mem = TNULL;
+		}
+	}
+	last = pool->tmpl_Closed && pool->tmpl_Pending == 0;
+	THALUnlock(hal, &pool->tmpl_Lock);
+
+	if (mem)
+		exec_msgpoolparent(pool, mem, size);
+	if (last)
+	{
+		TDESTROY(&pool->tmpl_Handle);
+		TFree(mmu);
+	}
+}
+
+static void exec_mmu_msgpooldestroy(struct TMemManager *mmu)
+{
+	struct TExecBase *TExecBase = (TEXECBASE *) TGetExecBase(mmu);
+	TAPTR hal = TExecBase->texb_HALBase;
+	struct TMsgPool *pool = mmu->tmm_Allocator;
+	TAPTR mem, next;
+	TBOOL last;
+	TINT c;
+
+	THALLock(hal, &pool->tmpl_Lock);
+	for (c = 1; c < TMSGPOOL_NUMCLASSES; ++c)
+	{
+		for (mem = pool->tmpl_Free[c]; mem; mem = next)
+		{
+			next = *(TAPTR *) mem;
+			exec_msgpoolparent(pool, mem, c * TMSGPOOL_GRANULE);
+		}
+		pool->tmpl_Free[c] = TNULL;
+		pool->tmpl_NumFree[c] = 0;
+	}
+	pool->tmpl_Closed = TTRUE;
+	last = pool->tmpl_Pending == 0;
+	if (!last)
+		TDBPRINTF(TDB_INFO,("%d messages pending\n", pool->tmpl_Pending));
+	THALUnlock(hal, &pool->tmpl_Lock);
+
+	if (last)
+	{
+		TDESTROY(&pool->tmpl_Handle);
+		TFree(mmu);
+	}
+}
+
+static THOOKENTRY TTAG exec_mmu_msgpool(struct THook *hook, TAPTR obj,
+	TTAG m)
+{
+	struct TMemManager *mmu = obj;
+	union TMemMsg *msg = (union TMemMsg *) m;
+	switch (msg->tmmsg_Type)
+	{
+		case TMMSG_DESTROY:
+			exec_mmu_msgpooldestroy(mmu);
+			break;
+		case TMMSG_ALLOC:
+			return (TTAG) exec_mmu_msgpoolalloc(mmu,
+				msg->tmmsg_Alloc.tmmsg_Size);
+		case TMMSG_FREE:
+			exec_mmu_msgpoolfree(mmu,
+				msg->tmmsg_Free.tmmsg_Ptr,
+				msg->tmmsg_Free.tmmsg_Size);
+			break;
+		case TMMSG_REALLOC:
+			TDBPRINTF(TDB_ERROR,("messages cannot be reallocated\n"));
+			break;
+		default:
+			TDBPRINTF(TDB_ERROR,("unknown hookmsg\n"));
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	num = exec_GetMsgPoolStats(exec, mmu, tags)
+**	Query the statistics of a recycling message memory manager. Returns
+**	the number of attributes queried, 0 if mmu is of another type.
+*/
+
+EXPORT TUINT exec_GetMsgPoolStats(struct TExecBase *TExecBase,
+	struct TMemManager *mmu, TTAGITEM *tags)
+{
+	TAPTR hal = TExecBase->texb_HALBase;
+	struct TMsgPool *pool;
+	TUINT n = 0;
+	TUINT *p;
+
+	if (mmu == TNULL || mmu->tmm_Hook.thk_Entry != exec_mmu_msgpool)
+		return 0;
+
+	pool = mmu->tmm_Allocator;
+	THALLock(hal, &pool->tmpl_Lock);
+	if ((p = (TUINT *) TGetTag(tags, TMsgPool_Hits, TNULL)))
+	{
+		*p = pool->tmpl_Hits;
+		n++;
+	}
+	if ((p = (TUINT *) TGetTag(tags, TMsgPool_Misses, TNULL)))
+	{
+		*p = pool->tmpl_Misses;
+		n++;
+	}
+	if ((p = (TUINT *) TGetTag(tags, TMsgPool_Pending, TNULL)))
+	{
+		*p = pool->tmpl_Pending;
+		n++;
+	}
+	if (TGetTag(tags, TMsgPool_Reset, TFALSE))
+	{
+		pool->tmpl_Hits = 0;
+		pool->tmpl_Misses = 0;
+	}
+	THALUnlock(hal, &pool->tmpl_Lock);
+	return n;
+}
+
 /*****************************************************************************/
 /*
 **	static memheader allocator
@@ -1578,6 +1864,221 @@ static THOOKENTRY TTAG exec_mmu_mmu(struct THook *hook, TAPTR obj, TTAG m)
 
 #endif /* defined(ENABLE_ADVANCED_MEMORY_MANAGERS) */
 
+/*****************************************************************************/
+/*
+**	Size-class slab allocator -
+**	Allocations up to tsl_MaxSize are rounded up to a multiple of
+**	sizeof(union TMemNode) and served from a free list per size class,
+**	or cut from the current chunk. Larger allocations are passed on to
+**	the parent allocator. Chunks are returned only when the slab is
+**	destroyed.
+*/
+
+#define TSLAB_GRANULE		sizeof(union TMemNode)
+#define TSLAB_DEF_CHUNKSIZE	8192
+
+union TSlabChunk
+{
+	struct TNode tsc_Node;
+	struct TMemNodeAlign tsc_Align;
+};
+
+static THOOKENTRY TTAG
+exec_destroyslab(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	if (msg == TMSG_DESTROY)
+	{
+		struct TMemSlab *slab = obj;
+		struct TExecBase *TExecBase = TGetExecBase(slab);
+		struct TNode *nnode, *node = slab->tsl_Chunks.tlh_Head.tln_Succ;
+		while ((nnode = node->tln_Succ))
+		{
+			TFree(node);
+			node = nnode;
+		}
+		TFree(slab);
+	}
+	return 0;
+}
+
+static struct TMemSlab *
+exec_createslab(struct TExecBase *TExecBase, TAPTR parent,
+	struct TTagItem *tags)
+{
+	struct TMemSlab *slab = TAlloc(TNULL, sizeof(struct TMemSlab));
+	if (slab)
+	{
+		TSIZE maxsize = (TSIZE) TGetTag(tags, TSlab_MaxSize,
+			(TTAG) (TSLAB_GRANULE * TSLAB_NUMCLASSES));
+		TSIZE chunksize = (TSIZE) TGetTag(tags, TSlab_ChunkSize,
+			(TTAG) TSLAB_DEF_CHUNKSIZE);
+
+		maxsize = TMIN(maxsize, TSLAB_GRANULE * TSLAB_NUMCLASSES);
+		maxsize -= maxsize % TSLAB_GRANULE;
+		chunksize = TMAX(chunksize, sizeof(union TSlabChunk) + maxsize);
+
+		TFillMem(slab, sizeof(struct TMemSlab), 0);
+		slab->tsl_Handle.thn_Owner = (struct TModule *) TExecBase;
+		slab->tsl_Handle.thn_Hook.thk_Entry = exec_destroyslab;
+		slab->tsl_MemManager = parent;
+		slab->tsl_ChunkSize = chunksize;
+		slab->tsl_MaxSize = maxsize;
+		TINITLIST(&slab->tsl_Chunks);
+	}
+	return slab;
+}
+
+static TAPTR exec_slaballoc(struct TExecBase *TExecBase,
+	struct TMemSlab *slab, TSIZE size)
+{
+	union TMemNode *node;
+	TUINT c;
+
+	if (size > slab->tsl_MaxSize)
+		return TAlloc(slab->tsl_MemManager, size);
+
+	c = (size - 1) / TSLAB_GRANULE;
+	node = slab->tsl_Free[c];
+	if (node)
+	{
+		slab->tsl_Free[c] = node->tmn_Node.tmn_Next;
+		return node;
+	}
+
+	size = (c + 1) * TSLAB_GRANULE;
+	if ((TSIZE) (slab->tsl_BumpEnd - slab->tsl_Bump) < size)
+	{
+		union TSlabChunk *chunk =
+			TAlloc(slab->tsl_MemManager, slab->tsl_ChunkSize);
+		TSIZE rest = slab->tsl_BumpEnd - slab->tsl_Bump;
+		if (chunk == TNULL)
+			return TNULL;
+		if (rest >= TSLAB_GRANULE)
+		{
+			/* put the rest of the old chunk into the matching class */
+			node = (union TMemNode *) slab->tsl_Bump;
+			c = rest / TSLAB_GRANULE - 1;
+			node->tmn_Node.tmn_Next = slab->tsl_Free[c];
+			slab->tsl_Free[c] = node;
+		}
+		TAddHead(&slab->tsl_Chunks, &chunk->tsc_Node);
+		slab->tsl_Bump = (TINT8 *) (chunk + 1);
+		slab->tsl_BumpEnd = (TINT8 *) chunk + slab->tsl_ChunkSize;
+	}
+
+	node = (union TMemNode *) slab->tsl_Bump;
+	slab->tsl_Bump += size;
+	return node;
+}
+
+static void exec_slabfree(struct TExecBase *TExecBase, struct TMemSlab *slab,
+	TINT8 *mem, TSIZE size)
+{
+	if (size <= slab->tsl_MaxSize)
+	{
+		union TMemNode *node = (union TMemNode *) mem;
+		TUINT c = (size - 1) / TSLAB_GRANULE;
+		node->tmn_Node.tmn_Next = slab->tsl_Free[c];
+		slab->tsl_Free[c] = node;
+	}
+	else
+		TFree(mem);
+}
+
+static TAPTR exec_slabrealloc(struct TExecBase *TExecBase,
+	struct TMemSlab *slab, TINT8 *oldmem, TSIZE oldsize, TSIZE newsize)
+{
+	TINT8 *newmem;
+	if (oldsize <= slab->tsl_MaxSize && newsize <= slab->tsl_MaxSize)
+	{
+		/* same size class: nothing to do */
+		if ((oldsize - 1) / TSLAB_GRANULE == (newsize - 1) / TSLAB_GRANULE)
+			return oldmem;
+	}
+	else if (oldsize > slab->tsl_MaxSize && newsize > slab->tsl_MaxSize)
+		return TRealloc(oldmem, newsize);
+
+	newmem = exec_slaballoc(TExecBase, slab, newsize);
+	if (newmem)
+	{
+		TCopyMem(oldmem, newmem, TMIN(oldsize, newsize));
+		exec_slabfree(TExecBase, slab, oldmem, oldsize);
+	}
+	return newmem;
+}
+
+static THOOKENTRY TTAG exec_mmu_slab(struct THook *hook, TAPTR obj, TTAG m)
+{
+	struct TMemManager *mmu = obj;
+	struct TExecBase *TExecBase = (TEXECBASE *) TGetExecBase(mmu);
+	union TMemMsg *msg = (union TMemMsg *) m;
+	switch (msg->tmmsg_Type)
+	{
+		case TMMSG_DESTROY:
+			break;
+		case TMMSG_ALLOC:
+			return (TTAG) exec_slaballoc(TExecBase, mmu->tmm_Allocator,
+				msg->tmmsg_Alloc.tmmsg_Size);
+		case TMMSG_FREE:
+			exec_slabfree(TExecBase, mmu->tmm_Allocator,
+				msg->tmmsg_Free.tmmsg_Ptr,
+				msg->tmmsg_Free.tmmsg_Size);
+			break;
+		case TMMSG_REALLOC:
+			return (TTAG) exec_slabrealloc(TExecBase, mmu->tmm_Allocator,
+				msg->tmmsg_Realloc.tmmsg_Ptr,
+				msg->tmmsg_Realloc.tmmsg_OSize,
+				msg->tmmsg_Realloc.tmmsg_NSize);
+		default:
+			TDBPRINTF(TDB_ERROR,("unknown hookmsg\n"));
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	slab allocator, task-safe
+*/
+
+static THOOKENTRY TTAG exec_mmu_slabtask(struct THook *hook, TAPTR obj,
+	TTAG m)
+{
+	struct TMemManager *mmu = obj;
+	struct TExecBase *TExecBase = (TEXECBASE *) TGetExecBase(mmu);
+	union TMemMsg *msg = (union TMemMsg *) m;
+	TAPTR mem = TNULL;
+	switch (msg->tmmsg_Type)
+	{
+		case TMMSG_DESTROY:
+			TDESTROY(&mmu->tmm_Lock);
+			break;
+		case TMMSG_ALLOC:
+			TLock(&mmu->tmm_Lock);
+			mem = exec_slaballoc(TExecBase, mmu->tmm_Allocator,
+				msg->tmmsg_Alloc.tmmsg_Size);
+			TUnlock(&mmu->tmm_Lock);
+			break;
+		case TMMSG_FREE:
+			TLock(&mmu->tmm_Lock);
+			exec_slabfree(TExecBase, mmu->tmm_Allocator,
+				msg->tmmsg_Free.tmmsg_Ptr,
+				msg->tmmsg_Free.tmmsg_Size);
+			TUnlock(&mmu->tmm_Lock);
+			break;
+		case TMMSG_REALLOC:
+			TLock(&mmu->tmm_Lock);
+			mem = exec_slabrealloc(TExecBase, mmu->tmm_Allocator,
+				msg->tmmsg_Realloc.tmmsg_Ptr,
+				msg->tmmsg_Realloc.tmmsg_OSize,
+				msg->tmmsg_Realloc.tmmsg_NSize);
+			TUnlock(&mmu->tmm_Lock);
+			break;
+		default:
+			TDBPRINTF(TDB_ERROR,("unknown hookmsg\n"));
+	}
+	return (TTAG) mem;
+}
+
 /*****************************************************************************/
 /*
 **	TNULL allocator
@@ -1696,15 +2197,38 @@ LOCAL TBOOL exec_initmm(TEXECBASE *TExecBase, struct TMemManager *mmu,
 			return TTRUE;
 
 		case TMMT_Message:
-			if (allocator == TNULL) /* must be TNULL for now */
+			if (allocator == TNULL)
 			{
 				/* note that we use the execbase lock */
 				TINITLIST(&mmu->tmm_TrackList);
 				mmu->tmm_Hook.thk_Entry = exec_mmu_msg;
+			}
+			else
+				/* recycling message MM, see exec_createmsgpool() */
+				mmu->tmm_Hook.thk_Entry = exec_mmu_msgpool;
+			return TTRUE;
+
+		case TMMT_Slab:
+			/*	MM on top of a slab */
+			if (allocator)
+			{
+				mmu->tmm_Hook.thk_Entry = exec_mmu_slab;
 				return TTRUE;
 			}
 			break;
 
+		case TMMT_Slab | TMMT_TaskSafe:
+			/*	MM on top of a slab, task-safe */
+			if (allocator)
+			{
+				if (exec_initlock(TExecBase, &mmu->tmm_Lock))
+				{
+					mmu->tmm_Hook.thk_Entry = exec_mmu_slabtask;
+					return TTRUE;
+				}
+			}
+			break;
+
 		case TMMT_Void:
 			mmu->tmm_Hook.thk_Entry = exec_mmu_void;
 			mmu->tmm_Allocator = TNULL;
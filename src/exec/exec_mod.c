@@ -232,6 +232,9 @@ exec_vectors[EXEC_NUMVECTORS] =
 	(TMFPTR) exec_GetInitData,
 	(TMFPTR) exec_GetMsgSender,
 	(TMFPTR) exec_FreeTask,
+	(TMFPTR) exec_GetLockStats,
+	(TMFPTR) exec_GetMsgPoolStats,
+	(TMFPTR) exec_GetMsgs,
 };
 
 /*****************************************************************************/
@@ -417,7 +420,7 @@ exec_destroyport_internal(struct THook *h, TAPTR obj, TTAG msg)
 		struct TMsgPort *port = obj;
 		TEXECBASE *exec = (TEXECBASE *) TGetExecBase(port);
 
-		if (!TISLISTEMPTY(&port->tmp_MsgList))
+		if (!TISLISTEMPTY(&port->tmp_MsgList) || port->tmp_Inbox)
 			TDBPRINTF(TDB_WARN,("Message queue was not empty\n"));
 
 		exec_freesignal(exec, port->tmp_SigTask, port->tmp_Signal);
@@ -447,6 +450,8 @@ exec_initport(TEXECBASE *exec, struct TMsgPort *port, struct TTask *task,
 		port->tmp_Hook = TNULL;
 		port->tmp_Signal = signal;
 		port->tmp_SigTask = task;
+		port->tmp_Flags = 0;
+		port->tmp_Inbox = TNULL;
 
 		return TTRUE;
 	}
@@ -483,6 +488,10 @@ exec_initlock(TEXECBASE *exec, struct TLock *lock)
 		lock->tlk_Owner = TNULL;
 		lock->tlk_NestCount = 0;
 		lock->tlk_WaitCount = 0;
+		lock->tlk_Spin = 0;
+		lock->tlk_Acquires = 0;
+		lock->tlk_Contended = 0;
+		lock->tlk_WaitTime.tdt_Int64 = 0;
 		return TTRUE;
 	}
 	return TFALSE;
@@ -505,14 +514,7 @@ LOCAL TUINT exec_sendmsg(TEXECBASE *TExecBase, struct TTask *task,
 	msg->tmsg_RPort = &task->tsk_SyncPort;
 	msg->tmsg_Sender = THALFindSelf(hal);
 
-	THALLock(hal, &port->tmp_Lock);
-	TAddTail(&port->tmp_MsgList, (struct TNode *) msg);
-	msg->tmsg_Flags = TMSG_STATUS_SENT | TMSGF_QUEUED;
-	if (port->tmp_Hook)
-		TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
-	THALUnlock(hal, &port->tmp_Lock);
-
-	THALSignal(hal, &port->tmp_SigTask->tsk_Thread, port->tmp_Signal);
+	exec_queuemsg(TExecBase, port, msg, TMSG_STATUS_SENT | TMSGF_QUEUED);
 
 	for (;;)
 	{
@@ -541,22 +543,84 @@ exec_returnmsg(TEXECBASE *exec, TAPTR mem, TUINT status)
 	struct TMessage *msg = TGETMSGPTR(mem);
 	struct TMsgPort *replyport = msg->tmsg_RPort;
 	if (replyport)
+		exec_queuemsg(exec, replyport, msg, status);
+	else
 	{
-		TAPTR hal = exec->texb_HALBase;
+		exec_Free(exec, mem);	/* free one-way msg transparently */
+		TDBPRINTF(TDB_TRACE,("message returned to memory manager\n"));
+	}
+}
 
-		THALLock(hal, &replyport->tmp_Lock);
-		TAddTail(&replyport->tmp_MsgList, (struct TNode *) msg);
-		msg->tmsg_Flags = status;
-		if (replyport->tmp_Hook)
-			TCALLHOOKPKT(replyport->tmp_Hook, replyport, (TTAG) msg);
-		THALUnlock(hal, &replyport->tmp_Lock);
+/*****************************************************************************/
+/*
+**	exec_queuemsg(exec, port, msg, status)
+**	Queue a message at a port, set its status, and signal the port's task.
+**	On a lock-free port, the message is pushed to tmp_Inbox, and the hook
+**	is invoked after it was queued, possibly when it was already received.
+*/
 
-		THALSignal(hal, &replyport->tmp_SigTask->tsk_Thread,
-			replyport->tmp_Signal);
+LOCAL void
+exec_queuemsg(TEXECBASE *exec, struct TMsgPort *port, struct TMessage *msg,
+	TUINT status)
+{
+	TAPTR hal = exec->texb_HALBase;
+#if defined(EXEC_LOCKFREE)
+	if (port->tmp_Flags & TMSGPORTF_LOCKFREE)
+	{
+		struct TNode *head;
+		/* not yet in tmp_MsgList, see exec_WaitIO() */
+		msg->tmsg_Node.tln_Pred = TNULL;
+		EXEC_BARRIER();
+		msg->tmsg_Flags = status;
+		do
+		{
+			head = port->tmp_Inbox;
+			msg->tmsg_Node.tln_Succ = head;
+		} while (!EXEC_CAS(&port->tmp_Inbox, head, &msg->tmsg_Node));
+		if (port->tmp_Hook)
+			TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
 	}
 	else
+#endif
 	{
-		exec_Free(exec, mem);	/* free one-way msg transparently */
-		TDBPRINTF(TDB_TRACE,("message returned to memory manager\n"));
+		THALLock(hal, &port->tmp_Lock);
+		TAddTail(&port->tmp_MsgList, (struct TNode *) msg);
+		msg->tmsg_Flags = status;
+		if (port->tmp_Hook)
+			TCALLHOOKPKT(port->tmp_Hook, port, (TTAG) msg);
+		THALUnlock(hal, &port->tmp_Lock);
+	}
+	THALSignal(hal, &port->tmp_SigTask->tsk_Thread, port->tmp_Signal);
+}
+
+/*****************************************************************************/
+/*
+**	exec_drainport(port)
+**	Move the messages pushed to a lock-free port's inbox to the tail of
+**	its message list, in the order in which they were sent. Must be called
+**	by the port's task only.
+*/
+
+LOCAL void
+exec_drainport(struct TMsgPort *port)
+{
+#if defined(EXEC_LOCKFREE)
+	if (port->tmp_Inbox)
+	{
+		struct TNode *next, *node = EXEC_XCHG(&port->tmp_Inbox, TNULL);
+		struct TNode *first = TNULL;
+		/* inbox is newest first, reverse it */
+		for (; node; node = next)
+		{
+			next = node->tln_Succ;
+			node->tln_Succ = first;
+			first = node;
+		}
+		for (; first; first = next)
+		{
+			next = first->tln_Succ;
+			TAddTail(&port->tmp_MsgList, first);
+		}
 	}
+#endif
 }
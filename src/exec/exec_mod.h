@@ -19,8 +19,8 @@
 /*****************************************************************************/
 
 #define EXEC_VERSION	12
-#define EXEC_REVISION	0
-#define EXEC_NUMVECTORS	81
+#define EXEC_REVISION	1
+#define EXEC_NUMVECTORS	84
 
 /*****************************************************************************/
 
@@ -32,6 +32,30 @@
 #define EXPORT	TMODAPI
 #endif
 
+/*****************************************************************************/
+/*
+**	Lock-free message ports and adaptive locks need atomic operations
+*/
+
+#if defined(__GNUC__) && !defined(EXEC_DISABLE_LOCKFREE)
+#define EXEC_LOCKFREE
+#define EXEC_CAS(p,o,n)		__sync_bool_compare_and_swap(p,o,n)
+#define EXEC_XCHG(p,v)		__sync_lock_test_and_set(p,v)
+#define EXEC_BARRIER()		__sync_synchronize()
+#if defined(__i386__) || defined(__x86_64__)
+#define EXEC_PAUSE()		__builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define EXEC_PAUSE()		__asm__ __volatile__("yield")
+#else
+#define EXEC_PAUSE()
+#endif
+#else
+#define EXEC_BARRIER()
+#endif
+
+/* Upper bound for spinning on a contended TLock */
+#define EXEC_LOCK_MAXSPIN	100
+
 /*****************************************************************************/
 /*
 **	Reserved module calls
@@ -61,6 +85,9 @@ LOCAL TBOOL exec_initlock(TEXECBASE *exec, struct TLock *lock);
 LOCAL void exec_returnmsg(TEXECBASE *exec, TAPTR mem, TUINT status);
 LOCAL TUINT exec_sendmsg(TEXECBASE *exec, struct TTask *task,
 	struct TMsgPort *port, TAPTR mem);
+LOCAL void exec_queuemsg(TEXECBASE *exec, struct TMsgPort *port,
+	struct TMessage *msg, TUINT status);
+LOCAL void exec_drainport(struct TMsgPort *port);
 
 /*****************************************************************************/
 /*
@@ -149,6 +176,12 @@ EXPORT TAPTR exec_ScanModules(struct TExecBase *TExecBase, TTAGITEM *tags);
 EXPORT TAPTR exec_GetInitData(TEXECBASE *exec, struct TTask *task);
 EXPORT struct TTask *exec_GetMsgSender(TEXECBASE *exec, TAPTR msg);
 EXPORT void exec_FreeTask(TEXECBASE *TExecBase, struct TTask *task);
+EXPORT TUINT exec_GetLockStats(TEXECBASE *TExecBase, struct TLock *lock,
+	TTAGITEM *tags);
+EXPORT TUINT exec_GetMsgPoolStats(TEXECBASE *TExecBase,
+	struct TMemManager *mmu, TTAGITEM *tags);
+EXPORT TUINT exec_GetMsgs(TEXECBASE *TExecBase, struct TMsgPort *port,
+	struct TList *list, TUINT max);
 
 /*****************************************************************************/
 /*
@@ -13,8 +13,8 @@
 #include <tek/debug.h>
 
 #define HAL_VERSION		4
-#define HAL_REVISION	0
-#define HAL_NUMVECTORS	28
+#define HAL_REVISION	1
+#define HAL_NUMVECTORS	29
 
 static THOOKENTRY TTAG hal_dispatch(struct THook *hook, TAPTR obj, TTAG msg);
 static const TMFPTR hal_vectors[HAL_NUMVECTORS];
@@ -125,6 +125,8 @@ hal_vectors[HAL_NUMVECTORS] =
 	(TMFPTR) hal_unloadmodule,
 
 	(TMFPTR) hal_scanmodules,
+
+	(TMFPTR) hal_getsystime,
 };
 
 /*****************************************************************************/
@@ -83,5 +83,6 @@ EXPORT TTAG hal_getattr(struct THALBase *hal, TUINT tag, TTAG defval);
 EXPORT TUINT hal_wait(struct THALBase *hal, TUINT signals);
 EXPORT void hal_signal(struct THALBase *hal, struct THALObject *thread, TUINT signals);
 EXPORT TUINT hal_setsignal(struct THALBase *hal, TUINT newsig, TUINT sigmask);
+EXPORT void hal_getsystime(struct THALBase *hal, TTIME *time);
 
 #endif
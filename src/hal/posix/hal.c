@@ -23,6 +23,10 @@
 #include <errno.h>
 #include <time.h>
 #include <dlfcn.h>
+#if defined(HAL_POSIX_FUTEX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 /* undefine to use waiting locks */
 #define HAL_POSIX_SPINLOCK_USE
@@ -34,6 +38,12 @@ static void TTASKENTRY hal_devfunc(struct TTask *task);
 
 /*****************************************************************************/
 
+#if defined(HAL_POSIX_TLS)
+static __thread struct HALThread *hal_self;
+#endif
+
+/*****************************************************************************/
+
 #ifdef TDEBUG
 #define TRACKMEM
 static int bytecount;
@@ -272,16 +282,41 @@ hal_unlock(struct THALBase *hal, struct THALObject *lock)
 **	Threads
 */
 
+static TBOOL
+hal_setthread(struct THALBase *hal, struct HALThread *t)
+{
+	struct HALSpecific *hps = hal->hmb_Specific;
+	if (pthread_setspecific(hps->hsp_TSDKey, (void *) t))
+		return TFALSE;
+#if defined(HAL_POSIX_TLS)
+	hal_self = t;
+#endif
+	return TTRUE;
+}
+
+static TINLINE struct HALThread *
+hal_getthread(struct THALBase *hal)
+{
+	struct HALSpecific *hps;
+#if defined(HAL_POSIX_TLS)
+	/* the cache is per thread, not per HAL instance */
+	struct HALThread *t = hal_self;
+	if (t && t->hth_HALBase == hal)
+		return t;
+#endif
+	hps = hal->hmb_Specific;
+	return pthread_getspecific(hps->hsp_TSDKey);
+}
+
 static void *
 hal_posixthread_entry(struct HALThread *thread)
 {
 	struct THALBase *hal = thread->hth_HALBase;
-	struct HALSpecific *hps = hal->hmb_Specific;
 
 	if (pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL))
 		TDBPRINTF(20,("pthread_setcancelstate\n"));
 
-	if (pthread_setspecific(hps->hsp_TSDKey, (void *) thread))
+	if (!hal_setthread(hal, thread))
 		TDBPRINTF(20,("failed to set TSD key\n"));
 
 	/* wait for initial signal to run */
@@ -300,9 +335,14 @@ hal_initthread(struct THALBase *hal, struct THALObject *thread,
 	struct HALThread *t = THALNewObject(hal, thread, struct HALThread);
 	if (t)
 	{
+#if defined(HAL_POSIX_FUTEX)
+		{
+			t->hth_SigWait = 0;
+#else
 		if (pthread_cond_init(&t->hth_SigCond, NULL) == 0)
 		{
 			pthread_mutex_init(&t->hth_SigMutex, NULL);
+#endif
 			t->hth_SigState = 0;
 			t->hth_Function = function;
 			t->hth_Data = data;
@@ -316,11 +356,12 @@ hal_initthread(struct THALBase *hal, struct THALObject *thread,
 			}
 			else
 			{
-				struct HALSpecific *hps = hal->hmb_Specific;
-				if (pthread_setspecific(hps->hsp_TSDKey, (void *) t) == 0)
+				if (hal_setthread(hal, t))
 					return TTRUE;
 			}
+#if !defined(HAL_POSIX_FUTEX)
 			pthread_cond_destroy(&t->hth_SigCond);
+#endif
 		}
 		THALDestroyObject(hal, t, struct HALThread);
 	}
@@ -336,18 +377,23 @@ hal_destroythread(struct THALBase *hal, struct THALObject *thread)
 	{
 		if (pthread_join(t->hth_PThread, NULL)) TDBPRINTF(20,("pthread_join\n"));
 	}
+#if defined(HAL_POSIX_TLS)
+	else if (hal_self == t)
+		hal_self = TNULL;
+#endif
+#if !defined(HAL_POSIX_FUTEX)
 	if (pthread_mutex_destroy(&t->hth_SigMutex))
 		TDBPRINTF(20,("mutex_destroy\n"));
 	if (pthread_cond_destroy(&t->hth_SigCond))
 		TDBPRINTF(20,("cond_destroy\n"));
+#endif
 	THALDestroyObject(hal, t, struct HALThread);
 }
 
 EXPORT TAPTR
 hal_findself(struct THALBase *hal)
 {
-	struct HALSpecific *hps = hal->hmb_Specific;
-	struct HALThread *t = pthread_getspecific(hps->hsp_TSDKey);
+	struct HALThread *t = hal_getthread(hal);
 	return t->hth_Data;
 }
 
@@ -356,6 +402,96 @@ hal_findself(struct THALBase *hal)
 **	Signals
 */
 
+#if defined(HAL_POSIX_FUTEX)
+
+/*
+**	A thread waiting for signals sets hth_SigWait and rechecks the signal
+**	state before sleeping on it, and a signalling thread changes the state
+**	before checking hth_SigWait, both with full barriers. Either the waiter
+**	sees the new signals, or the signaller sees the waiter and wakes it;
+**	a change between the waiter's check and its sleep makes FUTEX_WAIT
+**	return immediately.
+*/
+
+static TBOOL
+hal_futexwait(volatile TUINT *addr, TUINT val, struct timespec *abstime)
+{
+	if (abstime)
+		return syscall(SYS_futex, addr,
+			FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME, val, abstime,
+			NULL, FUTEX_BITSET_MATCH_ANY) == -1 && errno == ETIMEDOUT;
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+	return TFALSE;
+}
+
+static TUINT
+hal_waitsignals(struct HALThread *t, TUINT sigmask, struct timespec *abstime)
+{
+	TUINT state, sig;
+	for (;;)
+	{
+		sig = __sync_fetch_and_and(&t->hth_SigState, ~sigmask) & sigmask;
+		if (sig)
+			break;
+		t->hth_SigWait = 1;
+		__sync_synchronize();
+		state = t->hth_SigState;
+		if (!(state & sigmask) &&
+			hal_futexwait(&t->hth_SigState, state, abstime))
+		{
+			/* timed out */
+			t->hth_SigWait = 0;
+			break;
+		}
+		t->hth_SigWait = 0;
+	}
+	return sig;
+}
+
+EXPORT void
+hal_signal(struct THALBase *hal, struct THALObject *thread, TUINT signals)
+{
+	struct HALThread *t = THALGetObject(thread, struct HALThread);
+	TUINT oldsig = __sync_fetch_and_or(&t->hth_SigState, signals);
+	if ((signals & ~oldsig) && t->hth_SigWait)
+		syscall(SYS_futex, &t->hth_SigState, FUTEX_WAKE_PRIVATE, 1,
+			NULL, NULL, 0);
+}
+
+EXPORT TUINT
+hal_setsignal(struct THALBase *hal, TUINT newsig, TUINT sigmask)
+{
+	TUINT oldsig;
+	struct HALThread *t = hal_getthread(hal);
+	newsig &= sigmask;
+	/* only the calling thread waits on its signals, no wakeup needed */
+	do oldsig = t->hth_SigState;
+	while (!__sync_bool_compare_and_swap(&t->hth_SigState, oldsig,
+		(oldsig & ~sigmask) | newsig));
+	return oldsig;
+}
+
+EXPORT TUINT
+hal_wait(struct THALBase *hal, TUINT sigmask)
+{
+	struct HALThread *t = hal_getthread(hal);
+	return hal_waitsignals(t, sigmask, TNULL);
+}
+
+static TUINT
+hal_timedwaitevent(TAPTR hal, struct HALThread *t, TTIME *wt,
+	TUINT sigmask)
+{
+	struct timespec tv;
+	if (wt->tdt_Int64 == 0x7fffffffffffffffLL)
+		return hal_waitsignals(t, sigmask, TNULL);
+	tv.tv_sec = wt->tdt_Int64 / 1000000;
+	tv.tv_nsec = (wt->tdt_Int64 % 1000000) * 1000;
+	return hal_waitsignals(t, sigmask, &tv);
+}
+
+#else /* defined(HAL_POSIX_FUTEX) */
+
 EXPORT void
 hal_signal(struct THALBase *hal, struct THALObject *thread, TUINT signals)
 {
@@ -374,8 +510,7 @@ EXPORT TUINT
 hal_setsignal(struct THALBase *hal, TUINT newsig, TUINT sigmask)
 {
 	TUINT oldsig;
-	struct HALSpecific *hps = hal->hmb_Specific;
-	struct HALThread *t = pthread_getspecific(hps->hsp_TSDKey);
+	struct HALThread *t = hal_getthread(hal);
 	pthread_mutex_lock(&t->hth_SigMutex);
 	newsig &= sigmask;
 	oldsig = t->hth_SigState;
@@ -395,8 +530,7 @@ EXPORT TUINT
 hal_wait(struct THALBase *hal, TUINT sigmask)
 {
 	TUINT sig;
-	struct HALSpecific *hps = hal->hmb_Specific;
-	struct HALThread *t = pthread_getspecific(hps->hsp_TSDKey);
+	struct HALThread *t = hal_getthread(hal);
 
 	pthread_mutex_lock(&t->hth_SigMutex);
 	for (;;)
@@ -435,12 +569,14 @@ hal_timedwaitevent(TAPTR hal, struct HALThread *t, TTIME *wt,
 	return sig;
 }
 
+#endif /* defined(HAL_POSIX_FUTEX) */
+
 /*****************************************************************************/
 /*
 **	Time and date
 */
 
-static void
+EXPORT void
 hal_getsystime(struct THALBase *hal, TTIME *time)
 {
 	struct timeval tv;
@@ -835,7 +971,7 @@ static void TTASKENTRY hal_devfunc(struct TTask *task)
 	TAPTR exec = TGetExecBase(task);
 	struct THALBase *hal = (struct THALBase *) TExecGetHALBase(exec);
 	struct HALSpecific *hps = hal->hmb_Specific;
-	struct HALThread *thread = pthread_getspecific(hps->hsp_TSDKey);
+	struct HALThread *thread = hal_getthread(hal);
 	TAPTR port = TExecGetUserPort(exec, task);
 	struct TTimeRequest *msg;
 	TUINT sig = 0;
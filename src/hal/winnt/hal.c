@@ -40,8 +40,6 @@
 #define InterlockedOr __sync_fetch_and_or
 #endif
 
-static void hal_getsystime(struct THALBase *hal, TTIME *time);
-
 /*****************************************************************************/
 /*
 **	Host Init
@@ -413,7 +411,7 @@ hal_timedwaitevent(struct THALBase *hal, struct HALThread *t,
 **	Time and date
 */
 
-static void
+EXPORT void
 hal_getsystime(struct THALBase *hal, TTIME *time)
 {
 	struct HALSpecific *hws = hal->hmb_Specific;
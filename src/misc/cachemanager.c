@@ -12,11 +12,13 @@ struct Hash
 {
 	struct THandle handle;
 	struct TMemManager *memmgr;
+	struct TLock *lock;
 	struct CacheManagerIFace iface;
 	struct HashNode **buckets;
-	TINT nument, numbuckets, primeidx;
-	TSIZE allocbytes, maxbytes;
-	struct TList items;
+	TINT nument, numbuckets;
+	TSIZE allocbytes, maxbytes, peakbytes;
+	TSIZE hits, misses, evictions;
+	struct TList items; /* head is most recently used */
 	TINT numitems;
 };
 
@@ -28,6 +30,9 @@ struct HashNode
 	TUINT hash;
 };
 
+/* number of buckets is a power of two, growing and shrinking with nument: */
+#define CM_MINBUCKETS	8
+
 /* Lua's string hashing function, see lstring.c */
 static TUINT cm_hash(struct THandle *hnd, TUINT8 *str, TSIZE l)
 {
@@ -39,15 +44,34 @@ static TUINT cm_hash(struct THandle *hnd, TUINT8 *str, TSIZE l)
 	return h;
 }
 
-static const int cm_primes[] = { 7, 17, 31, 61, 127, 251, 509, 1021, 2039, 4093 };
-static const int cm_numprimes = sizeof(cm_primes) / sizeof(cm_primes[0]);
+/*
+**	The cache is shared by the display driver tasks and the task setting
+**	its budget and querying its statistics. All functions of the interface
+**	lock it; the lock is recursive, so that destroying an item can call
+**	back into the interface. cm_hash() does not access the cache.
+*/
+
+static void cm_lock(struct THandle *hnd)
+{
+	struct Hash *hash = (struct Hash *) hnd;
+	TAPTR TExecBase = TGetExecBase(hash);
+	TLock(hash->lock);
+}
+
+static void cm_unlock(struct THandle *hnd)
+{
+	struct Hash *hash = (struct Hash *) hnd;
+	TAPTR TExecBase = TGetExecBase(hash);
+	TUnlock(hash->lock);
+}
 
 static struct HashNode **cm_lookup(struct Hash *hash, TUINT8 *key,
 	TSIZE len, TUINT hval)
 {
-	struct HashNode **bucket = &hash->buckets[hval % hash->numbuckets];
+	struct HashNode **bucket = 
+		&hash->buckets[hval & (hash->numbuckets - 1)];
 	for (; *bucket; bucket = &(*bucket)->next)
-		if ((*bucket)->len == len && 
+		if ((*bucket)->hash == hval && (*bucket)->len == len && 
 			memcmp((char *) (*bucket + 1), key, len) == 0) break;
 	return bucket;
 }
@@ -55,32 +79,34 @@ static struct HashNode **cm_lookup(struct Hash *hash, TUINT8 *key,
 static TAPTR cm_get(struct THandle *hnd, TUINT8 *key, TSIZE len, TUINT hval)
 {
 	struct Hash *hash = (struct Hash *) hnd;
-	struct HashNode *node = *cm_lookup(hash, key, len, hval);
-	if (node)
-		return node->value;
-	return TNULL;
+	struct HashNode *node;
+	cm_lock(hnd);
+	node = *cm_lookup(hash, key, len, hval);
+	cm_unlock(hnd);
+	return node ? node->value : TNULL;
 }
 
 static void cm_resize(struct Hash *hash) 
 {
 	struct HashNode **newbuckets, *next, *node;
-	int numbuckets = hash->numbuckets, newnumbuckets;
-	int load = hash->nument / numbuckets;
-	int i, pi = hash->primeidx;
-	if (numbuckets < cm_primes[cm_numprimes - 1] && load >= 3)
-		for (; pi < cm_numprimes - 1 && cm_primes[pi + 1] < hash->nument; ++pi);
-	if (pi == hash->primeidx) 
+	TINT numbuckets = hash->numbuckets, newnumbuckets = numbuckets;
+	TINT i;
+	if (hash->nument > numbuckets * 2)
+		newnumbuckets = numbuckets * 2;
+	else if (numbuckets > CM_MINBUCKETS && hash->nument < numbuckets / 4)
+		newnumbuckets = numbuckets / 2;
+	if (newnumbuckets == numbuckets) 
 		return;
-	newnumbuckets = cm_primes[pi];
 	TAPTR TExecBase = TGetExecBase(hash);
-	newbuckets = TAlloc0(hash->memmgr, sizeof(struct HashNode) * newnumbuckets);
+	newbuckets = TAlloc0(hash->memmgr, 
+		sizeof(struct HashNode *) * newnumbuckets);
 	if (!newbuckets) 
 		return;
-	for (i = 0; i < hash->numbuckets; ++i)
+	for (i = 0; i < numbuckets; ++i)
 	{
 		for (node = hash->buckets[i]; node; node = next) 
 		{
-			int hashidx = node->hash % newnumbuckets;
+			TINT hashidx = node->hash & (newnumbuckets - 1);
 			next = node->next;
 			node->next = newbuckets[hashidx];
 			newbuckets[hashidx] = node;
@@ -89,7 +115,6 @@ static void cm_resize(struct Hash *hash)
 	TFree(hash->buckets);
 	hash->buckets = newbuckets;
 	hash->numbuckets = newnumbuckets;
-	hash->primeidx = pi;
 }
 
 static TBOOL cm_put(struct THandle *hnd, TUINT8 *key, TSIZE len, TUINT hval, 
@@ -97,16 +122,23 @@ static TBOOL cm_put(struct THandle *hnd, TUINT8 *key, TSIZE len, TUINT hval,
 {
 	struct Hash *hash = (struct Hash *) hnd;
 	char *newkey;
-	struct HashNode *newnode, **bucket = cm_lookup(hash, key, len, hval);
+	struct HashNode *newnode, **bucket;
+	cm_lock(hnd);
+	bucket = cm_lookup(hash, key, len, hval);
 	if (*bucket) 
 	{
 		TDBPRINTF(TDB_WARN,("Overwrite cache node\n"));
 		(*bucket)->value = value;
+		cm_unlock(hnd);
 		return TTRUE;
 	}
 	TAPTR TExecBase = TGetExecBase(hash);
 	newnode = TAlloc(hash->memmgr, sizeof(struct HashNode) + len);
-	if (!newnode) return 0;
+	if (!newnode)
+	{
+		cm_unlock(hnd);
+		return 0;
+	}
 	newkey = (char *) (newnode + 1);
 	memcpy(newkey, key, len);
 	newnode->next = NULL;
@@ -117,12 +149,29 @@ static TBOOL cm_put(struct THandle *hnd, TUINT8 *key, TSIZE len, TUINT hval,
 	hash->nument++;
 	TDBPRINTF(TDB_INFO,("Cache records: %d\n", hash->nument));
 	cm_resize(hash);
+	cm_unlock(hnd);
 	return TFALSE;
 }
 
-static TAPTR cm_alloc(struct THandle *hnd, TSIZE size)
+static void cm_rem(struct THandle *hnd, TUINT8 *key, TSIZE len, TUINT hval)
 {
 	struct Hash *hash = (struct Hash *) hnd;
+	struct HashNode *node, **bucket;
+	cm_lock(hnd);
+	bucket = cm_lookup(hash, key, len, hval);
+	if ((node = *bucket))
+	{
+		TAPTR TExecBase = TGetExecBase(hash);
+		*bucket = node->next;
+		TFree(node);
+		hash->nument--;
+		cm_resize(hash);
+	}
+	cm_unlock(hnd);
+}
+
+static void cm_evict(struct Hash *hash, TSIZE size)
+{
 	if (hash->maxbytes > 0)
 	{
 		while (hash->allocbytes + size > hash->maxbytes)
@@ -131,12 +180,26 @@ static TAPTR cm_alloc(struct THandle *hnd, TSIZE size)
 			if (!item)
 				break;
 			TDestroy(item->handle);
+			hash->evictions++;
 		}
 	}
+}
+
+static TAPTR cm_alloc(struct THandle *hnd, TSIZE size)
+{
+	struct Hash *hash = (struct Hash *) hnd;
 	TAPTR TExecBase = TGetExecBase(hash);
-	TAPTR mem = TAlloc(hash->memmgr, size);
+	TAPTR mem;
+	cm_lock(hnd);
+	cm_evict(hash, size);
+	mem = TAlloc(hash->memmgr, size);
 	if (mem)
+	{
 		hash->allocbytes += size;
+		if (hash->allocbytes > hash->peakbytes)
+			hash->peakbytes = hash->allocbytes;
+	}
+	cm_unlock(hnd);
 	return mem;
 }
 
@@ -144,24 +207,116 @@ static void cm_free(struct THandle *hnd, TAPTR mem)
 {
 	struct Hash *hash = (struct Hash *) hnd;
 	TAPTR TExecBase = TGetExecBase(hash);
+	cm_lock(hnd);
 	if (mem)
 		hash->allocbytes -= TGetSize(mem);
 	TFree(mem);
+	cm_unlock(hnd);
 }
 
 static void cm_additem(struct THandle *hnd, struct CacheItem *item)
 {
 	struct Hash *hash = (struct Hash *) hnd;
-	TAddTail(&hash->items, &item->node);
+	cm_lock(hnd);
+	TAddHead(&hash->items, &item->node);
 	hash->numitems++;
-	/*fprintf(stderr, "allocated: %ld - items: %d\n", hash->allocbytes, hash->numitems);*/
+	cm_unlock(hnd);
 }
 
 static void cm_remitem(struct THandle *hnd, struct CacheItem *item)
 {
 	struct Hash *hash = (struct Hash *) hnd;
+	cm_lock(hnd);
 	TRemove(&item->node);
 	hash->numitems--;
+	cm_unlock(hnd);
+}
+
+static void cm_touch(struct THandle *hnd, struct CacheItem *item)
+{
+	struct Hash *hash = (struct Hash *) hnd;
+	cm_lock(hnd);
+	TRemove(&item->node);
+	TAddHead(&hash->items, &item->node);
+	hash->hits++;
+	cm_unlock(hnd);
+}
+
+static void cm_miss(struct THandle *hnd)
+{
+	struct Hash *hash = (struct Hash *) hnd;
+	cm_lock(hnd);
+	hash->misses++;
+	cm_unlock(hnd);
+}
+
+static THOOKENTRY TTAG cm_setattrfunc(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	struct Hash *hash = hook->thk_Data;
+	TTAGITEM *item = obj;
+	switch (item->tti_Tag)
+	{
+		case CacheManager_MaxBytes:
+			hash->maxbytes = (TSIZE) item->tti_Value;
+			cm_evict(hash, 0);
+			break;
+	}
+	return TTRUE;
+}
+
+static void cm_setattrs(struct THandle *hnd, TTAGITEM *tags)
+{
+	struct THook hook;
+	TInitHook(&hook, cm_setattrfunc, hnd);
+	cm_lock(hnd);
+	TForEachTag(tags, &hook);
+	cm_unlock(hnd);
+}
+
+static THOOKENTRY TTAG cm_getattrfunc(struct THook *hook, TAPTR obj, TTAG msg)
+{
+	struct Hash *hash = hook->thk_Data;
+	TTAGITEM *item = obj;
+	TSIZE *valp = (TSIZE *) item->tti_Value;
+	switch (item->tti_Tag)
+	{
+		default:
+			return TTRUE;
+		case CacheManager_MaxBytes:
+			*valp = hash->maxbytes;
+			break;
+		case CacheManager_AllocBytes:
+			*valp = hash->allocbytes;
+			break;
+		case CacheManager_PeakBytes:
+			*valp = hash->peakbytes;
+			break;
+		case CacheManager_NumItems:
+			*valp = hash->numitems;
+			break;
+		case CacheManager_NumRecords:
+			*valp = hash->nument;
+			break;
+		case CacheManager_Hits:
+			*valp = hash->hits;
+			break;
+		case CacheManager_Misses:
+			*valp = hash->misses;
+			break;
+		case CacheManager_Evictions:
+			*valp = hash->evictions;
+			break;
+	}
+	return TTRUE;
+}
+
+static void cm_getattrs(struct THandle *hnd, TTAGITEM *tags)
+{
+	struct THook hook;
+	TInitHook(&hook, cm_getattrfunc, hnd);
+	cm_lock(hnd);
+	TForEachTag(tags, &hook);
+	cm_unlock(hnd);
 }
 
 static THOOKENTRY TTAG cm_msg(struct THook *hook, TAPTR obj, TTAG msg)
@@ -171,14 +326,27 @@ static THOOKENTRY TTAG cm_msg(struct THook *hook, TAPTR obj, TTAG msg)
 	{
 		int i;
 		TAPTR TExecBase = hash->handle.thn_Owner;
-		struct HashNode *node, *next;
+		struct CacheItem *item;
+		struct HashNode *node;
+		/* items first, values may remove themselves when they get empty: */
+		while ((item = (struct CacheItem *) TLASTNODE(&hash->items)))
+			TDestroy(item->handle);
 		for (i = 0; i < hash->numbuckets; ++i)
-			for (next = hash->buckets[i]; (node = next); 
-				next = node->next, TDestroy(node->value), TFree(node));
+		{
+			while ((node = hash->buckets[i]))
+			{
+				struct THandle *value = node->value;
+				hash->buckets[i] = node->next;
+				hash->nument--;
+				TFree(node);
+				TDestroy(value);
+			}
+		}
 		TFree(hash->buckets);
 		assert(hash->allocbytes == 0);
 		TDestroy((struct THandle *) hash->memmgr);
 		assert(hash->numitems == 0);
+		TDestroy((struct THandle *) hash->lock);
 		TFree(hash);
 	}
 	else if (msg == CacheManagerMsgQueryIFace)
@@ -186,19 +354,21 @@ static THOOKENTRY TTAG cm_msg(struct THook *hook, TAPTR obj, TTAG msg)
 	return 0;
 }
 
-TLIBAPI struct THandle *cachemanager_create(TAPTR TExecBase)
+TLIBAPI struct THandle *cachemanager_create(TAPTR TExecBase, TTAGITEM *tags)
 {
 	struct TMemManager *mmgr = TNULL; /*TCreateMemManager(TNULL, TMMT_Tracking, TNULL);*/
 	struct Hash *hash = TAlloc0(mmgr, sizeof(struct Hash));
 	if (hash)
 	{
-		hash->buckets = TAlloc0(mmgr, sizeof(struct HashNode) * cm_primes[0]);
-		if (hash->buckets)
+		hash->buckets = TAlloc0(mmgr, 
+			sizeof(struct HashNode *) * CM_MINBUCKETS);
+		hash->lock = TCreateLock(TNULL);
+		if (hash->buckets && hash->lock)
 		{
 			hash->handle.thn_Owner = TExecBase;
 			TInitHook(&hash->handle.thn_Hook, cm_msg, hash);
 			hash->memmgr = mmgr;
-			hash->numbuckets = cm_primes[0];
+			hash->numbuckets = CM_MINBUCKETS;
 			hash->iface.hash = cm_hash;
 			hash->iface.put = cm_put;
 			hash->iface.get = cm_get;
@@ -206,12 +376,22 @@ TLIBAPI struct THandle *cachemanager_create(TAPTR TExecBase)
 			hash->iface.free = cm_free;
 			hash->iface.additem = cm_additem;
 			hash->iface.remitem = cm_remitem;
+			hash->iface.rem = cm_rem;
+			hash->iface.touch = cm_touch;
+			hash->iface.miss = cm_miss;
+			hash->iface.setattrs = cm_setattrs;
+			hash->iface.getattrs = cm_getattrs;
+			hash->iface.lock = cm_lock;
+			hash->iface.unlock = cm_unlock;
 			hash->allocbytes = 0;
-			hash->maxbytes = 1000000;
+			hash->maxbytes = (TSIZE) TGetTag(tags, CacheManager_MaxBytes,
+				(TTAG) CACHEMANAGER_DEF_MAXBYTES);
 			hash->numitems = 0;
 			TInitList(&hash->items);
 			return &hash->handle;
 		}
+		TDestroy((struct THandle *) hash->lock);
+		TFree(hash->buckets);
 		TFree(hash);
 	}
 	return TNULL;
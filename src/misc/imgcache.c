@@ -1,10 +1,160 @@
 #ifndef _TEK_LIB_IMGCACHE_C
 #define _TEK_LIB_IMGCACHE_C
 
+#include <string.h>
 #include <tek/debug.h>
 #include <tek/teklib.h>
 #include <tek/lib/imgcache.h>
 
+/*****************************************************************************/
+/*
+**	The tiles of a record are kept in a treap ordered by y0, x0, in which
+**	each node also holds the greatest y1 of its subtree. Queries skip
+**	subtrees that end above the searched rows, and nodes that start below
+**	them, along with their right subtrees.
+*/
+
+#define IC_CONTAINS	0 /* find tile containing the rectangle */
+#define IC_INSIDE	1 /* collect tiles inside the rectangle */
+#define IC_ADJACENT	2 /* find tile of same width or height touching it */
+
+static TBOOL ic_less(struct ImageCacheNode *a, struct ImageCacheNode *b)
+{
+	if (a->y0 != b->y0)
+		return a->y0 < b->y0;
+	if (a->x0 != b->x0)
+		return a->x0 < b->x0;
+	return (TUINTPTR) a < (TUINTPTR) b;
+}
+
+static void ic_update(struct ImageCacheNode *n)
+{
+	TINT maxy1 = n->y1;
+	if (n->left && n->left->maxy1 > maxy1)
+		maxy1 = n->left->maxy1;
+	if (n->right && n->right->maxy1 > maxy1)
+		maxy1 = n->right->maxy1;
+	n->maxy1 = maxy1;
+}
+
+static struct ImageCacheNode *ic_insert(struct ImageCacheNode *t,
+	struct ImageCacheNode *n)
+{
+	struct ImageCacheNode *c;
+	if (!t)
+		return n;
+	if (ic_less(n, t))
+	{
+		c = t->left = ic_insert(t->left, n);
+		if (c->prio > t->prio)
+		{
+			t->left = c->right;
+			c->right = t;
+			ic_update(t);
+			t = c;
+		}
+	}
+	else
+	{
+		c = t->right = ic_insert(t->right, n);
+		if (c->prio > t->prio)
+		{
+			t->right = c->left;
+			c->left = t;
+			ic_update(t);
+			t = c;
+		}
+	}
+	ic_update(t);
+	return t;
+}
+
+static struct ImageCacheNode *ic_join(struct ImageCacheNode *a,
+	struct ImageCacheNode *b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	if (a->prio > b->prio)
+	{
+		a->right = ic_join(a->right, b);
+		ic_update(a);
+		return a;
+	}
+	b->left = ic_join(a, b->left);
+	ic_update(b);
+	return b;
+}
+
+static struct ImageCacheNode *ic_remove(struct ImageCacheNode *t,
+	struct ImageCacheNode *n)
+{
+	if (!t)
+		return TNULL;
+	if (t == n)
+		return ic_join(t->left, t->right);
+	if (ic_less(n, t))
+		t->left = ic_remove(t->left, n);
+	else
+		t->right = ic_remove(t->right, n);
+	ic_update(t);
+	return t;
+}
+
+static TBOOL ic_match(struct ImageCacheNode *cn, TINT *r, TINT mode)
+{
+	switch (mode)
+	{
+		case IC_CONTAINS:
+			return r[0] >= cn->x0 && r[2] <= cn->x1 && 
+				r[1] >= cn->y0 && r[3] <= cn->y1;
+		case IC_INSIDE:
+			return r[0] <= cn->x0 && r[2] >= cn->x1 && 
+				r[1] <= cn->y0 && r[3] >= cn->y1;
+		default:
+			if (cn->x0 == r[0] && cn->x1 == r[2])
+				return cn->y1 + 1 == r[1] || cn->y0 == r[3] + 1;
+			if (cn->y0 == r[1] && cn->y1 == r[3])
+				return cn->x1 + 1 == r[0] || cn->x0 == r[2] + 1;
+			return TFALSE;
+	}
+}
+
+/*
+**	Search nodes with y0 <= ymax and y1 >= ymin. In IC_INSIDE mode, all
+**	matches are collected in *list and TNULL is returned, otherwise the
+**	first match is returned.
+*/
+
+static struct ImageCacheNode *ic_query(struct ImageCacheNode *t, TINT *r,
+	TINT ymin, TINT ymax, TINT mode, struct ImageCacheNode **list)
+{
+	struct ImageCacheNode *found;
+	for (; t && t->maxy1 >= ymin; t = t->right)
+	{
+		/* in IC_INSIDE mode, nodes left of one above r[1] are above, too */
+		if (mode != IC_INSIDE || t->y0 >= r[1])
+		{
+			found = ic_query(t->left, r, ymin, ymax, mode, list);
+			if (found)
+				return found;
+		}
+		if (t->y0 > ymax)
+			break;
+		if (t->y1 >= ymin && ic_match(t, r, mode))
+		{
+			if (mode != IC_INSIDE)
+				return t;
+			t->link = *list;
+			*list = t;
+		}
+	}
+	return TNULL;
+}
+
+/*****************************************************************************/
+
 static THOOKENTRY TTAG destroy_cachenode(struct THook *hook, TAPTR obj, 
 	TTAG msg)
 {
@@ -12,10 +162,14 @@ static THOOKENTRY TTAG destroy_cachenode(struct THook *hook, TAPTR obj,
 		return 0;
 	struct ImageCacheNode *cn = obj;
 	struct THandle *cache = cn->handle.thn_Owner;
-	struct CacheManagerIFace *iface = cn->crec->iface;
+	struct ImageCacheRecord *cr = cn->crec;
+	struct CacheManagerIFace *iface = cr->iface;
+	cr->root = ic_remove(cr->root, cn);
 	TRemove(&cn->handle.thn_Node);
 	iface->remitem(cache, &cn->item);
 	iface->free(cache, cn);
+	if (--cr->numitems == 0 && !cr->busy)
+		TDestroy(&cr->handle);
 	return 0;
 }
 
@@ -27,12 +181,70 @@ static THOOKENTRY TTAG destroy_cacherecord(struct THook *hook, TAPTR obj,
 	struct ImageCacheRecord *cr = obj;
 	struct THandle *cache = cr->handle.thn_Owner;
 	struct TNode *next, *node = cr->list.tlh_Head.tln_Succ;
+	cr->busy = TTRUE;
 	for (; (next = node->tln_Succ); node = next)
 		TDestroy(&((struct ImageCacheNode *) node)->handle);
+	cr->iface->rem(cache, (TUINT8 *) (cr + 1), cr->keylen, cr->hashvalue);
 	cr->iface->free(cache, cr);
 	return 0;
 }
 
+static void imgcache_copytile(struct ImageCacheNode *dst,
+	struct ImageCacheNode *src, TINT bpp)
+{
+	TINT sw = src->x1 - src->x0 + 1;
+	TINT dw = dst->x1 - dst->x0 + 1;
+	TUINT8 *s = src->buf;
+	TUINT8 *d = dst->buf + 
+		bpp * (src->x0 - dst->x0 + (src->y0 - dst->y0) * dw);
+	TINT y;
+	for (y = src->y0; y <= src->y1; ++y, s += sw * bpp, d += dw * bpp)
+		memcpy(d, s, sw * bpp);
+}
+
+/*
+**	Merge the new, unlinked node with an adjacent tile of the same width or
+**	height. Returns the new node for the combined tile, or TNULL.
+*/
+
+static struct ImageCacheNode *imgcache_merge(struct THandle *cache,
+	struct ImageCacheRecord *cr, struct ImageCacheNode *cn, TINT bpp)
+{
+	struct CacheManagerIFace *iface = cr->iface;
+	TINT r[4] = { cn->x0, cn->y0, cn->x1, cn->y1 };
+	struct ImageCacheNode *mn, *nb = ic_query(cr->root, r, r[1] - 1, 
+		r[3] + 1, IC_ADJACENT, TNULL);
+	if (!nb)
+		return TNULL;
+	TINT x0 = TMIN(cn->x0, nb->x0);
+	TINT y0 = TMIN(cn->y0, nb->y0);
+	TINT x1 = TMAX(cn->x1, nb->x1);
+	TINT y1 = TMAX(cn->y1, nb->y1);
+	TUINT numpixels = (x1 - x0 + 1) * (y1 - y0 + 1);
+	if (numpixels > IMGCACHE_MERGE_MAXPIXELS)
+		return TNULL;
+	/* the neighbour must not be evicted for the combined tile: */
+	iface->remitem(cache, &nb->item);
+	mn = iface->alloc(cache, sizeof(struct ImageCacheNode) + numpixels * bpp);
+	iface->additem(cache, &nb->item);
+	if (!mn)
+		return TNULL;
+	mn->buf = (TUINT8 *) (mn + 1);
+	mn->pixels = numpixels;
+	mn->crec = cr;
+	mn->x0 = x0;
+	mn->y0 = y0;
+	mn->x1 = x1;
+	mn->y1 = y1;
+	imgcache_copytile(mn, cn, bpp);
+	imgcache_copytile(mn, nb, bpp);
+	TDestroy(&nb->handle);
+	iface->free(cache, cn);
+	return mn;
+}
+
+/*****************************************************************************/
+
 TLIBAPI TINT imgcache_lookup(struct ImageCacheState *cs, struct TVImageCacheRequest *creq, 
 	TINT x, TINT y, TINT w, TINT h)
 {
@@ -43,37 +255,42 @@ TLIBAPI TINT imgcache_lookup(struct ImageCacheState *cs, struct TVImageCacheRequ
 	cs->x1 = cs->x0 + w - 1;
 	cs->y1 = cs->y0 + h - 1;
 	
-	struct THandle *cache = creq->tvc_CacheManager;
+	struct THandle *cache = cs->cache = creq->tvc_CacheManager;
  	struct CacheManagerIFace *iface = cs->cacheiface = (struct CacheManagerIFace *)
  		TCallHookPkt(&cache->thn_Hook, cache, CacheManagerMsgQueryIFace);
+	/* held until imgcache_unlock(), cs->dst points into the cache: */
+	iface->lock(cache);
 	cs->hashvalue = iface->hash(cache, creq->tvc_Key, creq->tvc_KeyLen);
 	cs->cr = iface->get(cache, creq->tvc_Key, creq->tvc_KeyLen, 
 		cs->hashvalue);
 	if (cs->cr)
 	{
-		struct TNode *next, *node = cs->cr->list.tlh_Head.tln_Succ;
-		for (; (next = node->tln_Succ); node = next)
+		TINT r[4] = { cs->x0, cs->y0, cs->x1, cs->y1 };
+		struct ImageCacheNode *cn = ic_query(cs->cr->root, r, cs->y1, 
+			cs->y0, IC_CONTAINS, TNULL);
+		if (cn)
 		{
-			struct ImageCacheNode *cn = (struct ImageCacheNode *) node;
-			if (cs->x0 >= cn->x0 && cs->x1 <= cn->x1 && cs->y0 >= cn->y0
-				&& cs->y1 <= cn->y1)
-			{
-				int cw = cn->x1 - cn->x0 + 1;
-				/*int ch = cn->y1 - cn->y0 + 1;*/
-				TINT bpp = TVPIXFMT_BYTES_PER_PIXEL(cs->dst.tpb_Format);
-				cs->dst.tpb_Data = cn->buf + 
-					bpp * (cs->x0 - cn->x0 + (cs->y0 - cn->y0) * cw);
-				cs->dst.tpb_BytesPerLine = cw * bpp;
-				TNodeUp(&cn->item.node); /* bubble up */
-				/*TDBPRINTF(TDB_INFO,("pixcache: found %dx%d fmt=%08x\n",
-					cw, ch, cs->dst.fmt));*/
-				return creq->tvc_Result = TVIMGCACHE_FOUND;
-			}
+			int cw = cn->x1 - cn->x0 + 1;
+			/*int ch = cn->y1 - cn->y0 + 1;*/
+			TINT bpp = TVPIXFMT_BYTES_PER_PIXEL(cs->dst.tpb_Format);
+			cs->dst.tpb_Data = cn->buf + 
+				bpp * (cs->x0 - cn->x0 + (cs->y0 - cn->y0) * cw);
+			cs->dst.tpb_BytesPerLine = cw * bpp;
+			iface->touch(cache, &cn->item);
+			/*TDBPRINTF(TDB_INFO,("pixcache: found %dx%d fmt=%08x\n",
+				cw, ch, cs->dst.fmt));*/
+			return creq->tvc_Result = TVIMGCACHE_FOUND;
 		}
 	}
+	iface->miss(cache);
 	return creq->tvc_Result = TVIMGCACHE_NOTFOUND;
 }
 
+TLIBAPI void imgcache_unlock(struct ImageCacheState *cs)
+{
+	cs->cacheiface->unlock(cs->cache);
+}
+
 TLIBAPI TINT imgcache_store(struct ImageCacheState *cs, struct TVImageCacheRequest *creq)
 {
 	struct THandle *cache = creq->tvc_CacheManager;
@@ -81,27 +298,39 @@ TLIBAPI TINT imgcache_store(struct ImageCacheState *cs, struct TVImageCacheReque
 	struct ImageCacheRecord *cr = cs->cr;
 	if (!cr)
 	{
-		cr = cs->cr = iface->alloc(cache, sizeof(struct ImageCacheRecord));
+		cr = cs->cr = iface->alloc(cache, 
+			sizeof(struct ImageCacheRecord) + creq->tvc_KeyLen);
 		if (!cr)
 			return creq->tvc_Result = TVIMGCACHE_STORE_FAILED;
 		TInitList(&cr->list);
+		cr->root = TNULL;
+		cr->seed = cs->hashvalue;
 		cr->handle.thn_Owner = cache;
 		cr->numitems = 0;
+		cr->busy = TFALSE;
 		cr->iface = iface;
+		cr->hashvalue = cs->hashvalue;
+		cr->keylen = creq->tvc_KeyLen;
+		memcpy(cr + 1, creq->tvc_Key, creq->tvc_KeyLen);
 		TInitHook(&cr->handle.thn_Hook, destroy_cacherecord, cr);
 		iface->put(cache, creq->tvc_Key, creq->tvc_KeyLen,
 			cs->hashvalue, &cr->handle);
 	}
 	
-	if (cr->numitems >= 64)
-		return creq->tvc_Result = TVIMGCACHE_STORE_FAILED;
-	
+	/* evicting for the new node may empty this record; keep it: */
+	cr->busy = TTRUE;
 	TUINT numpixels = cs->w * cs->h;
 	TINT bpp = TVPIXFMT_BYTES_PER_PIXEL(cs->dst.tpb_Format);
-	struct ImageCacheNode *cn = iface->alloc(cache, 
+	struct ImageCacheNode *mn, *cn = iface->alloc(cache, 
 		sizeof(struct ImageCacheNode) + numpixels * bpp);
 	if (!cn)
+	{
+		cr->busy = TFALSE;
+		if (cr->numitems == 0)
+			TDestroy(&cr->handle);
+		cs->cr = TNULL;
 		return creq->tvc_Result = TVIMGCACHE_STORE_FAILED;
+	}
 	cn->buf = (TUINT8 *) (cn + 1);
 	cn->pixels = numpixels;
 	cn->crec = cr;
@@ -112,20 +341,39 @@ TLIBAPI TINT imgcache_store(struct ImageCacheState *cs, struct TVImageCacheReque
 	cs->dst.tpb_Data = (TUINT8 *) (cn + 1);
 	cs->dst.tpb_BytesPerLine = cs->w * bpp;
 	cs->convert(&cs->src, &cs->dst, 0, 0, cs->w - 1, cs->h - 1, 0, 0, 0, 0);
-	struct TNode *next, *node = cr->list.tlh_Head.tln_Succ;
-	for (; (next = node->tln_Succ); node = next)
+	
+	/* remove tiles covered by the new one: */
+	TINT r[4] = { cs->x0, cs->y0, cs->x1, cs->y1 };
+	struct ImageCacheNode *covered = TNULL;
+	ic_query(cr->root, r, cs->y0, cs->y1, IC_INSIDE, &covered);
+	while (covered)
 	{
-		struct ImageCacheNode *cn = (struct ImageCacheNode *) node;
-		if (cs->x0 <= cn->x0 && cs->x1 >= cn->x1 && 
-			cs->y0 <= cn->y0 && cs->y1 >= cn->y1)
-			TDestroy(&cn->handle);
+		struct ImageCacheNode *next = covered->link;
+		TDestroy(&covered->handle);
+		covered = next;
 	}
+	
+	/* combine with adjacent strips: */
+	while ((mn = imgcache_merge(cache, cr, cn, bpp)))
+		cn = mn;
+	
 	cn->handle.thn_Owner = cache;
 	TInitHook(&cn->handle.thn_Hook, destroy_cachenode, cn);
 	cn->item.handle = &cn->handle; /* backptr */
+	cn->left = cn->right = TNULL;
+	cr->seed = cr->seed * 1103515245 + 12345;
+	cn->prio = cr->seed;
+	cn->maxy1 = cn->y1;
+	cr->root = ic_insert(cr->root, cn);
 	iface->additem(cache, &cn->item);
 	TAddHead(&cr->list, &cn->handle.thn_Node);
 	cr->numitems++;
+	cr->busy = TFALSE;
+	
+	TINT cw = cn->x1 - cn->x0 + 1;
+	cs->dst.tpb_Data = cn->buf + 
+		bpp * (cs->x0 - cn->x0 + (cs->y0 - cn->y0) * cw);
+	cs->dst.tpb_BytesPerLine = cw * bpp;
 	TDBPRINTF(TDB_INFO,("pixcache: stored %dx%d fmt=%08x\n",
 		cs->w, cs->h, cs->dst.tpb_Format));
 	return creq->tvc_Result = TVIMGCACHE_STORED;
@@ -11,6 +11,31 @@
 #include <tek/debug.h>
 #include <tek/lib/pixconv.h>
 
+#if !defined(PIXCONV_DISABLE_SIMD)
+#if defined(__SSE2__)
+#define PIXCONV_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+	(defined(__x86_64__) || defined(__i386__))
+#define PIXCONV_AVX2
+#include <immintrin.h>
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXCONV_NEON
+#include <arm_neon.h>
+#endif
+#if defined(PIXCONV_SSE2) || defined(PIXCONV_NEON)
+#define PIXCONV_SIMD
+#endif
+#endif
+
+/* number of pixels converted per step on the transformed path: */
+#define PIXCONV_CHUNK	256
+
+#define PIXCONV_CODE(alpha, swap, sfmt, dfmt) \
+	(((alpha) << 17) | ((swap) << 16) | (((sfmt) & 0xff) << 8) | ((dfmt) & 0xff))
+
 TUINT8 *tvpb_getaddress(struct TVPixBuf *buf, TINT x, TINT y, TLIBTRANSFORM fn, void *data)
 {
 	if (!fn)
@@ -18,440 +43,716 @@ TUINT8 *tvpb_getaddress(struct TVPixBuf *buf, TINT x, TINT y, TLIBTRANSFORM fn,
 	return fn(buf, x, y, data);
 }
 
+/*****************************************************************************/
+/*
+**	Scalar row kernels. These are the reference implementation; SIMD
+**	kernels must produce identical results.
+*/
+
+#define PIXCONV_ROW(name, stype, dtype, expr) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	dtype *d = (dtype *) dbuf; \
+	stype *s = (stype *) sbuf; \
+	TINT x; \
+	for (x = 0; x < w; ++x) \
+	{ \
+		TUINT p = s[x]; \
+		d[x] = (dtype) (expr); \
+	} \
+}
+
+static void pixconv_row_copy32(TUINT8 *dbuf, TUINT8 *sbuf, TINT w)
+{
+	memmove(dbuf, sbuf, w * 4);
+}
+
+static void pixconv_row_copy16(TUINT8 *dbuf, TUINT8 *sbuf, TINT w)
+{
+	memmove(dbuf, sbuf, w * 2);
+}
+
+PIXCONV_ROW(pixconv_row_mask32, TUINT, TUINT, p & 0x00ffffff)
+PIXCONV_ROW(pixconv_row_swap32, TUINT, TUINT, TVPIXFMT_ARGB32_SWAP(p))
+PIXCONV_ROW(pixconv_row_swap0rgb32, TUINT, TUINT, TVPIXFMT_0RGB32_SWAP(p))
+PIXCONV_ROW(pixconv_row_argb_abgr, TUINT, TUINT, TVPIXFMT_ARGB32_TO_ABGR32(p))
+PIXCONV_ROW(pixconv_row_0rgb_0bgr, TUINT, TUINT, TVPIXFMT_0RGB32_TO_0BGR32(p))
+PIXCONV_ROW(pixconv_row_argb_rgb16, TUINT, TUINT16,
+	TVPIXFMT_ARGB32_TO_RGB16(p))
+PIXCONV_ROW(pixconv_row_argb_rgb16s, TUINT, TUINT16,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_ARGB32_TO_RGB16(p)))
+PIXCONV_ROW(pixconv_row_abgr_rgb16, TUINT, TUINT16,
+	TVPIXFMT_ABGR32_TO_RGB16(p))
+PIXCONV_ROW(pixconv_row_abgr_rgb16s, TUINT, TUINT16,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_ABGR32_TO_RGB16(p)))
+PIXCONV_ROW(pixconv_row_argb_rgb15, TUINT, TUINT16,
+	TVPIXFMT_ARGB32_TO_RGB15(p))
+PIXCONV_ROW(pixconv_row_argb_rgb15s, TUINT, TUINT16,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_ARGB32_TO_RGB15(p)))
+PIXCONV_ROW(pixconv_row_abgr_rgb15, TUINT, TUINT16,
+	TVPIXFMT_ABGR32_TO_RGB15(p))
+PIXCONV_ROW(pixconv_row_abgr_rgb15s, TUINT, TUINT16,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_ABGR32_TO_RGB15(p)))
+PIXCONV_ROW(pixconv_row_argb_bgr15, TUINT, TUINT16,
+	TVPIXFMT_ARGB32_TO_BGR15(p))
+PIXCONV_ROW(pixconv_row_argb_bgr15s, TUINT, TUINT16,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_ARGB32_TO_BGR15(p)))
+PIXCONV_ROW(pixconv_row_swap16, TUINT16, TUINT16, TVPIXFMT_RGB16_SWAP(p))
+PIXCONV_ROW(pixconv_row_bgr15_rgb16, TUINT16, TUINT16,
+	TVPIXFMT_BGR15_TO_RGB16(p))
+PIXCONV_ROW(pixconv_row_rgb15_argb, TUINT16, TUINT,
+	TVPIXFMT_RGB15_TO_ARGB32(p))
+PIXCONV_ROW(pixconv_row_rgb15_argbs, TUINT16, TUINT,
+	TVPIXFMT_0RGB32_SWAP(TVPIXFMT_RGB15_TO_ARGB32(p)))
+PIXCONV_ROW(pixconv_row_bgr15_argb, TUINT16, TUINT,
+	TVPIXFMT_BGR15_TO_ARGB32(p))
+PIXCONV_ROW(pixconv_row_bgr15_argbs, TUINT16, TUINT,
+	TVPIXFMT_0RGB32_SWAP(TVPIXFMT_BGR15_TO_ARGB32(p)))
+PIXCONV_ROW(pixconv_row_rgb16_argb, TUINT16, TUINT,
+	TVPIXFMT_RGB16_TO_ARGB32(p))
+PIXCONV_ROW(pixconv_row_rgb16_argbs, TUINT16, TUINT,
+	TVPIXFMT_0RGB32_SWAP(TVPIXFMT_RGB16_TO_ARGB32(p)))
+
+/*
+**	Alpha blending kernels: blend source with alpha over the destination,
+**	reading the destination pixel in the given format
+*/
+
+#define PIXCONV_BLEND(name, dtype, SGET, DGET, DPUT) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	dtype *d = (dtype *) dbuf; \
+	TUINT *s = (TUINT *) sbuf; \
+	TINT x; \
+	for (x = 0; x < w; ++x) \
+	{ \
+		TUINT spix = s[x]; \
+		TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix); \
+		TUINT r = SGET##_GET_RED8(spix); \
+		TUINT g = SGET##_GET_GREEN8(spix); \
+		TUINT b = SGET##_GET_BLUE8(spix); \
+		TUINT dpix = d[x]; \
+		TUINT dr = DGET##_GET_RED8(dpix); \
+		TUINT dg = DGET##_GET_GREEN8(dpix); \
+		TUINT db = DGET##_GET_BLUE8(dpix); \
+		dr += ((r - dr) * a) >> 8; \
+		dg += ((g - dg) * a) >> 8; \
+		db += ((b - db) * a) >> 8; \
+		d[x] = (dtype) (DPUT); \
+	} \
+}
+
+PIXCONV_BLEND(pixconv_row_blend_argb, TUINT, TVPIXFMT_ARGB32,
+	TVPIXFMT_ARGB32, TVPIXFMT_R_G_B_TO_ARGB32(dr, dg, db))
+PIXCONV_BLEND(pixconv_row_blend_argbs, TUINT, TVPIXFMT_ARGB32,
+	TVPIXFMT_ARGB32,
+	TVPIXFMT_0RGB32_SWAP(TVPIXFMT_R_G_B_TO_ARGB32(dr, dg, db)))
+PIXCONV_BLEND(pixconv_row_blend_abgr_argb, TUINT, TVPIXFMT_ABGR32,
+	TVPIXFMT_ARGB32, TVPIXFMT_R_G_B_TO_ARGB32(dr, dg, db))
+PIXCONV_BLEND(pixconv_row_blend_rgb15, TUINT16, TVPIXFMT_ARGB32,
+	TVPIXFMT_RGB15, TVPIXFMT_R_G_B_TO_RGB15(dr, dg, db))
+PIXCONV_BLEND(pixconv_row_blend_rgb15s, TUINT16, TVPIXFMT_ARGB32,
+	TVPIXFMT_RGB15,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_R_G_B_TO_RGB15(dr, dg, db)))
+PIXCONV_BLEND(pixconv_row_blend_bgr15, TUINT16, TVPIXFMT_ARGB32,
+	TVPIXFMT_BGR15, TVPIXFMT_R_G_B_TO_BGR15(dr, dg, db))
+PIXCONV_BLEND(pixconv_row_blend_bgr15s, TUINT16, TVPIXFMT_ARGB32,
+	TVPIXFMT_BGR15,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_R_G_B_TO_BGR15(dr, dg, db)))
+PIXCONV_BLEND(pixconv_row_blend_rgb16, TUINT16, TVPIXFMT_ARGB32,
+	TVPIXFMT_RGB16, TVPIXFMT_R_G_B_TO_RGB16(dr, dg, db))
+PIXCONV_BLEND(pixconv_row_blend_rgb16s, TUINT16, TVPIXFMT_ARGB32,
+	TVPIXFMT_RGB16,
+	TVPIXFMT_RGB16_SWAP(TVPIXFMT_R_G_B_TO_RGB16(dr, dg, db)))
+
+/*****************************************************************************/
+/*
+**	Kernel slots. Each slot is initialized with its scalar kernel and
+**	may be replaced by a SIMD kernel once at first use.
+*/
+
+enum
+{
+	PIXCONV_K_COPY32,
+	PIXCONV_K_COPY16,
+	PIXCONV_K_MASK32,
+	PIXCONV_K_SWAP32,
+	PIXCONV_K_SWAP0RGB32,
+	PIXCONV_K_ARGB_ABGR,
+	PIXCONV_K_0RGB_0BGR,
+	PIXCONV_K_ARGB_RGB16,
+	PIXCONV_K_ARGB_RGB16S,
+	PIXCONV_K_ABGR_RGB16,
+	PIXCONV_K_ABGR_RGB16S,
+	PIXCONV_K_ARGB_RGB15,
+	PIXCONV_K_ARGB_RGB15S,
+	PIXCONV_K_ABGR_RGB15,
+	PIXCONV_K_ABGR_RGB15S,
+	PIXCONV_K_ARGB_BGR15,
+	PIXCONV_K_ARGB_BGR15S,
+	PIXCONV_K_SWAP16,
+	PIXCONV_K_BGR15_RGB16,
+	PIXCONV_K_RGB15_ARGB,
+	PIXCONV_K_RGB15_ARGBS,
+	PIXCONV_K_BGR15_ARGB,
+	PIXCONV_K_BGR15_ARGBS,
+	PIXCONV_K_RGB16_ARGB,
+	PIXCONV_K_RGB16_ARGBS,
+	PIXCONV_K_BLEND_ARGB,
+	PIXCONV_K_BLEND_ARGBS,
+	PIXCONV_K_BLEND_ABGR_ARGB,
+	PIXCONV_K_BLEND_RGB15,
+	PIXCONV_K_BLEND_RGB15S,
+	PIXCONV_K_BLEND_BGR15,
+	PIXCONV_K_BLEND_BGR15S,
+	PIXCONV_K_BLEND_RGB16,
+	PIXCONV_K_BLEND_RGB16S,
+	PIXCONV_NUMKERNELS
+};
+
+static TLIBROWCONV *const pixconv_kernels[PIXCONV_NUMKERNELS] =
+{
+	pixconv_row_copy32,
+	pixconv_row_copy16,
+	pixconv_row_mask32,
+	pixconv_row_swap32,
+	pixconv_row_swap0rgb32,
+	pixconv_row_argb_abgr,
+	pixconv_row_0rgb_0bgr,
+	pixconv_row_argb_rgb16,
+	pixconv_row_argb_rgb16s,
+	pixconv_row_abgr_rgb16,
+	pixconv_row_abgr_rgb16s,
+	pixconv_row_argb_rgb15,
+	pixconv_row_argb_rgb15s,
+	pixconv_row_abgr_rgb15,
+	pixconv_row_abgr_rgb15s,
+	pixconv_row_argb_bgr15,
+	pixconv_row_argb_bgr15s,
+	pixconv_row_swap16,
+	pixconv_row_bgr15_rgb16,
+	pixconv_row_rgb15_argb,
+	pixconv_row_rgb15_argbs,
+	pixconv_row_bgr15_argb,
+	pixconv_row_bgr15_argbs,
+	pixconv_row_rgb16_argb,
+	pixconv_row_rgb16_argbs,
+	pixconv_row_blend_argb,
+	pixconv_row_blend_argbs,
+	pixconv_row_blend_abgr_argb,
+	pixconv_row_blend_rgb15,
+	pixconv_row_blend_rgb15s,
+	pixconv_row_blend_bgr15,
+	pixconv_row_blend_bgr15s,
+	pixconv_row_blend_rgb16,
+	pixconv_row_blend_rgb16s,
+};
+
+static const struct { TUINT code; TUINT kernel; } pixconv_dispatch[] =
+{
+	/* 24/32 bit -> 24/32 bit */
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08R8G8B8, TVPIXFMT_08R8G8B8), PIXCONV_K_COPY32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08R8G8B8, TVPIXFMT_A8R8G8B8), PIXCONV_K_COPY32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_A8R8G8B8), PIXCONV_K_COPY32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08B8G8R8, TVPIXFMT_08B8G8R8), PIXCONV_K_COPY32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08B8G8R8, TVPIXFMT_A8B8G8R8), PIXCONV_K_COPY32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_A8B8G8R8), PIXCONV_K_COPY32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_08R8G8B8), PIXCONV_K_MASK32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_08B8G8R8), PIXCONV_K_MASK32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_A8R8G8B8), PIXCONV_K_SWAP32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8B8G8R8, TVPIXFMT_A8B8G8R8), PIXCONV_K_SWAP32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08R8G8B8, TVPIXFMT_08R8G8B8), PIXCONV_K_SWAP0RGB32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08R8G8B8, TVPIXFMT_A8R8G8B8), PIXCONV_K_SWAP0RGB32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_08R8G8B8), PIXCONV_K_SWAP0RGB32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08B8G8R8, TVPIXFMT_08B8G8R8), PIXCONV_K_SWAP0RGB32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08B8G8R8, TVPIXFMT_A8B8G8R8), PIXCONV_K_SWAP0RGB32 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8B8G8R8, TVPIXFMT_08B8G8R8), PIXCONV_K_SWAP0RGB32 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_A8B8G8R8), PIXCONV_K_ARGB_ABGR },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_A8R8G8B8), PIXCONV_K_ARGB_ABGR },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_08B8G8R8), PIXCONV_K_0RGB_0BGR },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08R8G8B8, TVPIXFMT_08B8G8R8), PIXCONV_K_0RGB_0BGR },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_08R8G8B8), PIXCONV_K_0RGB_0BGR },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08B8G8R8, TVPIXFMT_08R8G8B8), PIXCONV_K_0RGB_0BGR },
+	/* 32 bit -> 16 bit */
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08R8G8B8, TVPIXFMT_R5G6B5), PIXCONV_K_ARGB_RGB16 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_R5G6B5), PIXCONV_K_ARGB_RGB16 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08R8G8B8, TVPIXFMT_R5G6B5), PIXCONV_K_ARGB_RGB16S },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_R5G6B5), PIXCONV_K_ARGB_RGB16S },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08B8G8R8, TVPIXFMT_R5G6B5), PIXCONV_K_ABGR_RGB16 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_R5G6B5), PIXCONV_K_ABGR_RGB16 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08B8G8R8, TVPIXFMT_R5G6B5), PIXCONV_K_ABGR_RGB16S },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8B8G8R8, TVPIXFMT_R5G6B5), PIXCONV_K_ABGR_RGB16S },
+	/* 32 bit -> 15 bit */
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08R8G8B8, TVPIXFMT_0R5G5B5), PIXCONV_K_ARGB_RGB15 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_0R5G5B5), PIXCONV_K_ARGB_RGB15 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08R8G8B8, TVPIXFMT_0R5G5B5), PIXCONV_K_ARGB_RGB15S },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_0R5G5B5), PIXCONV_K_ARGB_RGB15S },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08B8G8R8, TVPIXFMT_0R5G5B5), PIXCONV_K_ABGR_RGB15 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_0R5G5B5), PIXCONV_K_ABGR_RGB15 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08B8G8R8, TVPIXFMT_0R5G5B5), PIXCONV_K_ABGR_RGB15S },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8B8G8R8, TVPIXFMT_0R5G5B5), PIXCONV_K_ABGR_RGB15S },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_08R8G8B8, TVPIXFMT_0B5G5R5), PIXCONV_K_ARGB_BGR15 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_0B5G5R5), PIXCONV_K_ARGB_BGR15 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_08R8G8B8, TVPIXFMT_0B5G5R5), PIXCONV_K_ARGB_BGR15S },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_0B5G5R5), PIXCONV_K_ARGB_BGR15S },
+	/* 15/16 bit -> 15/16 bit */
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_R5G6B5, TVPIXFMT_R5G6B5), PIXCONV_K_COPY16 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_0R5G5B5, TVPIXFMT_0R5G5B5), PIXCONV_K_COPY16 },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_0B5G5R5, TVPIXFMT_0B5G5R5), PIXCONV_K_COPY16 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_R5G6B5, TVPIXFMT_R5G6B5), PIXCONV_K_SWAP16 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_0R5G5B5, TVPIXFMT_0R5G5B5), PIXCONV_K_SWAP16 },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_0B5G5R5, TVPIXFMT_0B5G5R5), PIXCONV_K_SWAP16 },
+	/* 15 bit -> 16 bit */
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_0B5G5R5, TVPIXFMT_R5G6B5), PIXCONV_K_BGR15_RGB16 },
+	/* 15 bit -> 32 bit */
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_0R5G5B5, TVPIXFMT_08R8G8B8), PIXCONV_K_RGB15_ARGB },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_0R5G5B5, TVPIXFMT_A8R8G8B8), PIXCONV_K_RGB15_ARGB },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_0R5G5B5, TVPIXFMT_08R8G8B8), PIXCONV_K_RGB15_ARGBS },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_0R5G5B5, TVPIXFMT_A8R8G8B8), PIXCONV_K_RGB15_ARGBS },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_0B5G5R5, TVPIXFMT_08R8G8B8), PIXCONV_K_BGR15_ARGB },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_0B5G5R5, TVPIXFMT_A8R8G8B8), PIXCONV_K_BGR15_ARGB },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_0B5G5R5, TVPIXFMT_08R8G8B8), PIXCONV_K_BGR15_ARGBS },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_0B5G5R5, TVPIXFMT_A8R8G8B8), PIXCONV_K_BGR15_ARGBS },
+	/* 16 bit -> 32 bit */
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_R5G6B5, TVPIXFMT_08R8G8B8), PIXCONV_K_RGB16_ARGB },
+	{ PIXCONV_CODE(0, 0, TVPIXFMT_R5G6B5, TVPIXFMT_A8R8G8B8), PIXCONV_K_RGB16_ARGB },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_R5G6B5, TVPIXFMT_08R8G8B8), PIXCONV_K_RGB16_ARGBS },
+	{ PIXCONV_CODE(0, 1, TVPIXFMT_R5G6B5, TVPIXFMT_A8R8G8B8), PIXCONV_K_RGB16_ARGBS },
+	/* 32+alpha -> 32bit */
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_A8R8G8B8), PIXCONV_K_BLEND_ARGB },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_08R8G8B8), PIXCONV_K_BLEND_ARGB },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_A8B8G8R8), PIXCONV_K_BLEND_ARGB },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_08B8G8R8), PIXCONV_K_BLEND_ARGB },
+	{ PIXCONV_CODE(1, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_A8R8G8B8), PIXCONV_K_BLEND_ARGBS },
+	{ PIXCONV_CODE(1, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_08R8G8B8), PIXCONV_K_BLEND_ARGBS },
+	{ PIXCONV_CODE(1, 1, TVPIXFMT_A8B8G8R8, TVPIXFMT_A8B8G8R8), PIXCONV_K_BLEND_ARGBS },
+	{ PIXCONV_CODE(1, 1, TVPIXFMT_A8B8G8R8, TVPIXFMT_08B8G8R8), PIXCONV_K_BLEND_ARGBS },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_A8B8G8R8), PIXCONV_K_BLEND_ABGR_ARGB },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_08B8G8R8), PIXCONV_K_BLEND_ABGR_ARGB },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_A8R8G8B8), PIXCONV_K_BLEND_ABGR_ARGB },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8B8G8R8, TVPIXFMT_08R8G8B8), PIXCONV_K_BLEND_ABGR_ARGB },
+	/* 32+alpha -> 15 bit */
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_0R5G5B5), PIXCONV_K_BLEND_RGB15 },
+	{ PIXCONV_CODE(1, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_0R5G5B5), PIXCONV_K_BLEND_RGB15S },
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_0B5G5R5), PIXCONV_K_BLEND_BGR15 },
+	{ PIXCONV_CODE(1, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_0B5G5R5), PIXCONV_K_BLEND_BGR15S },
+	/* 32+alpha -> 16 bit */
+	{ PIXCONV_CODE(1, 0, TVPIXFMT_A8R8G8B8, TVPIXFMT_R5G6B5), PIXCONV_K_BLEND_RGB16 },
+	{ PIXCONV_CODE(1, 1, TVPIXFMT_A8R8G8B8, TVPIXFMT_R5G6B5), PIXCONV_K_BLEND_RGB16S },
+};
+
+/*****************************************************************************/
+/*
+**	SSE2 kernels
+*/
+
+#if defined(PIXCONV_SSE2)
+
+#define PIXCONV_SSE2_ROW32(name, scalar, OP) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	TINT x = 0; \
+	for (; x + 4 <= w; x += 4) \
+	{ \
+		__m128i p = _mm_loadu_si128((__m128i *) (sbuf + x * 4)); \
+		OP; \
+		_mm_storeu_si128((__m128i *) (dbuf + x * 4), p); \
+	} \
+	scalar(dbuf + x * 4, sbuf + x * 4, w - x); \
+}
+
+/* byte-reverse each 32-bit lane */
+#define PIXCONV_SSE2_BSWAP32(p) do { \
+	p = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xb1), 0xb1); \
+	p = _mm_or_si128(_mm_slli_epi16(p, 8), _mm_srli_epi16(p, 8)); \
+} while (0)
+
+/* exchange bits 0-7 and 16-23 of each 32-bit lane, keeping mask k */
+#define PIXCONV_SSE2_RB(p, k) \
+	p = _mm_or_si128(_mm_and_si128(p, _mm_set1_epi32(k)), \
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), \
+		_mm_set1_epi32(0xff)), _mm_slli_epi32(_mm_and_si128(p, \
+		_mm_set1_epi32(0xff)), 16)))
+
+PIXCONV_SSE2_ROW32(pixconv_sse2_mask32, pixconv_row_mask32,
+	p = _mm_and_si128(p, _mm_set1_epi32(0x00ffffff)))
+PIXCONV_SSE2_ROW32(pixconv_sse2_swap32, pixconv_row_swap32,
+	PIXCONV_SSE2_BSWAP32(p))
+PIXCONV_SSE2_ROW32(pixconv_sse2_swap0rgb32, pixconv_row_swap0rgb32,
+	PIXCONV_SSE2_BSWAP32(p);
+	p = _mm_and_si128(p, _mm_set1_epi32((int) 0xffffff00)))
+PIXCONV_SSE2_ROW32(pixconv_sse2_argb_abgr, pixconv_row_argb_abgr,
+	PIXCONV_SSE2_RB(p, (int) 0xff00ff00))
+PIXCONV_SSE2_ROW32(pixconv_sse2_0rgb_0bgr, pixconv_row_0rgb_0bgr,
+	PIXCONV_SSE2_RB(p, 0x0000ff00))
+
+/* pack eight 32-bit lanes holding 16-bit values into 16-bit lanes */
+static TINLINE __m128i pixconv_sse2_pack16(__m128i a, __m128i b)
+{
+	a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+	b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+	return _mm_packs_epi32(a, b);
+}
+
+#define PIXCONV_SSE2_ROW32_16(name, scalar, OP, SWAP) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	TINT x = 0; \
+	for (; x + 8 <= w; x += 8) \
+	{ \
+		__m128i p = _mm_loadu_si128((__m128i *) (sbuf + x * 4)); \
+		__m128i q; \
+		OP; \
+		q = p; \
+		p = _mm_loadu_si128((__m128i *) (sbuf + x * 4 + 16)); \
+		OP; \
+		p = pixconv_sse2_pack16(q, p); \
+		if (SWAP) \
+			p = _mm_or_si128(_mm_slli_epi16(p, 8), _mm_srli_epi16(p, 8)); \
+		_mm_storeu_si128((__m128i *) (dbuf + x * 2), p); \
+	} \
+	scalar(dbuf + x * 2, sbuf + x * 4, w - x); \
+}
+
+#define PIXCONV_SSE2_ARGB_RGB16(p) \
+	p = _mm_or_si128(_mm_or_si128( \
+		_mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xf800)), \
+		_mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07e0))), \
+		_mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001f)))
+
+#define PIXCONV_SSE2_ABGR_RGB16(p) \
+	p = _mm_or_si128(_mm_or_si128( \
+		_mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xf8)), 8), \
+		_mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07e0))), \
+		_mm_and_si128(_mm_srli_epi32(p, 19), _mm_set1_epi32(0x001f)))
+
+PIXCONV_SSE2_ROW32_16(pixconv_sse2_argb_rgb16, pixconv_row_argb_rgb16,
+	PIXCONV_SSE2_ARGB_RGB16(p), 0)
+PIXCONV_SSE2_ROW32_16(pixconv_sse2_argb_rgb16s, pixconv_row_argb_rgb16s,
+	PIXCONV_SSE2_ARGB_RGB16(p), 1)
+PIXCONV_SSE2_ROW32_16(pixconv_sse2_abgr_rgb16, pixconv_row_abgr_rgb16,
+	PIXCONV_SSE2_ABGR_RGB16(p), 0)
+PIXCONV_SSE2_ROW32_16(pixconv_sse2_abgr_rgb16s, pixconv_row_abgr_rgb16s,
+	PIXCONV_SSE2_ABGR_RGB16(p), 1)
+
+static void pixconv_sse2_swap16(TUINT8 *dbuf, TUINT8 *sbuf, TINT w)
+{
+	TINT x = 0;
+	for (; x + 8 <= w; x += 8)
+	{
+		__m128i p = _mm_loadu_si128((__m128i *) (sbuf + x * 2));
+		p = _mm_or_si128(_mm_slli_epi16(p, 8), _mm_srli_epi16(p, 8));
+		_mm_storeu_si128((__m128i *) (dbuf + x * 2), p);
+	}
+	pixconv_row_swap16(dbuf + x * 2, sbuf + x * 2, w - x);
+}
+
+#endif /* defined(PIXCONV_SSE2) */
+
+/*****************************************************************************/
+/*
+**	AVX2 kernels, selected at runtime
+*/
+
+#if defined(PIXCONV_AVX2)
+
+#define PIXCONV_AVX2_FUNC __attribute__((target("avx2")))
+
+#define PIXCONV_AVX2_ROW32(name, scalar, OP) \
+static PIXCONV_AVX2_FUNC void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	TINT x = 0; \
+	for (; x + 8 <= w; x += 8) \
+	{ \
+		__m256i p = _mm256_loadu_si256((__m256i *) (sbuf + x * 4)); \
+		OP; \
+		_mm256_storeu_si256((__m256i *) (dbuf + x * 4), p); \
+	} \
+	scalar(dbuf + x * 4, sbuf + x * 4, w - x); \
+}
+
+#define PIXCONV_AVX2_RB(p, k) \
+	p = _mm256_or_si256(_mm256_and_si256(p, _mm256_set1_epi32(k)), \
+		_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 16), \
+		_mm256_set1_epi32(0xff)), _mm256_slli_epi32(_mm256_and_si256(p, \
+		_mm256_set1_epi32(0xff)), 16)))
+
+#define PIXCONV_AVX2_BSWAP32(p) \
+	p = _mm256_shuffle_epi8(p, _mm256_setr_epi8( \
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, \
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12))
+
+PIXCONV_AVX2_ROW32(pixconv_avx2_mask32, pixconv_row_mask32,
+	p = _mm256_and_si256(p, _mm256_set1_epi32(0x00ffffff)))
+PIXCONV_AVX2_ROW32(pixconv_avx2_swap32, pixconv_row_swap32,
+	PIXCONV_AVX2_BSWAP32(p))
+PIXCONV_AVX2_ROW32(pixconv_avx2_swap0rgb32, pixconv_row_swap0rgb32,
+	PIXCONV_AVX2_BSWAP32(p);
+	p = _mm256_and_si256(p, _mm256_set1_epi32((int) 0xffffff00)))
+PIXCONV_AVX2_ROW32(pixconv_avx2_argb_abgr, pixconv_row_argb_abgr,
+	PIXCONV_AVX2_RB(p, (int) 0xff00ff00))
+PIXCONV_AVX2_ROW32(pixconv_avx2_0rgb_0bgr, pixconv_row_0rgb_0bgr,
+	PIXCONV_AVX2_RB(p, 0x0000ff00))
+
+#define PIXCONV_AVX2_ROW32_16(name, scalar, OP, SWAP) \
+static PIXCONV_AVX2_FUNC void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	TINT x = 0; \
+	for (; x + 16 <= w; x += 16) \
+	{ \
+		__m256i p = _mm256_loadu_si256((__m256i *) (sbuf + x * 4)); \
+		__m256i q; \
+		OP; \
+		q = p; \
+		p = _mm256_loadu_si256((__m256i *) (sbuf + x * 4 + 32)); \
+		OP; \
+		p = _mm256_permute4x64_epi64(_mm256_packus_epi32(q, p), 0xd8); \
+		if (SWAP) \
+			p = _mm256_or_si256(_mm256_slli_epi16(p, 8), \
+				_mm256_srli_epi16(p, 8)); \
+		_mm256_storeu_si256((__m256i *) (dbuf + x * 2), p); \
+	} \
+	scalar(dbuf + x * 2, sbuf + x * 4, w - x); \
+}
+
+#define PIXCONV_AVX2_ARGB_RGB16(p) \
+	p = _mm256_or_si256(_mm256_or_si256( \
+		_mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xf800)), \
+		_mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07e0))), \
+		_mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x001f)))
+
+#define PIXCONV_AVX2_ABGR_RGB16(p) \
+	p = _mm256_or_si256(_mm256_or_si256( \
+		_mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xf8)), 8), \
+		_mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07e0))), \
+		_mm256_and_si256(_mm256_srli_epi32(p, 19), _mm256_set1_epi32(0x001f)))
+
+PIXCONV_AVX2_ROW32_16(pixconv_avx2_argb_rgb16, pixconv_row_argb_rgb16,
+	PIXCONV_AVX2_ARGB_RGB16(p), 0)
+PIXCONV_AVX2_ROW32_16(pixconv_avx2_argb_rgb16s, pixconv_row_argb_rgb16s,
+	PIXCONV_AVX2_ARGB_RGB16(p), 1)
+PIXCONV_AVX2_ROW32_16(pixconv_avx2_abgr_rgb16, pixconv_row_abgr_rgb16,
+	PIXCONV_AVX2_ABGR_RGB16(p), 0)
+PIXCONV_AVX2_ROW32_16(pixconv_avx2_abgr_rgb16s, pixconv_row_abgr_rgb16s,
+	PIXCONV_AVX2_ABGR_RGB16(p), 1)
+
+#endif /* defined(PIXCONV_AVX2) */
+
+/*****************************************************************************/
+/*
+**	NEON kernels
+*/
+
+#if defined(PIXCONV_NEON)
+
+#define PIXCONV_NEON_ROW32(name, scalar, OP) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	TINT x = 0; \
+	for (; x + 4 <= w; x += 4) \
+	{ \
+		uint32x4_t p = vld1q_u32((uint32_t *) (sbuf + x * 4)); \
+		OP; \
+		vst1q_u32((uint32_t *) (dbuf + x * 4), p); \
+	} \
+	scalar(dbuf + x * 4, sbuf + x * 4, w - x); \
+}
+
+#define PIXCONV_NEON_RB(p, k) \
+	p = vorrq_u32(vandq_u32(p, vdupq_n_u32(k)), \
+		vorrq_u32(vandq_u32(vshrq_n_u32(p, 16), vdupq_n_u32(0xff)), \
+		vshlq_n_u32(vandq_u32(p, vdupq_n_u32(0xff)), 16)))
+
+PIXCONV_NEON_ROW32(pixconv_neon_mask32, pixconv_row_mask32,
+	p = vandq_u32(p, vdupq_n_u32(0x00ffffff)))
+PIXCONV_NEON_ROW32(pixconv_neon_swap32, pixconv_row_swap32,
+	p = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(p))))
+PIXCONV_NEON_ROW32(pixconv_neon_swap0rgb32, pixconv_row_swap0rgb32,
+	p = vandq_u32(vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(p))),
+		vdupq_n_u32(0xffffff00)))
+PIXCONV_NEON_ROW32(pixconv_neon_argb_abgr, pixconv_row_argb_abgr,
+	PIXCONV_NEON_RB(p, 0xff00ff00))
+PIXCONV_NEON_ROW32(pixconv_neon_0rgb_0bgr, pixconv_row_0rgb_0bgr,
+	PIXCONV_NEON_RB(p, 0x0000ff00))
+
+#define PIXCONV_NEON_ROW32_16(name, scalar, OP) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w) \
+{ \
+	TINT x = 0; \
+	for (; x + 4 <= w; x += 4) \
+	{ \
+		uint32x4_t p = vld1q_u32((uint32_t *) (sbuf + x * 4)); \
+		OP; \
+		vst1_u16((uint16_t *) (dbuf + x * 2), vmovn_u32(p)); \
+	} \
+	scalar(dbuf + x * 2, sbuf + x * 4, w - x); \
+}
+
+PIXCONV_NEON_ROW32_16(pixconv_neon_argb_rgb16, pixconv_row_argb_rgb16,
+	p = vorrq_u32(vorrq_u32(
+		vandq_u32(vshrq_n_u32(p, 8), vdupq_n_u32(0xf800)),
+		vandq_u32(vshrq_n_u32(p, 5), vdupq_n_u32(0x07e0))),
+		vandq_u32(vshrq_n_u32(p, 3), vdupq_n_u32(0x001f))))
+PIXCONV_NEON_ROW32_16(pixconv_neon_abgr_rgb16, pixconv_row_abgr_rgb16,
+	p = vorrq_u32(vorrq_u32(
+		vshlq_n_u32(vandq_u32(p, vdupq_n_u32(0xf8)), 8),
+		vandq_u32(vshrq_n_u32(p, 5), vdupq_n_u32(0x07e0))),
+		vandq_u32(vshrq_n_u32(p, 19), vdupq_n_u32(0x001f))))
+
+#endif /* defined(PIXCONV_NEON) */
+
+/*****************************************************************************/
+
+#if defined(PIXCONV_SIMD)
+
+/* kernel table with SIMD kernels, filled in once: */
+static TLIBROWCONV *pixconv_simdkernels[PIXCONV_NUMKERNELS];
+/* published table, NULL until pixconv_simdkernels is complete: */
+static TLIBROWCONV **pixconv_active;
+static TINT pixconv_initclaim;
+
+#endif
+
+/*
+**	Get the kernel table. The first caller fills in the SIMD table and
+**	publishes it with release semantics. Callers arriving while the table
+**	is being filled in use the scalar kernels, which give the same results.
+*/
+
+static TLIBROWCONV *const *pixconv_getkernels(void)
+{
+#if defined(PIXCONV_SIMD)
+	TLIBROWCONV **k = __atomic_load_n(&pixconv_active, __ATOMIC_ACQUIRE);
+	if (k)
+		return k;
+	if (__atomic_exchange_n(&pixconv_initclaim, 1, __ATOMIC_ACQ_REL))
+		return pixconv_kernels;
+	k = pixconv_simdkernels;
+	memcpy(k, pixconv_kernels, sizeof pixconv_kernels);
+#if defined(PIXCONV_SSE2)
+	k[PIXCONV_K_MASK32] = pixconv_sse2_mask32;
+	k[PIXCONV_K_SWAP32] = pixconv_sse2_swap32;
+	k[PIXCONV_K_SWAP0RGB32] = pixconv_sse2_swap0rgb32;
+	k[PIXCONV_K_ARGB_ABGR] = pixconv_sse2_argb_abgr;
+	k[PIXCONV_K_0RGB_0BGR] = pixconv_sse2_0rgb_0bgr;
+	k[PIXCONV_K_ARGB_RGB16] = pixconv_sse2_argb_rgb16;
+	k[PIXCONV_K_ARGB_RGB16S] = pixconv_sse2_argb_rgb16s;
+	k[PIXCONV_K_ABGR_RGB16] = pixconv_sse2_abgr_rgb16;
+	k[PIXCONV_K_ABGR_RGB16S] = pixconv_sse2_abgr_rgb16s;
+	k[PIXCONV_K_SWAP16] = pixconv_sse2_swap16;
+#endif
+#if defined(PIXCONV_AVX2)
+	if (__builtin_cpu_supports("avx2"))
+	{
+		k[PIXCONV_K_MASK32] = pixconv_avx2_mask32;
+		k[PIXCONV_K_SWAP32] = pixconv_avx2_swap32;
+		k[PIXCONV_K_SWAP0RGB32] = pixconv_avx2_swap0rgb32;
+		k[PIXCONV_K_ARGB_ABGR] = pixconv_avx2_argb_abgr;
+		k[PIXCONV_K_0RGB_0BGR] = pixconv_avx2_0rgb_0bgr;
+		k[PIXCONV_K_ARGB_RGB16] = pixconv_avx2_argb_rgb16;
+		k[PIXCONV_K_ARGB_RGB16S] = pixconv_avx2_argb_rgb16s;
+		k[PIXCONV_K_ABGR_RGB16] = pixconv_avx2_abgr_rgb16;
+		k[PIXCONV_K_ABGR_RGB16S] = pixconv_avx2_abgr_rgb16s;
+	}
+#endif
+#if defined(PIXCONV_NEON)
+	k[PIXCONV_K_MASK32] = pixconv_neon_mask32;
+	k[PIXCONV_K_SWAP32] = pixconv_neon_swap32;
+	k[PIXCONV_K_SWAP0RGB32] = pixconv_neon_swap0rgb32;
+	k[PIXCONV_K_ARGB_ABGR] = pixconv_neon_argb_abgr;
+	k[PIXCONV_K_0RGB_0BGR] = pixconv_neon_0rgb_0bgr;
+	k[PIXCONV_K_ARGB_RGB16] = pixconv_neon_argb_rgb16;
+	k[PIXCONV_K_ABGR_RGB16] = pixconv_neon_abgr_rgb16;
+#endif
+	__atomic_store_n(&pixconv_active, k, __ATOMIC_RELEASE);
+	return k;
+#else
+	return pixconv_kernels;
+#endif
+}
+
+TLIBAPI TLIBROWCONV *pixconv_getrowconv(TUINT sfmt, TUINT dfmt, TBOOL alpha,
+	TBOOL swap)
+{
+	TUINT c = PIXCONV_CODE(alpha, swap, sfmt, dfmt);
+	TLIBROWCONV *const *k = pixconv_getkernels();
+	TUINT i;
+	for (i = 0; i < sizeof(pixconv_dispatch) / sizeof(pixconv_dispatch[0]);
+		++i)
+	{
+		if (pixconv_dispatch[i].code == c)
+			return k[pixconv_dispatch[i].kernel];
+	}
+	TDBPRINTF(TDB_WARN,("unsupported conversion %08x: alpha=%d swap=%d src=%08x dst=%08x\n",
+		c, alpha, swap, sfmt, dfmt));
+	return TNULL;
+}
+
+/*****************************************************************************/
+
 TLIBAPI TINT pixconv_transform_convert(struct TVPixBuf *src, struct TVPixBuf *dst,
 	TINT x0, TINT y0, TINT x1, TINT y1, TINT sx, TINT sy, TBOOL alpha,
 	TBOOL swap, TLIBTRANSFORM fn, void *data)
 {
 	TINT w = x1 - x0 + 1;
 	TINT h = y1 - y0 + 1;
-	TINT x, y;
-	TUINT c = (alpha << 17) | (swap << 16) | ((src->tpb_Format & 0xff) << 8) | (dst->tpb_Format & 0xff);
-	TUINT8 *sp = TVPB_GETADDRESS(src, sx, sy);
-	TUINT8 *dp = tvpb_getaddress(dst, x0, y0, fn, data);
-	
-	TDBPRINTF(TDB_DEBUG,("conversion %08x: alpha=%d swap=%d src=%08x dst=%08x\n",
-		c, alpha, swap, src->tpb_Format, dst->tpb_Format));
-	
-	for (y = 0; y < h; ++y, dp += dst->tpb_BytesPerLine, sp += src->tpb_BytesPerLine)
+	TINT y;
+	TLIBROWCONV *conv;
+	TUINT8 *sp;
+
+	TDBPRINTF(TDB_DEBUG,("conversion: alpha=%d swap=%d src=%08x dst=%08x\n",
+		alpha, swap, src->tpb_Format, dst->tpb_Format));
+
+	conv = pixconv_getrowconv(src->tpb_Format, dst->tpb_Format, alpha, swap);
+	if (conv == TNULL)
+		return 1;
+	if (w <= 0 || h <= 0)
+		return 0;
+
+	sp = TVPB_GETADDRESS(src, sx, sy);
+
+	if (fn == TNULL)
 	{
-		for (x = 0; x < w; ++x) {
-		dp = tvpb_getaddress(dst, x0 + x, y0 + y, fn, data);
-		switch(c)
+		TUINT8 *dp = TVPB_GETADDRESS(dst, x0, y0);
+		for (y = 0; y < h; ++y, dp += dst->tpb_BytesPerLine,
+			sp += src->tpb_BytesPerLine)
+			(*conv)(dp, sp, w);
+	}
+	else
+	{
+		/* convert chunks through a buffer, scatter to transformed addresses */
+		TUINT buf[PIXCONV_CHUNK];
+		TUINT8 *tp = (TUINT8 *) buf;
+		TINT sbpp = TVPIXFMT_BYTES_PER_PIXEL(src->tpb_Format);
+		TINT dbpp = TVPIXFMT_BYTES_PER_PIXEL(dst->tpb_Format);
+		for (y = 0; y < h; ++y, sp += src->tpb_BytesPerLine)
 		{
-			/* 24/32 bit -> 24/32 bit */
-			
-			case ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-			case ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-			case ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-			case ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-			case ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-					*((TUINT *)dp) = ((TUINT *)sp)[x];
-				break;
-				
-			case ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-					*((TUINT *)dp) = ((TUINT *)sp)[x] & 0x00ffffff;
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT *)dp) = TVPIXFMT_ARGB32_SWAP(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT *)dp) = TVPIXFMT_0RGB32_SWAP(p);
-				}
-				break;
-				
-			case ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-			case ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT *)dp) = TVPIXFMT_ARGB32_TO_ABGR32(p);
-				}
-				break;
-				
-			case ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-			case ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-			case ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT *)dp) = TVPIXFMT_0RGB32_TO_0BGR32(p);
-				}
-				break;
-
-			/* 32 bit -> 16 bit */
-			
-			case ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-			case ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT16 *)dp) = TVPIXFMT_ARGB32_TO_RGB16(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					TUINT p2 = TVPIXFMT_ARGB32_TO_RGB16(p);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p2);
-				}
-				break;
-				
-			case ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-			case ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT16 *)dp) = TVPIXFMT_ABGR32_TO_RGB16(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					TUINT p2 = TVPIXFMT_ABGR32_TO_RGB16(p);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p2);
-				}
-				break;
-			
-			/* 32 bit -> 15 bit */
-			
-			case ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-			case ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT16 *)dp) = TVPIXFMT_ARGB32_TO_RGB15(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					TUINT16 p2 = TVPIXFMT_ARGB32_TO_RGB15(p);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p2);
-				}
-				break;
-				
-			case ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-			case ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT16 *)dp) = TVPIXFMT_ABGR32_TO_RGB15(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_08B8G8R8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					TUINT p2 = TVPIXFMT_ABGR32_TO_RGB15(p);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p2);
-				}
-				break;
-				
-			case ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-			case ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					*((TUINT16 *)dp) = TVPIXFMT_ARGB32_TO_BGR15(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_08R8G8B8 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-			case 0x10000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-				{
-					TUINT p = ((TUINT *)sp)[x];
-					TUINT16 p2 = TVPIXFMT_ARGB32_TO_BGR15(p);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p2);
-				}
-				break;
-			
-			/* 15/16 bit -> 15/16 bit */
-			
-			case ((TVPIXFMT_R5G6B5 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-			case ((TVPIXFMT_0R5G5B5 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-			case ((TVPIXFMT_0B5G5R5 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-				{
-					*((TUINT16 *)dp) = ((TUINT16 *)sp)[x];;
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_R5G6B5 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-			case 0x10000 | ((TVPIXFMT_0R5G5B5 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-			case 0x10000 | ((TVPIXFMT_0B5G5R5 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p);
-				}
-				break;
-			
-			/* 15 bit -> 16 bit */
-			
-			case ((TVPIXFMT_0B5G5R5 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					*((TUINT16 *)dp) = TVPIXFMT_BGR15_TO_RGB16(p);
-				}
-				break;
-			
-			/* 15 bit -> 32 bit */
-			
-			case ((TVPIXFMT_0R5G5B5 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case ((TVPIXFMT_0R5G5B5 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					*((TUINT *)dp) = TVPIXFMT_RGB15_TO_ARGB32(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_0R5G5B5 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_0R5G5B5 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					TUINT32 p2 = TVPIXFMT_RGB15_TO_ARGB32(p);
-					*((TUINT *)dp) = TVPIXFMT_0RGB32_SWAP(p2);
-				}
-				break;
-				
-			case ((TVPIXFMT_0B5G5R5 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case ((TVPIXFMT_0B5G5R5 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					*((TUINT *)dp) = TVPIXFMT_BGR15_TO_ARGB32(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_0B5G5R5 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_0B5G5R5 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					TUINT32 p2 = TVPIXFMT_BGR15_TO_ARGB32(p);
-					*((TUINT *)dp) = TVPIXFMT_0RGB32_SWAP(p2);
-				}
-				break;
-			
-			/* 16 bit -> 32 bit */
-			
-			case ((TVPIXFMT_R5G6B5 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case ((TVPIXFMT_R5G6B5 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					*((TUINT *)dp) = TVPIXFMT_RGB16_TO_ARGB32(p);
-				}
-				break;
-				
-			case 0x10000 | ((TVPIXFMT_R5G6B5 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case 0x10000 | ((TVPIXFMT_R5G6B5 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-				{
-					TUINT16 p = ((TUINT16 *)sp)[x];
-					TUINT32 p2 = TVPIXFMT_RGB16_TO_ARGB32(p);
-					*((TUINT *)dp) = TVPIXFMT_0RGB32_SWAP(p2);
-				}
-				break;
-			
-			/* 32+alpha -> 32bit */
-			
-			case 0x20000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-			case 0x20000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case 0x20000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-			case 0x20000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT *)dp)[x];
-					TUINT dr = TVPIXFMT_ARGB32_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_ARGB32_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_ARGB32_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					*((TUINT *)dp) = TVPIXFMT_R_G_B_TO_ARGB32(dr, dg, db);
-				}
-				break;
-				
-			case 0x30000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-			case 0x30000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-			case 0x30000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-			case 0x30000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT *)dp)[x];
-					TUINT dr = TVPIXFMT_ARGB32_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_ARGB32_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_ARGB32_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					TUINT p = TVPIXFMT_R_G_B_TO_ARGB32(dr, dg, db);
-					*((TUINT *)dp) = TVPIXFMT_0RGB32_SWAP(p);
-				}
-				break;
-			
-			case 0x20000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_A8B8G8R8 & 0xff):
-			case 0x20000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_08B8G8R8 & 0xff):
-			case 0x20000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_A8R8G8B8 & 0xff):
-			case 0x20000 | ((TVPIXFMT_A8B8G8R8 & 0xff) << 8) | (TVPIXFMT_08R8G8B8 & 0xff):
-				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ABGR32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ABGR32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ABGR32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ABGR32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT *)dp)[x];
-					TUINT dr = TVPIXFMT_ARGB32_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_ARGB32_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_ARGB32_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					*((TUINT *)dp) = TVPIXFMT_R_G_B_TO_ARGB32(dr, dg, db);
-				}
-				break;
-			
-			/* 32+alpha -> 15 bit */
-			
-			case 0x20000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT16 *)dp)[x];
-					TUINT dr = TVPIXFMT_RGB15_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_RGB15_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_RGB15_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					*((TUINT16 *)dp) = TVPIXFMT_R_G_B_TO_RGB15(dr, dg, db);
-				}
-				break;
-				
-			case 0x30000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0R5G5B5 & 0xff):
-				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT16 *)dp)[x];
-					TUINT dr = TVPIXFMT_RGB15_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_RGB15_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_RGB15_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					TUINT16 p = TVPIXFMT_R_G_B_TO_RGB15(dr, dg, db);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p);
-				}
-				break;
-				
-			case 0x20000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT16 *)dp)[x];
-					TUINT dr = TVPIXFMT_BGR15_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_BGR15_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_BGR15_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					*((TUINT16 *)dp) = TVPIXFMT_R_G_B_TO_BGR15(dr, dg, db);
-				}
-				break;
-				
-			case 0x30000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_0B5G5R5 & 0xff):
-				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT16 *)dp)[x];
-					TUINT dr = TVPIXFMT_BGR15_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_BGR15_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_BGR15_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					TUINT16 p = TVPIXFMT_R_G_B_TO_BGR15(dr, dg, db);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p);
-				}
-				break;
-			
-			/* 32+alpha -> 16 bit */
-			
-			case 0x20000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
-				// This tested with udlfb
+			TINT x, i, n;
+			for (x = 0; x < w; x += n)
+			{
+				n = TMIN(w - x, PIXCONV_CHUNK);
+				if (alpha)
 				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT16 *)dp)[x];
-					TUINT dr = TVPIXFMT_RGB16_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_RGB16_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_RGB16_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					dp = tvpb_getaddress(dst, x0 + x, y0 + y, fn, data);
-					*((TUINT16 *)dp) = TVPIXFMT_R_G_B_TO_RGB16(dr, dg, db);
+					/* blending reads the destination */
+					for (i = 0; i < n; ++i)
+					{
+						TUINT8 *dp = fn(dst, x0 + x + i, y0 + y, data);
+						if (dbpp == 4)
+							((TUINT *) tp)[i] = *((TUINT *) dp);
+						else
+							((TUINT16 *) tp)[i] = *((TUINT16 *) dp);
+					}
 				}
-				break;
-				
-			case 0x30000 | ((TVPIXFMT_A8R8G8B8 & 0xff) << 8) | (TVPIXFMT_R5G6B5 & 0xff):
+				(*conv)(tp, sp + x * sbpp, n);
+				for (i = 0; i < n; ++i)
 				{
-					TUINT32 spix = ((TUINT *)sp)[x];
-					TUINT a = TVPIXFMT_ARGB32_GET_ALPHA8(spix);
-					TUINT r = TVPIXFMT_ARGB32_GET_RED8(spix);
-					TUINT g = TVPIXFMT_ARGB32_GET_GREEN8(spix);
-					TUINT b = TVPIXFMT_ARGB32_GET_BLUE8(spix);
-					TUINT dpix = ((TUINT16 *)dp)[x];
-					TUINT dr = TVPIXFMT_RGB16_GET_RED8(dpix);
-					TUINT dg = TVPIXFMT_RGB16_GET_GREEN8(dpix);
-					TUINT db = TVPIXFMT_RGB16_GET_BLUE8(dpix);
-					dr += ((r - dr) * a) >> 8;
-					dg += ((g - dg) * a) >> 8;
-					db += ((b - db) * a) >> 8;
-					TUINT16 p = TVPIXFMT_R_G_B_TO_RGB16(dr, dg, db);
-					*((TUINT16 *)dp) = TVPIXFMT_RGB16_SWAP(p);
+					TUINT8 *dp = fn(dst, x0 + x + i, y0 + y, data);
+					if (dbpp == 4)
+						*((TUINT *) dp) = ((TUINT *) tp)[i];
+					else
+						*((TUINT16 *) dp) = ((TUINT16 *) tp)[i];
 				}
-				break;
-			
-			default:
-				TDBPRINTF(TDB_WARN,("unsupported conversion %08x: alpha=%d swap=%d src=%08x dst=%08x\n",
-					c, alpha, swap, src->tpb_Format, dst->tpb_Format));
-				return 1;
-		}
+			}
 		}
 	}
 	return 0;
@@ -465,80 +766,494 @@ TLIBAPI TINT pixconv_convert(struct TVPixBuf *src, struct TVPixBuf *dst,
 						alpha, swap, NULL, NULL);
 }
 
+/*****************************************************************************/
+/*
+**	Rotated conversion: The source is converted in square tiles to a
+**	temporary buffer, from which the tile is written to the destination
+**	rotated by 90, 180 or 270 degrees clockwise. A 32x32 tile of 32 bit
+**	pixels fits into L1 cache, and each destination row receives a run of
+**	PIXCONV_TILE pixels instead of a single pixel.
+*/
+
+#define PIXCONV_TILE	32
+
+#if defined(PIXCONV_SSE2)
+
+static TINLINE void pixconv_sse2_transpose4(TUINT *t, TINT i, TINT j,
+	__m128i *c)
+{
+	__m128i r0 = _mm_loadu_si128((__m128i *) (t + (i + 0) * PIXCONV_TILE + j));
+	__m128i r1 = _mm_loadu_si128((__m128i *) (t + (i + 1) * PIXCONV_TILE + j));
+	__m128i r2 = _mm_loadu_si128((__m128i *) (t + (i + 2) * PIXCONV_TILE + j));
+	__m128i r3 = _mm_loadu_si128((__m128i *) (t + (i + 3) * PIXCONV_TILE + j));
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+	c[0] = _mm_unpacklo_epi64(t0, t1);
+	c[1] = _mm_unpackhi_epi64(t0, t1);
+	c[2] = _mm_unpacklo_epi64(t2, t3);
+	c[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+#define PIXCONV_TRANSPOSE4(t, i, j, c)	pixconv_sse2_transpose4(t, i, j, c)
+#define PIXCONV_REVERSE4(v)	_mm_shuffle_epi32(v, 0x1b)
+#define PIXCONV_LOAD4(p)	_mm_loadu_si128((__m128i *) (p))
+#define PIXCONV_STORE4(p, v)	_mm_storeu_si128((__m128i *) (p), v)
+#define PIXCONV_HAVE_TRANSPOSE4
+typedef __m128i pixconv_vec4;
+
+#elif defined(PIXCONV_NEON)
+
+static TINLINE void pixconv_neon_transpose4(TUINT *t, TINT i, TINT j,
+	uint32x4_t *c)
+{
+	uint32x4x2_t p0 = vtrnq_u32(vld1q_u32(t + (i + 0) * PIXCONV_TILE + j),
+		vld1q_u32(t + (i + 1) * PIXCONV_TILE + j));
+	uint32x4x2_t p1 = vtrnq_u32(vld1q_u32(t + (i + 2) * PIXCONV_TILE + j),
+		vld1q_u32(t + (i + 3) * PIXCONV_TILE + j));
+	c[0] = vcombine_u32(vget_low_u32(p0.val[0]), vget_low_u32(p1.val[0]));
+	c[1] = vcombine_u32(vget_low_u32(p0.val[1]), vget_low_u32(p1.val[1]));
+	c[2] = vcombine_u32(vget_high_u32(p0.val[0]), vget_high_u32(p1.val[0]));
+	c[3] = vcombine_u32(vget_high_u32(p0.val[1]), vget_high_u32(p1.val[1]));
+}
+
+static TINLINE uint32x4_t pixconv_neon_reverse4(uint32x4_t v)
+{
+	v = vrev64q_u32(v);
+	return vcombine_u32(vget_high_u32(v), vget_low_u32(v));
+}
+
+#define PIXCONV_TRANSPOSE4(t, i, j, c)	pixconv_neon_transpose4(t, i, j, c)
+#define PIXCONV_REVERSE4(v)	pixconv_neon_reverse4(v)
+#define PIXCONV_LOAD4(p)	vld1q_u32((TUINT *) (p))
+#define PIXCONV_STORE4(p, v)	vst1q_u32((TUINT *) (p), v)
+#define PIXCONV_HAVE_TRANSPOSE4
+typedef uint32x4_t pixconv_vec4;
+
+#endif
+
+/*
+**	Write the w * h tile t, with the upper left edge at the destination
+**	row address d and x offset dx in pixels, rotated: Column j of the tile
+**	becomes destination row d + j * dinc. With reverse, the column is
+**	written from bottom to top.
+*/
+
+static void pixconv_rotcols32(TUINT *t, TINT w, TINT h, TUINT8 *d,
+	TINT dinc, TBOOL reverse)
+{
+	TINT i = 0, j;
+#if defined(PIXCONV_HAVE_TRANSPOSE4)
+	for (; i + 4 <= h; i += 4)
+	{
+		for (j = 0; j + 4 <= w; j += 4)
+		{
+			pixconv_vec4 c[4];
+			TINT k;
+			PIXCONV_TRANSPOSE4(t, i, j, c);
+			for (k = 0; k < 4; ++k)
+			{
+				TUINT *dp = (TUINT *) (d + (j + k) * dinc);
+				if (reverse)
+					PIXCONV_STORE4(dp + h - i - 4, PIXCONV_REVERSE4(c[k]));
+				else
+					PIXCONV_STORE4(dp + i, c[k]);
+			}
+		}
+		for (; j < w; ++j)
+		{
+			TUINT *dp = (TUINT *) (d + j * dinc);
+			TINT k;
+			for (k = i; k < i + 4; ++k)
+				dp[reverse ? h - 1 - k : k] = t[k * PIXCONV_TILE + j];
+		}
+	}
+#endif
+	for (; i < h; ++i)
+	{
+		for (j = 0; j < w; ++j)
+		{
+			TUINT *dp = (TUINT *) (d + j * dinc);
+			dp[reverse ? h - 1 - i : i] = t[i * PIXCONV_TILE + j];
+		}
+	}
+}
+
+static void pixconv_rotcols16(TUINT16 *t, TINT w, TINT h, TUINT8 *d,
+	TINT dinc, TBOOL reverse)
+{
+	TINT i, j;
+	for (j = 0; j < w; ++j)
+	{
+		TUINT16 *dp = (TUINT16 *) (d + j * dinc);
+		if (reverse)
+			for (i = 0; i < h; ++i)
+				dp[h - 1 - i] = t[i * PIXCONV_TILE + j];
+		else
+			for (i = 0; i < h; ++i)
+				dp[i] = t[i * PIXCONV_TILE + j];
+	}
+}
+
+static void pixconv_revrow32(TUINT *dp, TUINT *sp, TINT w)
+{
+	TINT x = 0;
+#if defined(PIXCONV_HAVE_TRANSPOSE4)
+	for (; x + 4 <= w; x += 4)
+		PIXCONV_STORE4(dp + w - x - 4, PIXCONV_REVERSE4(PIXCONV_LOAD4(sp + x)));
+#endif
+	for (; x < w; ++x)
+		dp[w - 1 - x] = sp[x];
+}
+
+static void pixconv_revrow16(TUINT16 *dp, TUINT16 *sp, TINT w)
+{
+	TINT x;
+	for (x = 0; x < w; ++x)
+		dp[w - 1 - x] = sp[x];
+}
+
+TLIBAPI TINT pixconv_rotate_convert(struct TVPixBuf *src, struct TVPixBuf *dst,
+	TINT x0, TINT y0, TINT x1, TINT y1, TINT sx, TINT sy, TINT rot,
+	TINT dw, TINT dh)
+{
+	TUINT tile[PIXCONV_TILE * PIXCONV_TILE];
+	TINT dbpp = TVPIXFMT_BYTES_PER_PIXEL(dst->tpb_Format);
+	TINT dbpl = dst->tpb_BytesPerLine;
+	TINT tpitch = PIXCONV_TILE * dbpp;
+	TINT tx, ty;
+	TLIBROWCONV *conv;
+
+	if (rot == 0)
+		return pixconv_convert(src, dst, x0, y0, x1, y1, sx, sy, TFALSE,
+			TFALSE);
+
+	conv = pixconv_getrowconv(src->tpb_Format, dst->tpb_Format, TFALSE,
+		TFALSE);
+	if (conv == TNULL || (rot != 90 && rot != 180 && rot != 270))
+		return 1;
+
+	for (ty = y0; ty <= y1; ty += PIXCONV_TILE)
+	{
+		TINT h = TMIN(PIXCONV_TILE, y1 - ty + 1);
+		for (tx = x0; tx <= x1; tx += PIXCONV_TILE)
+		{
+			TINT w = TMIN(PIXCONV_TILE, x1 - tx + 1);
+			TUINT8 *sp = TVPB_GETADDRESS(src, sx + tx - x0, sy + ty - y0);
+			TUINT8 *tp = (TUINT8 *) tile;
+			TUINT8 *d;
+			TINT i;
+
+			for (i = 0; i < h; ++i, sp += src->tpb_BytesPerLine,
+				tp += tpitch)
+				(*conv)(tp, sp, w);
+
+			switch (rot)
+			{
+				case 90:
+					/* (x, y) -> (y, dh - 1 - x) */
+					d = dst->tpb_Data + (dh - 1 - tx) * dbpl + ty * dbpp;
+					if (dbpp == 4)
+						pixconv_rotcols32(tile, w, h, d, -dbpl, TFALSE);
+					else
+						pixconv_rotcols16((TUINT16 *) tile, w, h, d, -dbpl,
+							TFALSE);
+					break;
+				case 270:
+					/* (x, y) -> (dw - 1 - y, x) */
+					d = dst->tpb_Data + tx * dbpl + (dw - ty - h) * dbpp;
+					if (dbpp == 4)
+						pixconv_rotcols32(tile, w, h, d, dbpl, TTRUE);
+					else
+						pixconv_rotcols16((TUINT16 *) tile, w, h, d, dbpl,
+							TTRUE);
+					break;
+				case 180:
+					/* (x, y) -> (dw - 1 - x, dh - 1 - y) */
+					d = dst->tpb_Data + (dh - 1 - ty) * dbpl +
+						(dw - tx - w) * dbpp;
+					tp = (TUINT8 *) tile;
+					for (i = 0; i < h; ++i, d -= dbpl, tp += tpitch)
+					{
+						if (dbpp == 4)
+							pixconv_revrow32((TUINT *) d, (TUINT *) tp, w);
+						else
+							pixconv_revrow16((TUINT16 *) d, (TUINT16 *) tp,
+								w);
+					}
+					break;
+			}
+		}
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	Coverage blending of a solid color, as used for antialiased text.
+**	The scalar kernels are the reference; SIMD kernels must produce
+**	identical results, including the contents of padding bits.
+*/
+
+#define PIXCONV_WRITEALPHA(name, dtype, DGET, DPUT) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w, TINT r, TINT g, TINT b) \
+{ \
+	TINT x; \
+	for (x = 0; x < w; ++x) \
+	{ \
+		TUINT pix = ((dtype *) dbuf)[x]; \
+		TUINT dr = DGET##_GET_RED8(pix); \
+		TUINT dg = DGET##_GET_GREEN8(pix); \
+		TUINT db = DGET##_GET_BLUE8(pix); \
+		TUINT8 a = sbuf[x]; \
+		dr += ((r - dr) * a) >> 8; \
+		dg += ((g - dg) * a) >> 8; \
+		db += ((b - db) * a) >> 8; \
+		((dtype *) dbuf)[x] = DPUT(dr, dg, db); \
+	} \
+}
+
+PIXCONV_WRITEALPHA(pixconv_writealpha_0rgb32, TUINT, TVPIXFMT_ARGB32,
+	TVPIXFMT_R_G_B_TO_ARGB32)
+PIXCONV_WRITEALPHA(pixconv_writealpha_0bgr32, TUINT, TVPIXFMT_ABGR32,
+	TVPIXFMT_R_G_B_TO_ABGR32)
+PIXCONV_WRITEALPHA(pixconv_writealpha_rgb16, TUINT16, TVPIXFMT_RGB16,
+	TVPIXFMT_R_G_B_TO_RGB16)
+PIXCONV_WRITEALPHA(pixconv_writealpha_rgb15, TUINT16, TVPIXFMT_RGB15,
+	TVPIXFMT_R_G_B_TO_RGB15)
+PIXCONV_WRITEALPHA(pixconv_writealpha_bgr15, TUINT16, TVPIXFMT_BGR15,
+	TVPIXFMT_R_G_B_TO_BGR15)
+
+#if defined(PIXCONV_SSE2)
+
+/*
+**	Blend 16-bit lanes d towards t by coverage a, as the scalar kernels
+**	do in unsigned arithmetic: d + ((t - d) * a >> 8) for t >= d, and
+**	d - ceil((d - t) * a / 256) otherwise. The rounded-up negative part is
+**	returned in *neg, as it determines the carry into bit 24 of the
+**	32-bit scalar result.
+*/
+
+static TINLINE __m128i pixconv_sse2_blend(__m128i d, __m128i t, __m128i a,
+	__m128i *neg)
+{
+	__m128i p = _mm_srli_epi16(_mm_mullo_epi16(_mm_subs_epu16(t, d), a), 8);
+	__m128i n = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(
+		_mm_subs_epu16(d, t), a), _mm_set1_epi16(255)), 8);
+	*neg = n;
+	return _mm_sub_epi16(_mm_add_epi16(d, p), n);
+}
+
+/* t: pen color in destination byte order, without alpha */
+static void pixconv_sse2_writealpha32(TUINT8 *dbuf, TUINT8 *sbuf, TINT w,
+	TUINT t, void (*scalar)(TUINT8 *, TUINT8 *, TINT, TINT, TINT, TINT),
+	TINT r, TINT g, TINT b)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i tv = _mm_unpacklo_epi8(_mm_set1_epi32(t), zero);
+	__m128i rgbmask = _mm_set1_epi32(0x00ffffff);
+	__m128i carry = _mm_set1_epi32(0x01000000);
+	TINT x = 0;
+	for (; x + 4 <= w; x += 4)
+	{
+		__m128i *dp = (__m128i *) (dbuf + x * 4);
+		__m128i d = _mm_loadu_si128(dp);
+		__m128i a, lo, hi, nlo, nhi, n;
+		TUINT32 cov;
+		memcpy(&cov, sbuf + x, 4);
+		if (cov == 0)
+		{
+			/* transparent: only the padding byte is affected */
+			_mm_storeu_si128(dp, _mm_and_si128(d, rgbmask));
+			continue;
+		}
+		a = _mm_cvtsi32_si128(cov);
+		a = _mm_unpacklo_epi8(a, a);
+		a = _mm_unpacklo_epi16(a, a);
+		lo = pixconv_sse2_blend(_mm_unpacklo_epi8(d, zero), tv,
+			_mm_unpacklo_epi8(a, zero), &nlo);
+		hi = pixconv_sse2_blend(_mm_unpackhi_epi8(d, zero), tv,
+			_mm_unpackhi_epi8(a, zero), &nhi);
+		n = _mm_and_si128(_mm_packus_epi16(nlo, nhi), _mm_set1_epi32(0xff));
+		d = _mm_and_si128(_mm_packus_epi16(lo, hi), rgbmask);
+		d = _mm_or_si128(d, _mm_and_si128(_mm_cmpgt_epi32(n, zero), carry));
+		_mm_storeu_si128(dp, d);
+	}
+	(*scalar)(dbuf + x * 4, sbuf + x, w - x, r, g, b);
+}
+
+#define PIXCONV_SSE2_BITS(p, m, s) \
+	((s) > 0 ? _mm_slli_epi16(_mm_and_si128(p, _mm_set1_epi16(m)), s) : \
+	_mm_srli_epi16(_mm_and_si128(p, _mm_set1_epi16(m)), -(s)))
+#define PIXCONV_SSE2_EXPAND(p, m1, s1, m2, s2) \
+	_mm_or_si128(PIXCONV_SSE2_BITS(p, m1, s1), PIXCONV_SSE2_BITS(p, m2, s2))
+
+/* expand a 5 or 6 bit channel to 8 bit, as the GET_*8 macros do */
+#define PIXCONV_SSE2_RED16(p) PIXCONV_SSE2_EXPAND(p, 0xf800, -8, 0xe000, -13)
+#define PIXCONV_SSE2_GREEN16(p) PIXCONV_SSE2_EXPAND(p, 0x07e0, -3, 0x0600, -9)
+#define PIXCONV_SSE2_LOW5(p) PIXCONV_SSE2_EXPAND(p, 0x001f, 3, 0x001c, -2)
+#define PIXCONV_SSE2_GREEN15(p) PIXCONV_SSE2_EXPAND(p, 0x03e0, -2, 0x0380, -7)
+#define PIXCONV_SSE2_HIGH15(p) PIXCONV_SSE2_EXPAND(p, 0x7c00, -7, 0x7000, -12)
+
+/*
+**	16-bit destinations: R, G, B select the channel expansions, PUT packs
+**	the 8-bit channels, KEEP masks the bits surviving a transparent pixel.
+*/
+
+#define PIXCONV_SSE2_WRITEALPHA16(name, scalar, R, G, B, PUT, KEEP) \
+static void name(TUINT8 *dbuf, TUINT8 *sbuf, TINT w, TINT r, TINT g, TINT b) \
+{ \
+	__m128i zero = _mm_setzero_si128(); \
+	__m128i tr = _mm_set1_epi16(r); \
+	__m128i tg = _mm_set1_epi16(g); \
+	__m128i tb = _mm_set1_epi16(b); \
+	TINT x = 0; \
+	for (; x + 8 <= w; x += 8) \
+	{ \
+		__m128i *dp = (__m128i *) (dbuf + x * 2); \
+		__m128i p = _mm_loadu_si128(dp); \
+		__m128i a, n, dr, dg, db; \
+		TUINT64 cov; \
+		memcpy(&cov, sbuf + x, 8); \
+		if (cov == 0) \
+		{ \
+			if ((KEEP) != 0xffff) \
+				_mm_storeu_si128(dp, _mm_and_si128(p, \
+					_mm_set1_epi16((TINT16) (KEEP)))); \
+			continue; \
+		} \
+		a = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (sbuf + x)), zero); \
+		dr = pixconv_sse2_blend(R(p), tr, a, &n); \
+		dg = pixconv_sse2_blend(G(p), tg, a, &n); \
+		db = pixconv_sse2_blend(B(p), tb, a, &n); \
+		_mm_storeu_si128(dp, PUT); \
+	} \
+	scalar(dbuf + x * 2, sbuf + x, w - x, r, g, b); \
+}
+
+PIXCONV_SSE2_WRITEALPHA16(pixconv_sse2_writealpha_rgb16,
+	pixconv_writealpha_rgb16,
+	PIXCONV_SSE2_RED16, PIXCONV_SSE2_GREEN16, PIXCONV_SSE2_LOW5,
+	_mm_or_si128(_mm_or_si128(PIXCONV_SSE2_BITS(dr, 0xf8, 8),
+		PIXCONV_SSE2_BITS(dg, 0xfc, 3)), PIXCONV_SSE2_BITS(db, 0xf8, -3)),
+	0xffff)
+PIXCONV_SSE2_WRITEALPHA16(pixconv_sse2_writealpha_rgb15,
+	pixconv_writealpha_rgb15,
+	PIXCONV_SSE2_HIGH15, PIXCONV_SSE2_GREEN15, PIXCONV_SSE2_LOW5,
+	_mm_or_si128(_mm_or_si128(PIXCONV_SSE2_BITS(dr, 0xf8, 7),
+		PIXCONV_SSE2_BITS(dg, 0xf8, 2)), PIXCONV_SSE2_BITS(db, 0xf8, -3)),
+	0x7fff)
+PIXCONV_SSE2_WRITEALPHA16(pixconv_sse2_writealpha_bgr15,
+	pixconv_writealpha_bgr15,
+	PIXCONV_SSE2_LOW5, PIXCONV_SSE2_GREEN15, PIXCONV_SSE2_HIGH15,
+	_mm_or_si128(_mm_or_si128(PIXCONV_SSE2_BITS(db, 0xf8, 7),
+		PIXCONV_SSE2_BITS(dg, 0xf8, 2)), PIXCONV_SSE2_BITS(dr, 0xf8, -3)),
+	0x7fff)
+
+#endif /* defined(PIXCONV_SSE2) */
+
+#if defined(PIXCONV_NEON)
+
+static void pixconv_neon_writealpha32(TUINT8 *dbuf, TUINT8 *sbuf, TINT w,
+	TUINT t, void (*scalar)(TUINT8 *, TUINT8 *, TINT, TINT, TINT, TINT),
+	TINT r, TINT g, TINT b)
+{
+	uint16x8_t tv = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(t)));
+	uint16x8_t round = vdupq_n_u16(255);
+	uint32x4_t rgbmask = vdupq_n_u32(0x00ffffff);
+	TINT x = 0;
+	for (; x + 4 <= w; x += 4)
+	{
+		uint32_t *dp = (uint32_t *) (dbuf + x * 4);
+		uint32x4_t d = vld1q_u32(dp);
+		uint8x16_t a, d8;
+		uint16x8_t dl, dh, al, ah, nl, nh;
+		uint32x4_t n;
+		TUINT32 cov;
+		memcpy(&cov, sbuf + x, 4);
+		if (cov == 0)
+		{
+			vst1q_u32(dp, vandq_u32(d, rgbmask));
+			continue;
+		}
+		/* replicate each coverage byte across its pixel */
+		a = vreinterpretq_u8_u32(vmulq_n_u32(vmovl_u16(vget_low_u16(
+			vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(cov))))), 0x01010101));
+		d8 = vreinterpretq_u8_u32(d);
+		dl = vmovl_u8(vget_low_u8(d8));
+		dh = vmovl_u8(vget_high_u8(d8));
+		al = vmovl_u8(vget_low_u8(a));
+		ah = vmovl_u8(vget_high_u8(a));
+		nl = vshrq_n_u16(vaddq_u16(vmulq_u16(vqsubq_u16(dl, tv), al), round), 8);
+		nh = vshrq_n_u16(vaddq_u16(vmulq_u16(vqsubq_u16(dh, tv), ah), round), 8);
+		dl = vsubq_u16(vaddq_u16(dl,
+			vshrq_n_u16(vmulq_u16(vqsubq_u16(tv, dl), al), 8)), nl);
+		dh = vsubq_u16(vaddq_u16(dh,
+			vshrq_n_u16(vmulq_u16(vqsubq_u16(tv, dh), ah), 8)), nh);
+		n = vandq_u32(vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(nl),
+			vmovn_u16(nh))), vdupq_n_u32(0xff));
+		d = vandq_u32(vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(dl),
+			vmovn_u16(dh))), rgbmask);
+		d = vorrq_u32(d, vandq_u32(vcgtq_u32(n, vdupq_n_u32(0)),
+			vdupq_n_u32(0x01000000)));
+		vst1q_u32(dp, d);
+	}
+	(*scalar)(dbuf + x * 4, sbuf + x, w - x, r, g, b);
+}
+
+#endif /* defined(PIXCONV_NEON) */
+
 TLIBAPI void pixconv_writealpha(TUINT8 *dbuf, TUINT8 *sbuf, TINT w, TUINT dfmt, TINT r, TINT g, TINT b)
 {
-	int x;
 	switch (dfmt)
 	{
 		case TVPIXFMT_08R8G8B8:
-			for (x = 0; x < w; ++x)
-			{
-				TUINT pix = ((TUINT *)dbuf)[x];
-				TUINT dr = TVPIXFMT_ARGB32_GET_RED8(pix);
-				TUINT dg = TVPIXFMT_ARGB32_GET_GREEN8(pix);
-				TUINT db = TVPIXFMT_ARGB32_GET_BLUE8(pix);
-				TUINT8 a = sbuf[x];
-				dr += ((r - dr) * a) >> 8;
-				dg += ((g - dg) * a) >> 8;
-				db += ((b - db) * a) >> 8;
-				((TUINT *)dbuf)[x] = TVPIXFMT_R_G_B_TO_ARGB32(dr, dg, db);
-			}
+#if defined(PIXCONV_SSE2)
+			pixconv_sse2_writealpha32(dbuf, sbuf, w,
+				TVPIXFMT_R_G_B_TO_ARGB32(r, g, b), pixconv_writealpha_0rgb32,
+				r, g, b);
+#elif defined(PIXCONV_NEON)
+			pixconv_neon_writealpha32(dbuf, sbuf, w,
+				TVPIXFMT_R_G_B_TO_ARGB32(r, g, b), pixconv_writealpha_0rgb32,
+				r, g, b);
+#else
+			pixconv_writealpha_0rgb32(dbuf, sbuf, w, r, g, b);
+#endif
 			break;
 		case TVPIXFMT_08B8G8R8:
-			for (x = 0; x < w; ++x)
-			{
-				TUINT pix = ((TUINT *)dbuf)[x];
-				TUINT dr = TVPIXFMT_ABGR32_GET_RED8(pix);
-				TUINT dg = TVPIXFMT_ABGR32_GET_GREEN8(pix);
-				TUINT db = TVPIXFMT_ABGR32_GET_BLUE8(pix);
-				TUINT8 a = sbuf[x];
-				dr += ((r - dr) * a) >> 8;
-				dg += ((g - dg) * a) >> 8;
-				db += ((b - db) * a) >> 8;
-				((TUINT *)dbuf)[x] = TVPIXFMT_R_G_B_TO_ABGR32(dr, dg, db);
-			}
+#if defined(PIXCONV_SSE2)
+			pixconv_sse2_writealpha32(dbuf, sbuf, w,
+				TVPIXFMT_R_G_B_TO_ABGR32(r, g, b), pixconv_writealpha_0bgr32,
+				r, g, b);
+#elif defined(PIXCONV_NEON)
+			pixconv_neon_writealpha32(dbuf, sbuf, w,
+				TVPIXFMT_R_G_B_TO_ABGR32(r, g, b), pixconv_writealpha_0bgr32,
+				r, g, b);
+#else
+			pixconv_writealpha_0bgr32(dbuf, sbuf, w, r, g, b);
+#endif
 			break;
 		case TVPIXFMT_R5G6B5:
-			for (x = 0; x < w; ++x)
-			{
-				TUINT pix = ((TUINT16 *)dbuf)[x];
-				TUINT dr = TVPIXFMT_RGB16_GET_RED8(pix);
-				TUINT dg = TVPIXFMT_RGB16_GET_GREEN8(pix);
-				TUINT db = TVPIXFMT_RGB16_GET_BLUE8(pix);
-				TUINT8 a = sbuf[x];
-				dr += ((r - dr) * a) >> 8;
-				dg += ((g - dg) * a) >> 8;
-				db += ((b - db) * a) >> 8;
-				((TUINT16 *)dbuf)[x] = TVPIXFMT_R_G_B_TO_RGB16(dr, dg, db);
-			}
+#if defined(PIXCONV_SSE2)
+			pixconv_sse2_writealpha_rgb16(dbuf, sbuf, w, r, g, b);
+#else
+			pixconv_writealpha_rgb16(dbuf, sbuf, w, r, g, b);
+#endif
 			break;
 		case TVPIXFMT_0R5G5B5:
-			for (x = 0; x < w; ++x)
-			{
-				TUINT pix = ((TUINT16 *)dbuf)[x];
-				TUINT dr = TVPIXFMT_RGB15_GET_RED8(pix);
-				TUINT dg = TVPIXFMT_RGB15_GET_GREEN8(pix);
-				TUINT db = TVPIXFMT_RGB15_GET_BLUE8(pix);
-				TUINT8 a = sbuf[x];
-				dr += ((r - dr) * a) >> 8;
-				dg += ((g - dg) * a) >> 8;
-				db += ((b - db) * a) >> 8;
-				((TUINT16 *)dbuf)[x] = TVPIXFMT_R_G_B_TO_RGB15(dr, dg, db);
-			}
+#if defined(PIXCONV_SSE2)
+			pixconv_sse2_writealpha_rgb15(dbuf, sbuf, w, r, g, b);
+#else
+			pixconv_writealpha_rgb15(dbuf, sbuf, w, r, g, b);
+#endif
 			break;
 		case TVPIXFMT_0B5G5R5:
-			for (x = 0; x < w; ++x)
-			{
-				TUINT pix = ((TUINT16 *)dbuf)[x];
-				TUINT dr = TVPIXFMT_BGR15_GET_RED8(pix);
-				TUINT dg = TVPIXFMT_BGR15_GET_GREEN8(pix);
-				TUINT db = TVPIXFMT_BGR15_GET_BLUE8(pix);
-				TUINT8 a = sbuf[x];
-				dr += ((r - dr) * a) >> 8;
-				dg += ((g - dg) * a) >> 8;
-				db += ((b - db) * a) >> 8;
-				((TUINT16 *)dbuf)[x] = TVPIXFMT_R_G_B_TO_BGR15(dr, dg, db);
-			}
+#if defined(PIXCONV_SSE2)
+			pixconv_sse2_writealpha_bgr15(dbuf, sbuf, w, r, g, b);
+#else
+			pixconv_writealpha_bgr15(dbuf, sbuf, w, r, g, b);
+#endif
 			break;
 	}
 }
@@ -9,6 +9,7 @@
 
 /*#define NDEBUG*/
 #include <assert.h>
+#include <stdlib.h>
 
 #include <tek/debug.h>
 #include <tek/teklib.h>
@@ -20,8 +21,10 @@
 
 /* number of merge operations: */
 #define MERGE_NUMOPS					5
-/* max number of rects buffered for re-use: */
-#define MAXPOOLNODES 					1024
+/* number of rects in the first slab of a pool: */
+#define MINSLABNODES					64
+/* max number of rects per slab: */
+#define MAXSLABNODES					4096
 /* opportunistic merge min number of pixels: */
 #define OPPORTUNISTIC_MERGE_THRESHOLD	1000
 /* opportunistic merge ratio n/256: */
@@ -43,26 +46,56 @@ static void region_relinklist(struct TList *dlist, struct TList *slist)
 	}
 }
 
+/*
+**	rect nodes are carved from slabs, which grow geometrically with the
+**	total number of nodes in the pool. nodes are returned to the pool's
+**	free list in bulk, the slabs are freed with the pool.
+*/
+
+struct RectSlab
+{
+	struct RectSlab *rs_Next;
+	TSIZE rs_NumNodes;
+};
+
+static TBOOL region_allocslab(struct RectPool *pool)
+{
+	struct TNode *temp;
+	struct RectSlab *slab;
+	struct RectNode *rn;
+	TINT i, num = TMIN(TMAX(pool->p_NumNodes, MINSLABNODES), MAXSLABNODES);
+	slab = TExecAlloc(pool->p_ExecBase, TNULL,
+		sizeof(struct RectSlab) + sizeof(struct RectNode) * num);
+	if (slab == TNULL)
+		return TFALSE;
+	slab->rs_Next = pool->p_Slabs;
+	slab->rs_NumNodes = num;
+	pool->p_Slabs = slab;
+	rn = (struct RectNode *) (slab + 1);
+	for (i = 0; i < num; ++i)
+		TADDTAIL(&pool->p_Rects.rl_List, &rn[i].rn_Node, temp);
+	pool->p_Rects.rl_NumNodes += num;
+	pool->p_NumNodes += num;
+	pool->p_NumSlabs++;
+	return TTRUE;
+}
+
 static struct RectNode *region_allocrectnode(struct RectPool *pool,
 	TINT x0, TINT y0, TINT x1, TINT y1)
 {
 	struct TNode *temp;
-	struct RectNode *rn = (struct RectNode *) 
-		TREMHEAD(&pool->p_Rects.rl_List, temp);
-	if (rn)
-	{
-		pool->p_Rects.rl_NumNodes--;
-		assert(pool->p_Rects.rl_NumNodes >= 0);
-	}
-	else
-		rn = TExecAlloc(pool->p_ExecBase, TNULL, sizeof(struct RectNode));
-	if (rn)
-	{
-		rn->rn_Rect[0] = x0;
-		rn->rn_Rect[1] = y0;
-		rn->rn_Rect[2] = x1;
-		rn->rn_Rect[3] = y1;
-	}
+	struct RectNode *rn;
+	if (TISLISTEMPTY(&pool->p_Rects.rl_List) && !region_allocslab(pool))
+		return TNULL;
+	rn = (struct RectNode *) TREMHEAD(&pool->p_Rects.rl_List, temp);
+	pool->p_Rects.rl_NumNodes--;
+	assert(pool->p_Rects.rl_NumNodes >= 0);
+	if (++pool->p_NumLive > pool->p_MaxLive)
+		pool->p_MaxLive = pool->p_NumLive;
+	rn->rn_Rect[0] = x0;
+	rn->rn_Rect[1] = y0;
+	rn->rn_Rect[2] = x1;
+	rn->rn_Rect[3] = y1;
 	return rn;
 }
 
@@ -81,14 +114,9 @@ static void region_relinkrects(struct RectList *d, struct RectList *s)
 
 TLIBAPI void region_freerects(struct RectPool *p, struct RectList *list)
 {
-	struct TNode *temp;
-	struct TExecBase *TExecBase = p->p_ExecBase;
+	p->p_NumLive -= list->rl_NumNodes;
+	assert(p->p_NumLive >= 0);
 	region_relinkrects(&p->p_Rects, list);
-	while (p->p_Rects.rl_NumNodes > MAXPOOLNODES)
-	{
-		TFree(TREMTAIL(&p->p_Rects.rl_List, temp));
-		p->p_Rects.rl_NumNodes--;
-	}
 }
 
 TLIBAPI TBOOL region_insertrect(struct RectPool *pool, struct RectList *list,
@@ -142,77 +170,397 @@ TLIBAPI TBOOL region_insertrect(struct RectPool *pool, struct RectList *list,
 	return TFALSE;
 }
 
-static TBOOL region_cutrect(struct RectPool *pool, struct RectList *list,
-	const RECTINT d[4], const RECTINT s[4])
-{
-	TINT d0 = d[0];
-	TINT d1 = d[1];
-	TINT d2 = d[2];
-	TINT d3 = d[3];
+/*
+**	Banded rectangle arrays. Region operations are performed on arrays of
+**	rectangles in y-x banded order: rectangles of a band share the same
+**	y0 and y1 and are sorted by x without overlapping, and bands are sorted
+**	by y without overlapping. Results are written back to the rect lists in
+**	this order, so that they usually need no sorting when reused.
+*/
+
+#define REGION_OP_OR		0
+#define REGION_OP_AND		1
+#define REGION_OP_SUB		2
+#define REGION_OP_XOR		3
+
+#define REGION_BANDS_A		0
+#define REGION_BANDS_B		1
+#define REGION_BANDS_OUT	2
+#define REGION_BANDS_AUX	3
 
-	if (!REGION_OVERLAPRECT(d, s))
-		return region_insertrect(pool, list, d[0], d[1], d[2], d[3]);
+#define REGION_MAXCOORD		0x7fffffff
 
-	for (;;)
+/* k-th span boundary of a band, alternating between entry and exit: */
+#define REGION_BOUNDARY(r, k) \
+	(((k) & 1) ? (r)[((k) >> 1) * 4 + 2] + 1 : (r)[((k) >> 1) * 4])
+
+static TBOOL region_growbands(struct RectPool *pool, struct RectBands *b,
+	TINT num)
+{
+	if (num > b->rb_MaxRects)
 	{
-		if (d0 < s[0])
+		struct TExecBase *TExecBase = pool->p_ExecBase;
+		TINT max = TMAX(num, b->rb_MaxRects * 2);
+		RECTINT *r;
+		max = TMAX(max, 64);
+		r = TAlloc(TNULL, sizeof(RECTINT) * 4 * max);
+		if (r == TNULL)
+			return TFALSE;
+		if (b->rb_Rects)
 		{
-			if (!region_insertrect(pool, list, d0, d1, s[0] - 1, d3))
-				break;
-			d0 = s[0];
+			TCopyMem(b->rb_Rects, r, sizeof(RECTINT) * 4 * b->rb_NumRects);
+			TFree(b->rb_Rects);
 		}
+		b->rb_Rects = r;
+		b->rb_MaxRects = max;
+	}
+	return TTRUE;
+}
+
+static void region_addband(struct RectBands *b, TINT x0, TINT y0, TINT x1,
+	TINT y1)
+{
+	RECTINT *r = b->rb_Rects + b->rb_NumRects++ * 4;
+	r[0] = x0;
+	r[1] = y0;
+	r[2] = x1;
+	r[3] = y1;
+}
+
+/*
+**	merge the band starting at index cur with the previous band at index
+**	prev, if they touch vertically and have identical spans. returns the
+**	index of the band that the next band must be compared against.
+*/
+
+static TINT region_coalesce(struct RectBands *b, TINT prev, TINT cur)
+{
+	RECTINT *r = b->rb_Rects;
+	TINT n = b->rb_NumRects - cur;
+	TINT i;
+	if (n == 0)
+		return prev;
+	if (prev < 0 || cur - prev != n || r[prev * 4 + 3] + 1 != r[cur * 4 + 1])
+		return cur;
+	for (i = 0; i < n; ++i)
+	{
+		if (r[(prev + i) * 4] != r[(cur + i) * 4] ||
+			r[(prev + i) * 4 + 2] != r[(cur + i) * 4 + 2])
+			return cur;
+	}
+	for (i = 0; i < n; ++i)
+		r[(prev + i) * 4 + 3] = r[(cur + i) * 4 + 3];
+	b->rb_NumRects = cur;
+	return prev;
+}
+
+static int region_cmpy(const void *a, const void *b)
+{
+	const RECTINT *ra = a, *rb = b;
+	return ra[1] < rb[1] ? -1 : ra[1] > rb[1];
+}
+
+static int region_cmpx(const void *a, const void *b)
+{
+	const RECTINT *ra = a, *rb = b;
+	return ra[0] < rb[0] ? -1 : ra[0] > rb[0];
+}
+
+/*
+**	bring an arbitrary set of rectangles into banded order by sweeping
+**	over the y coordinates where rectangles start and end. overlapping
+**	input is allowed.
+*/
 
-		if (d1 < s[1])
+static TBOOL region_sortbands(struct RectPool *pool, struct RectBands *b)
+{
+	struct RectBands *out = &pool->p_Bands[REGION_BANDS_OUT];
+	struct RectBands *aux = &pool->p_Bands[REGION_BANDS_AUX];
+	struct RectBands swap;
+	RECTINT *r = b->rb_Rects;
+	TINT n = b->rb_NumRects;
+	TINT i = 0, nact = 0, prev = -1, top = 0;
+	TINT *act, *span;
+
+	out->rb_NumRects = 0;
+	/* room for n active indices and n spans: */
+	if (!region_growbands(pool, aux, n))
+		return TFALSE;
+	act = aux->rb_Rects;
+	span = act + n;
+
+	qsort(r, n, sizeof(RECTINT) * 4, region_cmpy);
+
+	while (i < n || nact > 0)
+	{
+		TINT bot = REGION_MAXCOORD;
+		TINT j, k, cur;
+
+		if (nact == 0)
+			top = r[i * 4 + 1];
+		while (i < n && r[i * 4 + 1] <= top)
+			act[nact++] = i++;
+		if (i < n)
+			bot = r[i * 4 + 1] - 1;
+		for (j = 0; j < nact; ++j)
 		{
-			if (!region_insertrect(pool, list, d0, d1, d2, s[1] - 1))
-				break;
-			d1 = s[1];
+			bot = TMIN(bot, r[act[j] * 4 + 3]);
+			span[j * 2] = r[act[j] * 4];
+			span[j * 2 + 1] = r[act[j] * 4 + 2];
 		}
+		qsort(span, nact, sizeof(RECTINT) * 2, region_cmpx);
 
-		if (d2 > s[2])
+		if (!region_growbands(pool, out, out->rb_NumRects + nact))
+			return TFALSE;
+		cur = out->rb_NumRects;
+		for (j = 0; j < nact; )
 		{
-			if (!region_insertrect(pool, list, s[2] + 1, d1, d2, d3))
-				break;
-			d2 = s[2];
+			TINT x0 = span[j * 2];
+			TINT x1 = span[j * 2 + 1];
+			for (++j; j < nact && span[j * 2] <= x1 + 1; ++j)
+				x1 = TMAX(x1, span[j * 2 + 1]);
+			region_addband(out, x0, top, x1, bot);
 		}
+		prev = region_coalesce(out, prev, cur);
+
+		/* retire rectangles ending in this band: */
+		for (j = k = 0; j < nact; ++j)
+			if (r[act[j] * 4 + 3] > bot)
+				act[k++] = act[j];
+		nact = k;
+		top = bot + 1;
+	}
+
+	swap = *b;
+	*b = *out;
+	*out = swap;
+	return TTRUE;
+}
 
-		if (d3 > s[3])
+static TBOOL region_tobands(struct RectPool *pool, struct RectList *list,
+	struct RectBands *b)
+{
+	struct TNode *next, *node = list->rl_List.tlh_Head.tln_Succ;
+	TBOOL banded = TTRUE;
+	RECTINT *p = TNULL;
+	TINT n = 0;
+	if (!region_growbands(pool, b, list->rl_NumNodes))
+		return TFALSE;
+	for (; (next = node->tln_Succ); node = next)
+	{
+		struct RectNode *rn = (struct RectNode *) node;
+		RECTINT *q = b->rb_Rects + n * 4;
+		if (rn->rn_Rect[2] < rn->rn_Rect[0] || rn->rn_Rect[3] < rn->rn_Rect[1])
+			continue;
+		q[0] = rn->rn_Rect[0];
+		q[1] = rn->rn_Rect[1];
+		q[2] = rn->rn_Rect[2];
+		q[3] = rn->rn_Rect[3];
+		if (p && banded)
 		{
-			if (!region_insertrect(pool, list, d0, s[3] + 1, d2, d3))
-				break;
+			if (q[1] == p[1] && q[3] == p[3])
+				banded = q[0] > p[2];
+			else
+				banded = q[1] > p[3];
 		}
+		p = q;
+		n++;
+	}
+	b->rb_NumRects = n;
+	return banded || region_sortbands(pool, b);
+}
 
-		return TTRUE;
+static TBOOL region_setbands(struct RectPool *pool, struct RectBands *b,
+	RECTINT s0, RECTINT s1, RECTINT s2, RECTINT s3)
+{
+	if (!region_growbands(pool, b, 1))
+		return TFALSE;
+	b->rb_NumRects = 0;
+	if (s2 >= s0 && s3 >= s1)
+		region_addband(b, s0, s1, s2, s3);
+	return TTRUE;
+}
+
+/*
+**	write the banded result to a rect list, reusing its nodes. the list
+**	is left unmodified if allocating additional nodes fails.
+*/
+
+static TBOOL region_frombands(struct RectPool *pool, struct RectList *list,
+	struct RectBands *b)
+{
+	struct TNode *temp, *next, *node;
+	struct RectList more, surplus;
+	TINT n = b->rb_NumRects;
+	TINT i;
 
+	region_initrectlist(&more);
+	for (i = list->rl_NumNodes; i < n; ++i)
+	{
+		struct RectNode *rn = region_allocrectnode(pool, 0, 0, 0, 0);
+		if (rn == TNULL)
+		{
+			region_freerects(pool, &more);
+			return TFALSE;
+		}
+		TADDTAIL(&more.rl_List, &rn->rn_Node, temp);
+		more.rl_NumNodes++;
 	}
-	return TFALSE;
+
+	region_initrectlist(&surplus);
+	i = 0;
+	node = list->rl_List.tlh_Head.tln_Succ;
+	for (; (next = node->tln_Succ); node = next)
+	{
+		struct RectNode *rn = (struct RectNode *) node;
+		if (i < n)
+		{
+			RECTINT *r = b->rb_Rects + i++ * 4;
+			rn->rn_Rect[0] = r[0];
+			rn->rn_Rect[1] = r[1];
+			rn->rn_Rect[2] = r[2];
+			rn->rn_Rect[3] = r[3];
+		}
+		else
+		{
+			TREMOVE(node);
+			TADDTAIL(&surplus.rl_List, node, temp);
+			surplus.rl_NumNodes++;
+			list->rl_NumNodes--;
+		}
+	}
+	node = more.rl_List.tlh_Head.tln_Succ;
+	for (; (next = node->tln_Succ); node = next)
+	{
+		struct RectNode *rn = (struct RectNode *) node;
+		RECTINT *r = b->rb_Rects + i++ * 4;
+		rn->rn_Rect[0] = r[0];
+		rn->rn_Rect[1] = r[1];
+		rn->rn_Rect[2] = r[2];
+		rn->rn_Rect[3] = r[3];
+	}
+	region_relinkrects(list, &more);
+	region_freerects(pool, &surplus);
+	return TTRUE;
 }
 
-static TBOOL region_cutrectlist(struct RectPool *pool, struct RectList *inlist,
-	struct RectList *outlist, const RECTINT s[4])
+/* combine the spans of two bands, walking over their boundaries: */
+
+static void region_combine(struct RectBands *out, const RECTINT *a, TINT na,
+	const RECTINT *b, TINT nb, TINT op, TINT y0, TINT y1)
 {
-	TBOOL success = TTRUE;
-	struct TNode *next, *node = inlist->rl_List.tlh_Head.tln_Succ;
-	for (; success && (next = node->tln_Succ); node = next)
+	TINT ia = 0, ib = 0, x0 = 0;
+	TBOOL ina = TFALSE, inb = TFALSE, in = TFALSE;
+	na *= 2;
+	nb *= 2;
+	while (ia < na || ib < nb)
 	{
-		struct RectNode *rn = (struct RectNode *) node;
-		struct RectList temp;
-		region_initrectlist(&temp);
-		success = region_cutrect(pool, &temp, rn->rn_Rect, s);
-		if (success)
+		TINT p = TMIN(ia < na ? REGION_BOUNDARY(a, ia) : REGION_MAXCOORD,
+			ib < nb ? REGION_BOUNDARY(b, ib) : REGION_MAXCOORD);
+		TBOOL o;
+		for (; ia < na && REGION_BOUNDARY(a, ia) == p; ++ia)
+			ina = !ina;
+		for (; ib < nb && REGION_BOUNDARY(b, ib) == p; ++ib)
+			inb = !inb;
+		switch (op)
 		{
-			struct TNode *next2, *node2 = temp.rl_List.tlh_Head.tln_Succ;
-			for (; success && (next2 = node2->tln_Succ); node2 = next2)
-			{
-				struct RectNode *rn2 = (struct RectNode *) node2;
-				success = region_insertrect(pool, outlist, rn2->rn_Rect[0],
-					rn2->rn_Rect[1], rn2->rn_Rect[2], rn2->rn_Rect[3]);
-				/* note that if unsuccessful, outlist is unusable as well */
-			}
+			default:
+			case REGION_OP_OR:
+				o = ina || inb;
+				break;
+			case REGION_OP_AND:
+				o = ina && inb;
+				break;
+			case REGION_OP_SUB:
+				o = ina && !inb;
+				break;
+			case REGION_OP_XOR:
+				o = ina != inb;
+				break;
+		}
+		if (o != in)
+		{
+			if (o)
+				x0 = p;
+			else
+				region_addband(out, x0, y0, p - 1, y1);
+			in = o;
 		}
-		region_freerects(pool, &temp);
 	}
-	return success;
+}
+
+static TINT region_bandend(const RECTINT *r, TINT i, TINT n)
+{
+	TINT y0 = r[i * 4 + 1];
+	while (++i < n && r[i * 4 + 1] == y0);
+	return i;
+}
+
+/* sweep over the bands of a and b, result in p_Bands[REGION_BANDS_OUT]: */
+
+static TBOOL region_bandop(struct RectPool *pool, TINT op)
+{
+	struct RectBands *A = &pool->p_Bands[REGION_BANDS_A];
+	struct RectBands *B = &pool->p_Bands[REGION_BANDS_B];
+	struct RectBands *out = &pool->p_Bands[REGION_BANDS_OUT];
+	const RECTINT *a = A->rb_Rects;
+	const RECTINT *b = B->rb_Rects;
+	TINT na = A->rb_NumRects;
+	TINT nb = B->rb_NumRects;
+	TINT ia = 0, ib = 0, prev = -1;
+	TINT top = -REGION_MAXCOORD;
+
+	out->rb_NumRects = 0;
+	while (ia < na || ib < nb)
+	{
+		TINT iae = ia < na ? region_bandend(a, ia, na) : na;
+		TINT ibe = ib < nb ? region_bandend(b, ib, nb) : nb;
+		TINT ay0 = ia < na ? a[ia * 4 + 1] : REGION_MAXCOORD;
+		TINT by0 = ib < nb ? b[ib * 4 + 1] : REGION_MAXCOORD;
+		TINT ay1 = ia < na ? a[ia * 4 + 3] : REGION_MAXCOORD;
+		TINT by1 = ib < nb ? b[ib * 4 + 3] : REGION_MAXCOORD;
+		TBOOL ina, inb;
+		TINT bot, sa, sb, cur;
+
+		top = TMAX(top, TMIN(ay0, by0));
+		ina = ay0 <= top;
+		inb = by0 <= top;
+		bot = TMIN(ina ? ay1 : ay0 - 1, inb ? by1 : by0 - 1);
+		sa = ina ? iae - ia : 0;
+		sb = inb ? ibe - ib : 0;
+
+		if (!region_growbands(pool, out, out->rb_NumRects + sa + sb))
+			return TFALSE;
+		cur = out->rb_NumRects;
+		region_combine(out, a + ia * 4, sa, b + ib * 4, sb, op, top, bot);
+		prev = region_coalesce(out, prev, cur);
+
+		if (ina && ay1 == bot)
+			ia = iae;
+		if (inb && by1 == bot)
+			ib = ibe;
+		top = bot + 1;
+	}
+	return TTRUE;
+}
+
+static TBOOL region_rectop(struct RectPool *pool, struct RectList *list,
+	RECTINT s0, RECTINT s1, RECTINT s2, RECTINT s3, TINT op)
+{
+	return region_tobands(pool, list, &pool->p_Bands[REGION_BANDS_A]) &&
+		region_setbands(pool, &pool->p_Bands[REGION_BANDS_B],
+			s0, s1, s2, s3) &&
+		region_bandop(pool, op) &&
+		region_frombands(pool, list, &pool->p_Bands[REGION_BANDS_OUT]);
+}
+
+static TBOOL region_listop(struct RectPool *pool, struct RectList *list,
+	struct RectList *slist, TINT op)
+{
+	return region_tobands(pool, list, &pool->p_Bands[REGION_BANDS_A]) &&
+		region_tobands(pool, slist, &pool->p_Bands[REGION_BANDS_B]) &&
+		region_bandop(pool, op) &&
+		region_frombands(pool, list, &pool->p_Bands[REGION_BANDS_OUT]);
 }
 
 TLIBAPI TBOOL region_orrectlist(struct RectPool *pool, struct RectList *list, 
@@ -258,19 +606,7 @@ TLIBAPI TBOOL region_orrectlist(struct RectPool *pool, struct RectList *list,
 		}
 	}
 
-	struct RectList temp;
-	region_initrectlist(&temp);
-	if (region_cutrectlist(pool, list, &temp, s))
-	{
-		if (region_insertrect(pool, &temp, s[0], s[1], s[2], s[3]))
-		{
-			region_freerects(pool, list);
-			region_relinkrects(list, &temp);
-			return TTRUE;
-		}
-	}
-	region_freerects(pool, &temp);
-	return TFALSE;
+	return region_rectop(pool, list, s[0], s[1], s[2], s[3], REGION_OP_OR);
 }
 
 TLIBAPI TBOOL region_orregion(struct Region *region, 
@@ -278,6 +614,9 @@ TLIBAPI TBOOL region_orregion(struct Region *region,
 {
 	TBOOL success = TTRUE;
 	struct TNode *next, *node = list->rl_List.tlh_Head.tln_Succ;
+	if (!opportunistic)
+		return region_listop(region->rg_Pool, &region->rg_Rects, list,
+			REGION_OP_OR);
 	for (; success && (next = node->tln_Succ); node = next)
 	{
 		struct RectNode *rn = (struct RectNode *) node;
@@ -287,86 +626,22 @@ TLIBAPI TBOOL region_orregion(struct Region *region,
 	return success;
 }
 
-static TBOOL region_andrect_internal(struct RectList *temp,
-	struct Region *region, TINT s[], TINT dx, TINT dy)
-{
-	struct RectPool *pool = region->rg_Pool;
-	struct TNode *next, *node = region->rg_Rects.rl_List.tlh_Head.tln_Succ;
-	TBOOL success = TTRUE;
-	TINT s0 = s[0] + dx;
-	TINT s1 = s[1] + dy;
-	TINT s2 = s[2] + dx;
-	TINT s3 = s[3] + dy;
-	for (; success && (next = node->tln_Succ); node = next)
-	{
-		struct RectNode *dr = (struct RectNode *) node;
-		TINT x0 = dr->rn_Rect[0];
-		TINT y0 = dr->rn_Rect[1];
-		TINT x1 = dr->rn_Rect[2];
-		TINT y1 = dr->rn_Rect[3];
-		if (REGION_OVERLAP(x0, y0, x1, y1, s0, s1, s2, s3))
-		{
-			success = region_insertrect(pool, temp,
-				TMAX(x0, s0), TMAX(y0, s1), TMIN(x1, s2), TMIN(y1, s3));
-		}
-	}
-	if (!success)
-		region_freerects(pool, temp);
-	return success;
-}
-
 TLIBAPI TBOOL region_subrect(struct RectPool *pool, struct Region *region, 
 	RECTINT s[])
 {
-	struct RectList r1;
-	struct TNode *next, *node;
-	TBOOL success = TTRUE;
-
-	region_initrectlist(&r1);
-	node = region->rg_Rects.rl_List.tlh_Head.tln_Succ;
-	for (; success && (next = node->tln_Succ); node = next)
-	{
-		struct TNode *next2, *node2;
-		struct RectNode *rn = (struct RectNode *) node;
-		struct RectList temp;
-		
-		region_initrectlist(&temp);
-		success = region_cutrect(pool, &temp, rn->rn_Rect, s);
-
-		node2 = temp.rl_List.tlh_Head.tln_Succ;
-		for (; success && (next2 = node2->tln_Succ); node2 = next2)
-		{
-			struct RectNode *rn2 = (struct RectNode *) node2;
-			success = region_insertrect(pool, &r1, rn2->rn_Rect[0],
-				rn2->rn_Rect[1], rn2->rn_Rect[2], rn2->rn_Rect[3]);
-		}
-
-		region_freerects(pool, &temp);
-	}
-
-	if (success)
-	{
-		region_freerects(pool, &region->rg_Rects);
-		region_relinkrects(&region->rg_Rects, &r1);
-	}
-	else
-		region_freerects(pool, &r1);
-
-	return success;
+	if (!region_overlap(pool, region, s))
+		return TTRUE;
+	return region_rectop(pool, &region->rg_Rects, s[0], s[1], s[2], s[3],
+		REGION_OP_SUB);
 }
 
 TLIBAPI TBOOL region_subregion(struct RectPool *pool, struct Region *dregion,
 	struct Region *sregion)
 {
-	TBOOL success = TTRUE;
-	struct TNode *next, *node = sregion->rg_Rects.rl_List.tlh_Head.tln_Succ;
-	for (; success && (next = node->tln_Succ); node = next)
-	{
-		struct RectNode *rn = (struct RectNode *) node;
-		success = region_subrect(pool, dregion, rn->rn_Rect);
-	}
-	/* note: if unsucessful, dregion is of no use anymore */
-	return success;
+	if (region_isempty(pool, sregion))
+		return TTRUE;
+	return region_listop(pool, &dregion->rg_Rects, &sregion->rg_Rects,
+		REGION_OP_SUB);
 }
 
 TLIBAPI TBOOL region_overlap(struct RectPool *pool, struct Region *region,
@@ -385,37 +660,15 @@ TLIBAPI TBOOL region_overlap(struct RectPool *pool, struct Region *region,
 TLIBAPI TBOOL region_andrect(struct RectPool *pool, struct Region *region,
 	TINT s[], TINT dx, TINT dy)
 {
-	struct RectList temp;
-	region_initrectlist(&temp);
-	if (region_andrect_internal(&temp, region, s, dx, dy))
-	{
-		region_freerects(pool, &region->rg_Rects);
-		region_relinkrects(&region->rg_Rects, &temp);
-		return TTRUE;
-	}
-	return TFALSE;
+	return region_rectop(pool, &region->rg_Rects, s[0] + dx, s[1] + dy,
+		s[2] + dx, s[3] + dy, REGION_OP_AND);
 }
 
 TLIBAPI TBOOL region_andregion(struct RectPool *pool, struct Region *dregion,
 	struct Region *sregion)
 {
-	struct TNode *next, *node = sregion->rg_Rects.rl_List.tlh_Head.tln_Succ;
-	TBOOL success = TTRUE;
-	struct RectList temp;
-	region_initrectlist(&temp);
-	for (; success && (next = node->tln_Succ); node = next)
-	{
-		struct RectNode *sr = (struct RectNode *) node;
-		success = region_andrect_internal(&temp, dregion,
-			sr->rn_Rect, 0, 0);
-	}
-	if (success)
-	{
-		region_freerects(pool, &dregion->rg_Rects);
-		region_relinkrects(&dregion->rg_Rects, &temp);
-	}
-	/* note: if unsucessful, dregion is of no use anymore */
-	return success;
+	return region_listop(pool, &dregion->rg_Rects, &sregion->rg_Rects,
+		REGION_OP_AND);
 }
 
 TLIBAPI TBOOL region_intersect(TINT *d, TINT *s)
@@ -434,56 +687,8 @@ TLIBAPI TBOOL region_intersect(TINT *d, TINT *s)
 TLIBAPI TBOOL region_xorrect(struct RectPool *pool, struct Region *region,
 	RECTINT s[])
 {
-	struct TNode *next, *node;
-	TBOOL success;
-	struct RectList r1, r2;
-	
-	region_initrectlist(&r1);
-	region_initrectlist(&r2);
-
-	success = region_insertrect(pool, &r2, s[0], s[1], s[2], s[3]);
-
-	node = region->rg_Rects.rl_List.tlh_Head.tln_Succ;
-	for (; success && (next = node->tln_Succ); node = next)
-	{
-		struct TNode *next2, *node2;
-		struct RectNode *rn = (struct RectNode *) node;
-		struct RectList temp;
-
-		region_initrectlist(&temp);
-		success = region_cutrect(pool, &temp, rn->rn_Rect, s);
-
-		node2 = temp.rl_List.tlh_Head.tln_Succ;
-		for (; success && (next2 = node2->tln_Succ); node2 = next2)
-		{
-			struct RectNode *rn2 = (struct RectNode *) node2;
-			success = region_insertrect(pool, &r1, rn2->rn_Rect[0],
-				rn2->rn_Rect[1], rn2->rn_Rect[2], rn2->rn_Rect[3]);
-		}
-		
-		region_freerects(pool, &temp);
-
-		if (success)
-		{
-			success = region_cutrectlist(pool, &r2, &temp, rn->rn_Rect);
-			region_freerects(pool, &r2);
-			region_relinkrects(&r2, &temp);
-		}
-	}
-
-	if (success)
-	{
-		region_freerects(pool, &region->rg_Rects);
-		region_relinkrects(&region->rg_Rects, &r1);
-		region_orregion(region, &r2, TFALSE);
-		region_freerects(pool, &r2);
-	}
-	else
-	{
-		region_freerects(pool, &r1);
-		region_freerects(pool, &r2);
-	}
-	return success;
+	return region_rectop(pool, &region->rg_Rects, s[0], s[1], s[2], s[3],
+		REGION_OP_XOR);
 }
 
 TLIBAPI TBOOL region_isempty(struct RectPool *pool, struct Region *region)
@@ -561,16 +766,37 @@ TLIBAPI TBOOL region_orrect(struct RectPool *pool, struct Region *region,
 
 TLIBAPI void region_initpool(struct RectPool *pool, TAPTR TExecBase)
 {
+	int i;
 	region_initrectlist(&pool->p_Rects);
 	pool->p_ExecBase = TExecBase;
+	pool->p_Slabs = TNULL;
+	pool->p_NumSlabs = 0;
+	pool->p_NumNodes = 0;
+	pool->p_NumLive = 0;
+	pool->p_MaxLive = 0;
+	for (i = 0; i < REGION_NUMBANDS; ++i)
+	{
+		pool->p_Bands[i].rb_Rects = TNULL;
+		pool->p_Bands[i].rb_NumRects = 0;
+		pool->p_Bands[i].rb_MaxRects = 0;
+	}
 }
 
 TLIBAPI void region_destroypool(struct RectPool *pool)
 {
 	TAPTR TExecBase = pool->p_ExecBase;
-	struct TNode *next, *node = pool->p_Rects.rl_List.tlh_Head.tln_Succ;
-	for (; (next = node->tln_Succ); node = next)
-		TFree(node);
+	struct RectSlab *slab = pool->p_Slabs;
+	int i;
+	TDBPRINTF(TDB_TRACE,("rect pool: %d slabs, %d nodes, max %d in use\n",
+		pool->p_NumSlabs, pool->p_NumNodes, pool->p_MaxLive));
+	while (slab)
+	{
+		struct RectSlab *next = slab->rs_Next;
+		TFree(slab);
+		slab = next;
+	}
+	for (i = 0; i < REGION_NUMBANDS; ++i)
+		TFree(pool->p_Bands[i].rb_Rects);
 }
 
 TLIBAPI void region_shift(struct Region *region, TINT sx, TINT sy)
@@ -4,6 +4,8 @@
 
 /*****************************************************************************/
 
+static void visi_reclaimbatches(struct TVisualBase *inst);
+
 static struct TVRequest *visi_getreq(struct TVisualBase *inst, TUINT cmd,
 	struct TDisplayBase *display, TTAGITEM *tags)
 {
@@ -49,6 +51,14 @@ static struct TVRequest *visi_getreq(struct TVisualBase *inst, TUINT cmd,
 				}
 			}
 
+			if (req == TNULL && (inst->vis_Flags & TVISFL_CMDBUFFER) &&
+				inst->vis_NumRequests >= VISUAL_MAXREQPERBUFFER)
+			{
+				/* requests are held by the batches; reclaim them: */
+				visi_reclaimbatches(inst);
+				req = (struct TVRequest *) TRemHead(&inst->vis_ReqPool);
+			}
+
 			if (req == TNULL)
 			{
 				req = TDisplayAllocReq(display);
@@ -79,10 +89,165 @@ visi_ungetreq(struct TVisualBase *mod, struct TVRequest *req)
 		TAddTail(&mod->vis_ReqPool, &req->tvr_Req.io_Node);
 }
 
+/*****************************************************************************/
+/*
+**	Command buffering: In an instance opened with TVisual_CmdBuffer,
+**	asynchronous commands are collected in a batch and sent to the display
+**	as a single TVCMD_BATCH request - when the batch is full, before a
+**	synchronous request, or in vis_flush(). Two batches are alternating,
+**	so that one can be filled while the display is processing the other.
+**	Requests in batches count against the instance's request limit.
+**	Before a font is closed, the batches of all instances are submitted,
+**	see vis_flushinstances(); the batches are therefore guarded by a lock.
+*/
+
+static void
+visi_reclaimbatch(struct TVisualBase *inst, struct vis_Batch *b)
+{
+	struct TExecBase *TExecBase = TGetExecBase(inst);
+	TLock(inst->vis_BatchLock);
+	if (b->vb_Pending)
+	{
+		struct TVRequest *breq = b->vb_Request;
+		struct TNode *node;
+		TWaitIO(&breq->tvr_Req);
+		while ((node = TRemHead(&breq->tvr_Op.Batch.Commands)))
+			TAddTail(&inst->vis_ReqPool, node);
+		breq->tvr_Op.Batch.Num = 0;
+		b->vb_TextLen = 0;
+		b->vb_Pending = TFALSE;
+	}
+	TUnlock(inst->vis_BatchLock);
+}
+
+static struct vis_Batch *
+visi_getbatch(struct TVisualBase *inst)
+{
+	struct vis_Batch *b = &inst->vis_Batch[inst->vis_CurBatch];
+	visi_reclaimbatch(inst, b);
+	if (b->vb_Request == TNULL)
+	{
+		struct TVRequest *breq = TDisplayAllocReq(inst->vis_Display);
+		if (breq == TNULL)
+			return TNULL;
+		breq->tvr_Req.io_Command = TVCMD_BATCH;
+		breq->tvr_Req.io_ReplyPort = inst->vis_CmdRPort;
+		breq->tvr_Op.Batch.Window = inst->vis_Window;
+		TInitList(&breq->tvr_Op.Batch.Commands);
+		breq->tvr_Op.Batch.Num = 0;
+		b->vb_Request = breq;
+	}
+	return b;
+}
+
+static void
+visi_submitbatch(struct TVisualBase *inst)
+{
+	struct TExecBase *TExecBase = TGetExecBase(inst);
+	struct vis_Batch *b;
+	TLock(inst->vis_BatchLock);
+	b = &inst->vis_Batch[inst->vis_CurBatch];
+	if (b->vb_Request && b->vb_Request->tvr_Op.Batch.Num > 0)
+	{
+		TPutIO(&b->vb_Request->tvr_Req);
+		b->vb_Pending = TTRUE;
+		inst->vis_CurBatch ^= 1;
+	}
+	TUnlock(inst->vis_BatchLock);
+}
+
+static void
+visi_reclaimbatches(struct TVisualBase *inst)
+{
+	struct TExecBase *TExecBase = TGetExecBase(inst);
+	TLock(inst->vis_BatchLock);
+	visi_submitbatch(inst);
+	visi_reclaimbatch(inst, &inst->vis_Batch[0]);
+	visi_reclaimbatch(inst, &inst->vis_Batch[1]);
+	TUnlock(inst->vis_BatchLock);
+}
+
+static TSTRPTR
+visi_batchtext(struct TVisualBase *inst, TSTRPTR text, TUINT len)
+{
+	struct TExecBase *TExecBase = TGetExecBase(inst);
+	struct vis_Batch *b;
+	TSTRPTR copy;
+
+	if (len >= VISUAL_BATCHTEXTSIZE)
+		return TNULL;
+	TLock(inst->vis_BatchLock);
+	b = visi_getbatch(inst);
+	if (b && b->vb_TextLen + len + 1 > VISUAL_BATCHTEXTSIZE)
+	{
+		visi_submitbatch(inst);
+		b = visi_getbatch(inst);
+	}
+	if (b && b->vb_Text == TNULL)
+		b->vb_Text = TAlloc(TNULL, VISUAL_BATCHTEXTSIZE);
+	if (b == TNULL || b->vb_Text == TNULL)
+	{
+		TUnlock(inst->vis_BatchLock);
+		return TNULL;
+	}
+	copy = (TSTRPTR) b->vb_Text + b->vb_TextLen;
+	TCopyMem(text, copy, len);
+	copy[len] = 0;
+	b->vb_TextLen += len + 1;
+	TUnlock(inst->vis_BatchLock);
+	return copy;
+}
+
+LOCAL void vis_freebatches(struct TVisualBase *inst)
+{
+	struct TExecBase *TExecBase = TGetExecBase(inst);
+	TINT i;
+	if (!(inst->vis_Flags & TVISFL_CMDBUFFER))
+		return;
+	for (i = 0; i < 2; ++i)
+	{
+		struct vis_Batch *b = &inst->vis_Batch[i];
+		visi_reclaimbatch(inst, b);
+		if (b->vb_Request)
+		{
+			struct TNode *node;
+			while ((node = TRemHead(&b->vb_Request->tvr_Op.Batch.Commands)))
+				TAddTail(&inst->vis_ReqPool, node);
+			TDisplayFreeReq(inst->vis_Display, b->vb_Request);
+			b->vb_Request = TNULL;
+		}
+		TFree(b->vb_Text);
+		b->vb_Text = TNULL;
+	}
+}
+
+/*
+**	Submit the batches of all instances. The display processes requests in
+**	the order of their arrival, so commands in these batches are executed
+**	before any request sent after this function returns.
+*/
+
+LOCAL void vis_flushinstances(struct TVisualBase *mod)
+{
+	struct TVisualBase *base =
+		(struct TVisualBase *) mod->vis_Module.tmd_ModSuper;
+	struct TExecBase *TExecBase = TGetExecBase(base);
+	struct TNode *node, *next;
+	TLock(base->vis_Lock);
+	node = base->vis_Instances.tlh_Head.tln_Succ;
+	for (; (next = node->tln_Succ); node = next)
+		visi_submitbatch(((struct vis_InstanceNode *) node)->vin_Visual);
+	TUnlock(base->vis_Lock);
+}
+
+/*****************************************************************************/
+
 static void
 visi_dosync(struct TVisualBase *mod, struct TVRequest *req)
 {
 	struct TExecBase *TExecBase = TGetExecBase(mod);
+	if (mod->vis_Flags & TVISFL_CMDBUFFER)
+		visi_submitbatch(mod);
 	TDoIO(&req->tvr_Req);
 	visi_ungetreq(mod, req);
 }
@@ -91,6 +256,22 @@ static void
 visi_doasync(struct TVisualBase *mod, struct TVRequest *req)
 {
 	struct TExecBase *TExecBase = TGetExecBase(mod);
+	if (mod->vis_Flags & TVISFL_CMDBUFFER)
+	{
+		struct vis_Batch *b;
+		TLock(mod->vis_BatchLock);
+		b = visi_getbatch(mod);
+		if (b)
+		{
+			struct TVRequest *breq = b->vb_Request;
+			TAddTail(&breq->tvr_Op.Batch.Commands, &req->tvr_Req.io_Node);
+			if (++breq->tvr_Op.Batch.Num >= VISUAL_MAXBATCHCMDS)
+				visi_submitbatch(mod);
+			TUnlock(mod->vis_BatchLock);
+			return;
+		}
+		TUnlock(mod->vis_BatchLock);
+	}
 	TPutIO(&req->tvr_Req);
 	TAddTail(&mod->vis_WaitList, &req->tvr_Req.io_Node);
 }
@@ -193,6 +374,8 @@ EXPORT void vis_closefont(struct TVisualBase *mod, struct TVRequest *fontreq)
 {
 	if (fontreq)
 	{
+		/* commands using the font may be waiting in any instance: */
+		vis_flushinstances(mod);
 		fontreq->tvr_Req.io_Command = TVCMD_CLOSEFONT;
 		visi_dosync(mod, fontreq);
 	}
@@ -346,6 +529,8 @@ EXPORT void vis_setfont(struct TVisualBase *inst, struct TVRequest *fontreq)
 	if (fontreq)
 	{
 		struct TExecBase *TExecBase = TGetExecBase(inst);
+		if (inst->vis_Flags & TVISFL_CMDBUFFER)
+			visi_submitbatch(inst);
 		fontreq->tvr_Req.io_Command = TVCMD_SETFONT;
 		fontreq->tvr_Op.SetFont.Window = inst->vis_Window;
 		TDoIO(&fontreq->tvr_Req);
@@ -442,12 +627,28 @@ EXPORT void vis_text(struct TVisualBase *inst, TINT x, TINT y, TSTRPTR t,
 {
 	struct TVRequest *req = visi_getreq(inst, TVCMD_TEXT,
 		inst->vis_Display, TNULL);
+	TSTRPTR copy = TNULL;
 	req->tvr_Op.Text.Window = inst->vis_Window;
 	req->tvr_Op.Text.X = x;
 	req->tvr_Op.Text.Y = y;
 	req->tvr_Op.Text.FgPen = fg;
-	req->tvr_Op.Text.Text = t;
 	req->tvr_Op.Text.Length = l;
+	if (inst->vis_Flags & TVISFL_CMDBUFFER)
+	{
+		struct TExecBase *TExecBase = TGetExecBase(inst);
+		/* the copy must go into the same batch as the command: */
+		TLock(inst->vis_BatchLock);
+		copy = visi_batchtext(inst, t, l);
+		if (copy)
+		{
+			req->tvr_Op.Text.Text = copy;
+			visi_doasync(inst, req);
+		}
+		TUnlock(inst->vis_BatchLock);
+		if (copy)
+			return;
+	}
+	req->tvr_Op.Text.Text = t;
 	visi_dosync(inst, req);
 }
 
@@ -510,7 +711,10 @@ EXPORT void vis_setcliprect(struct TVisualBase *inst, TINT x, TINT y, TINT w,
 	req->tvr_Op.ClipRect.Rect[2] = w;
 	req->tvr_Op.ClipRect.Rect[3] = h;
 	req->tvr_Op.ClipRect.Tags = tags;
-	visi_dosync(inst, req);
+	if (tags == TNULL && (inst->vis_Flags & TVISFL_CMDBUFFER))
+		visi_doasync(inst, req);
+	else
+		visi_dosync(inst, req);
 }
 
 /*****************************************************************************/
@@ -520,7 +724,10 @@ EXPORT void vis_unsetcliprect(struct TVisualBase *inst)
 	struct TVRequest *req = visi_getreq(inst, TVCMD_UNSETCLIPRECT,
 		inst->vis_Display, TNULL);
 	req->tvr_Op.ClipRect.Window = inst->vis_Window;
-	visi_dosync(inst, req);
+	if (inst->vis_Flags & TVISFL_CMDBUFFER)
+		visi_doasync(inst, req);
+	else
+		visi_dosync(inst, req);
 }
 
 /*****************************************************************************/
@@ -658,3 +865,78 @@ EXPORT TINT vis_setselection(struct TVisualBase *inst, TSTRPTR selection,
 	visi_dosync(inst, req);
 	return 0;
 }
+
+/*****************************************************************************/
+
+EXPORT void vis_flush(struct TVisualBase *inst, TBOOL display)
+{
+	if (display)
+	{
+		struct TVRequest *req = visi_getreq(inst, TVCMD_FLUSH,
+			inst->vis_Display, TNULL);
+		if (req == TNULL)
+			return;
+		req->tvr_Op.Flush.Window = inst->vis_Window;
+		req->tvr_Op.Flush.Rect[0] = 0;
+		req->tvr_Op.Flush.Rect[1] = 0;
+		req->tvr_Op.Flush.Rect[2] = -1;
+		req->tvr_Op.Flush.Rect[3] = -1;
+		if (inst->vis_Flags & TVISFL_CMDBUFFER)
+		{
+			struct TExecBase *TExecBase = TGetExecBase(inst);
+			/* flush as the last command of the batch, then wait: */
+			TLock(inst->vis_BatchLock);
+			visi_doasync(inst, req);
+			visi_submitbatch(inst);
+			visi_reclaimbatch(inst, &inst->vis_Batch[inst->vis_CurBatch ^ 1]);
+			TUnlock(inst->vis_BatchLock);
+		}
+		else
+			visi_dosync(inst, req);
+	}
+	else if (inst->vis_Flags & TVISFL_CMDBUFFER)
+		visi_submitbatch(inst);
+}
+
+/*****************************************************************************/
+
+EXPORT TAPTR vis_allocbuffer(struct TVisualBase *inst, TAPTR buf, TINT w,
+	TINT h, TINT totw, TTAGITEM *tags)
+{
+	TAPTR handle = TNULL;
+	struct TVRequest *req = visi_getreq(inst, TVCMD_ALLOCBUFFER,
+		inst->vis_Display, TNULL);
+	if (req)
+	{
+		struct TExecBase *TExecBase = TGetExecBase(inst);
+		req->tvr_Op.AllocBuffer.Window = inst->vis_Window;
+		req->tvr_Op.AllocBuffer.Buf = buf;
+		req->tvr_Op.AllocBuffer.Width = w;
+		req->tvr_Op.AllocBuffer.Height = h;
+		req->tvr_Op.AllocBuffer.TotWidth = totw;
+		req->tvr_Op.AllocBuffer.Tags = tags;
+		req->tvr_Op.AllocBuffer.Handle = TNULL;
+		if (inst->vis_Flags & TVISFL_CMDBUFFER)
+			visi_submitbatch(inst);
+		TDoIO(&req->tvr_Req);
+		handle = req->tvr_Op.AllocBuffer.Handle;
+		visi_ungetreq(inst, req);
+	}
+	return handle;
+}
+
+/*****************************************************************************/
+
+EXPORT void vis_freebuffer(struct TVisualBase *mod, TAPTR handle)
+{
+	if (handle)
+	{
+		struct TVRequest *req = visi_getreq(mod, TVCMD_FREEBUFFER,
+			TGetOwner(handle), TNULL);
+		if (req)
+		{
+			req->tvr_Op.FreeBuffer.Handle = handle;
+			visi_dosync(mod, req);
+		}
+	}
+}
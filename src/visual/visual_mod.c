@@ -65,6 +65,10 @@ vis_vectors[VISUAL_NUMVECTORS] =
 	
 	(TMFPTR) vis_getselection,
 	(TMFPTR) vis_setselection,
+
+	(TMFPTR) vis_flush,
+	(TMFPTR) vis_allocbuffer,
+	(TMFPTR) vis_freebuffer,
 };
 
 static void
@@ -169,6 +173,16 @@ vis_modopen(struct TVisualBase *mod, TTAGITEM *tags)
 				TInitList(&inst->vis_ReqPool);
 				TInitList(&inst->vis_WaitList);
 
+				TFillMem(inst->vis_Batch, sizeof inst->vis_Batch, 0);
+				inst->vis_CurBatch = 0;
+				inst->vis_BatchLock = TNULL;
+				if (TGetTag(tags, TVisual_CmdBuffer, TFALSE))
+				{
+					inst->vis_BatchLock = TCreateLock(TNULL);
+					if (inst->vis_BatchLock)
+						inst->vis_Flags |= TVISFL_CMDBUFFER;
+				}
+
 				inst->vis_IMsgPort = (struct TMsgPort *)
 					TGetTag(tags, TVisual_IMsgPort, TNULL);
 				if (inst->vis_IMsgPort == TNULL)
@@ -181,16 +195,30 @@ vis_modopen(struct TVisualBase *mod, TTAGITEM *tags)
 					TGetTag(tags, TVisual_CmdRPort, TNULL);
 				if (inst->vis_CmdRPort == TNULL)
 				{
-					inst->vis_CmdRPort = TCreatePort(TNULL);
+					TTAGITEM ptags[2];
+					ptags[0].tti_Tag = TMsgPort_LockFree;
+					ptags[0].tti_Value = TTRUE;
+					ptags[1].tti_Tag = TTAG_DONE;
+					inst->vis_CmdRPort = TCreatePort(ptags);
 					inst->vis_Flags |= TVISFL_CMDRPORT_OWNER;
 				}
 
 				if (inst->vis_IMsgPort == TNULL || inst->vis_CmdRPort == TNULL)
 				{
 					vis_destroyports(inst);
+					TDestroy(inst->vis_BatchLock);
 					TFreeInstance(&inst->vis_Module);
 					inst = TNULL;
 				}
+				else if (inst->vis_Flags & TVISFL_CMDBUFFER)
+				{
+					/* register for vis_flushinstances(): */
+					inst->vis_InstanceNode.vin_Visual = inst;
+					TLock(mod->vis_Lock);
+					TAddTail(&mod->vis_Instances,
+						&inst->vis_InstanceNode.vin_Node);
+					TUnlock(mod->vis_Lock);
+				}
 			}
 			if (inst == TNULL)
 				vis_modclose(mod);
@@ -225,6 +253,15 @@ vis_modclose(struct TVisualBase *inst)
 				TDBPRINTF(TDB_WARN,("freed %d pending input message\n", n));
 		}
 
+		if (inst->vis_Flags & TVISFL_CMDBUFFER)
+		{
+			TLock(mod->vis_Lock);
+			TRemove(&inst->vis_InstanceNode.vin_Node);
+			TUnlock(mod->vis_Lock);
+		}
+
+		vis_freebatches(inst);
+
 		while ((node = TRemHead(&inst->vis_ReqPool)))
 			TFree(node);
 
@@ -235,6 +272,7 @@ vis_modclose(struct TVisualBase *inst)
 		}
 
 		vis_destroyports(inst);
+		TDestroy(inst->vis_BatchLock);
 		TFreeInstance(&inst->vis_Module);
 	}
 	TLock(mod->vis_Lock);
@@ -252,6 +290,7 @@ static TBOOL
 vis_init(struct TVisualBase *mod)
 {
 	TInitList(&mod->vis_Displays);
+	TInitList(&mod->vis_Instances);
 	return TTRUE;
 }
 
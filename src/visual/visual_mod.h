@@ -17,8 +17,8 @@
 /*****************************************************************************/
 
 #define VISUAL_VERSION		5
-#define VISUAL_REVISION		0
-#define VISUAL_NUMVECTORS	43
+#define VISUAL_REVISION		2
+#define VISUAL_NUMVECTORS	46
 
 #ifndef LOCAL
 #define LOCAL
@@ -30,6 +30,14 @@
 
 #define VISUAL_MAXREQPERINSTANCE	64
 
+/* Max. number of commands and bytes of text in a command buffer: */
+#define VISUAL_MAXBATCHCMDS			256
+#define VISUAL_BATCHTEXTSIZE		8192
+
+/* Requests held by an instance with command buffers, including batches: */
+#define VISUAL_MAXREQPERBUFFER \
+	(VISUAL_MAXREQPERINSTANCE + 2 * VISUAL_MAXBATCHCMDS)
+
 #if defined(TSYS_WINNT)
 #define DEF_DISPLAYNAME	"display_windows"
 #else
@@ -49,6 +57,24 @@ struct vis_FontQueryHandle
 	struct THandle vfq_Handle;
 };
 
+struct vis_Batch
+{
+	/* TVCMD_BATCH request carrying the commands: */
+	struct TVRequest *vb_Request;
+	/* Buffer holding copies of texts referenced by the commands: */
+	TUINT8 *vb_Text;
+	/* Number of bytes used in the text buffer: */
+	TSIZE vb_TextLen;
+	/* Batch request is in progress: */
+	TBOOL vb_Pending;
+};
+
+struct vis_InstanceNode
+{
+	struct TNode vin_Node;
+	struct TVisualBase *vin_Visual;
+};
+
 struct TVisualBase
 {
 	/* Module header: */
@@ -82,10 +108,21 @@ struct TVisualBase
 	struct TList vis_WaitList;
 	/* Number of requests allocated so far: */
 	TINT vis_NumRequests;
+	/* Command buffers, one being filled while the other is in progress: */
+	struct vis_Batch vis_Batch[2];
+	/* Index of the command buffer currently being filled: */
+	TINT vis_CurBatch;
+	/* Locking for the command buffers, which other instances may flush: */
+	TAPTR vis_BatchLock;
+	/* Node in the base's list of instances with command buffers: */
+	struct vis_InstanceNode vis_InstanceNode;
+	/* Base only: list of instances with command buffers: */
+	struct TList vis_Instances;
 };
 
 #define TVISFL_CMDRPORT_OWNER	0x0001
 #define TVISFL_IMSGPORT_OWNER	0x0002
+#define TVISFL_CMDBUFFER		0x0004
 
 /*****************************************************************************/
 
@@ -143,5 +180,12 @@ EXPORT void vis_drawbuffer(struct TVisualBase *inst,
 
 EXPORT TAPTR vis_getselection(struct TVisualBase *inst, TTAGITEM *tags);
 EXPORT TINT vis_setselection(struct TVisualBase *inst, TSTRPTR sel, TSIZE len, TTAGITEM *tags);
+EXPORT void vis_flush(struct TVisualBase *inst, TBOOL display);
+EXPORT TAPTR vis_allocbuffer(struct TVisualBase *inst, TAPTR buf, TINT w,
+	TINT h, TINT totw, TTAGITEM *tags);
+EXPORT void vis_freebuffer(struct TVisualBase *mod, TAPTR handle);
+
+LOCAL void vis_freebatches(struct TVisualBase *inst);
+LOCAL void vis_flushinstances(struct TVisualBase *mod);
 
 #endif
@@ -0,0 +1,111 @@
+-------------------------------------------------------------------------------
+--
+--	tek.class.nativelist
+--	Written by agent <agent at local>
+--	See copyright notice in COPYRIGHT
+--
+--	OVERVIEW::
+--		[[#ClassOverview]] :
+--		[[#tek.class : Class]] / [[#tek.class.list : List]] /
+--		NativeList ${subclasses(NativeList)}
+--
+--		This class implements a list container with the items stored in
+--		native memory, see [[#tek.lib.list : ListStore]]. It is intended
+--		for lists with large numbers of items, which are expensive to hold
+--		in Lua tables and to traverse for the garbage collector.
+--
+--		Items are of the form
+--
+--				{ { "column1", "column2", ... }, userdata, selected }
+--
+--		with all columns being strings. An item returned by
+--		NativeList:getItem() refers to the stored item; its text can only
+--		be modified using NativeList:changeItem(). It becomes invalid when
+--		items are added to or removed from the list.
+--
+--	ATTRIBUTES::
+--		- {{Items}} [I] (table)
+--			Table of initial list items, indexed numerically. They are
+--			transferred to native storage, the table is not retained.
+--
+--	OVERRIDES::
+--		- List:addItem()
+--		- List:changeItem()
+--		- List:clear()
+--		- List:getItem()
+--		- List:getN()
+--		- Class.new()
+--		- List:remItem()
+--
+-------------------------------------------------------------------------------
+
+local List = require "tek.class.list"
+local ListStore = require "tek.lib.list"
+
+local NativeList = List.module("tek.class.nativelist", "tek.class.list")
+NativeList._VERSION = "NativeList 1.0"
+
+-------------------------------------------------------------------------------
+--	new: overrides
+-------------------------------------------------------------------------------
+
+function NativeList.new(class, self)
+	self = self or { }
+	local items = self.Items
+	self.Items = nil
+	self.Store = ListStore.new()
+	if items then
+		self.Store:addItems(items)
+	end
+	return List.new(class, self)
+end
+
+-------------------------------------------------------------------------------
+--	getN: overrides
+-------------------------------------------------------------------------------
+
+function NativeList:getN()
+	return self.Store:getN()
+end
+
+-------------------------------------------------------------------------------
+--	getItem: overrides
+-------------------------------------------------------------------------------
+
+function NativeList:getItem(lnr)
+	return self.Store:getItem(lnr)
+end
+
+-------------------------------------------------------------------------------
+--	addItem: overrides
+-------------------------------------------------------------------------------
+
+function NativeList:addItem(entry, lnr)
+	return self.Store:addItem(entry, lnr)
+end
+
+-------------------------------------------------------------------------------
+--	remItem: overrides
+-------------------------------------------------------------------------------
+
+function NativeList:remItem(lnr)
+	return self.Store:remItem(lnr)
+end
+
+-------------------------------------------------------------------------------
+--	changeItem: overrides
+-------------------------------------------------------------------------------
+
+function NativeList:changeItem(entry, lnr)
+	return self.Store:changeItem(entry, lnr)
+end
+
+-------------------------------------------------------------------------------
+--	clear: overrides
+-------------------------------------------------------------------------------
+
+function NativeList:clear()
+	self.Store:clear()
+end
+
+return NativeList
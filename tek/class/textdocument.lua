@@ -0,0 +1,391 @@
+-------------------------------------------------------------------------------
+--
+--	tek.class.textdocument
+--	Written by agent <agent at local>
+--	See copyright notice in COPYRIGHT
+--
+--	OVERVIEW::
+--		[[#ClassOverview]] :
+--		[[#tek.class : Class]] / [[#tek.class.list : List]] /
+--		TextDocument ${subclasses(TextDocument)}
+--
+--		This class implements a list of text lines, as used by the
+--		[[#tek.ui.class.textedit : TextEdit]] class. The initial lines can
+--		be provided by a [[#tek.lib.textfile : TextFile]]. A line of the
+--		file is read when it is accessed for the first time, and from then
+--		on held in memory, like items added to the document.
+--
+--		The document is stored as a table of pieces. A piece is either a
+--		run of consecutive lines of the file, or a block of items in
+--		memory. The number of pieces grows with the number of edits and
+--		regions of the file accessed, not with the number of lines.
+--		Blocks are limited in size, so that adding and removing items
+--		does not shift large tables.
+--
+--	ATTRIBUTES::
+--		- {{File}} [I] (userdata)
+--			A [[#tek.lib.textfile : TextFile]] providing the initial lines.
+--			If specified, {{Items}} is ignored.
+--		- {{Items}} [I] (table)
+--			Table of initial items, indexed numerically
+--
+--	IMPLEMENTS::
+--		- TextDocument:closeFile() - Reads the remaining lines and closes the file
+--		- TextDocument:findItem() - Finds the next candidate for a search
+--		- TextDocument:forEachLoaded() - Calls a function for items in memory
+--
+--	OVERRIDES::
+--		- List:addItem()
+--		- List:changeItem()
+--		- List:clear()
+--		- List:getItem()
+--		- List:getN()
+--		- Class.new()
+--		- List:remItem()
+--
+-------------------------------------------------------------------------------
+
+local List = require "tek.class.list"
+local floor = math.floor
+local insert = table.insert
+local max = math.max
+local min = math.min
+local remove = table.remove
+
+local TextDocument = List.module("tek.class.textdocument", "tek.class.list")
+TextDocument._VERSION = "TextDocument 1.0"
+
+-- maximum number of items in a block:
+local MAXBLOCK = 512
+
+-------------------------------------------------------------------------------
+--	pieces: a run of lines of the file is a table { Line = first, N = num },
+--	a block is a table of items indexed numerically.
+-------------------------------------------------------------------------------
+
+local function piecelen(p)
+	return p.N or #p
+end
+
+-- find the piece holding an item; returns the index of the piece, the
+-- position of the item in the piece, and the position of the piece's first
+-- item. The position of the last piece found is kept as a hint.
+local function locate(self, lnr)
+	local pieces = self.Pieces
+	local i, pos = self.HintPiece, self.HintPos
+	if lnr * 2 < pos then
+		i, pos = 1, 1
+	end
+	while lnr < pos do
+		i = i - 1
+		pos = pos - piecelen(pieces[i])
+	end
+	local n = piecelen(pieces[i])
+	while lnr >= pos + n do
+		pos = pos + n
+		i = i + 1
+		n = piecelen(pieces[i])
+	end
+	self.HintPiece, self.HintPos = i, pos
+	return i, lnr - pos + 1, pos
+end
+
+local function sethint(self, i, pos)
+	if self.Pieces[i] then
+		self.HintPiece, self.HintPos = i, pos
+	else
+		self.HintPiece, self.HintPos = 1, 1
+	end
+end
+
+-- cut a run in two before its line at position o:
+local function splitrun(pieces, i, o)
+	local p = pieces[i]
+	insert(pieces, i + 1, { Line = p.Line + o - 1, N = p.N - o + 1 })
+	p.N = o - 1
+end
+
+-------------------------------------------------------------------------------
+--	new: overrides
+-------------------------------------------------------------------------------
+
+function TextDocument.new(class, self)
+	self = self or { }
+	self.File = self.File or false
+	local pieces = { }
+	local n = 0
+	if self.File then
+		n = self.File:getN()
+		pieces[1] = { Line = 1, N = n }
+	elseif self.Items then
+		local items = self.Items
+		n = #items
+		for i = 1, n, MAXBLOCK do
+			local b = { }
+			for j = i, min(i + MAXBLOCK - 1, n) do
+				b[j - i + 1] = items[j]
+			end
+			insert(pieces, b)
+		end
+	end
+	self.Items = nil
+	self.Pieces = pieces
+	self.NumItems = n
+	self.HintPiece = 1
+	self.HintPos = 1
+	return List.new(class, self)
+end
+
+-------------------------------------------------------------------------------
+--	getN: overrides
+-------------------------------------------------------------------------------
+
+function TextDocument:getN()
+	return self.NumItems
+end
+
+-------------------------------------------------------------------------------
+--	item = TextDocument:getItem(pos[, peek]): overrides. A line of the file
+--	is returned as a string. Unless {{peek}} is '''true''', it is held in
+--	memory from then on.
+-------------------------------------------------------------------------------
+
+function TextDocument:getItem(lnr, peek)
+	if lnr < 1 or lnr > self.NumItems then
+		return
+	end
+	local pieces = self.Pieces
+	local i, o, pos = locate(self, lnr)
+	local p = pieces[i]
+	if not p.N then
+		return p[o]
+	end
+	local item = self.File:getLine(p.Line + o - 1)
+	if peek then
+		return item
+	end
+	local prev, nxt = pieces[i - 1], pieces[i + 1]
+	if o == 1 and prev and not prev.N and #prev < MAXBLOCK then
+		-- append to the preceding block:
+		insert(prev, item)
+		p.Line = p.Line + 1
+		p.N = p.N - 1
+		if p.N == 0 then
+			remove(pieces, i)
+		end
+		sethint(self, i - 1, pos - #prev + 1)
+		return item
+	end
+	if o == p.N and nxt and not nxt.N and #nxt < MAXBLOCK then
+		-- prepend to the following block:
+		insert(nxt, 1, item)
+		p.N = p.N - 1
+	else
+		if o < p.N then
+			splitrun(pieces, i, o + 1)
+		end
+		if o > 1 then
+			splitrun(pieces, i, o)
+			i = i + 1
+			pos = lnr
+		end
+		pieces[i] = { item }
+	end
+	if pieces[i].N == 0 then
+		remove(pieces, i)
+	end
+	sethint(self, i, pos)
+	return item
+end
+
+-------------------------------------------------------------------------------
+--	addItem: overrides
+-------------------------------------------------------------------------------
+
+function TextDocument:addItem(entry, lnr)
+	local n = self.NumItems
+	local pieces = self.Pieces
+	lnr = lnr and min(max(1, lnr), n + 1) or n + 1
+	self.NumItems = n + 1
+	if n == 0 then
+		self.Pieces = { { entry } }
+		sethint(self, 1, 1)
+		return lnr
+	end
+	local i, o, pos = locate(self, min(lnr, n))
+	if lnr > n then
+		o = o + 1
+	end
+	local p = pieces[i]
+	if p.N then
+		local prev = pieces[i - 1]
+		if o == 1 and prev and not prev.N and #prev < MAXBLOCK then
+			insert(prev, entry)
+			sethint(self, i - 1, pos - #prev + 1)
+			return lnr
+		end
+		if o > p.N then
+			insert(pieces, i + 1, { entry })
+		else
+			if o > 1 then
+				splitrun(pieces, i, o)
+				i = i + 1
+				pos = lnr
+			end
+			insert(pieces, i, { entry })
+		end
+	else
+		insert(p, o, entry)
+		if #p > MAXBLOCK then
+			local h = floor(#p / 2)
+			local b = { }
+			for j = h + 1, #p do
+				b[j - h] = p[j]
+			end
+			for j = #p, h + 1, -1 do
+				p[j] = nil
+			end
+			insert(pieces, i + 1, b)
+		end
+	end
+	sethint(self, i, pos)
+	return lnr
+end
+
+-------------------------------------------------------------------------------
+--	remItem: overrides
+-------------------------------------------------------------------------------
+
+function TextDocument:remItem(lnr)
+	if lnr < 1 or lnr > self.NumItems then
+		return
+	end
+	local pieces = self.Pieces
+	local i, o, pos = locate(self, lnr)
+	local p = pieces[i]
+	local item
+	if p.N then
+		item = self.File:getLine(p.Line + o - 1)
+		if o < p.N then
+			splitrun(pieces, i, o + 1)
+		end
+		p.N = p.N - 1
+	else
+		item = remove(p, o)
+	end
+	if piecelen(p) == 0 then
+		remove(pieces, i)
+	end
+	self.NumItems = self.NumItems - 1
+	sethint(self, i, pos)
+	return item
+end
+
+-------------------------------------------------------------------------------
+--	changeItem: overrides
+-------------------------------------------------------------------------------
+
+function TextDocument:changeItem(entry, lnr)
+	if lnr > 0 and lnr <= self.NumItems then
+		-- bring the item into memory:
+		self:getItem(lnr)
+		local i, o = locate(self, lnr)
+		self.Pieces[i][o] = entry
+		return true
+	end
+end
+
+-------------------------------------------------------------------------------
+--	clear: overrides
+-------------------------------------------------------------------------------
+
+function TextDocument:clear()
+	self.File = false
+	self.Pieces = { }
+	self.NumItems = 0
+	sethint(self, 1, 1)
+end
+
+-------------------------------------------------------------------------------
+--	TextDocument:closeFile(): Reads all lines of the file that are not yet
+--	held in memory, and closes the file. Afterwards, the document no longer
+--	depends on the file, which can then be overwritten.
+-------------------------------------------------------------------------------
+
+function TextDocument:closeFile()
+	local file = self.File
+	if file then
+		local pieces = { }
+		for i = 1, #self.Pieces do
+			local p = self.Pieces[i]
+			if p.N then
+				for line = p.Line, p.Line + p.N - 1, MAXBLOCK do
+					local b = { }
+					for j = line, min(line + MAXBLOCK - 1, p.Line + p.N - 1) do
+						b[j - line + 1] = file:getLine(j)
+					end
+					insert(pieces, b)
+				end
+			else
+				insert(pieces, p)
+			end
+		end
+		self.Pieces = pieces
+		self.File = false
+		sethint(self, 1, 1)
+		file:close()
+	end
+end
+
+-------------------------------------------------------------------------------
+--	TextDocument:forEachLoaded(func): Calls {{func(item, pos)}} for each item
+--	held in memory, in ascending order. The function must not add or remove
+--	items.
+-------------------------------------------------------------------------------
+
+function TextDocument:forEachLoaded(func)
+	local pos = 1
+	for i = 1, #self.Pieces do
+		local p = self.Pieces[i]
+		if p.N then
+			pos = pos + p.N
+		else
+			for o = 1, #p do
+				func(p[o], pos)
+				pos = pos + 1
+			end
+		end
+	end
+end
+
+-------------------------------------------------------------------------------
+--	pos = TextDocument:findItem(string, pos): Returns the position of the
+--	first item at or after {{pos}} that is either held in memory, or a line
+--	of the file containing the given string. Returns '''nil''' if there is
+--	no such item. This allows to search the document without reading lines
+--	that do not match.
+-------------------------------------------------------------------------------
+
+function TextDocument:findItem(search, lnr)
+	if lnr < 1 or lnr > self.NumItems then
+		return
+	end
+	local pieces = self.Pieces
+	local i, o, pos = locate(self, lnr)
+	local p = pieces[i]
+	while p do
+		if not p.N then
+			return pos + o - 1
+		end
+		local line = self.File:find(search, p.Line + o - 1, p.Line + p.N - 1)
+		if line then
+			return pos + line - p.Line
+		end
+		pos = pos + p.N
+		o = 1
+		i = i + 1
+		p = pieces[i]
+	end
+end
+
+return TextDocument
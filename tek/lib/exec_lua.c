@@ -133,6 +133,7 @@ struct LuaExecChild
 	int chunklen, status, luastatus, ref, numargs, numres;
 	char *fname;
 	struct LuaTaskArgs *args, *results;
+	struct TMemManager *msgpool;
 	TBOOL abort;
 };
 
@@ -731,7 +732,7 @@ static int tek_lib_exec_run(lua_State *L)
 	const char *taskname = TNULL;
 	size_t extralen = 0;
 	struct THook hook;
-	TTAGITEM tags[2];
+	TTAGITEM tags[3];
 	int nremove = 1;
 	TBOOL abort = TTRUE;
 	
@@ -822,13 +823,20 @@ static int tek_lib_exec_run(lua_State *L)
 		luaL_error(L, "cannot create interpreter");
 	}
 	
+	/* recycle the messages sent by the child */
+	ctx->msgpool = TCreateMemManager(TNULL, TMMT_Message, TNULL);
+	
 	tags[0].tti_Tag = TTask_UserData;
 	tags[0].tti_Value = (TTAG) ctx;
-	tags[1].tti_Tag = TTAG_DONE;
+	tags[1].tti_Tag = TTask_MsgMemManager;
+	tags[1].tti_Value = (TTAG) ctx->msgpool;
+	tags[2].tti_Tag = TTAG_DONE;
 	TInitHook(&hook, tek_lib_exec_run_dispatch, ctx);
 	ctx->task = TCreateTask(&hook, tags);
 	if (ctx->task == TNULL)
 	{
+		TDestroy((struct THandle *) ctx->msgpool);
+		ctx->msgpool = TNULL;
 		tek_lib_exec_freectxargs(ctx);
 		lua_pop(L, 1);
 		lua_pushnil(L);
@@ -983,6 +991,9 @@ static int tek_lib_exec_child_sigjoin(lua_State *L, TUINT sig, TBOOL sigparent,
 	TFreeTask(task);
 	
 	ctx->task = TNULL;
+	/* freed when the last of its messages is freed */
+	TDestroy((struct THandle *) ctx->msgpool);
+	ctx->msgpool = TNULL;
 	tek_lib_exec_freectxargs(ctx);
 	if (!abort && do_results)
 	{
@@ -54,6 +54,8 @@ static const luaL_Reg lualibs2[] = {
 #endif
   { "tek.lib.visual", luaopen_tek_lib_visual },
   { "tek.lib.support", luaopen_tek_lib_support },
+  { "tek.lib.list", luaopen_tek_lib_list },
+  { "tek.lib.textfile", luaopen_tek_lib_textfile },
   { "tek.ui.layout.default", luaopen_tek_ui_layout_default },
   { "tek.ui.class.area", luaopen_tek_ui_class_area },
   { "tek.ui.class.frame", luaopen_tek_ui_class_frame },
@@ -95,6 +95,8 @@
 #include "region.c"
 #include "string.c"
 #include "support.c"
+#include "list.c"
+#include "textfile.c"
 
 #include "../../src/misc/utf8.c"
 #include "../../src/misc/region.c"
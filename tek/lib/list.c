@@ -0,0 +1,807 @@
+/*-----------------------------------------------------------------------------
+--
+--	tek.lib.list
+--	Written by agent <agent at local>
+--	See copyright notice in COPYRIGHT
+--
+--	OVERVIEW::
+--		Native storage for the items of a list or table, as used by
+--		[[#tek.class.nativelist : NativeList]]. The cells of each column
+--		are stored as UTF-8 text in one buffer per column, the selection
+--		state of all items in a bitset. An item is returned as a table
+--
+--				{ { "column1", "column2", ... }, userdata, selected, ... }
+--
+--		like the items of a [[#tek.class.list : List]]. The columns table
+--		is a copy; to change the text of an item, use ListStore:changeItem().
+--		The other fields are read from and written to the store, as long as
+--		the list is not modified by adding or removing items. An item
+--		returned by ListStore:remItem() is a plain table.
+--
+--		The field {{entry[4]}} is read-only. It holds a number identifying
+--		the stored item, which remains the same while other items are added
+--		or removed, and is not reused. A [[#tek.ui.class.lister : Lister]]
+--		uses it to recognize the items it has measured.
+--
+--	FUNCTIONS::
+--		- ListStore:addItem() - Adds an item
+--		- ListStore:addItems() - Adds a number of items
+--		- ListStore:changeItem() - Replaces an item
+--		- ListStore:clear() - Removes all items
+--		- ListStore:getItem() - Returns the item at the specified position
+--		- ListStore:getN() - Returns the number of items
+--		- ListStore.new() - Creates a new, empty store
+--		- ListStore:remItem() - Removes an item
+--
+-------------------------------------------------------------------------------
+
+module "tek.lib.list"
+_VERSION = "ListStore 1.1"
+local ListStore = _M
+
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tek/lib/tek_lua.h>
+#include <tek/teklib.h>
+#include <tek/lib/tekui.h>
+
+#define TEK_LIB_LIST_VERSION	"ListStore 1.1"
+#define TEK_LIB_LIST_NAME		"tek.lib.list"
+#define TEK_LIB_LIST_ITEM_NAME	"tek.lib.list.item"
+
+/* minimum number of items to allocate: */
+#define MINROWS			64
+/* garbage text bytes in a column before it is compacted: */
+#define COMPACT_MIN		4096
+
+/* hidden fields of an item table, referring to the store and position: */
+#define ITEM_STORE		0
+#define ITEM_ROW		-1
+
+/*****************************************************************************/
+
+struct tek_list_cell
+{
+	size_t lc_Offset;		/* offset of text in column buffer */
+	int32_t lc_Length;		/* length of text, -1 if no cell */
+};
+
+struct tek_list_column
+{
+	struct tek_list_cell *lcl_Cells;
+	char *lcl_Text;
+	size_t lcl_TextLength;	/* bytes used in text buffer */
+	size_t lcl_TextAlloc;	/* bytes allocated for text buffer */
+	size_t lcl_Garbage;		/* bytes no longer referenced by cells */
+};
+
+typedef struct
+{
+	struct tek_list_column *tl_Columns;
+	int tl_NumColumns;
+	size_t tl_NumRows;
+	size_t tl_AllocRows;
+	int *tl_Data;			/* references to userdata fields */
+	lua_Integer *tl_Keys;	/* numbers identifying the items */
+	lua_Integer tl_LastKey;	/* last number assigned to an item */
+	uint32_t *tl_Selected;	/* selection bitset */
+} tek_list;
+
+/*****************************************************************************/
+
+static int getbit(const uint32_t *bits, size_t i)
+{
+	return (bits[i >> 5] >> (i & 31)) & 1;
+}
+
+static void setbit(uint32_t *bits, size_t i, int on)
+{
+	if (on)
+		bits[i >> 5] |= (uint32_t) 1 << (i & 31);
+	else
+		bits[i >> 5] &= ~((uint32_t) 1 << (i & 31));
+}
+
+static void *tek_list_realloc(lua_State *L, void *mem, size_t size)
+{
+	void *newmem = realloc(mem, size);
+	if (newmem == TNULL && size > 0)
+		luaL_error(L, "out of memory");
+	return newmem;
+}
+
+/*****************************************************************************/
+/*
+**	Ensure space for the specified number of rows in all arrays
+*/
+
+static void tek_list_allocrows(lua_State *L, tek_list *l, size_t numrows)
+{
+	if (numrows > l->tl_AllocRows)
+	{
+		size_t alloc = TMAX(l->tl_AllocRows, MINROWS);
+		size_t oldwords = (l->tl_AllocRows + 31) >> 5;
+		size_t words;
+		int c;
+		while (alloc < numrows)
+			alloc <<= 1;
+		words = (alloc + 31) >> 5;
+		for (c = 0; c < l->tl_NumColumns; ++c)
+		{
+			struct tek_list_column *col = &l->tl_Columns[c];
+			col->lcl_Cells = tek_list_realloc(L, col->lcl_Cells,
+				sizeof(struct tek_list_cell) * alloc);
+		}
+		l->tl_Data = tek_list_realloc(L, l->tl_Data, sizeof(int) * alloc);
+		l->tl_Keys = tek_list_realloc(L, l->tl_Keys,
+			sizeof(lua_Integer) * alloc);
+		l->tl_Selected = tek_list_realloc(L, l->tl_Selected,
+			sizeof(uint32_t) * words);
+		memset(l->tl_Selected + oldwords, 0,
+			sizeof(uint32_t) * (words - oldwords));
+		l->tl_AllocRows = alloc;
+	}
+}
+
+/*****************************************************************************/
+/*
+**	Ensure the specified number of columns; cells of existing rows in new
+**	columns are empty
+*/
+
+static void tek_list_alloccolumns(lua_State *L, tek_list *l, int numcols)
+{
+	if (numcols > l->tl_NumColumns)
+	{
+		int c;
+		l->tl_Columns = tek_list_realloc(L, l->tl_Columns,
+			sizeof(struct tek_list_column) * numcols);
+		for (c = l->tl_NumColumns; c < numcols; ++c)
+			memset(&l->tl_Columns[c], 0, sizeof(struct tek_list_column));
+		for (c = l->tl_NumColumns; c < numcols; ++c)
+		{
+			struct tek_list_column *col = &l->tl_Columns[c];
+			size_t i;
+			/* count the column before allocating, so that it is freed: */
+			l->tl_NumColumns = c + 1;
+			col->lcl_Cells = tek_list_realloc(L, TNULL,
+				sizeof(struct tek_list_cell) * TMAX(l->tl_AllocRows, 1));
+			for (i = 0; i < l->tl_NumRows; ++i)
+				col->lcl_Cells[i].lc_Length = -1;
+		}
+	}
+}
+
+/*****************************************************************************/
+/*
+**	Discard a cell's text. The space is reclaimed when the column is
+**	compacted.
+*/
+
+static void tek_list_clearcell(struct tek_list_column *col, size_t row)
+{
+	struct tek_list_cell *cell = &col->lcl_Cells[row];
+	if (cell->lc_Length > 0)
+		col->lcl_Garbage += cell->lc_Length;
+	cell->lc_Length = -1;
+}
+
+static void tek_list_compact(lua_State *L, tek_list *l,
+	struct tek_list_column *col)
+{
+	size_t size = col->lcl_TextLength - col->lcl_Garbage;
+	char *text = tek_list_realloc(L, TNULL, TMAX(size, 1));
+	size_t pos = 0;
+	size_t i;
+	for (i = 0; i < l->tl_NumRows; ++i)
+	{
+		struct tek_list_cell *cell = &col->lcl_Cells[i];
+		if (cell->lc_Length > 0)
+		{
+			memcpy(text + pos, col->lcl_Text + cell->lc_Offset,
+				cell->lc_Length);
+			cell->lc_Offset = pos;
+			pos += cell->lc_Length;
+		}
+	}
+	free(col->lcl_Text);
+	col->lcl_Text = text;
+	col->lcl_TextLength = pos;
+	col->lcl_TextAlloc = TMAX(size, 1);
+	col->lcl_Garbage = 0;
+}
+
+static void tek_list_checkcompact(lua_State *L, tek_list *l,
+	struct tek_list_column *col)
+{
+	if (col->lcl_Garbage > COMPACT_MIN &&
+		col->lcl_Garbage > col->lcl_TextLength / 2)
+		tek_list_compact(L, l, col);
+}
+
+static void tek_list_setcell(lua_State *L, tek_list *l,
+	struct tek_list_column *col, size_t row, const char *s, size_t len)
+{
+	struct tek_list_cell *cell = &col->lcl_Cells[row];
+	tek_list_clearcell(col, row);
+	tek_list_checkcompact(L, l, col);
+	if (col->lcl_TextLength + len > col->lcl_TextAlloc)
+	{
+		size_t alloc = TMAX(col->lcl_TextAlloc, 256);
+		while (alloc < col->lcl_TextLength + len)
+			alloc <<= 1;
+		col->lcl_Text = tek_list_realloc(L, col->lcl_Text, alloc);
+		col->lcl_TextAlloc = alloc;
+	}
+	memcpy(col->lcl_Text + col->lcl_TextLength, s, len);
+	cell->lc_Offset = col->lcl_TextLength;
+	cell->lc_Length = len;
+	col->lcl_TextLength += len;
+}
+
+/*****************************************************************************/
+/*
+**	Append num empty rows. Items are always stored in new rows at the end
+**	first, because the items passed in may refer to rows of the same store.
+*/
+
+static void tek_list_appendrows(lua_State *L, tek_list *l, size_t num)
+{
+	size_t n = l->tl_NumRows;
+	size_t i;
+	int c;
+	tek_list_allocrows(L, l, n + num);
+	for (c = 0; c < l->tl_NumColumns; ++c)
+	{
+		struct tek_list_cell *cells = l->tl_Columns[c].lcl_Cells;
+		for (i = n; i < n + num; ++i)
+			cells[i].lc_Length = -1;
+	}
+	for (i = n; i < n + num; ++i)
+	{
+		l->tl_Data[i] = LUA_NOREF;
+		l->tl_Keys[i] = 0;
+		setbit(l->tl_Selected, i, 0);
+	}
+	l->tl_NumRows = n + num;
+}
+
+/*
+**	Move the last num rows to row pos
+*/
+
+static void tek_list_rotate(void *array, void *tmp, size_t elsize,
+	size_t pos, size_t move, size_t num)
+{
+	char *a = array;
+	memcpy(tmp, a + (pos + move) * elsize, num * elsize);
+	memmove(a + (pos + num) * elsize, a + pos * elsize, move * elsize);
+	memcpy(a + pos * elsize, tmp, num * elsize);
+}
+
+static void tek_list_rotaterows(lua_State *L, tek_list *l, size_t pos,
+	size_t num)
+{
+	size_t move = l->tl_NumRows - num - pos;
+	if (move > 0 && num > 0)
+	{
+		size_t elsize = TMAX(sizeof(struct tek_list_cell),
+			sizeof(lua_Integer));
+		unsigned char *tmp = tek_list_realloc(L, TNULL, elsize * num);
+		size_t i;
+		int c;
+		for (c = 0; c < l->tl_NumColumns; ++c)
+			tek_list_rotate(l->tl_Columns[c].lcl_Cells, tmp,
+				sizeof(struct tek_list_cell), pos, move, num);
+		tek_list_rotate(l->tl_Data, tmp, sizeof(int), pos, move, num);
+		tek_list_rotate(l->tl_Keys, tmp, sizeof(lua_Integer), pos, move,
+			num);
+		for (i = 0; i < num; ++i)
+			tmp[i] = getbit(l->tl_Selected, pos + move + i);
+		for (i = pos + move; i-- > pos; )
+			setbit(l->tl_Selected, i + num, getbit(l->tl_Selected, i));
+		for (i = 0; i < num; ++i)
+			setbit(l->tl_Selected, pos + i, tmp[i]);
+		free(tmp);
+	}
+}
+
+/*
+**	Close the gap of num rows at row pos. The rows must have been emptied.
+*/
+
+static void tek_list_closerows(tek_list *l, size_t pos, size_t num)
+{
+	size_t n = l->tl_NumRows;
+	size_t move = n - pos - num;
+	size_t i;
+	int c;
+	for (c = 0; c < l->tl_NumColumns; ++c)
+	{
+		struct tek_list_cell *cells = l->tl_Columns[c].lcl_Cells;
+		memmove(cells + pos, cells + pos + num,
+			sizeof(struct tek_list_cell) * move);
+	}
+	memmove(l->tl_Data + pos, l->tl_Data + pos + num, sizeof(int) * move);
+	memmove(l->tl_Keys + pos, l->tl_Keys + pos + num,
+		sizeof(lua_Integer) * move);
+	for (i = pos; i < n - num; ++i)
+		setbit(l->tl_Selected, i, getbit(l->tl_Selected, i + num));
+	for (i = n - num; i < n; ++i)
+		setbit(l->tl_Selected, i, 0);
+	l->tl_NumRows = n - num;
+}
+
+/*****************************************************************************/
+/*
+**	Check an item table at the given stack index, return its number of
+**	columns
+*/
+
+static int tek_list_checkitem(lua_State *L, int idx, int narg)
+{
+	int numcols = 0;
+	if (lua_type(L, idx) != LUA_TTABLE)
+		luaL_argerror(L, narg, "table expected");
+	lua_rawgeti(L, idx, 1);
+	if (lua_type(L, -1) != LUA_TTABLE)
+		luaL_argerror(L, narg, "table of columns expected");
+	for (;;)
+	{
+		lua_rawgeti(L, -1, numcols + 1);
+		if (lua_isnil(L, -1))
+			break;
+		if (!lua_isstring(L, -1))
+			luaL_argerror(L, narg, "string expected in column");
+		lua_pop(L, 1);
+		numcols++;
+	}
+	lua_pop(L, 2);
+	return numcols;
+}
+
+/*
+**	Store the item table at the given stack index in an empty row. The row
+**	is a different item, so it gets a new key, even if the item table
+**	refers to a row of this store.
+*/
+
+static void tek_list_setrow(lua_State *L, tek_list *l, size_t row, int idx,
+	int refidx)
+{
+	int c;
+	lua_rawgeti(L, idx, 1);
+	for (c = 0; ; ++c)
+	{
+		size_t len;
+		const char *s;
+		lua_rawgeti(L, -1, c + 1);
+		if (lua_isnil(L, -1))
+			break;
+		s = lua_tolstring(L, -1, &len);
+		tek_list_setcell(L, l, &l->tl_Columns[c], row, s, len);
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 2);
+	lua_pushinteger(L, 2);
+	lua_gettable(L, idx);
+	l->tl_Data[row] = lua_isnil(L, -1) ? (lua_pop(L, 1), LUA_NOREF) :
+		luaL_ref(L, refidx);
+	lua_pushinteger(L, 3);
+	lua_gettable(L, idx);
+	setbit(l->tl_Selected, row, lua_toboolean(L, -1));
+	lua_pop(L, 1);
+	l->tl_Keys[row] = ++l->tl_LastKey;
+}
+
+/*
+**	Empty a row, optionally leaving a plain item table on the stack
+*/
+
+static void tek_list_clearrow(lua_State *L, tek_list *l, size_t row,
+	int refidx, int push)
+{
+	int c;
+	if (push)
+	{
+		int numcols = 0;
+		while (numcols < l->tl_NumColumns &&
+			l->tl_Columns[numcols].lcl_Cells[row].lc_Length >= 0)
+			numcols++;
+		lua_createtable(L, 3, 0);
+		lua_createtable(L, numcols, 0);
+		for (c = 0; c < numcols; ++c)
+		{
+			struct tek_list_column *col = &l->tl_Columns[c];
+			struct tek_list_cell *cell = &col->lcl_Cells[row];
+			lua_pushlstring(L, col->lcl_Text + cell->lc_Offset,
+				cell->lc_Length);
+			lua_rawseti(L, -2, c + 1);
+		}
+		lua_rawseti(L, -2, 1);
+		if (l->tl_Data[row] != LUA_NOREF)
+		{
+			lua_rawgeti(L, refidx, l->tl_Data[row]);
+			lua_rawseti(L, -2, 2);
+		}
+		lua_pushboolean(L, getbit(l->tl_Selected, row));
+		lua_rawseti(L, -2, 3);
+	}
+	for (c = 0; c < l->tl_NumColumns; ++c)
+		tek_list_clearcell(&l->tl_Columns[c], row);
+	luaL_unref(L, refidx, l->tl_Data[row]);
+	l->tl_Data[row] = LUA_NOREF;
+	l->tl_Keys[row] = 0;
+	setbit(l->tl_Selected, row, 0);
+}
+
+/*
+**	Push an item table referring to the row
+*/
+
+static void tek_list_pushitem(lua_State *L, tek_list *l, size_t row)
+{
+	int numcols = 0;
+	int c;
+	while (numcols < l->tl_NumColumns &&
+		l->tl_Columns[numcols].lcl_Cells[row].lc_Length >= 0)
+		numcols++;
+	lua_createtable(L, 1, 2);
+	lua_createtable(L, numcols, 0);
+	for (c = 0; c < numcols; ++c)
+	{
+		struct tek_list_column *col = &l->tl_Columns[c];
+		struct tek_list_cell *cell = &col->lcl_Cells[row];
+		lua_pushlstring(L, col->lcl_Text + cell->lc_Offset, cell->lc_Length);
+		lua_rawseti(L, -2, c + 1);
+	}
+	lua_rawseti(L, -2, 1);
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, ITEM_STORE);
+	lua_pushinteger(L, row + 1);
+	lua_rawseti(L, -2, ITEM_ROW);
+	luaL_getmetatable(L, TEK_LIB_LIST_ITEM_NAME);
+	lua_setmetatable(L, -2);
+}
+
+/*****************************************************************************/
+
+static tek_list *tek_list_check(lua_State *L)
+{
+	return luaL_checkudata(L, 1, TEK_LIB_LIST_NAME "*");
+}
+
+/*
+**	Get position argument, checked to be in the range 1...max, or return
+**	the default position
+*/
+
+static size_t tek_list_checkpos(lua_State *L, int narg, size_t max,
+	size_t def)
+{
+	lua_Integer pos;
+	if (lua_isnoneornil(L, narg))
+		return def;
+	pos = luaL_checkinteger(L, narg);
+	return (size_t) TMIN((lua_Integer) max, TMAX(pos, 1));
+}
+
+/*-----------------------------------------------------------------------------
+--	store = ListStore.new(): Creates a new, empty store.
+-----------------------------------------------------------------------------*/
+
+static int tek_list_new(lua_State *L)
+{
+	tek_list *l = lua_newuserdata(L, sizeof(tek_list));
+	memset(l, 0, sizeof(tek_list));
+	luaL_getmetatable(L, TEK_LIB_LIST_NAME "*");
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	ListStore:clear(): Removes all items from the store.
+-----------------------------------------------------------------------------*/
+
+static void tek_list_freeall(lua_State *L, tek_list *l)
+{
+	int c;
+	size_t i;
+	lua_getmetatable(L, 1);
+	for (i = 0; i < l->tl_NumRows; ++i)
+		luaL_unref(L, -1, l->tl_Data[i]);
+	lua_pop(L, 1);
+	for (c = 0; c < l->tl_NumColumns; ++c)
+	{
+		free(l->tl_Columns[c].lcl_Cells);
+		free(l->tl_Columns[c].lcl_Text);
+	}
+	free(l->tl_Columns);
+	free(l->tl_Data);
+	free(l->tl_Keys);
+	free(l->tl_Selected);
+	memset(l, 0, sizeof(tek_list));
+}
+
+static int tek_list_collect(lua_State *L)
+{
+	tek_list_freeall(L, tek_list_check(L));
+	return 0;
+}
+
+/*-----------------------------------------------------------------------------
+--	n = ListStore:getN(): Returns the number of items in the store.
+-----------------------------------------------------------------------------*/
+
+static int tek_list_getn(lua_State *L)
+{
+	tek_list *l = tek_list_check(L);
+	lua_pushinteger(L, l->tl_NumRows);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	item = ListStore:getItem(pos): Returns the item at the specified
+--	position, or '''nil''' if the position is out of range.
+-----------------------------------------------------------------------------*/
+
+static int tek_list_getitem(lua_State *L)
+{
+	tek_list *l = tek_list_check(L);
+	lua_Integer pos = luaL_checkinteger(L, 2);
+	if (pos < 1 || pos > (lua_Integer) l->tl_NumRows)
+		return 0;
+	tek_list_pushitem(L, l, pos - 1);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	pos = ListStore:addItem(item[, pos]): Adds an item, optionally
+--	inserting it at the specified position. Returns the position at which
+--	the item was added.
+-----------------------------------------------------------------------------*/
+
+static int tek_list_additem(lua_State *L)
+{
+	tek_list *l = tek_list_check(L);
+	size_t n = l->tl_NumRows;
+	size_t pos = tek_list_checkpos(L, 3, n + 1, n + 1) - 1;
+	int numcols = tek_list_checkitem(L, 2, 2);
+	tek_list_alloccolumns(L, l, numcols);
+	tek_list_appendrows(L, l, 1);
+	lua_getmetatable(L, 1);
+	tek_list_setrow(L, l, n, 2, lua_gettop(L));
+	tek_list_rotaterows(L, l, pos, 1);
+	lua_pushinteger(L, pos + 1);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	pos, num = ListStore:addItems(items[, pos]): Adds the items from the
+--	numerically indexed table {{items}} in one operation, optionally
+--	inserting them at the specified position. Returns the position of the
+--	first item added, and the number of items added.
+-----------------------------------------------------------------------------*/
+
+static int tek_list_additems(lua_State *L)
+{
+	tek_list *l = tek_list_check(L);
+	size_t n = l->tl_NumRows;
+	size_t pos = tek_list_checkpos(L, 3, n + 1, n + 1) - 1;
+	size_t num = 0;
+	int numcols = 0;
+	size_t i;
+	luaL_checktype(L, 2, LUA_TTABLE);
+	for (;;)
+	{
+		int nc;
+		lua_rawgeti(L, 2, num + 1);
+		if (lua_isnil(L, -1))
+			break;
+		nc = tek_list_checkitem(L, lua_gettop(L), 2);
+		numcols = TMAX(numcols, nc);
+		lua_pop(L, 1);
+		num++;
+	}
+	lua_pop(L, 1);
+	tek_list_alloccolumns(L, l, numcols);
+	tek_list_appendrows(L, l, num);
+	lua_getmetatable(L, 1);
+	for (i = 0; i < num; ++i)
+	{
+		lua_rawgeti(L, 2, i + 1);
+		tek_list_setrow(L, l, n + i, lua_gettop(L), lua_gettop(L) - 1);
+		lua_pop(L, 1);
+	}
+	tek_list_rotaterows(L, l, pos, num);
+	lua_pushinteger(L, pos + 1);
+	lua_pushinteger(L, num);
+	return 2;
+}
+
+/*-----------------------------------------------------------------------------
+--	item = ListStore:remItem(pos): Removes the item at the specified
+--	position and returns it as a plain table.
+-----------------------------------------------------------------------------*/
+
+static int tek_list_remitem(lua_State *L)
+{
+	tek_list *l = tek_list_check(L);
+	lua_Integer pos = luaL_checkinteger(L, 2);
+	int c;
+	if (pos < 1 || pos > (lua_Integer) l->tl_NumRows)
+		return 0;
+	lua_getmetatable(L, 1);
+	tek_list_clearrow(L, l, pos - 1, lua_gettop(L), 1);
+	tek_list_closerows(l, pos - 1, 1);
+	for (c = 0; c < l->tl_NumColumns; ++c)
+		tek_list_checkcompact(L, l, &l->tl_Columns[c]);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	success = ListStore:changeItem(item, pos): Replaces the item at the
+--	specified position. Returns '''true''' if an item was changed.
+-----------------------------------------------------------------------------*/
+
+static int tek_list_changeitem(lua_State *L)
+{
+	tek_list *l = tek_list_check(L);
+	lua_Integer pos = luaL_checkinteger(L, 3);
+	int numcols = tek_list_checkitem(L, 2, 2);
+	size_t n = l->tl_NumRows;
+	size_t row = pos - 1;
+	int c;
+	if (pos < 1 || pos > (lua_Integer) n)
+		return 0;
+	tek_list_alloccolumns(L, l, numcols);
+	tek_list_appendrows(L, l, 1);
+	lua_getmetatable(L, 1);
+	tek_list_setrow(L, l, n, 2, lua_gettop(L));
+	/* replace the old row by the appended one: */
+	tek_list_clearrow(L, l, row, lua_gettop(L), 0);
+	for (c = 0; c < l->tl_NumColumns; ++c)
+		l->tl_Columns[c].lcl_Cells[row] = l->tl_Columns[c].lcl_Cells[n];
+	l->tl_Data[row] = l->tl_Data[n];
+	l->tl_Keys[row] = l->tl_Keys[n];
+	setbit(l->tl_Selected, row, getbit(l->tl_Selected, n));
+	setbit(l->tl_Selected, n, 0);
+	l->tl_NumRows = n;
+	for (c = 0; c < l->tl_NumColumns; ++c)
+		tek_list_checkcompact(L, l, &l->tl_Columns[c]);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+static int tek_list_clear(lua_State *L)
+{
+	tek_list *l = tek_list_check(L);
+	/* keys are not reused: */
+	lua_Integer lastkey = l->tl_LastKey;
+	tek_list_freeall(L, l);
+	l->tl_LastKey = lastkey;
+	return 0;
+}
+
+/*****************************************************************************/
+/*
+**	Item metamethods: item[2] is the userdata field, item[3] the selection,
+**	item[4] the item's key. Other fields are stored in the item table.
+*/
+
+static tek_list *tek_list_getrow(lua_State *L, size_t *prow)
+{
+	tek_list *l;
+	lua_Integer row;
+	lua_rawgeti(L, 1, ITEM_STORE);
+	l = luaL_checkudata(L, -1, TEK_LIB_LIST_NAME "*");
+	lua_rawgeti(L, 1, ITEM_ROW);
+	row = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	/* s: store */
+	if (row < 1 || row > (lua_Integer) l->tl_NumRows)
+		luaL_error(L, "list item no longer valid");
+	*prow = row - 1;
+	return l;
+}
+
+static int tek_list_item_index(lua_State *L)
+{
+	size_t row;
+	tek_list *l;
+	switch (lua_type(L, 2) == LUA_TNUMBER ? lua_tointeger(L, 2) : 0)
+	{
+		default:
+			return 0;
+		case 2:
+			l = tek_list_getrow(L, &row);
+			if (l->tl_Data[row] == LUA_NOREF)
+				return 0;
+			lua_getmetatable(L, -1);
+			lua_rawgeti(L, -1, l->tl_Data[row]);
+			return 1;
+		case 3:
+			l = tek_list_getrow(L, &row);
+			lua_pushboolean(L, getbit(l->tl_Selected, row));
+			return 1;
+		case 4:
+			l = tek_list_getrow(L, &row);
+			lua_pushinteger(L, l->tl_Keys[row]);
+			return 1;
+	}
+}
+
+static int tek_list_item_newindex(lua_State *L)
+{
+	size_t row;
+	tek_list *l;
+	switch (lua_type(L, 2) == LUA_TNUMBER ? lua_tointeger(L, 2) : 0)
+	{
+		default:
+			lua_rawset(L, 1);
+			break;
+		case 2:
+			l = tek_list_getrow(L, &row);
+			lua_getmetatable(L, -1);
+			luaL_unref(L, -1, l->tl_Data[row]);
+			lua_pushvalue(L, 3);
+			l->tl_Data[row] = lua_isnil(L, -1) ? (lua_pop(L, 1), LUA_NOREF) :
+				luaL_ref(L, -2);
+			break;
+		case 3:
+			l = tek_list_getrow(L, &row);
+			setbit(l->tl_Selected, row, lua_toboolean(L, 3));
+			break;
+		case 4:
+			/* read-only */
+			break;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+
+static const luaL_Reg tek_list_funcs[] =
+{
+	{ "new", tek_list_new },
+	{ NULL, NULL }
+};
+
+static const luaL_Reg tek_list_methods[] =
+{
+	{ "__gc", tek_list_collect },
+	{ "addItem", tek_list_additem },
+	{ "addItems", tek_list_additems },
+	{ "changeItem", tek_list_changeitem },
+	{ "clear", tek_list_clear },
+	{ "getItem", tek_list_getitem },
+	{ "getN", tek_list_getn },
+	{ "remItem", tek_list_remitem },
+	{ NULL, NULL }
+};
+
+static const luaL_Reg tek_list_itemmethods[] =
+{
+	{ "__index", tek_list_item_index },
+	{ "__newindex", tek_list_item_newindex },
+	{ NULL, NULL }
+};
+
+TMODENTRY int luaopen_tek_lib_list(lua_State *L)
+{
+	tek_lua_register(L, TEK_LIB_LIST_NAME, tek_list_funcs, 0);
+	lua_pushstring(L, TEK_LIB_LIST_VERSION);
+	lua_setfield(L, -2, "_VERSION");
+	luaL_newmetatable(L, TEK_LIB_LIST_NAME "*");
+	tek_lua_register(L, NULL, tek_list_methods, 0);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+	luaL_newmetatable(L, TEK_LIB_LIST_ITEM_NAME);
+	tek_lua_register(L, NULL, tek_list_itemmethods, 0);
+	lua_pop(L, 1);
+	return 1;
+}
@@ -14,6 +14,7 @@
 --		- region:checkIntersect() - Checks if a rectangle intersects a region
 --		- region:forEach() - Calls a function for each rectangle in a region
 --		- region:get() - Gets a region's min/max extents
+--		- Region.getPoolStats() - Gets statistics of the rectangle pool
 --		- Region.intersect() - Returns the intersection of two rectangles
 --		- region:isEmpty() - Checks if a Region is empty
 --		- Region.new() - Creates a new Region
@@ -28,7 +29,7 @@
 -------------------------------------------------------------------------------
 
 module "tek.lib.region"
-_VERSION = "Region 11.3"
+_VERSION = "Region 11.4"
 local Region = _M
 
 ******************************************************************************/
@@ -40,7 +41,7 @@ local Region = _M
 #include <tek/lib/region.h>
 #include <tek/proto/exec.h>
 
-#define TEK_LIB_REGION_VERSION "Region 11.3"
+#define TEK_LIB_REGION_VERSION "Region 11.4"
 #define TEK_LIB_REGION_NAME "tek.lib.region"
 #define TEK_LIB_REGION_POOL_NAME "tek.lib.pool*"
 
@@ -92,6 +93,30 @@ static int tek_lib_region_intersect(lua_State *L)
 	return 0;
 }
 
+/*-----------------------------------------------------------------------------
+--	live, maxlive, nodes, slabs = Region.getPoolStats(): Returns the number
+--	of rectangles currently in use by all regions, the highest number of
+--	rectangles that were in use at the same time, the total number of
+--	rectangles allocated in the pool, and the number of memory blocks
+--	(slabs) that were allocated for them.
+-----------------------------------------------------------------------------*/
+
+static int tek_lib_region_getpoolstats(lua_State *L)
+{
+	struct RectPool *pool;
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_REGION_NAME "*");
+	/* s: metatable */
+	lua_rawgeti(L, -1, 2);
+	/* s: metatable, pool */
+	pool = lua_touserdata(L, -1);
+	lua_pop(L, 2);
+	lua_pushinteger(L, pool->p_NumLive);
+	lua_pushinteger(L, pool->p_MaxLive);
+	lua_pushinteger(L, pool->p_NumNodes);
+	lua_pushinteger(L, pool->p_NumSlabs);
+	return 4;
+}
+
 /*-----------------------------------------------------------------------------
 --	region = Region.new(r1, r2, r3, r4): Creates a new region from the given
 --	coordinates.
@@ -344,6 +369,7 @@ static const luaL_Reg tek_lib_region_funcs[] =
 {
 	{ "new", tek_lib_region_new },
 	{ "intersect", tek_lib_region_intersect },
+	{ "getPoolStats", tek_lib_region_getpoolstats },
 	{ NULL, NULL }
 };
 
@@ -403,8 +429,7 @@ TMODENTRY int luaopen_tek_lib_region(lua_State *L)
 	/* s: execbase, metatable, metatable */
 	
 	pool = lua_newuserdata(L, sizeof(struct RectPool));
-	region_initrectlist(&pool->p_Rects);
-	pool->p_ExecBase = *(TAPTR *) lua_touserdata(L, -4);
+	region_initpool(pool, *(TAPTR *) lua_touserdata(L, -4));
 	/* s: execbase, metatable, metatable, pool */
 	luaL_newmetatable(L, TEK_LIB_REGION_POOL_NAME);
 	/* s: execbase, metatable, metatable, pool, poolmt */
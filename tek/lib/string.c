@@ -34,7 +34,7 @@
 -------------------------------------------------------------------------------
 
 module "tek.lib.string"
-_VERSION = "String 2.0"
+_VERSION = "String 2.1"
 local String = _M
 
 ******************************************************************************/
@@ -48,7 +48,7 @@ local String = _M
 #include <tek/lib/utf8.h>
 #include <tek/lib/tekui.h>
 
-#define TEK_LIB_STRING_VERSION	"String Library 2.0"
+#define TEK_LIB_STRING_VERSION	"String Library 2.2"
 #define TEK_LIB_STRING_NAME		"tek.lib.string"
 
 /*****************************************************************************/
@@ -61,6 +61,8 @@ local String = _M
 #define MAXOVERSIZE	64	/* max node length that receives an overhang */
 #define OVERSIZE	8
 #define COMPACT_THRESHOLD	30
+#define UTF8INDEXSTEP	64	/* characters per entry in UTF-8 offset index */
+#define MAXNODELEN	1024	/* max length of nodes created from bulk text */
 
 #define NUMFIELDS	2
 #define METAIDX		1
@@ -76,31 +78,63 @@ typedef struct
 	tek_char cdata[NUMFIELDS];
 } tek_entity;
 
-typedef struct 
+/*
+**	Nodes are linked in a list in the order of the string, and form a
+**	treap, a binary tree ordered by position and heap-ordered by priority,
+**	in which each node knows the number of characters in its subtree.
+*/
+
+typedef struct tek_node
 {
 	struct TNode tsn_Node;
+	struct tek_node *tsn_Parent;
+	struct tek_node *tsn_Left;
+	struct tek_node *tsn_Right;
+	tek_size tsn_Sum;		/* number of characters in subtree */
+	uint32_t tsn_Priority;
 	tek_size tsn_Length;
 	tek_size tsn_AllocLength;
 	tek_entity tsn_Data[0];
 } tek_node;
 
+#if defined(COMPACTION)
 typedef struct 
 { 
 	tek_size pos; 
-	tek_node *node; 
-#if defined(COMPACTION)
 	tek_size utf8pos[NUMFIELDS];
-#endif
 } tek_hint;
+#endif
+
+typedef struct
+{
+	int32_t *tw_X;			/* x position after each character, [0] = 0 */
+	tek_size tw_NumX;		/* number of characters measured */
+	tek_size tw_AllocX;
+	tek_size *tw_Tabs;		/* positions of tabulators measured */
+	tek_size tw_NumTabs;
+	tek_size tw_AllocTabs;
+	/* parameters of the measurement: */
+	int tw_TabSize;
+	int tw_FixedWidth;
+	int tw_BlankWidth;
+	const void *tw_Func;
+	const void *tw_Arg;
+	lua_Integer tw_Serial;
+} tek_widths;
 
 typedef struct TEKString
 {
 	struct TList ts_List;
+	tek_node *ts_Root;
 	tek_size ts_Length;
-	tek_hint ts_Hint;
+	tek_widths ts_Widths;
 #if defined(COMPACTION)
+	tek_hint ts_Hint;
 	unsigned char *ts_UTF8[NUMFIELDS];
 	tek_size ts_UTF8Len[NUMFIELDS];
+	/* byte offsets of every UTF8INDEXSTEP-th character: */
+	tek_size *ts_UTF8Index[NUMFIELDS];
+	tek_size ts_UTF8NumIndex;
 #endif
 	int ts_NumReadAccess;
 	int ts_RefData;
@@ -179,8 +213,7 @@ static void dostats(void)
 #if defined(DUMP_STRING)
 static void tek_string_dump(tek_string *s)
 {
-	struct TNode *next, *node = s->ts_List.tlh_Head;
-	tek_size pos = 1;
+	struct TNode *next, *node = s->ts_List.tlh_Head.tln_Succ;
 #if defined(SANITY_CHECKS)
 	tek_size elen = 0;
 #endif
@@ -195,9 +228,7 @@ static void tek_string_dump(tek_string *s)
 		{
 			int c = sn->tsn_Data[i].cdata[0];
 			if (c == 9) c = ' ';
-			if (s->ts_Hint.pos == pos && s->ts_Hint.node == sn) c = '*';
 			fprintf(stderr, "%c", c);
-			pos++;
 		}
 		for (i = sn->tsn_Length; i < sn->tsn_AllocLength; ++i)
 			fprintf(stderr, ".");
@@ -215,38 +246,41 @@ static void tek_string_dump(tek_string *s)
 #endif
 
 #if defined(SANITY_CHECKS)
+static tek_size tek_string_checktree(tek_node *sn, tek_node *parent)
+{
+	tek_size sum;
+	if (sn == TNULL)
+		return 0;
+	assert(sn->tsn_Parent == parent);
+	assert(!parent || parent->tsn_Priority <= sn->tsn_Priority);
+	sum = tek_string_checktree(sn->tsn_Left, sn) + sn->tsn_Length +
+		tek_string_checktree(sn->tsn_Right, sn);
+	assert(sum == sn->tsn_Sum);
+	return sum;
+}
+
 static void tek_string_check(tek_string *s)
 {
-	tek_size hintpos = s->ts_Hint.pos;
-	if (hintpos > 0 && hintpos <= s->ts_Length)
+	struct TNode *next, *node = s->ts_List.tlh_Head.tln_Succ;
+	tek_node *prev = TNULL;
+	assert(tek_string_checktree(s->ts_Root, TNULL) == 
+		(TISLISTEMPTY(&s->ts_List) ? 0 : s->ts_Length));
+	/* the list must be the in-order sequence of the tree: */
+	for (; (next = node->tln_Succ); node = next)
 	{
-		struct TNode *next, *node = s->ts_List.tlh_Head;
-		tek_size p0 = 1;
-		int i = 1;
-		assert(hintpos != 1);
-		assert(hintpos <= s->ts_Length);
-		for (; (next = node->tln_Succ); node = next, i++)
+		tek_node *sn = (tek_node *) node;
+		tek_node *q = sn;
+		assert(sn->tsn_Length > 0);
+		if (q->tsn_Left)
+			for (q = q->tsn_Left; q->tsn_Right; q = q->tsn_Right);
+		else
 		{
-			tek_node *sn = (tek_node *) node;
-			if (hintpos == p0)
-			{
-				if (sn != s->ts_Hint.node)
-				{
-					fprintf(stderr, "hintpos=%ld, p0=%ld, node=%d\n",
-						hintpos, p0, i);
-					assert(sn == s->ts_Hint.node);
-				}
-				return;	/* check passed */
-			}
-			if (hintpos < p0 + sn->tsn_Length)
-			{
-				fprintf(stderr, "hpos=%ld, p0=%ld, p0+len=%ld, node=%d\n",
-					hintpos, p0, p0 + sn->tsn_Length, i);
-				assert(hintpos >= p0 + sn->tsn_Length);
-			}
-			p0 += sn->tsn_Length;
+			while (q->tsn_Parent && q->tsn_Parent->tsn_Left == q)
+				q = q->tsn_Parent;
+			q = q->tsn_Parent;
 		}
-		assert(0);
+		assert(q == prev);
+		prev = sn;
 	}
 }
 #endif
@@ -303,25 +337,160 @@ static void tek_string_freelist(lua_State *L, tek_string *s)
 	while ((sn = (tek_node *) TRemHead(&s->ts_List)))
 		tek_string_free(sn, 
 			sizeof(tek_node) + sn->tsn_AllocLength * sizeof(tek_entity));
+	s->ts_Root = TNULL;
 	s->ts_Length = 0;
-	s->ts_Hint.pos = 0;
-	s->ts_Hint.node = TNULL;
+	s->ts_Widths.tw_NumX = 0;
+	s->ts_Widths.tw_NumTabs = 0;
 }
 
 /*****************************************************************************/
 
-static void tek_string_hintnode(tek_string *s, tek_size pos, tek_node *node)
+/*
+**	Treap functions
+*/
+
+static uint32_t tek_string_priority(tek_node *sn)
 {
-	if (pos > 1) /* no point in hinting at position 1 */
+	/* hash of the node address, so no state is needed: */
+	uint64_t x = (uint64_t) (uintptr_t) sn;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return (uint32_t) x;
+}
+
+static void tek_string_updatenode(tek_node *sn)
+{
+	sn->tsn_Sum = sn->tsn_Length +
+		(sn->tsn_Left ? sn->tsn_Left->tsn_Sum : 0) +
+		(sn->tsn_Right ? sn->tsn_Right->tsn_Sum : 0);
+}
+
+/*
+**	rotate a node up, exchanging it with its parent
+*/
+
+static void tek_string_rotateup(tek_string *s, tek_node *sn)
+{
+	tek_node *p = sn->tsn_Parent;
+	tek_node *g = p->tsn_Parent;
+	if (p->tsn_Left == sn)
 	{
-		s->ts_Hint.pos = pos;
-		s->ts_Hint.node = node;
+		p->tsn_Left = sn->tsn_Right;
+		if (p->tsn_Left)
+			p->tsn_Left->tsn_Parent = p;
+		sn->tsn_Right = p;
 	}
-#if defined(SANITY_CHECKS)
-	tek_string_check(s);
-#endif
+	else
+	{
+		p->tsn_Right = sn->tsn_Left;
+		if (p->tsn_Right)
+			p->tsn_Right->tsn_Parent = p;
+		sn->tsn_Left = p;
+	}
+	p->tsn_Parent = sn;
+	sn->tsn_Parent = g;
+	if (g == TNULL)
+		s->ts_Root = sn;
+	else if (g->tsn_Left == p)
+		g->tsn_Left = sn;
+	else
+		g->tsn_Right = sn;
+	tek_string_updatenode(p);
+	tek_string_updatenode(sn);
+}
+
+/*
+**	insert node after prednode, or at the head if prednode is the list
+**	header. Does not update the string's length.
+*/
+
+static void tek_string_addnode(tek_string *s, tek_node *sn, tek_node *pred)
+{
+	struct TNode *prednode = pred ? &pred->tsn_Node : &s->ts_List.tlh_Head;
+	tek_node *succ = (tek_node *) prednode->tln_Succ;
+	tek_node *p;
+	
+	sn->tsn_Left = sn->tsn_Right = TNULL;
+	sn->tsn_Sum = sn->tsn_Length;
+	sn->tsn_Priority = tek_string_priority(sn);
+	
+	if (s->ts_Root == TNULL)
+	{
+		sn->tsn_Parent = TNULL;
+		s->ts_Root = sn;
+	}
+	else if (prednode != &s->ts_List.tlh_Head && pred->tsn_Right == TNULL)
+	{
+		/* predecessor has no right subtree */
+		pred->tsn_Right = sn;
+		sn->tsn_Parent = pred;
+	}
+	else
+	{
+		/* successor is leftmost in the predecessor's right subtree */
+		assert(succ->tsn_Node.tln_Succ && succ->tsn_Left == TNULL);
+		succ->tsn_Left = sn;
+		sn->tsn_Parent = succ;
+	}
+	
+	TInsert(&s->ts_List, &sn->tsn_Node, prednode);
+	
+	for (p = sn->tsn_Parent; p; p = p->tsn_Parent)
+		p->tsn_Sum += sn->tsn_Length;
+	while (sn->tsn_Parent && 
+		sn->tsn_Parent->tsn_Priority > sn->tsn_Priority)
+		tek_string_rotateup(s, sn);
 }
 
+/*
+**	unlink a node from the list and the tree. Does not update the string's
+**	length.
+*/
+
+static void tek_string_remnode(tek_string *s, tek_node *sn)
+{
+	tek_node *p;
+	/* rotate down to a leaf: */
+	while (sn->tsn_Left || sn->tsn_Right)
+	{
+		tek_node *c;
+		if (sn->tsn_Left == TNULL)
+			c = sn->tsn_Right;
+		else if (sn->tsn_Right == TNULL)
+			c = sn->tsn_Left;
+		else
+			c = sn->tsn_Left->tsn_Priority < sn->tsn_Right->tsn_Priority ?
+				sn->tsn_Left : sn->tsn_Right;
+		tek_string_rotateup(s, c);
+	}
+	p = sn->tsn_Parent;
+	if (p == TNULL)
+		s->ts_Root = TNULL;
+	else if (p->tsn_Left == sn)
+		p->tsn_Left = TNULL;
+	else
+		p->tsn_Right = TNULL;
+	for (; p; p = p->tsn_Parent)
+		p->tsn_Sum -= sn->tsn_Length;
+	TRemove(&sn->tsn_Node);
+}
+
+/*
+**	change the length of a node, without updating the string's length
+*/
+
+static void tek_string_resizenode(tek_node *sn, tek_size delta)
+{
+	sn->tsn_Length += delta;
+	for (; sn; sn = sn->tsn_Parent)
+		sn->tsn_Sum += delta;
+}
+
+#if defined(COMPACTION)
+
 /*
 **	invalidate hints beginning with the given position
 */
@@ -330,9 +499,32 @@ static void tek_string_unhint(tek_string *s, tek_size pos)
 {
 	if (s->ts_Hint.pos > pos) /* invalidate */
 		s->ts_Hint.pos = 0;
-#if defined(SANITY_CHECKS)
-	tek_string_check(s);
+}
+
 #endif
+
+/*
+**	invalidate measured widths beginning with the given position
+*/
+
+static void tek_string_unwidth(tek_string *s, tek_size pos)
+{
+	tek_widths *tw = &s->ts_Widths;
+	if (tw->tw_NumX >= pos)
+	{
+		tw->tw_NumX = pos > 0 ? pos - 1 : 0;
+		while (tw->tw_NumTabs > 0 &&
+			tw->tw_Tabs[tw->tw_NumTabs - 1] > tw->tw_NumX)
+			tw->tw_NumTabs--;
+	}
+}
+
+static void tek_string_freewidths(tek_string *s)
+{
+	tek_widths *tw = &s->ts_Widths;
+	tek_string_free(tw->tw_X, tw->tw_AllocX * sizeof(int32_t));
+	tek_string_free(tw->tw_Tabs, tw->tw_AllocTabs * sizeof(tek_size));
+	memset(tw, 0, sizeof(tek_widths));
 }
 
 /*****************************************************************************/
@@ -350,7 +542,42 @@ static void tek_string_freeutf8(lua_State *L, tek_string *s)
 			s->ts_UTF8[i] = TNULL;
 			s->ts_UTF8Len[i] = 0;
 		}
+		if (s->ts_UTF8Index[i])
+		{
+			tek_string_free(s->ts_UTF8Index[i],
+				s->ts_UTF8NumIndex * sizeof(tek_size));
+			s->ts_UTF8Index[i] = TNULL;
+		}
 	}
+	tek_string_unhint(s, 0);
+}
+
+/*
+**	index the byte offsets of every UTF8INDEXSTEP-th character in a field,
+**	so that reading from a packed string takes constant time
+*/
+
+static void tek_string_indexutf8(lua_State *L, tek_string *s, int idx)
+{
+	const unsigned char *utf8 = s->ts_UTF8[idx];
+	tek_size *index;
+	tek_size pos = 0, b, k = 0;
+	assert(!s->ts_UTF8Index[idx] && utf8);
+	s->ts_UTF8NumIndex = (s->ts_Length + UTF8INDEXSTEP - 1) / UTF8INDEXSTEP;
+	index = tek_string_alloc(s->ts_UTF8NumIndex * sizeof(tek_size));
+	if (index == TNULL)
+		luaL_error(L, "Out of memory");
+	for (b = 0; b < s->ts_UTF8Len[idx]; ++b)
+	{
+		/* count lead bytes: */
+		if ((utf8[b] & 0xc0) != 0x80)
+		{
+			if (pos++ % UTF8INDEXSTEP == 0)
+				index[k++] = b;
+		}
+	}
+	assert(k == s->ts_UTF8NumIndex && pos == s->ts_Length);
+	s->ts_UTF8Index[idx] = index;
 }
 
 static unsigned char *tek_string_allocutf8n(lua_State *L, tek_string *s,
@@ -368,8 +595,9 @@ static unsigned char *tek_string_allocutf8n(lua_State *L, tek_string *s,
 static void tek_string_unpack(lua_State *L, tek_string *s)
 {
 	struct utf8reader rd[NUMFIELDS];
-	tek_node *sn;
+	tek_node *sn, *pred;
 	tek_entity *chars;
+	tek_size len, n;
 	int i;
 	
 	if (s->ts_Length == 0) return;
@@ -387,19 +615,20 @@ static void tek_string_unpack(lua_State *L, tek_string *s)
 			utf8initreader(&rd[i], s->ts_UTF8[i], s->ts_UTF8Len[i]);
 	}
 	
-	sn = tek_string_allocnode(L, s->ts_Length);
-	chars = sn->tsn_Data;
-	for (;;)
+	/* nodes of bounded length keep breaking and moving them cheap: */
+	for (len = s->ts_Length, pred = TNULL; len > 0; len -= n, pred = sn)
 	{
-		tek_char c = utf8read(&rd[0]);
-		if (c < 0) break;
-		for (i = 1; i < NUMFIELDS; ++i)
-			chars->cdata[i] = s->ts_UTF8[i] ? utf8read(&rd[i]) : 0;
-		chars++->cdata[0] = c;
+		n = TMIN(len, MAXNODELEN);
+		sn = tek_string_allocnode(L, n);
+		for (chars = sn->tsn_Data; chars < sn->tsn_Data + n; ++chars)
+		{
+			chars->cdata[0] = utf8read(&rd[0]);
+			for (i = 1; i < NUMFIELDS; ++i)
+				chars->cdata[i] = s->ts_UTF8[i] ? utf8read(&rd[i]) : 0;
+		}
+		tek_string_addnode(s, sn, pred);
 	}
-	TAddTail(&s->ts_List, &sn->tsn_Node);
 	tek_string_freeutf8(L, s);
-	tek_string_unhint(s, 0);
 	
 #if defined(STATS)
 	s_unpacked++;
@@ -472,10 +701,15 @@ static void tek_string_compact_int(lua_State *L, tek_string *s)
 		tek_string_free(sn, 
 			sizeof(tek_node) + sn->tsn_AllocLength * sizeof(tek_entity));
 	}
+	s->ts_Root = TNULL;
 	assert(utf8[0] - s->ts_UTF8[0] == elen[0]);
 	assert(!have_data[1] || utf8[1] - s->ts_UTF8[1] == elen[1]);
 	
-	tek_string_unhint(s, 0);
+	for (j = 0; j < NUMFIELDS; ++j)
+	{
+		if (s->ts_UTF8[j])
+			tek_string_indexutf8(L, s, j);
+	}
 	
 #if defined(STATS)
 	s_unpacked--;
@@ -499,13 +733,15 @@ static int tek_string_compact(lua_State *L)
 static tek_node *tek_string_getnode(lua_State *L, tek_string *s, 
 	tek_size pos, tek_size *ppos)
 {
-	struct TNode *next, *node;
+	tek_node *sn;
 	tek_size p0 = 1;
 	assert(pos > 0);
 #if defined(COMPACTION)
 	tek_string_unpack(L, s);
 #endif
-	node = s->ts_List.tlh_Head.tln_Succ;
+#if defined(SANITY_CHECKS)
+	tek_string_check(s);
+#endif
 
 	if (pos > s->ts_Length)
 	{
@@ -513,35 +749,24 @@ static tek_node *tek_string_getnode(lua_State *L, tek_string *s,
 		return TNULL;
 	}
 
-	if (pos > 1) /* no point in looking for hints to position 1 */
-	{
-		tek_size hintpos = s->ts_Hint.pos;
-		if (hintpos > 0 && hintpos <= pos)
-		{
-			node = &s->ts_Hint.node->tsn_Node;
-			p0 = hintpos;
-#if defined(SANITY_CHECKS)
-			tek_string_check(s);
-#endif
-		}
-	}
-
-	for (; (next = node->tln_Succ); node = next)
+	sn = s->ts_Root;
+	for (;;)
 	{
-		tek_node *sn = (tek_node *) node;
-		tek_size p1 = p0 + sn->tsn_Length;
+		tek_size left = sn->tsn_Left ? sn->tsn_Left->tsn_Sum : 0;
 		assert(sn->tsn_Length > 0);
-		if (pos >= p0 && pos < p1)
+		if (pos < p0 + left)
+			sn = sn->tsn_Left;
+		else if (pos < p0 + left + sn->tsn_Length)
 		{
-			tek_string_hintnode(s, p0, sn);
-			*ppos = p0;
+			*ppos = p0 + left;
 			return sn;
 		}
-		p0 = p1;
+		else
+		{
+			p0 += left + sn->tsn_Length;
+			sn = sn->tsn_Right;
+		}
 	}
-
-	assert(0);
-	return TNULL;
 }
 
 static tek_char tek_string_getval_int(lua_State *L, tek_string *s, 
@@ -554,11 +779,15 @@ static tek_char tek_string_getval_int(lua_State *L, tek_string *s,
 	if (s->ts_UTF8[0])
 	{
 		struct utf8reader rd[NUMFIELDS];
-		tek_size pos = 1;
+		tek_size k = (p0 - 1) / UTF8INDEXSTEP;
+		tek_size pos = k * UTF8INDEXSTEP + 1;
 		tek_size rawpos[NUMFIELDS];
 		int i;
 		
- 		if (p0 > 1 && s->ts_Hint.pos > 0 && s->ts_Hint.pos <= p0)
+		if (p0 < 1 || p0 > s->ts_Length)
+			return -1;
+		
+ 		if (s->ts_Hint.pos > pos && s->ts_Hint.pos <= p0)
  		{
 			memcpy(rawpos, s->ts_Hint.utf8pos, sizeof rawpos);
  			pos = s->ts_Hint.pos;
@@ -568,8 +797,9 @@ static tek_char tek_string_getval_int(lua_State *L, tek_string *s,
 		}
 		else
 		{
+			/* start at the nearest indexed position: */
 			for (i = 0; i < NUMFIELDS; ++i)
-				rawpos[i] = 0;
+				rawpos[i] = s->ts_UTF8Index[i] ? s->ts_UTF8Index[i][k] : 0;
 		}
 		
 #if defined(STATS)
@@ -748,7 +978,7 @@ static int tek_string_set(lua_State *L)
 #else
 		tek_node *sn = tek_string_allocnode(L, partlen);
 		tek_entity *chars = sn->tsn_Data;
-		TAddTail(&s->ts_List, &sn->tsn_Node);
+		tek_string_addnode(s, sn, TNULL);
 		if (s2)
 		{
 			tek_size j, i;
@@ -773,9 +1003,15 @@ static int tek_string_set(lua_State *L)
 		}
 #endif
 		s->ts_Length = partlen;
+#if defined(COMPACTION)
+		for (j = 0; j < NUMFIELDS; ++j)
+		{
+			if (s->ts_UTF8[j])
+				tek_string_indexutf8(L, s, j);
+		}
+#endif
 	}
 	s->ts_NumReadAccess = 0;
-	tek_string_unhint(s, 0);
 	lua_pushvalue(L, 1);
 	return 1;
 }
@@ -844,36 +1080,33 @@ done:	luaL_pushresult(&b);
 	return 1;
 }
 
+/*
+**	split the node at the given position, return the node ending before it,
+**	or the list header if the position is at the beginning
+*/
+
 static tek_node *tek_string_breaklist(lua_State *L, tek_string *s, int pos)
 {
 	tek_size p0;
-	tek_node *newnode1, *newnode2;
-	struct TNode *node;
+	tek_node *newnode;
 	tek_size i;
 	tek_node *sn = tek_string_getnode(L, s, pos, &p0);
 	tek_size splitpos;
 		
-	tek_string_unhint(s, 0);
 	if (sn == TNULL)
 		return (tek_node *) s->ts_List.tlh_Tail.tln_Pred;
-	node = &sn->tsn_Node;
 	splitpos = pos - p0;
 	assert(splitpos >= 0);
 	if (splitpos == 0)
 		return (tek_node *) sn->tsn_Node.tln_Pred;
 	assert(sn->tsn_Length - splitpos > 0);
-	newnode1 = tek_string_allocnode(L, splitpos);
-	newnode2 = tek_string_allocnode(L, sn->tsn_Length - splitpos);
-	for (i = 0; i < splitpos; ++i)
-		newnode1->tsn_Data[i] = sn->tsn_Data[i];
+	/* move the characters from the split position to a new node: */
+	newnode = tek_string_allocnode(L, sn->tsn_Length - splitpos);
 	for (i = splitpos; i < sn->tsn_Length; ++i)
-		newnode2->tsn_Data[i - splitpos] = sn->tsn_Data[i];
-	TInsert(&s->ts_List, &newnode1->tsn_Node, node);
-	TInsert(&s->ts_List, &newnode2->tsn_Node, &newnode1->tsn_Node);
-	TRemove(node);
-	tek_string_free(sn, 
-		sizeof(tek_node) + sn->tsn_AllocLength * sizeof(tek_entity));
-	return newnode1;
+		newnode->tsn_Data[i - splitpos] = sn->tsn_Data[i];
+	tek_string_resizenode(sn, -newnode->tsn_Length);
+	tek_string_addnode(s, newnode, sn);
+	return sn;
 }
 
 /*-----------------------------------------------------------------------------
@@ -884,6 +1117,29 @@ static tek_node *tek_string_breaklist(lua_State *L, tek_string *s, int pos)
 --	inserted accordingly, otherwise it is set to {{0}}.
 -----------------------------------------------------------------------------*/
 
+/*
+**	read num characters to insert, either from a string object starting
+**	at position j, or from a UTF-8 reader
+*/
+
+static void tek_string_readchars(lua_State *L, tek_string *s2,
+	struct utf8reader *rd, tek_size j, tek_entity *chars, tek_size num)
+{
+	tek_size i;
+	int k;
+	for (i = 0; i < num; ++i, ++chars)
+	{
+		if (s2)
+			tek_string_getval_int(L, s2, j + i, chars);
+		else
+		{
+			chars->cdata[0] = utf8read(rd);
+			for (k = 1; k < NUMFIELDS; ++k)
+				chars->cdata[k] = 0;
+		}
+	}
+}
+
 static int tek_string_insert(lua_State *L)
 {
 	tek_string *s = luaL_checkudata(L, 1, TEK_LIB_STRING_NAME "*");
@@ -894,9 +1150,8 @@ static int tek_string_insert(lua_State *L)
 	tek_node *nnode;
 	tek_node *sn;
 	tek_entity *chars;
-	tek_char c;
 	tek_size nodepos;
-	tek_size j;
+	tek_size j, n;
 	
 	if (lua_type(L, 2) == LUA_TSTRING)
 	{
@@ -924,6 +1179,8 @@ static int tek_string_insert(lua_State *L)
 		return 0;
 	}
 	
+	tek_string_unwidth(s, p0);
+	
 	nnode = tek_string_getnode(L, s, TCLAMP(1, p0 - 1, s->ts_Length), 
 		&nodepos);
 	if (nnode && (nnode->tsn_AllocLength - nnode->tsn_Length >= inslen))
@@ -933,37 +1190,25 @@ static int tek_string_insert(lua_State *L)
 		chars = &nnode->tsn_Data[innodepos];
 		memmove(chars + inslen, chars,
 			(nnode->tsn_Length - innodepos) * sizeof(tek_entity));
-		nnode->tsn_Length += inslen;
-		s->ts_Length += inslen;
-		tek_string_unhint(s, 0);
+		tek_string_resizenode(nnode, inslen);
+		tek_string_readchars(L, s2, &rd, 1, chars, inslen);
 	}
 	else
 	{
-		/* need new node, break at insertion pos */
+		/* need new nodes, break at insertion pos */
 		nnode = tek_string_breaklist(L, s, p0);
-		sn = tek_string_allocnode(L, inslen);
-		chars = sn->tsn_Data;
-		TInsert(&s->ts_List, &sn->tsn_Node, &nnode->tsn_Node);
-		s->ts_Length += inslen;
- 		/* tek_string_hintnode(s, nodepos, nnode, "insert2"); */
-		tek_string_unhint(s, 0);
-	}
-	
-	if (s2)
-	{
-		for (j = 1; j <= inslen; ++j)
-			tek_string_getval_int(L, s2, j, chars++);
-	}
-	else
-	{
-		while ((c = utf8read(&rd)) >= 0)
+		if (&nnode->tsn_Node == &s->ts_List.tlh_Head)
+			nnode = TNULL;
+		for (j = 0; j < inslen; j += n)
 		{
-			chars->cdata[0] = c;
-			for (j = 1; j < NUMFIELDS; ++j)
-				chars->cdata[j] = 0;
-			chars++;
+			n = TMIN(inslen - j, MAXNODELEN);
+			sn = tek_string_allocnode(L, n);
+			tek_string_readchars(L, s2, &rd, j + 1, sn->tsn_Data, n);
+			tek_string_addnode(s, sn, nnode);
+			nnode = sn;
 		}
 	}
+	s->ts_Length += inslen;
 
 	s->ts_NumReadAccess = 0;
 #if defined(DUMP_STRING)
@@ -989,6 +1234,8 @@ static int tek_string_erase(lua_State *L)
 		tek_node *nnode1, *nnode2;
 		tek_size nodepos, eraselen, nodelen, copylen;
 		
+		tek_string_unwidth(s, p0);
+		
 		nnode2 = tek_string_getnode(L, s, p1, &nodepos);
 		nnode1 = p0 == p1 ? nnode2 : tek_string_getnode(L, s, p0, &nodepos);
 		
@@ -1004,9 +1251,8 @@ static int tek_string_erase(lua_State *L)
 			if (copylen > 0)
 				memmove(chars + p0, chars + p1 + 1, 
 					copylen * sizeof(tek_entity));
-			nnode1->tsn_Length -= eraselen;
+			tek_string_resizenode(nnode1, -eraselen);
 			s->ts_Length -= eraselen;
-			tek_string_unhint(s, p0);
 		}
 		else
 		{
@@ -1024,10 +1270,8 @@ static int tek_string_erase(lua_State *L)
 				tek_node *sn = (tek_node *) node;
 #if defined(SANITY_CHECKS)
 				elen += sn->tsn_Length;
-				assert(s->ts_Hint.pos == 0 || 
-					(tek_node *) node != s->ts_Hint.node);
 #endif
-				TRemove(node);
+				tek_string_remnode(s, sn);
 				tek_string_free(sn, sizeof(tek_node) + 
 					sn->tsn_AllocLength * sizeof(tek_entity));
 				if (node == node2) break;
@@ -1036,7 +1280,6 @@ static int tek_string_erase(lua_State *L)
 			assert(elen == eraselen);
 #endif
 			s->ts_Length -= eraselen;
-			tek_string_unhint(s, p0);
 #if defined(STATS)
 			if (TISLISTEMPTY(&s->ts_List))
 				s_unpacked--;
@@ -1070,13 +1313,14 @@ static int tek_string_overwrite(lua_State *L)
 	
 	if (!getfirst(s->ts_Length, &p0, 1, s->ts_Length))
 		luaL_error(L, "illegal position");
+	if (s->ts_Length == 0)
+		return 1;
 
+	tek_string_unwidth(s, p0);
 	utf8initreader(&rd, raws, rawlen);
 	
-#if defined(COMPACTION)
-	tek_string_unpack(L, s);
-#endif
-	node = s->ts_List.tlh_Head.tln_Succ;
+	node = &tek_string_getnode(L, s, p0, &pos)->tsn_Node;
+	pos--;
 	
 	for (; (next = node->tln_Succ); node = next)
 	{
@@ -1084,19 +1328,13 @@ static int tek_string_overwrite(lua_State *L)
 		tek_size i, j;
 		tek_char c;
 		
-		if (pos + sn->tsn_Length < p0) 
-		{
-			pos += sn->tsn_Length;
-			continue;
-		}
-		
 		for (i = 0; i < sn->tsn_Length; ++i)
 		{
 			pos++;
 			if (pos < p0) continue;
 			
 			c = utf8read(&rd);
-			if (c < 0) break;
+			if (c < 0) return 1;
 			sn->tsn_Data[i].cdata[0] = c;
 			for (j = 1; j < NUMFIELDS; ++j)
 				sn->tsn_Data[i].cdata[j] = 0;
@@ -1282,6 +1520,7 @@ static int tek_string_setmetadata(lua_State *L)
 			s->ts_UTF8[meta_idx] = tek_string_alloc(s->ts_Length);
 			memset(s->ts_UTF8[meta_idx], 0, s->ts_Length);
 			s->ts_UTF8Len[meta_idx] = s->ts_Length;
+			tek_string_indexutf8(L, s, meta_idx);
 			tek_string_unhint(s, 0);
 		}
 		if (s->ts_UTF8Len[meta_idx] == s->ts_Length)
@@ -1295,16 +1534,12 @@ static int tek_string_setmetadata(lua_State *L)
 #endif
 
 	node = &tek_string_getnode(L, s, p0, &pos)->tsn_Node;
-	for (; (next = node->tln_Succ); node = next)
+	for (; pos <= p1 && (next = node->tln_Succ); node = next)
 	{
 		tek_node *sn = (tek_node *) node;
-		tek_size i;
-		for (i = 0; i < sn->tsn_Length; ++i, ++pos)
-		{
-			if (pos < p0) continue;
-			if (pos > p1) break;
+		tek_size i = p0 > pos ? p0 - pos : 0;
+		for (pos += i; i < sn->tsn_Length && pos <= p1; ++i, ++pos)
 			sn->tsn_Data[i].cdata[meta_idx] = val;
-		}
 	}
 	return 0;
 }
@@ -1350,6 +1585,7 @@ static int tek_string_collect(lua_State *L)
 #if defined(COMPACTION)
 	tek_string_freeutf8(L, s);
 #endif
+	tek_string_freewidths(s);
 #if defined(STATS)
 	s_numstr--;
 	dostats();
@@ -1534,92 +1770,258 @@ static int tek_string_foreachchar(lua_State *L)
 }
 
 /*
-**	text:gettextwidth(tabsize, p0, p1, fixedwidth_or_func[, arg, blankwidth])
-**	func(arg, text, p0, p1): gets raw text width for a range of characters 
+**	text:gettextwidth(tabsize, p0, p1, fixedwidth_or_func[, arg, blankwidth
+**	[, serial]])
+**	func(arg, text, p0, p1): gets raw text width for a range of characters
+**
+**	The x positions after each character are cached in the string, and
+**	remain valid up to the first position modified. Widths of characters
+**	below CHARCACHESIZE are additionally cached per Lua state, so that the
+**	function is called only once for each of them. The cache is keyed by
+**	func, arg, blankwidth and an optional serial number, which the caller
+**	should change when the font changes.
 */
 
-static int tek_string_getrawwidth_int(lua_State *L, int p0, int p1, int fixedfwidth)
+#define CHARCACHESIZE	256
+#define CHARCACHENAME	"widthcache"
+
+typedef struct
+{
+	int tc_BlankWidth;
+	const void *tc_Func;
+	const void *tc_Arg;
+	lua_Integer tc_Serial;
+	int32_t tc_Width[CHARCACHESIZE];	/* -1 = unknown */
+} tek_charcache;
+
+typedef struct
+{
+	int tp_TabSize;
+	int tp_FixedWidth;	/* fixed character width, -1 if function */
+	int tp_BlankWidth;	/* width of a blank character */
+	int tp_FuncIdx;		/* stack index of function, followed by arg */
+	lua_Integer tp_Serial;
+	tek_charcache *tp_CharCache;
+} tek_widthparams;
+
+static void tek_string_getwidthparams(lua_State *L, int tabidx, int funcidx,
+	tek_widthparams *tp)
+{
+	tp->tp_TabSize = luaL_checkinteger(L, tabidx);
+	if (tp->tp_TabSize <= 0)
+		luaL_argerror(L, tabidx, "illegal tab size");
+	tp->tp_FuncIdx = funcidx;
+	tp->tp_CharCache = TNULL;
+	if (lua_type(L, funcidx) != LUA_TFUNCTION)
+	{
+		tp->tp_FixedWidth = luaL_checkinteger(L, funcidx);
+		if (tp->tp_FixedWidth <= 0)
+			luaL_argerror(L, funcidx, "illegal width");
+		tp->tp_BlankWidth = tp->tp_FixedWidth;
+		tp->tp_Serial = 0;
+	}
+	else
+	{
+		tek_charcache *tc;
+		tp->tp_FixedWidth = -1;
+		tp->tp_BlankWidth = luaL_checkinteger(L, funcidx + 2);
+		tp->tp_Serial = lua_isnumber(L, funcidx + 3) ?
+			lua_tointeger(L, funcidx + 3) : 0;
+		lua_getmetatable(L, 1);
+		lua_getfield(L, -1, CHARCACHENAME);
+		tc = lua_touserdata(L, -1);
+		if (tc == TNULL)
+		{
+			tc = lua_newuserdata(L, sizeof(tek_charcache));
+			memset(tc, 0, sizeof(tek_charcache));
+			lua_setfield(L, -3, CHARCACHENAME);
+		}
+		lua_pop(L, 2);
+		if (tc->tc_Func != lua_topointer(L, funcidx) ||
+			tc->tc_Arg != lua_topointer(L, funcidx + 1) ||
+			tc->tc_BlankWidth != tp->tp_BlankWidth ||
+			tc->tc_Serial != tp->tp_Serial)
+		{
+			int i;
+			tc->tc_Func = lua_topointer(L, funcidx);
+			tc->tc_Arg = lua_topointer(L, funcidx + 1);
+			tc->tc_BlankWidth = tp->tp_BlankWidth;
+			tc->tc_Serial = tp->tp_Serial;
+			for (i = 0; i < CHARCACHESIZE; ++i)
+				tc->tc_Width[i] = -1;
+		}
+		tp->tp_CharCache = tc;
+	}
+}
+
+static int tek_string_getcharwidth(lua_State *L, tek_widthparams *tp,
+	tek_size pos, tek_char c)
 {
-	if (fixedfwidth > 0)
-		return (p1 - p0 + 1) * fixedfwidth;
-	lua_pushvalue(L, 5);
-	lua_pushvalue(L, 6);
+	tek_charcache *tc = tp->tp_CharCache;
+	int res;
+	if (tp->tp_FixedWidth > 0)
+		return tp->tp_FixedWidth;
+	if (c < CHARCACHESIZE && tc->tc_Width[c] >= 0)
+		return tc->tc_Width[c];
+	lua_pushvalue(L, tp->tp_FuncIdx);
+	lua_pushvalue(L, tp->tp_FuncIdx + 1);
 	lua_pushvalue(L, 1);
-	lua_pushinteger(L, p0);
-	lua_pushinteger(L, p1);
+	lua_pushinteger(L, pos);
+	lua_pushinteger(L, pos);
 	lua_call(L, 4, 1);
-	int res = lua_tointeger(L, -1);
+	res = lua_tointeger(L, -1);
 	lua_pop(L, 1);
+	if (c < CHARCACHESIZE)
+		tc->tc_Width[c] = res;
 	return res;
 }
 
-static int tek_string_gettextwidth(lua_State *L)
+/*
+**	Get the string's x positions, measured at least up to the given
+**	position. A tabulator advances to the next multiple of tabsize
+**	characters since the previous tabulator.
+*/
+
+static int32_t *tek_string_getwidths(lua_State *L, tek_string *s,
+	tek_widthparams *tp, tek_size p1)
 {
-	tek_string *s = luaL_checkudata(L, 1, TEK_LIB_STRING_NAME "*");
-	int tabsize = luaL_checkinteger(L, 2);
-	int p0 = luaL_checkinteger(L, 3);
-	int p1 = luaL_checkinteger(L, 4);
-	int fixedfwidth = -1; /* fixed character width */
-	int fwidth = -1; /* width of a blank character */
-	
-	if (lua_type(L, 5) != LUA_TFUNCTION)
+	tek_widths *tw = &s->ts_Widths;
+	const void *func = tp->tp_FixedWidth > 0 ? TNULL :
+		lua_topointer(L, tp->tp_FuncIdx);
+	const void *arg = tp->tp_FixedWidth > 0 ? TNULL :
+		lua_topointer(L, tp->tp_FuncIdx + 1);
+	tek_size a;
+
+	if (tw->tw_TabSize != tp->tp_TabSize ||
+		tw->tw_FixedWidth != tp->tp_FixedWidth ||
+		tw->tw_BlankWidth != tp->tp_BlankWidth ||
+		tw->tw_Func != func || tw->tw_Arg != arg ||
+		tw->tw_Serial != tp->tp_Serial)
 	{
-		fixedfwidth = luaL_checkinteger(L, 5);
-		if (fixedfwidth <= 0)
-			luaL_argerror(L, 5, "illegal width");
-		fwidth = fixedfwidth;
+		tw->tw_TabSize = tp->tp_TabSize;
+		tw->tw_FixedWidth = tp->tp_FixedWidth;
+		tw->tw_BlankWidth = tp->tp_BlankWidth;
+		tw->tw_Func = func;
+		tw->tw_Arg = arg;
+		tw->tw_Serial = tp->tp_Serial;
+		tw->tw_NumX = 0;
+		tw->tw_NumTabs = 0;
 	}
-	else
-		fwidth = luaL_checkinteger(L, 7);
-	
-	tek_size len = s->ts_Length;
-	
-	if (p1 < 0)
-		p1 += len + 1;
 
-	int w = 0;
-	if (p1 >= p0 && len > 0)
+	if (p1 + 1 > tw->tw_AllocX)
 	{
-		int a;
-		int oa = 0;
-		int x = 0;
-		int w0 = 0;
-		p0 = TMAX(p0, 1);
-		p1 = TMIN(p1, len);
-		
-		for (a = 1; a <= p1; ++a)
+		tek_size alloc = TMAX(tw->tw_AllocX, 16);
+		int32_t *x;
+		while (alloc < s->ts_Length + 1)
+			alloc <<= 1;
+		x = tek_string_alloc(alloc * sizeof(int32_t));
+		if (x == TNULL)
+			luaL_error(L, "Out of memory");
+		if (tw->tw_X)
+			memcpy(x, tw->tw_X, (tw->tw_NumX + 1) * sizeof(int32_t));
+		else
+			x[0] = 0;
+		tek_string_free(tw->tw_X, tw->tw_AllocX * sizeof(int32_t));
+		tw->tw_X = x;
+		tw->tw_AllocX = alloc;
+	}
+
+	for (a = tw->tw_NumX + 1; a <= p1; ++a)
+	{
+		tek_char c = tek_string_getval_int(L, s, a, TNULL);
+		int32_t x = tw->tw_X[a - 1];
+		if (c == 9)
 		{
-			tek_char c = tek_string_getval_int(L, s, a, TNULL);
-			if (a == p0)
+			tek_size oa = tw->tw_NumTabs > 0 ?
+				tw->tw_Tabs[tw->tw_NumTabs - 1] + 1 : 1;
+			x += (tp->tp_TabSize - ((a - oa) % tp->tp_TabSize)) *
+				tp->tp_BlankWidth;
+			if (tw->tw_NumTabs == tw->tw_AllocTabs)
 			{
-				x += tek_string_getrawwidth_int(L, oa, a - 1, fixedfwidth);
-				w0 = x;
-				oa = a;
-			}
-			if (c == 9)
-			{
-				x += tek_string_getrawwidth_int(L, oa, a - 1, fixedfwidth);
-				int inslen = tabsize - ((a - oa) % tabsize);
-				x += inslen * fwidth;
-				oa = a + 1;
-			}
-			if (a == p1)
-			{
-				x += tek_string_getrawwidth_int(L, oa, a, fixedfwidth);
-				oa = -1;
+				tek_size alloc = TMAX(tw->tw_AllocTabs * 2, 8);
+				tek_size *tabs = tek_string_alloc(alloc * sizeof(tek_size));
+				if (tabs == TNULL)
+					luaL_error(L, "Out of memory");
+				if (tw->tw_Tabs)
+					memcpy(tabs, tw->tw_Tabs,
+						tw->tw_NumTabs * sizeof(tek_size));
+				tek_string_free(tw->tw_Tabs,
+					tw->tw_AllocTabs * sizeof(tek_size));
+				tw->tw_Tabs = tabs;
+				tw->tw_AllocTabs = alloc;
 			}
+			tw->tw_Tabs[tw->tw_NumTabs++] = a;
 		}
-		
-		if (oa > 0)
-			x += tek_string_getrawwidth_int(L, oa, len, fixedfwidth);
-		
-		w = x - w0;
+		else
+			x += tek_string_getcharwidth(L, tp, a, c);
+		tw->tw_X[a] = x;
+		tw->tw_NumX = a;
 	}
-	
+
+	return tw->tw_X;
+}
+
+static int tek_string_gettextwidth(lua_State *L)
+{
+	tek_string *s = luaL_checkudata(L, 1, TEK_LIB_STRING_NAME "*");
+	tek_size p0 = luaL_checkinteger(L, 3);
+	tek_size p1 = luaL_checkinteger(L, 4);
+	tek_size len = s->ts_Length;
+	tek_widthparams tp;
+	int w = 0;
+
+	tek_string_getwidthparams(L, 2, 5, &tp);
+
+	if (p1 < 0)
+		p1 += len + 1;
+	p0 = TMAX(p0, 1);
+	p1 = TMIN(p1, len);
+
+	if (p1 >= p0)
+	{
+		int32_t *x = tek_string_getwidths(L, s, &tp, p1);
+		w = x[p1] - x[p0 - 1];
+	}
+
 	lua_pushinteger(L, w);
 	return 1;
 }
 
+/*
+**	pos = text:getcharbyx(tabsize, x, fixedwidth_or_func[, arg, blankwidth
+**	[, serial]]): Gets the position of the character at the horizontal
+**	position x, or the position following the string if x is beyond its
+**	end; see text:gettextwidth()
+*/
+
+static int tek_string_getcharbyx(lua_State *L)
+{
+	tek_string *s = luaL_checkudata(L, 1, TEK_LIB_STRING_NAME "*");
+	lua_Integer x = luaL_checkinteger(L, 3);
+	tek_size len = s->ts_Length;
+	tek_size p0 = 1, p1 = len + 1;
+	tek_widthparams tp;
+
+	tek_string_getwidthparams(L, 2, 4, &tp);
+
+	if (x >= 0 && len > 0)
+	{
+		int32_t *xp = tek_string_getwidths(L, s, &tp, len);
+		/* find the first character ending beyond x: */
+		while (p0 < p1)
+		{
+			tek_size pn = p0 + (p1 - p0) / 2;
+			if (xp[pn] > x)
+				p1 = pn;
+			else
+				p0 = pn + 1;
+		}
+	}
+
+	lua_pushinteger(L, p0);
+	return 1;
+}
+
 
 /*
 **	text:attachdata(data): Attaches Lua data to a string
@@ -1693,6 +2095,7 @@ static const luaL_Reg tek_string_methods[] =
 	{ "getVisualPos", tek_string_getvisualpos },
 	{ "forEachChar", tek_string_foreachchar },
 	{ "getTextWidth", tek_string_gettextwidth },
+	{ "getCharByX", tek_string_getcharbyx },
 	
 	{ NULL, NULL }
 };
@@ -0,0 +1,395 @@
+/*-----------------------------------------------------------------------------
+--
+--	tek.lib.textfile
+--	Written by agent <agent at local>
+--	See copyright notice in COPYRIGHT
+--
+--	OVERVIEW::
+--		Read-only access to the lines of a text file, as used by
+--		[[#tek.class.textdocument : TextDocument]]. The file is mapped into
+--		memory (or read in one piece on platforms without mmap), and its
+--		lines are counted when it is opened. Only the start of every 64th
+--		line is indexed; a line is located by scanning from the nearest
+--		index entry, or from the line following the one last accessed.
+--		Lines are separated by {{"\n"}} or {{"\r\n"}}, like in
+--		TextEdit.breakText(). Lines are returned as raw strings, no
+--		decoding takes place.
+--
+--		The file must not be truncated by another process while it is open.
+--
+--	FUNCTIONS::
+--		- TextFile:close() - Closes the file
+--		- TextFile:find() - Finds the next line containing a string
+--		- TextFile:getLine() - Returns the text of a line
+--		- TextFile:getN() - Returns the number of lines
+--		- TextFile.open() - Opens a text file
+--		- TextFile:sameFile() - Tests whether a name refers to the file
+--
+-------------------------------------------------------------------------------
+
+module "tek.lib.textfile"
+_VERSION = "TextFile 1.0"
+local TextFile = _M
+
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tek/lib/tek_lua.h>
+#include <tek/teklib.h>
+#include <tek/lib/tekui.h>
+
+#if defined(TSYS_POSIX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define TEK_LIB_TEXTFILE_VERSION	"TextFile 1.0"
+#define TEK_LIB_TEXTFILE_NAME		"tek.lib.textfile"
+
+/* lines per entry in the line index: */
+#define TEXTFILE_INDEXSTEP	64
+
+/*****************************************************************************/
+
+typedef struct
+{
+	const char *tf_Data;	/* file contents */
+	size_t tf_Size;			/* size of file contents */
+	int tf_Mapped;			/* contents are mapped, not allocated */
+	size_t tf_NumLines;
+	size_t *tf_Index;		/* offset of every TEXTFILE_INDEXSTEP-th line */
+	size_t tf_HintLine;		/* line at tf_HintOffset, 0 = none */
+	size_t tf_HintOffset;
+#if defined(TSYS_POSIX)
+	dev_t tf_Device;		/* identity of the file opened */
+	ino_t tf_Inode;
+#endif
+} tek_textfile;
+
+/*****************************************************************************/
+/*
+**	count lines and build the line index
+*/
+
+static int tek_textfile_index(tek_textfile *tf)
+{
+	const char *p = tf->tf_Data;
+	const char *e = p + tf->tf_Size;
+	size_t numindex = 0, allocindex = 64;
+	size_t lnr = 0;
+	tf->tf_Index = malloc(allocindex * sizeof(size_t));
+	if (tf->tf_Index == TNULL)
+		return 0;
+	for (;;)
+	{
+		if (lnr % TEXTFILE_INDEXSTEP == 0)
+		{
+			if (numindex == allocindex)
+			{
+				size_t *newindex;
+				allocindex *= 2;
+				newindex = realloc(tf->tf_Index, allocindex * sizeof(size_t));
+				if (newindex == TNULL)
+					return 0;
+				tf->tf_Index = newindex;
+			}
+			tf->tf_Index[numindex++] = p - tf->tf_Data;
+		}
+		lnr++;
+		p = p < e ? memchr(p, '\n', e - p) : TNULL;
+		if (p == TNULL)
+			break;
+		p++;
+	}
+	tf->tf_NumLines = lnr;
+	return 1;
+}
+
+/*
+**	get offset of a line, scanning from the index or from the hint
+*/
+
+static size_t tek_textfile_seek(tek_textfile *tf, size_t lnr)
+{
+	size_t k = (lnr - 1) / TEXTFILE_INDEXSTEP;
+	size_t line = k * TEXTFILE_INDEXSTEP + 1;
+	size_t offs = tf->tf_Index[k];
+	const char *p;
+	if (tf->tf_HintLine > line && tf->tf_HintLine <= lnr)
+	{
+		line = tf->tf_HintLine;
+		offs = tf->tf_HintOffset;
+	}
+	p = tf->tf_Data + offs;
+	for (; line < lnr; ++line)
+		p = (const char *) memchr(p, '\n', tf->tf_Size - (p - tf->tf_Data)) + 1;
+	tf->tf_HintLine = lnr;
+	tf->tf_HintOffset = p - tf->tf_Data;
+	return tf->tf_HintOffset;
+}
+
+static const char *tek_textfile_search(const char *p, size_t len,
+	const char *s, size_t slen)
+{
+	const char *e = p + len;
+	while ((size_t) (e - p) >= slen)
+	{
+		p = memchr(p, s[0], e - p - slen + 1);
+		if (p == TNULL)
+			break;
+		if (memcmp(p, s, slen) == 0)
+			return p;
+		p++;
+	}
+	return TNULL;
+}
+
+static void tek_textfile_free(tek_textfile *tf)
+{
+	if (tf->tf_Data)
+	{
+#if defined(TSYS_POSIX)
+		if (tf->tf_Mapped)
+			munmap((void *) tf->tf_Data, tf->tf_Size);
+		else
+#endif
+			free((void *) tf->tf_Data);
+	}
+	free(tf->tf_Index);
+	memset(tf, 0, sizeof(tek_textfile));
+}
+
+static tek_textfile *tek_textfile_check(lua_State *L)
+{
+	tek_textfile *tf = luaL_checkudata(L, 1, TEK_LIB_TEXTFILE_NAME "*");
+	if (tf->tf_Index == TNULL)
+		luaL_error(L, "text file closed");
+	return tf;
+}
+
+/*-----------------------------------------------------------------------------
+--	file[, msg] = TextFile.open(filename): Opens a text file for reading.
+--	Returns '''nil''' and an error message if the file cannot be opened.
+-----------------------------------------------------------------------------*/
+
+static int tek_textfile_open(lua_State *L)
+{
+	const char *fname = luaL_checkstring(L, 1);
+	tek_textfile *tf = lua_newuserdata(L, sizeof(tek_textfile));
+	int success = 0;
+	memset(tf, 0, sizeof(tek_textfile));
+	luaL_getmetatable(L, TEK_LIB_TEXTFILE_NAME "*");
+	lua_setmetatable(L, -2);
+#if defined(TSYS_POSIX)
+	{
+		int fd = open(fname, O_RDONLY);
+		if (fd >= 0)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0)
+			{
+				tf->tf_Device = st.st_dev;
+				tf->tf_Inode = st.st_ino;
+				tf->tf_Size = st.st_size;
+				if (tf->tf_Size == 0)
+					success = 1;
+				else
+				{
+					void *p = mmap(TNULL, tf->tf_Size, PROT_READ, MAP_PRIVATE,
+						fd, 0);
+					if (p != MAP_FAILED)
+					{
+						tf->tf_Data = p;
+						tf->tf_Mapped = 1;
+						success = 1;
+					}
+				}
+			}
+			close(fd);
+		}
+	}
+#else
+	{
+		FILE *f = fopen(fname, "rb");
+		if (f)
+		{
+			long size;
+			if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 &&
+				fseek(f, 0, SEEK_SET) == 0)
+			{
+				tf->tf_Size = size;
+				tf->tf_Data = malloc(size + 1);
+				if (tf->tf_Data &&
+					fread((void *) tf->tf_Data, 1, size, f) == (size_t) size)
+					success = 1;
+			}
+			fclose(f);
+		}
+	}
+#endif
+	if (success && !tek_textfile_index(tf))
+	{
+		tek_textfile_free(tf);
+		luaL_error(L, "out of memory");
+	}
+	if (!success)
+	{
+		tek_textfile_free(tf);
+		lua_pushnil(L);
+		lua_pushfstring(L, "cannot open %s", fname);
+		return 2;
+	}
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	TextFile:close(): Closes the file and releases its contents. This is
+--	also done when the object is collected.
+-----------------------------------------------------------------------------*/
+
+static int tek_textfile_close(lua_State *L)
+{
+	tek_textfile_free(luaL_checkudata(L, 1, TEK_LIB_TEXTFILE_NAME "*"));
+	return 0;
+}
+
+/*-----------------------------------------------------------------------------
+--	n = TextFile:getN(): Returns the number of lines in the file. A file
+--	has at least one line, which may be empty.
+-----------------------------------------------------------------------------*/
+
+static int tek_textfile_getn(lua_State *L)
+{
+	tek_textfile *tf = tek_textfile_check(L);
+	lua_pushinteger(L, tf->tf_NumLines);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	text = TextFile:getLine(lnr): Returns the text of the specified line,
+--	without the line ending, or '''nil''' if the line is out of range.
+-----------------------------------------------------------------------------*/
+
+static int tek_textfile_getline(lua_State *L)
+{
+	tek_textfile *tf = tek_textfile_check(L);
+	lua_Integer lnr = luaL_checkinteger(L, 2);
+	const char *p, *e;
+	size_t len;
+	if (lnr < 1 || lnr > (lua_Integer) tf->tf_NumLines)
+		return 0;
+	p = tf->tf_Data + tek_textfile_seek(tf, lnr);
+	len = tf->tf_Size - (p - tf->tf_Data);
+	e = len > 0 ? memchr(p, '\n', len) : TNULL;
+	if (e)
+	{
+		/* the next line is most likely to be accessed next: */
+		tf->tf_HintLine = lnr + 1;
+		tf->tf_HintOffset = e + 1 - tf->tf_Data;
+		len = e - p;
+		if (len > 0 && p[len - 1] == '\r')
+			len--;
+	}
+	lua_pushlstring(L, len > 0 ? p : "", len);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	lnr = TextFile:find(string[, lnr0[, lnr1]]): Returns the number of the
+--	first line from {{lnr0}} to {{lnr1}} containing the given string, or
+--	'''nil''' if no such line is found. The string is compared byte by
+--	byte. The default range is from the first to the last line.
+-----------------------------------------------------------------------------*/
+
+static int tek_textfile_find(lua_State *L)
+{
+	tek_textfile *tf = tek_textfile_check(L);
+	size_t slen;
+	const char *s = luaL_checklstring(L, 2, &slen);
+	lua_Integer lnr = luaL_optinteger(L, 3, 1);
+	lua_Integer lnr1 = luaL_optinteger(L, 4, tf->tf_NumLines);
+	size_t end = tf->tf_Size;
+	const char *p, *f, *nl;
+	if (lnr < 1 || lnr > lnr1 || lnr > (lua_Integer) tf->tf_NumLines)
+		return 0;
+	if (slen == 0)
+	{
+		lua_pushinteger(L, lnr);
+		return 1;
+	}
+	if (lnr1 < (lua_Integer) tf->tf_NumLines)
+		end = tek_textfile_seek(tf, lnr1 + 1);
+	p = tf->tf_Data + tek_textfile_seek(tf, lnr);
+	f = tek_textfile_search(p, end - (p - tf->tf_Data), s, slen);
+	if (f == TNULL)
+		return 0;
+	/* count the line breaks before the match: */
+	while ((nl = memchr(p, '\n', f - p)))
+	{
+		p = nl + 1;
+		lnr++;
+	}
+	tf->tf_HintLine = lnr;
+	tf->tf_HintOffset = p - tf->tf_Data;
+	lua_pushinteger(L, lnr);
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------
+--	same = TextFile:sameFile(filename): Returns '''true''' if the specified
+--	name refers to the file that was opened, also through another path or
+--	a link. On platforms where this cannot be determined, '''true''' is
+--	returned.
+-----------------------------------------------------------------------------*/
+
+static int tek_textfile_samefile(lua_State *L)
+{
+	tek_textfile *tf = tek_textfile_check(L);
+	const char *fname = luaL_checkstring(L, 2);
+#if defined(TSYS_POSIX)
+	struct stat st;
+	lua_pushboolean(L, stat(fname, &st) == 0 &&
+		st.st_dev == tf->tf_Device && st.st_ino == tf->tf_Inode);
+#else
+	(void) tf;
+	(void) fname;
+	lua_pushboolean(L, 1);
+#endif
+	return 1;
+}
+
+/*****************************************************************************/
+
+static const luaL_Reg tek_textfile_funcs[] =
+{
+	{ "open", tek_textfile_open },
+	{ NULL, NULL }
+};
+
+static const luaL_Reg tek_textfile_methods[] =
+{
+	{ "__gc", tek_textfile_close },
+	{ "close", tek_textfile_close },
+	{ "find", tek_textfile_find },
+	{ "getLine", tek_textfile_getline },
+	{ "getN", tek_textfile_getn },
+	{ "sameFile", tek_textfile_samefile },
+	{ NULL, NULL }
+};
+
+TMODENTRY int luaopen_tek_lib_textfile(lua_State *L)
+{
+	tek_lua_register(L, TEK_LIB_TEXTFILE_NAME, tek_textfile_funcs, 0);
+	lua_pushstring(L, TEK_LIB_TEXTFILE_VERSION);
+	lua_setfield(L, -2, "_VERSION");
+	luaL_newmetatable(L, TEK_LIB_TEXTFILE_NAME "*");
+	tek_lua_register(L, NULL, tek_textfile_methods, 0);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+	return 1;
+}
@@ -25,6 +25,7 @@
 --		- Visual:getAttrs() - Retrieve attributes from a visual
 --		- Visual:getClipRect() - Get active clipping rectangle
 --		- Visual.getDisplayAttrs() - Get attributes from the display
+--		- Visual.getCacheStats() - Get statistics of the pixmap cache
 --		- Visual.getFontAttrs() - Get font attributes
 --		- Visual.getMsg() - Get next input message
 --		- Visual:getPaintInfo() - Get type of the background paint
@@ -37,6 +38,7 @@
 --		- Visual:pushClipRect() - Push rectangle on stack of clip rects
 --		- Visual:setAttrs() - Set attributes in visual
 --		- Visual:setBGPen() - Set visual's background pen, pixmap or gradient
+--		- Visual.setCacheSize() - Set the budget of the pixmap cache
 --		- Visual:setClipRect() - Set clipping rectangle
 --		- Visual:setFont() - Set the visual's current font
 --		- Visual:setInput() - Add input sources
@@ -59,9 +61,13 @@ local Visual = _M
 
 #include <string.h>
 #include "visual_lua.h"
+#include <tek/mod/exec.h>
 #include <tek/lib/pixconv.h>
 #include <tek/lib/imgload.h>
 #include <tek/lib/tek_lua.h>
+#if defined(ENABLE_PIXMAP_CACHE)
+#include <tek/lib/cachemanager.h>
+#endif
 
 /*****************************************************************************/
 /*
@@ -216,8 +222,10 @@ tek_lib_visual_wait(lua_State *L)
 	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_VISUAL_BASECLASSNAME);
 	vis = lua_touserdata(L, -1);
 	TExecBase = vis->vis_ExecBase;
-	vis->vis_SignalsPending |= TWait(TGetPortSignal(vis->vis_IMsgPort) | 
-		TTASK_SIG_ABORT | TTASK_SIG_TERM | TTASK_SIG_CHLD);
+	/* messages taken from the port are no longer signalled */
+	if (TISLISTEMPTY(&vis->vis_IMsgList))
+		vis->vis_SignalsPending |= TWait(TGetPortSignal(vis->vis_IMsgPort) | 
+			TTASK_SIG_ABORT | TTASK_SIG_TERM | TTASK_SIG_CHLD);
 	if (vis->vis_SignalsPending & TTASK_SIG_ABORT)
 		luaL_error(L, "received abort signal");
 	lua_pop(L, 1);
@@ -273,6 +281,78 @@ tek_lib_visual_getdisplayattrs(lua_State *L)
 	return narg;
 }
 
+/*-----------------------------------------------------------------------------
+--	hits, misses, evictions, bytes, peak, max, items, keys =
+--	Visual.getCacheStats(): Returns the number of lookups in the pixmap cache
+--	that were found and not found, the number of cached images that were
+--	evicted to stay within the budget, the number of bytes in use, the
+--	highest number of bytes that were in use, the budget in bytes (0 for
+--	unlimited), and the number of cached images and keys. Returns nothing
+--	if tekUI was built without the pixmap cache.
+-----------------------------------------------------------------------------*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_getcachestats(lua_State *L)
+{
+#if defined(ENABLE_PIXMAP_CACHE)
+	TSIZE stats[8];
+	TTAGITEM tags[9];
+	TUINT i;
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_VISUAL_BASECLASSNAME);
+	TEKVisual *vis = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	struct THandle *cache = vis->vis_CacheManager;
+	struct CacheManagerIFace *iface = (struct CacheManagerIFace *)
+		TCallHookPkt(&cache->thn_Hook, cache, CacheManagerMsgQueryIFace);
+	tags[0].tti_Tag = CacheManager_Hits;
+	tags[1].tti_Tag = CacheManager_Misses;
+	tags[2].tti_Tag = CacheManager_Evictions;
+	tags[3].tti_Tag = CacheManager_AllocBytes;
+	tags[4].tti_Tag = CacheManager_PeakBytes;
+	tags[5].tti_Tag = CacheManager_MaxBytes;
+	tags[6].tti_Tag = CacheManager_NumItems;
+	tags[7].tti_Tag = CacheManager_NumRecords;
+	tags[8].tti_Tag = TTAG_DONE;
+	for (i = 0; i < 8; ++i)
+	{
+		stats[i] = 0;
+		tags[i].tti_Value = (TTAG) &stats[i];
+	}
+	iface->getattrs(cache, tags);
+	for (i = 0; i < 8; ++i)
+		lua_pushnumber(L, (lua_Number) stats[i]);
+	return 8;
+#else
+	return 0;
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+--	Visual.setCacheSize(bytes): Sets the budget of the pixmap cache in bytes,
+--	evicting the least recently used images if necessary. A budget of 0
+--	means unlimited. The default is 1000000 bytes.
+-----------------------------------------------------------------------------*/
+
+LOCAL LUACFUNC TINT
+tek_lib_visual_setcachesize(lua_State *L)
+{
+#if defined(ENABLE_PIXMAP_CACHE)
+	TTAGITEM tags[2];
+	lua_Number bytes = luaL_checknumber(L, 1);
+	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_VISUAL_BASECLASSNAME);
+	TEKVisual *vis = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	struct THandle *cache = vis->vis_CacheManager;
+	struct CacheManagerIFace *iface = (struct CacheManagerIFace *)
+		TCallHookPkt(&cache->thn_Hook, cache, CacheManagerMsgQueryIFace);
+	tags[0].tti_Tag = CacheManager_MaxBytes;
+	tags[0].tti_Value = (TTAG) (TSIZE) (bytes > 0 ? bytes : 0);
+	tags[1].tti_Tag = TTAG_DONE;
+	iface->setattrs(cache, tags);
+#endif
+	return 0;
+}
+
 /*-----------------------------------------------------------------------------
 --	sec, millis = Visual.getTime(): Returns the system time in seconds and
 --	milliseconds.
@@ -499,12 +579,12 @@ tek_lib_visual_flush(lua_State *L)
 	TEKVisual *vis = checkvisptr(L, 1);
 	if (vis->vis_FlushReq && (vis->vis_Dirty || lua_toboolean(L, 2)))
 	{
-		struct TExecBase *TExecBase = vis->vis_ExecBase;
-		struct TVRequest *req = vis->vis_FlushReq;
-		req->tvr_Req.io_ReplyPort = TGetSyncPort(TNULL);
-		TDoIO(&req->tvr_Req);
+		/* submits buffered commands and the flush in one request: */
+		TVisualFlush(vis->vis_Visual, TTRUE);
 		vis->vis_Dirty = TFALSE;
 	}
+	else if (vis->vis_Visual)
+		TVisualFlush(vis->vis_Visual, TFALSE);
 	lua_pop(L, 1);
 	return 0;
 }
@@ -729,6 +809,7 @@ tek_lib_visual_getmsg(lua_State *L)
 	TEKVisual *vis;
 	TIMSG *imsg;
 	tek_msg *tmsg;
+	struct TNode *node;
 	
 	lua_getfield(L, LUA_REGISTRYINDEX, TEK_LIB_VISUAL_BASECLASSNAME);
 	/* s: visbase */
@@ -738,7 +819,13 @@ tek_lib_visual_getmsg(lua_State *L)
 	if (/*!(imsg = tek_lib_visual_getsigmsg(vis, TTASK_SIG_ABORT)) &&*/
 		!(imsg = tek_lib_visual_getsigmsg(vis, TTASK_SIG_CHLD)) &&
 		!(imsg = tek_lib_visual_getsigmsg(vis, TTASK_SIG_TERM)))
-		imsg = (TIMSG *) TGetMsg(vis->vis_IMsgPort);
+	{
+		/* deliver from a batch taken from the port at once */
+		node = TRemHead(&vis->vis_IMsgList);
+		if (node == TNULL && TGetMsgs(vis->vis_IMsgPort, &vis->vis_IMsgList, 0))
+			node = TRemHead(&vis->vis_IMsgList);
+		imsg = node ? (TIMSG *) TGETMSGBODY(node) : TNULL;
+	}
 
 	if (imsg == TNULL)
 	{
@@ -802,6 +889,7 @@ static TINT tek_lib_visual_createpixmap_from_img(lua_State *L)
 			ld.iml_Flags &= ~IMLFL_HAS_ALPHA;
 	}
 	pm->pxm_VisualBase = vis;
+	pm->pxm_Buffer = TNULL;
 	
 	lua_pushinteger(L, pm->pxm_Width);
 	lua_pushinteger(L, pm->pxm_Height);
@@ -848,6 +936,7 @@ tek_lib_visual_createpixmap_from_table(lua_State *L)
 	bm->pxm_Height = th;
 	bm->pxm_Flags = has_alpha ? IMLFL_HAS_ALPHA : 0;
 	bm->pxm_VisualBase = vis;
+	bm->pxm_Buffer = TNULL;
 	
 	for (y = 0; y < th; ++y)
 	{
@@ -884,10 +973,21 @@ tek_lib_visual_createpixmap(lua_State *L)
 	return tek_lib_visual_createpixmap_from_img(L);
 }
 
+static void
+tek_lib_visual_freepixmapbuffer(TEKPixmap *pm)
+{
+	if (pm->pxm_Buffer)
+	{
+		TVisualFreeBuffer(pm->pxm_VisualBase->vis_Base, pm->pxm_Buffer);
+		pm->pxm_Buffer = TNULL;
+	}
+}
+
 LOCAL LUACFUNC TINT
 tek_lib_visual_freepixmap(lua_State *L)
 {
 	TEKPixmap *bm = getpixmapptr(L, 1);
+	tek_lib_visual_freepixmapbuffer(bm);
 	if (bm->pxm_Image.tpb_Data)
 	{
 		TEKVisual *vis = bm->pxm_VisualBase;
@@ -945,6 +1045,8 @@ tek_lib_visual_setpixmap(lua_State *L)
 		if (y < 0 || y >= bm->pxm_Height)
 			luaL_argerror(L, 3, "Invalid position");
 		pixconv_setpixelbuf(&bm->pxm_Image, x, y, val);
+		/* registered copy is outdated, register again when drawn: */
+		tek_lib_visual_freepixmapbuffer(bm);
 	}
 	return 0;
 }
@@ -1075,6 +1177,29 @@ tek_lib_visual_frectpixmap(lua_State *L, TEKVisual *vis, TEKPixmap *pm,
 		y = y0;
 	}
 	
+	if (!(pm->pxm_Flags & PXMFL_NOBUFFER) && pm->pxm_Buffer == TNULL)
+	{
+		pm->pxm_Buffer = TVisualAllocBuffer(vis->vis_Visual, buf, tw, th,
+			tw, tags);
+		if (pm->pxm_Buffer == TNULL)
+			pm->pxm_Flags |= PXMFL_NOBUFFER;
+	}
+	
+	if (pm->pxm_Buffer)
+	{
+		/* display fills the rectangle from its own copy: */
+		TTAGITEM btags[4];
+		btags[0].tti_Tag = TVisual_Buffer;
+		btags[0].tti_Value = (TTAG) pm->pxm_Buffer;
+		btags[1].tti_Tag = TVisual_OrigX;
+		btags[1].tti_Value = ox;
+		btags[2].tti_Tag = TVisual_OrigY;
+		btags[2].tti_Value = oy;
+		btags[3].tti_Tag = TTAG_DONE;
+		TVisualDrawBuffer(vis->vis_Visual, x0, y0, TNULL, w, h, 0, btags);
+		return;
+	}
+	
 	yo = (y0 - oy) % th;
 	if (yo < 0) yo += th;
 	th0 = th - yo;
@@ -1155,6 +1280,49 @@ static void getS2(vec r0, vec u, int Ar, int Ag, int Ab, int Dr, int Dg,
 	*pf = f * 256;
 }
 
+/*
+**	Generate n pixels of a gradient that changes only along one axis,
+**	starting at position t0 on that axis, relative to the texture origin.
+**	Positions before A get A's color, positions after B get B's color.
+*/
+
+static void
+tek_lib_visual_gradientstrip(TEKGradient *gr, TUINT *buf, TINT t0, TINT n)
+{
+	TINT a, b, i, s;
+	TINT Ar = gr->A.r, Ag = gr->A.g, Ab = gr->A.b;
+	TINT Dr = gr->B.r - Ar, Dg = gr->B.g - Ag, Db = gr->B.b - Ab;
+	TUINT ca = (Ar << 16) | (Ag << 8) | Ab;
+	TUINT cb = ((TUINT) gr->B.r << 16) | ((TUINT) gr->B.g << 8) | 
+		(TUINT) gr->B.b;
+	if (gr->axis == GRADIENT_AXIS_X)
+	{
+		a = gr->A.vec.x;
+		b = gr->B.vec.x;
+	}
+	else
+	{
+		a = gr->A.vec.y;
+		b = gr->B.vec.y;
+	}
+	TINT len = b > a ? b - a : a - b;
+	TINT dir = b > a ? 1 : -1;
+	/* s is the distance from A towards B, advanced by one per pixel: */
+	s = (t0 - a) * dir;
+	for (i = 0; i < n; ++i, s += dir)
+	{
+		if (s <= 0)
+			buf[i] = ca;
+		else if (s >= len)
+			buf[i] = cb;
+		else
+			buf[i] = 
+				((TUINT) ((Ar * len + Dr * s) / len) << 16) |
+				((TUINT) ((Ag * len + Dg * s) / len) << 8) |
+				(TUINT) ((Ab * len + Db * s) / len);
+	}
+}
+
 static void
 tek_lib_visual_frectgradient(lua_State *L, TEKVisual *vis, TEKGradient *gr,
 	TINT x0, TINT y0, TINT w, TINT h, TINT ox, TINT oy)
@@ -1169,6 +1337,26 @@ tek_lib_visual_frectgradient(lua_State *L, TEKVisual *vis, TEKGradient *gr,
 	
 	TTAGITEM tags[2];
 	tags[0].tti_Tag = TTAG_DONE;
+	
+	if (gr->axis != GRADIENT_AXIS_NONE && vis->vis_VisBase->vis_HaveStrips)
+	{
+		/* all rows or all columns are equal, let the display repeat one: */
+		TBOOL column = gr->axis == GRADIENT_AXIS_Y;
+		TINT n = column ? h : w;
+		TUINT *buf = TExecAlloc(vis->vis_ExecBase, TNULL, n * sizeof(TUINT));
+		if (buf)
+		{
+			tek_lib_visual_gradientstrip(gr, buf, column ? y0 - oy : x0 - ox,
+				n);
+			tags[0].tti_Tag = TVisual_Strip;
+			tags[0].tti_Value = column ? TVSTRIP_COLUMN : TVSTRIP_ROW;
+			tags[1].tti_Tag = TTAG_DONE;
+			TVisualDrawBuffer(vis->vis_Visual, x0, y0, buf, w, h, 
+				column ? 1 : w, tags);
+			TExecFree(vis->vis_ExecBase, buf);
+			return;
+		}
+	}
 
 #if defined(ENABLE_PIXMAP_CACHE)
 	struct 
@@ -2455,6 +2643,11 @@ LOCAL LUACFUNC TINT tek_lib_visual_creategradient(lua_State *L)
 	gr->B.r = (rgb1 & 0xff0000) >> 16;
 	gr->B.g = (rgb1 & 0xff00) >> 8;
 	gr->B.b = rgb1 & 0xff;
+	gr->axis = GRADIENT_AXIS_NONE;
+	if (gr->A.vec.y == gr->B.vec.y && gr->A.vec.x != gr->B.vec.x)
+		gr->axis = GRADIENT_AXIS_X;
+	else if (gr->A.vec.x == gr->B.vec.x && gr->A.vec.y != gr->B.vec.y)
+		gr->axis = GRADIENT_AXIS_Y;
 	luaL_newmetatable(L, TEK_LIB_VISUALGRADIENT_CLASSNAME);
 	lua_setmetatable(L, -2);
 #else
@@ -211,6 +211,7 @@ getusermsg(TEKVisual *vis, TIMSG **msgptr, TUINT type, TSIZE size)
 struct IOData
 {
 	TEKVisual *vis;
+	struct TMemManager *msgpool;
 	char atomname[256];
 #if defined(ENABLE_FILENO) || defined(ENABLE_DGRAM)
 	struct THook mphook;
@@ -459,18 +460,23 @@ LOCAL TBOOL tek_lib_visual_io_open(TEKVisual *vis)
 	struct IOData *iodata = TAlloc(TNULL, sizeof(struct IOData));
 	if (iodata)
 	{
-		TTAGITEM tags[2];
+		TTAGITEM tags[3];
 		sprintf(iodata->atomname, "msgport.ui.%p", TFindTask(TNULL));
 		iodata->vis = vis;
+		/* recycle user input messages */
+		iodata->msgpool = TCreateMemManager(TNULL, TMMT_Message, TNULL);
 		vis->vis_IOData = iodata;
 		tags[0].tti_Tag = TTask_UserData;
 		tags[0].tti_Value = (TTAG) iodata;
-		tags[1].tti_Tag = TTAG_DONE;
+		tags[1].tti_Tag = TTask_MsgMemManager;
+		tags[1].tti_Value = (TTAG) iodata->msgpool;
+		tags[2].tti_Tag = TTAG_DONE;
 		struct THook taskhook;
 		TInitHook(&taskhook, tek_lib_visual_io_dispatch, TNULL);
 		vis->vis_IOTask = TCreateTask(&taskhook, tags);
 		if (vis->vis_IOTask)
 			return TTRUE;
+		TDestroy((struct THandle *) iodata->msgpool);
 		TFree(iodata);
 		vis->vis_IOData = TNULL;
 	}
@@ -482,14 +488,15 @@ LOCAL void tek_lib_visual_io_close(TEKVisual *vis)
 	if (vis->vis_IOTask)
 	{
 		struct TExecBase *TExecBase = vis->vis_ExecBase;
+		struct IOData *iodata = vis->vis_IOData;
 		TSignal(vis->vis_IOTask, TTASK_SIG_ABORT);
 		#if defined(ENABLE_FILENO) || defined(ENABLE_DGRAM)
-		struct IOData *iodata = vis->vis_IOData;
 		tek_lib_visual_io_wake(iodata);
 		#endif
 		TDestroy((struct THandle *) vis->vis_IOTask);
 		vis->vis_IOTask = TNULL;
-		TFree(vis->vis_IOData);
+		TDestroy((struct THandle *) iodata->msgpool);
+		TFree(iodata);
 		vis->vis_IOData = TNULL;
 	}
 }
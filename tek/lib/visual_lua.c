@@ -41,6 +41,8 @@ static const luaL_Reg tek_lib_visual_funcs[] =
 	{ "createPixmap", tek_lib_visual_createpixmap },
 	{ "createGradient", tek_lib_visual_creategradient },
 	{ "getDisplayAttrs", tek_lib_visual_getdisplayattrs },
+	{ "getCacheStats", tek_lib_visual_getcachestats },
+	{ "setCacheSize", tek_lib_visual_setcachesize },
 	{ TNULL, TNULL }
 };
 
@@ -105,7 +107,7 @@ static const luaL_Reg tek_lib_visual_pixmapmethods[] =
 LOCAL LUACFUNC TINT
 tek_lib_visual_open(lua_State *L)
 {
-	TTAGITEM tags[22], *tp = tags;
+	TTAGITEM tags[23], *tp = tags;
 	TEKVisual *visbase, *vis;
 
 	vis = lua_newuserdata(L, sizeof(TEKVisual));
@@ -302,6 +304,9 @@ tek_lib_visual_open(lua_State *L)
 	tp->tti_Tag = TVisual_IMsgPort;
 	tp++->tti_Value = (TTAG) visbase->vis_IMsgPort;
 
+	tp->tti_Tag = TVisual_CmdBuffer;
+	tp++->tti_Value = TTRUE;
+
 	
 	tp->tti_Tag = TTAG_DONE;
 
@@ -413,6 +418,16 @@ tek_lib_visual_close(lua_State *L)
 			}
 		}
 		THALUnlock(visbase->vis_ExecBase->texb_HALBase, &port->tmp_Lock);
+		node = visbase->vis_IMsgList.tlh_Head.tln_Succ;
+		for (; (next = node->tln_Succ); node = next)
+		{
+			TIMSG *imsg = TGETMSGBODY(node);
+			if (imsg->timsg_UserData == vis->vis_refSelf)
+			{
+				TRemove(node);
+				TAddTail(&tmplist, node);
+			}
+		}
 
 		while ((node = TRemHead(&tmplist)))
 			TAckMsg(TGETMSGBODY(node));
@@ -454,6 +469,12 @@ tek_lib_visual_close(lua_State *L)
 	{
 		tek_lib_visual_io_close(vis);
 		
+		if (vis->vis_IMsgPort)
+		{
+			struct TNode *node;
+			while ((node = TRemHead(&vis->vis_IMsgList)))
+				TAckMsg(TGETMSGBODY(node));
+		}
 		TDestroy((struct THandle *) vis->vis_IMsgPort);
 		TDestroy((struct THandle *) vis->vis_CmdRPort);
 		if (vis->vis_Base)
@@ -596,25 +617,34 @@ TMODENTRY int luaopen_tek_lib_visual(lua_State *L)
 	for (;;)
 	{
 		TTAGITEM ftags[2];
-		TTAGITEM dtags[4];
+		TTAGITEM dtags[5];
 
 		/* Open the Visual module: */
 		vis->vis_Base = TOpenModule("visual", 0, TNULL);
 		if (vis->vis_Base == TNULL)
 			break;
-		vis->vis_CmdRPort = TCreatePort(TNULL);
+		/* only waited on with TWaitIO(), replies can be queued lock-free */
+		ftags[0].tti_Tag = TMsgPort_LockFree;
+		ftags[0].tti_Value = TTRUE;
+		ftags[1].tti_Tag = TTAG_DONE;
+		vis->vis_CmdRPort = TCreatePort(ftags);
 		if (vis->vis_CmdRPort == TNULL) 
 			break;
 		vis->vis_IMsgPort = TCreatePort(TNULL);
 		if (vis->vis_IMsgPort == TNULL) 
 			break;
+		TInitList(&vis->vis_IMsgList);
 #if defined(ENABLE_PIXMAP_CACHE)
-		vis->vis_CacheManager = cachemanager_create(TExecBase);
+		dtags[0].tti_Tag = CacheManager_MaxBytes;
+		dtags[0].tti_Value = (TTAG) CACHEMANAGER_DEF_MAXBYTES;
+		dtags[1].tti_Tag = TTAG_DONE;
+		vis->vis_CacheManager = cachemanager_create(TExecBase, dtags);
 		if (!vis->vis_CacheManager)
 			break;
 #endif
 		
 		vis->vis_HaveWindowManager = TTRUE;
+		vis->vis_HaveStrips = TFALSE;
 		/* Open a display: */
 		dtags[0].tti_Tag = TVisual_DisplayName;
 		dtags[0].tti_Value = (TTAG) "display_" DISPLAY_DRIVER;
@@ -622,7 +652,9 @@ TMODENTRY int luaopen_tek_lib_visual(lua_State *L)
 		dtags[1].tti_Value = (TTAG) vis->vis_IMsgPort;
 		dtags[2].tti_Tag = TVisual_HaveWindowManager;
 		dtags[2].tti_Value = (TTAG) &vis->vis_HaveWindowManager;
-		dtags[3].tti_Tag = TTAG_DONE;
+		dtags[3].tti_Tag = TVisual_HaveStrips;
+		dtags[3].tti_Value = (TTAG) &vis->vis_HaveStrips;
+		dtags[4].tti_Tag = TTAG_DONE;
 		vis->vis_Display = TVisualOpenDisplay(vis->vis_Base, dtags);
 		if (vis->vis_Display == TNULL)
 		{
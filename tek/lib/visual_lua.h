@@ -93,6 +93,8 @@ typedef struct TEKVisual
 
 	struct TMsgPort *vis_CmdRPort;
 	struct TMsgPort *vis_IMsgPort;
+	/* Input messages taken from vis_IMsgPort, not yet delivered */
+	struct TList vis_IMsgList;
 	
 	TINT *vis_DrawBuffer;
 	
@@ -114,6 +116,7 @@ typedef struct TEKVisual
 	int vis_IOFileNo;
 	
 	TBOOL vis_HaveWindowManager;
+	TBOOL vis_HaveStrips;
 	TUINT vis_SignalsPending;
 	
 	struct TModInitNode vis_InitModules;
@@ -145,8 +148,13 @@ typedef struct
 	TINT pxm_Width, pxm_Height;
 	TUINT pxm_Flags;
 	TEKVisual *pxm_VisualBase;
+	/* Copy of the image registered with the display, see frectpixmap: */
+	TAPTR pxm_Buffer;
 } TEKPixmap;
 
+/* Pixmap flags besides IMLFL_*: display cannot register the pixmap: */
+#define PXMFL_NOBUFFER	0x0100
+
 typedef struct
 {
 	/* Visualbase: */
@@ -172,9 +180,15 @@ typedef struct {
 	float r, g, b;
 } rgbpt;
 
+/* Axis along which a gradient's color changes, if only along one: */
+#define GRADIENT_AXIS_NONE	0
+#define GRADIENT_AXIS_X		1
+#define GRADIENT_AXIS_Y		2
+
 typedef struct
 {
 	rgbpt A, B;
+	TINT axis;
 } TEKGradient;
 
 #endif
@@ -188,6 +202,8 @@ LOCAL LUACFUNC TINT tek_lib_visual_open(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_close(lua_State *L);
 LOCAL LUACFUNC int tek_lib_visual_getuserdata(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_getdisplayattrs(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_getcachestats(lua_State *L);
+LOCAL LUACFUNC TINT tek_lib_visual_setcachesize(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_wait(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_sleep(lua_State *L);
 LOCAL LUACFUNC TINT tek_lib_visual_openfont(lua_State *L);
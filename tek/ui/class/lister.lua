@@ -73,6 +73,13 @@
 --		- {{SelectMode [IG]}} (string)
 --			The Lister's selection mode, which can be {{"none"}},
 --			{{"single"}}, or {{"multi"}}.
+--		- {{Virtual [IG]}} (boolean)
+--			If '''true''', lines are measured only when they are displayed
+--			for the first time, and column widths grow as previously unseen
+--			lines are scrolled into view. This is intended for very long
+--			lists, e.g. log viewers, in which adding a line should not
+--			depend on the number of lines in the list.
+--			[Default: '''false''']
 --
 --	IMPLEMENTS::
 --		- Lister:addItem() - Adds an item to the list
@@ -122,6 +129,7 @@ local intersect = Region.intersect
 local max = math.max
 local min = math.min
 local pairs = pairs
+local setmetatable = setmetatable
 local sort = table.sort
 local tonumber = tonumber
 local tostring = tostring
@@ -129,7 +137,7 @@ local type = type
 local unpack = unpack or table.unpack
 
 local Lister = Text.module("tek.ui.class.lister", "tek.ui.class.text")
-Lister._VERSION = "Lister 32.1"
+Lister._VERSION = "Lister 32.2"
 
 -------------------------------------------------------------------------------
 --	Constants & Class data:
@@ -139,6 +147,9 @@ local FL_LAYOUT = ui.FL_LAYOUT
 local MSG_KEYDOWN = ui.MSG_KEYDOWN
 local MSG_KEYUP = ui.MSG_KEYUP
 
+-- metatable for the table of measured entries:
+local WEAKKEYS = { __mode = "k" }
+
 -------------------------------------------------------------------------------
 --	addClassNotifications: overrides
 -------------------------------------------------------------------------------
@@ -186,6 +197,7 @@ function Lister.new(class, self)
 	self.Canvas = false -- fixed
 	self.CanvasHeight = false -- !!
 	self.ColumnPadding = self.ColumnPadding or false
+	self.ColumnCounts = { }
 	self.ColumnPositions = { 0 }
 	self.ColumnWidths = { 0 }
 	self.CursorLine = self.CursorLine or 0
@@ -196,8 +208,12 @@ function Lister.new(class, self)
 	self.HeaderGroup = self.HeaderGroup or false
 	self.Mode = "button"
 	self.LineHeight = false
+	-- text widths of measured entries, see linekey():
+	self.LineWidths = setmetatable({ }, WEAKKEYS)
 	self.LastKey = false
 	self.ListObject = self.ListObject or List:new()
+	-- entries were added without being measured:
+	self.MeasureDirty = false
 	self.NumColumns = 1
 	self.NumSelectedLines = 0
 	self.RenderData = { }
@@ -205,9 +221,14 @@ function Lister.new(class, self)
 	self.SelectedLine = self.SelectedLine or 0
 	-- selection modes ("none", "single", "multi"):
 	self.SelectMode = self.SelectMode or "single"
+	-- widest text per column:
+	self.TextWidths = { }
 	self.TrackDamage = true
 	self.OldCursorLine = self.CursorLine
 	self.OldSelectedLine = self.SelectedLine
+	self.Virtual = self.Virtual or false
+	-- number of measured entries per column and text width:
+	self.WidthCounts = { }
 	return Text.new(class, self)
 end
 
@@ -308,21 +329,29 @@ end
 --	getLineOnScreen:
 -------------------------------------------------------------------------------
 
+local function getonscreen(self, y0, y1)
+	local c = self.Canvas
+	if c then
+		local r1, r2, r3, r4 = c:getRect()
+		if r1 then
+			local v1 = c.CanvasLeft
+			local v2 = c.CanvasTop
+			local v3 = v1 + r3 - r1
+			local v4 = v2 + r4 - r2
+			return intersect(v1, v2, v3, v4, 0, y0, c.CanvasWidth - 1, y1)
+		end
+	end
+end
+
 function Lister:getLineOnScreen(lnr)
+	local lh = self.LineHeight
+	if not self.Canvas or not lh then
+		-- not set up yet
+		return
+	end
 	local l = self.ListObject and self.ListObject:getItem(lnr)
 	if l then
-		local c = self.Canvas
-		if c then
-			local r1, r2, r3, r4 = c:getRect()
-			if r1 then
-				local v1 = c.CanvasLeft
-				local v2 = c.CanvasTop
-				local v3 = v1 + r3 - r1
-				local v4 = v2 + r4 - r2
-				return intersect(v1, v2, v3, v4, 0, l[4], c.CanvasWidth - 1,
-					l[5])
-			end
-		end
+		return getonscreen(self, (lnr - 1) * lh, lnr * lh - 1)
 	end
 end
 
@@ -337,6 +366,121 @@ function Lister:damageLine(lnr)
 	end
 end
 
+-------------------------------------------------------------------------------
+--	linekey: Returns the key under which an entry's text widths are kept.
+--	This is the entry itself, unless it is provided by a list that creates
+--	its entries per access, like a [[#tek.class.nativelist : NativeList]];
+--	those identify the stored item in entry[4].
+-------------------------------------------------------------------------------
+
+local function linekey(l)
+	return l[4] or l
+end
+
+-------------------------------------------------------------------------------
+--	resetcolumns: Forgets all measured entries.
+-------------------------------------------------------------------------------
+
+local function resetcolumns(self)
+	self.LineWidths = setmetatable({ }, WEAKKEYS)
+	self.TextWidths = { }
+	self.WidthCounts = { }
+	self.ColumnCounts = { }
+	self.MeasureDirty = false
+end
+
+-------------------------------------------------------------------------------
+--	measureline: Measures an entry and accounts for its text widths in the
+--	column widths, unless it has been measured already. Returns true if a
+--	column has grown.
+-------------------------------------------------------------------------------
+
+local function measureline(self, l)
+	local lw = self.LineWidths
+	local key = linekey(l)
+	if lw[key] then
+		return false
+	end
+	local f = self.FontHandle
+	local tw = self.TextWidths
+	local wc = self.WidthCounts
+	local cc = self.ColumnCounts
+	local w = { }
+	local grown = false
+	for i, text in ipairs(l[1]) do
+		local x = f:getTextSize(text)
+		w[i] = x
+		local c = wc[i]
+		if not c then
+			c = { }
+			wc[i] = c
+			cc[i] = 0
+			tw[i] = 0
+		end
+		c[x] = (c[x] or 0) + 1
+		cc[i] = cc[i] + 1
+		if x > tw[i] then
+			tw[i] = x
+			grown = true
+		end
+	end
+	lw[key] = w
+	return grown
+end
+
+-------------------------------------------------------------------------------
+--	unmeasureline: Removes the text widths of the entry with the given key
+--	from the column widths. When the widest text of a column goes away, the
+--	next smaller width is looked up among the widths counted for that column.
+-------------------------------------------------------------------------------
+
+local function unmeasureline(self, key)
+	local lw = self.LineWidths
+	local w = lw[key]
+	if w then
+		lw[key] = nil
+		local tw = self.TextWidths
+		local wc = self.WidthCounts
+		local cc = self.ColumnCounts
+		for i = 1, #w do
+			local x = w[i]
+			local c = wc[i]
+			local n = c[x] - 1
+			cc[i] = cc[i] - 1
+			if n > 0 then
+				c[x] = n
+			else
+				c[x] = nil
+				if x == tw[i] then
+					local m = 0
+					for x in pairs(c) do
+						m = max(m, x)
+					end
+					tw[i] = m
+				end
+			end
+		end
+	end
+end
+
+-------------------------------------------------------------------------------
+--	updatelines: Relayouts the list after the number of lines has changed,
+--	and damages the lines from {{lnr}} to {{numl}} that are on screen.
+-------------------------------------------------------------------------------
+
+local function updatelines(self, lnr, numl)
+	local c = self.Canvas
+	if c then
+		self:layoutColumns(false)
+		local lh = self.LineHeight
+		local r1, r2, r3, r4 = getonscreen(self, (lnr - 1) * lh, numl * lh - 1)
+		if r1 then
+			self:damage(r1, r2, r3, r4)
+		end
+		c:updateUnusedRegion()
+	end
+end
+
 -------------------------------------------------------------------------------
 --	shiftSelection: shift selection by given number of steps, starting at the
 --	specified line number.
@@ -380,14 +524,17 @@ function Lister:addItem(entry, lnr, quick)
 			self.NumSelectedLines = self.NumSelectedLines + 1
 			self.SelectedLines[lnr] = lnr
 		end
-		if not quick then
+		if not self.CursorObject then
+			-- not set up; entries are measured in setup
+		elseif quick then
+			self.MeasureDirty = self.MeasureDirty or not self.Virtual
+		elseif self.MeasureDirty then
 			self:prepare(true)
-			for i = lnr, lo:getN() do
-				self:damageLine(i)
-			end
-			if self.Canvas then
-				self.Canvas:updateUnusedRegion()
+		else
+			if not self.Virtual then
+				measureline(self, lo:getItem(lnr))
 			end
+			updatelines(self, lnr, lo:getN())
 		end
 	end
 end
@@ -402,6 +549,8 @@ end
 function Lister:remItem(lnr, quick)
 	local lo = self.ListObject
 	if lo then
+		local l = lo:getItem(lnr)
+		local key = l and linekey(l)
 		local entry = lo:remItem(lnr)
 		if entry then
 			if entry[3] then
@@ -409,10 +558,12 @@ function Lister:remItem(lnr, quick)
 				self.NumSelectedLines = self.NumSelectedLines - 1
 			end
 			self:shiftSelection(lnr + 1, -1)
-			if not quick then
-				self:prepare(true)
-				for i = lnr, lo:getN() do
-					self:damageLine(i)
+			unmeasureline(self, key)
+			if not quick and self.CursorObject then
+				if self.MeasureDirty then
+					self:prepare(true)
+				else
+					updatelines(self, lnr, lo:getN() + 1)
 				end
 				self:moveLine()
 			end
@@ -469,16 +620,39 @@ function Lister:prepare(damage)
 	local lo = self.ListObject
 	local co = self.CursorObject
 	if lo and co then -- and d then
+		resetcolumns(self)
+		if not self.Virtual then
+			for lnr = 1, lo:getN() do
+				measureline(self, lo:getItem(lnr))
+			end
+		end
+		self:layoutColumns(damage)
+	end
+end
+
+-------------------------------------------------------------------------------
+--	layoutColumns: internal; determines the column positions from the
+--	measured text widths and the header, and updates the canvas size.
+-------------------------------------------------------------------------------
+
+function Lister:layoutColumns(damage)
+	local lo = self.ListObject
+	local co = self.CursorObject
+	if lo and co then
 
 		local b1, b2, b3, b4 = co:getBorder()
-		local f = self.FontHandle
+		local oldcw = self.ColumnWidths
 		local cw = { }
 		self.ColumnWidths = cw
 		local cp = self.ColumnPositions
-		local nc = 0
-		local y = 0
+		local tw = self.TextWidths
+		local nc = #self.ColumnCounts
 		local hg = self.HeaderGroup
-		local lh = self.LineHeight
+
+		-- number of columns, from the widest measured entries:
+		while nc > 0 and self.ColumnCounts[nc] == 0 do
+			nc = nc - 1
+		end
 
 		-- initialize column widths with head item sizes:
 		if hg then
@@ -487,21 +661,11 @@ function Lister:prepare(damage)
 			end
 		end
 
-		for lnr = 1, lo:getN() do
-			local l = lo:getItem(lnr)
-			local columns = l[1]
-			nc = max(nc, #columns)
-			for i, t in ipairs(columns) do
-				local w = f:getTextSize(columns[i])
-				cw[i] = max(cw[i] or 0, w)
-			end
-			l[4], l[5] = y, y + lh - 1
-			y = y + lh
+		for i = 1, nc do
+			cw[i] = max(cw[i] or 0, tw[i])
 		end
 
-		-- TODO: it's nonsense to depend on 'damage' here,
-		-- the real question is if we have been layouted yet...
-		if damage and self.AlignColumn then
+		if self.AlignColumn and self:checkFlags(FL_LAYOUT) then
 			local ae = self.AlignElement or self.Canvas
 			local r1, _, r3 = ae:getRect()
 			if r1 then
@@ -528,8 +692,8 @@ function Lister:prepare(damage)
 		local redraw = false
 		for i, w in ipairs(cw) do
 
-			-- column positions changed?:
-			redraw = redraw or cp[i] ~= cx
+			-- column positions or widths changed?:
+			redraw = redraw or cp[i] ~= cx or oldcw[i] ~= w
 			cp[i] = cx
 
 			if i < nc then
@@ -554,14 +718,16 @@ function Lister:prepare(damage)
 
 		self.MinWidth = cx
 		self.NumColumns = nc
-		self.CanvasHeight = y
+		self.CanvasHeight = lo:getN() * self.LineHeight
 
 		local c = self.Canvas
 
 		c:setValue("CanvasWidth", cx + b1 + b3)
 
-		if self:layout(0, 0, c.CanvasWidth - 1, c.CanvasHeight - 1, damage)
-			or damage then
+		-- repaint everything on screen if the columns have changed:
+		redraw = redraw or damage
+		if self:layout(0, 0, c.CanvasWidth - 1, c.CanvasHeight - 1, redraw)
+			or redraw then
 			c:rethinkLayout(1)
 			self:setFlags(ui.FL_REDRAW)
 		end
@@ -580,6 +746,23 @@ end
 function Lister:draw()
 	local lo, dr = self.ListObject, self.DamageRegion
 	if lo and dr then
+		if self.Virtual then
+			-- measure the lines to be drawn; if columns have grown, this
+			-- extends the damage to the entire visible area:
+			local _, y0, _, y1 = dr:get()
+			if y0 then
+				local lh = self.LineHeight
+				local grown = false
+				for lnr = max(floor(y0 / lh) + 1, 1), min(lo:getN(),
+					floor(y1 / lh) + 1) do
+					grown = measureline(self, lo:getItem(lnr)) or grown
+				end
+				if grown then
+					self:layoutColumns(false)
+					dr = self.DamageRegion
+				end
+			end
+		end
 		-- repaint intra-area damagerects:
 		local props = self.Properties
 		local d = self.Window.Drawable
@@ -603,23 +786,25 @@ function Lister:drawPatch(r1, r2, r3, r4, t, d, lo, lh, x1, fpen, cpen,
 	d:pushClipRect(r1, r2, r3, r4)
 	for lnr = floor(r2 / lh) + 1, min(lo:getN(), floor(r4 / lh) + 1) do
 		local l = lo:getItem(lnr)
+		local y0 = (lnr - 1) * lh
+		local y1 = y0 + lh - 1
 		-- overlap between damage and line:
-		if intersect(r1, r2, r3, r4, 0, l[4], x1, l[5]) then
+		if intersect(r1, r2, r3, r4, 0, y0, x1, y1) then
 			local b1, b2, b3, b4 = unpack(t, 1, 4)
 			local cp = self.ColumnPositions
 			local bpen = t[6 + lnr % 2]
 			if lnr == self.CursorLine then
 				-- with cursor:
-				d:fillRect(b1, l[4] + b2, x1 - b3, l[5] - b4,
+				d:fillRect(b1, y0 + b2, x1 - b3, y1 - b4,
 					l[3] and cpen or bpen)
 				for ci = 1, #cp do
 					local text = l[1][ci]
 					if text then
 						local cx = cp[ci]
-						d:pushClipRect(b1 + cx, l[4] + b2,
-							b1 + cx + self.ColumnWidths[ci], l[5] - b4)
-						d:drawText(b1 + cx, l[4] + b2,
-							b1 + cx + self.ColumnWidths[ci], l[5] - b4,
+						d:pushClipRect(b1 + cx, y0 + b2,
+							b1 + cx + self.ColumnWidths[ci], y1 - b4)
+						d:drawText(b1 + cx, y0 + b2,
+							b1 + cx + self.ColumnWidths[ci], y1 - b4,
 							l[1][ci], l[3] and cfpen or fpen)
 						d:popClipRect()
 					end
@@ -627,19 +812,19 @@ function Lister:drawPatch(r1, r2, r3, r4, t, d, lo, lh, x1, fpen, cpen,
 				self.CursorObject:draw(d)
 			else
 				-- without cursor:
-				d:fillRect(0, l[4], x1, l[5], l[3] and cpen or bpen)
+				d:fillRect(0, y0, x1, y1, l[3] and cpen or bpen)
 				for ci = 1, #cp do
 					local text = l[1][ci]
 					if text then
 						local cx = cp[ci]
-						if intersect(r1, r2, r3, r4, cx, l[4],
-							b1 + cx + self.ColumnWidths[ci] - 1, l[5]) then
-							d:pushClipRect(b1 + cx, l[4] + b2,
-								b1 + cx + self.ColumnWidths[ci], l[5] - b4)
+						if intersect(r1, r2, r3, r4, cx, y0,
+							b1 + cx + self.ColumnWidths[ci] - 1, y1) then
+							d:pushClipRect(b1 + cx, y0 + b2,
+								b1 + cx + self.ColumnWidths[ci], y1 - b4)
 							-- draw text:
-							d:drawText(b1 + cx, l[4] + b2,
+							d:drawText(b1 + cx, y0 + b2,
 								b1 + cx + self.ColumnWidths[ci],
-								l[5] - b4, l[1][ci], l[3] and cfpen or fpen)
+								y1 - b4, l[1][ci], l[3] and cfpen or fpen)
 							d:popClipRect()
 						end
 					end
@@ -795,30 +980,29 @@ function Lister:moveLine(lnr, follow)
 	local ca = self.Canvas
 	if ca then
 		local x1 = ca.CanvasWidth - 1
+		local lh = self.LineHeight
 		local cl = self.CursorLine
 		if cl >= 0 then
 			local ol = lo:getItem(cl)
 			if ol then
-				self:damage(0, ol[4], x1, ol[5])
+				self:damage(0, (cl - 1) * lh, x1, cl * lh - 1)
 			end
 		end
 		local l = lnr and lo:getItem(lnr)
 		if l then
-			local y0, y1 = l[4], l[5]
-			if y0 and y1 then
-				self:damage(0, y0, x1, y1)
-				if y1 < ca.CanvasTop then
-					if follow then
-						ca:setValue("CanvasTop", y0)
-					end
-				else
-					local _, r2, _, r4 = ca:getRect()
-					if r2 then
-						local vh = r4 - r2 + 1 - (y1 - y0 + 1)
-						if y0 > ca.CanvasTop + vh then
-							if follow then
-								ca:setValue("CanvasTop", y0 - vh)
-							end
+			local y0, y1 = (lnr - 1) * lh, lnr * lh - 1
+			self:damage(0, y0, x1, y1)
+			if y1 < ca.CanvasTop then
+				if follow then
+					ca:setValue("CanvasTop", y0)
+				end
+			else
+				local _, r2, _, r4 = ca:getRect()
+				if r2 then
+					local vh = r4 - r2 + 1 - (y1 - y0 + 1)
+					if y0 > ca.CanvasTop + vh then
+						if follow then
+							ca:setValue("CanvasTop", y0 - vh)
 						end
 					end
 				end
@@ -831,14 +1015,18 @@ function Lister:moveLine(lnr, follow)
 	end
 end
 
+-------------------------------------------------------------------------------
+--	lnr = findLine(y): Returns the number of the line at the specified
+--	position in the list, or '''nil''' if there is no line.
+-------------------------------------------------------------------------------
+
 function Lister:findLine(y)
 	local lo = self.ListObject
-	if lo then
-		for lnr = 1, lo:getN() do
-			local l = lo:getItem(lnr)
-			if y >= l[4] and y <= l[5] then
-				return lnr
-			end
+	local lh = self.LineHeight
+	if lo and lh and y >= 0 then
+		local lnr = floor(y / lh) + 1
+		if lnr <= lo:getN() then
+			return lnr
 		end
 	end
 end
@@ -935,8 +1123,8 @@ function Lister:handleInput(msg)
 					if qual == 4 or qual == 8 then
 						self:moveLine(numl, true)
 					else
-						local entry = self:getItem(lnr)
-						local y0 = entry and entry[4] or self.CanvasTop
+						local y0 = self:getItem(lnr) and
+							(lnr - 1) * self.LineHeight or self.Canvas.CanvasTop
 						local l1 = self:findLine(y0 + getheight(self)) or numl
 						self:moveLine(l1, true)
 					end
@@ -944,8 +1132,8 @@ function Lister:handleInput(msg)
 					if qual == 4 or qual == 8 then
 						self:moveLine(1, true)
 					else
-						local entry = self:getItem(lnr)
-						local y0 = entry and entry[4] or self.CanvasTop
+						local y0 = self:getItem(lnr) and
+							(lnr - 1) * self.LineHeight or self.Canvas.CanvasTop
 						local l1 = self:findLine(y0 - getheight(self)) or 1
 						self:moveLine(l1, true)
 					end
@@ -1027,6 +1215,7 @@ function Lister:clear()
 	local lo = self.ListObject
 	if lo then
 		lo:clear()
+		resetcolumns(self)
 	end
 end
 
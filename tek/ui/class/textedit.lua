@@ -42,6 +42,8 @@
 
 local db = require "tek.lib.debug"
 local String = require "tek.lib.string"
+local TextDocument = require "tek.class.textdocument"
+local TextFile = require "tek.lib.textfile"
 local ui = require "tek.ui".checkVersion(112)
 local Region = ui.loadLibrary("region", 9)
 local Sizeable = ui.require("sizeable", 10)
@@ -61,7 +63,7 @@ local type = type
 local unpack = unpack or table.unpack
 
 local TextEdit = Sizeable.module("tek.ui.class.textedit", "tek.ui.class.sizeable")
-TextEdit._VERSION = "TextEdit 21.1"
+TextEdit._VERSION = "TextEdit 22.0"
 
 local LNR_HUGE = 1000000000
 local FAKECANVASWIDTH = 1000000000 --30000
@@ -71,6 +73,9 @@ local FL_TRACKDAMAGE = ui.FL_TRACKDAMAGE
 
 local PENIDX_MARK = 64
 
+-- identifies the font in the width caches of strings:
+local FontSerial = 0
+
 -------------------------------------------------------------------------------
 --	Constants & Class data:
 -------------------------------------------------------------------------------
@@ -113,7 +118,7 @@ function TextEdit.new(class, self)
 	self.CursorThickness = self.CursorThickness or 1 -- in line mode, minus 1
 	self.CursorX = self.CursorX or 1
 	self.CursorY = self.CursorY or 1
-	self.Data = self.Data or { "" }	-- transformed during init
+	self.Data = TextEdit.newDocument(self.Data)
 	self.Editing = false
 	self.FileName = self.FileName or ""
 	self.FixedFont = self.FixedFont or false
@@ -121,6 +126,7 @@ function TextEdit.new(class, self)
 	self.FollowCursor = false
 	self.FontHandle = false
 	self.FontName = self.FontName or false
+	self.FontSerial = false
 	self.FWidth = false
 	self.HardScroll = self.HardScroll or false
 	self.LineHeight = false
@@ -453,14 +459,6 @@ end
 
 function TextEdit:initText()
 	if self:checkFlags(FL_SETUP) then
-		local d = self.Data
-		if not d.Initialized then
-			for i = 1, self:getN() do
-				local line = d[i]
-				d[i] = self:createLine(line)
-			end
-			d.Initialized = true
-		end
 		return self:recalcTextWidth()
 	end
 end
@@ -475,12 +473,13 @@ function TextEdit:recalcTextWidth()
 		-- text width recalculation avoided
 		maxw = FAKECANVASWIDTH
 	elseif self:checkFlags(FL_SETUP) then
-		local d = self.Data
-		for i = 1, self:getN() do
-			local line = d[i]
-			assert(type(line) ~= "string")
+		-- lines of a file not yet read are not taken into account:
+		self.Data:forEachLoaded(function(line, lnr)
+			if type(line) == "string" then
+				line = self:getLine(lnr)
+			end
 			maxw = max(maxw, line[2])
-		end
+		end)
 	end
 	if self.TextWidth ~= maxw then
 		self.TextWidth = maxw
@@ -519,24 +518,35 @@ function TextEdit:updateCanvasSize()
 end
 
 -------------------------------------------------------------------------------
---	newtext(text) - Initialize text from a string or a table of strings.
+--	doc = TextEdit.newDocument(text) - Create a document from a string, a
+--	table of strings, or a TextFile. A TextDocument is returned unmodified.
 -------------------------------------------------------------------------------
 
-function TextEdit:newText(text)
-	self:endMark()
-	local data
+function TextEdit.newDocument(text)
 	if not text then
-		data = { "" }
+		return TextDocument:new { Items = { "" } }
 	elseif type(text) == "string" then
-		data = { }
+		local data = { }
 		for l in (text .. "\n"):gmatch("([^\n]*)\n") do
 			insert(data, l)
 		end
-	else -- assuming it's a table
-		data = text
+		return TextDocument:new { Items = data }
+	elseif text.getItem then
+		return text
+	elseif text.getLine then
+		return TextDocument:new { File = text }
 	end
-	data.Initialized = false
-	self.Data = data
+	return TextDocument:new { Items = text }
+end
+
+-------------------------------------------------------------------------------
+--	newtext(text) - Initialize text from a string, a table of strings, a
+--	TextFile or a TextDocument.
+-------------------------------------------------------------------------------
+
+function TextEdit:newText(text)
+	self:endMark()
+	self.Data = self.newDocument(text)
 	self:initText()
 	self:updateCanvasSize()
 	self.LockCursorX = false
@@ -648,7 +658,7 @@ end
 -------------------------------------------------------------------------------
 
 function TextEdit:changeLine(lnr)
-	local line = self.Data[lnr or self.CursorY]
+	local line = self:getLine(lnr)
 	if not line then
 		db.info("no line %s", lnr)
 		return
@@ -679,6 +689,8 @@ function TextEdit:initFont()
 	local fname = self.FontName or props["font"]
 	local f = self.Application.Display:openFont(fname)
 	self.FontHandle = f
+	FontSerial = FontSerial + 1
+	self.FontSerial = FontSerial
 	local fw, lh
 
 	if self.PasswordChar then
@@ -1052,7 +1064,7 @@ end
 function TextEdit:insertLineStr(lnr, str, bmdelta)
 	bmdelta = bmdelta or 0
 	local line = self:createLine(str)
-	insert(self.Data, lnr or #self.Data, line)
+	self.Data:addItem(line, lnr or self:getN())
 	local idx = self:findBookmark(lnr + bmdelta)
 	if idx then
 		if self:checkBookmark(lnr + bmdelta) then
@@ -1088,9 +1100,9 @@ function TextEdit:removeLine(lnr, remove_bookmark)
 			b[i] = b[i] - 1
 		end
 	end
-	local line = remove(self.Data, lnr)
+	local line = self.Data:remItem(lnr)
 	self:setValue("Changed", true)
-	if line[2] == self.TextWidth then
+	if type(line) == "table" and line[2] == self.TextWidth then
 		self:initText()
 	end
 end
@@ -1100,13 +1112,12 @@ end
 -------------------------------------------------------------------------------
 
 function TextEdit:getN()
-	return #self.Data
+	return self.Data:getN()
 end
 
 function TextEdit:getNumLines()
-	local d = self.Data
-	local nl = #d
-	if nl == 1 and d[1][1]:len() == 0 then -- do not count empty line 1:
+	local nl = self:getN()
+	if nl == 1 and self:getLineLength(1) == 0 then -- do not count empty line 1:
 		return 0
 	end
 	return nl
@@ -1121,12 +1132,26 @@ end
 
 function TextEdit:getLine(lnr)
 	lnr = lnr or self.CursorY
--- 	assert(lnr >= 1 and lnr <= #self.Data)
-	local line = self.Data[lnr]
--- 	assert(line)
+	local d = self.Data
+	local line = d:getItem(lnr)
+	if type(line) == "string" and self:checkFlags(FL_SETUP) then
+		-- decode on first access:
+		line = self:createLine(line)
+		d:changeItem(line, lnr)
+	end
 	return line, lnr
 end
 
+-- get the text of a line as a Lua string, without reading it into the
+-- document if it is a line of a file:
+function TextEdit:getLineString(lnr)
+	local line = self.Data:getItem(lnr, true)
+	if type(line) == "string" then
+		return line
+	end
+	return line[1]:get()
+end
+
 function TextEdit:getLineLength(lnr)
 	local line, lnr = self:getLine(lnr)
 -- 	assert(line, "no text line: "..lnr)
@@ -1331,7 +1356,8 @@ end
 
 function TextEdit:getTextWidth(text, p0, p1)
 	return text:getTextWidth(self.TabSize, p0, p1, 
-		self.FixedFWidth or self.getRawTextWidth, self, self.FWidth)
+		self.FixedFWidth or self.getRawTextWidth, self, self.FWidth,
+		self.FontSerial)
 end
 
 -------------------------------------------------------------------------------
@@ -1725,32 +1751,9 @@ function TextEdit:pageDown()
 end
 
 function TextEdit:getCursorByX(text, x)
-	if x < 0 then
-		return 1
-	end
-	local p0 = 0
-	local p1 = text:len()
-	local pn
-	local x0 = 0
-	local x1 = self:getTextWidth(text, 1, p1)
-	local xn
-	while true do
-		if x >= x1 then
-			return p1 + 1
-		end
-		if p0 + 1 == p1 then
-			return p1
-		end
-		pn = p0 + floor((p1 - p0) / 2)
-		xn = self:getTextWidth(text, 1, pn)
-		if xn > x then
-			p1 = pn
-			x1 = xn
-		else
-			p0 = pn
-			x0 = xn
-		end
-	end
+	return text:getCharByX(self.TabSize, floor(x),
+		self.FixedFWidth or self.getRawTextWidth, self, self.FWidth,
+		self.FontSerial)
 end
 
 function TextEdit:getCursorByXY(x, y)
@@ -1839,30 +1842,38 @@ function TextEdit.breakText(readfunc, data)
 end
 
 -------------------------------------------------------------------------------
---	loadText(filename)
+--	loadText(filename) - The file is opened as a TextFile, its lines are
+--	read only when they are accessed.
 -------------------------------------------------------------------------------
 
 function TextEdit:loadText(fname)
-	local f = open(fname)
+	local f = TextFile.open(fname)
 	if f then
-		local data = self.breakText(function() return f:read(4096) end)
-		self:newText(data)
+		self:newText(f)
 		self:setValue("FileName", fname)
 		return true
 	end
 end
 
 -------------------------------------------------------------------------------
---	saveText(filename)
+--	saveText(filename): The file is overwritten in place, so that its mode,
+--	owner and links are retained. Lines not yet read from the file the text
+--	was loaded from are copied from it directly. Only if that file is the
+--	one written, its remaining lines are read into memory first.
 -------------------------------------------------------------------------------
 
 function TextEdit:saveText(fname)
+	local data = self.Data
+	local file = data.File
+	if file and file:sameFile(fname) then
+		data:closeFile()
+	end
 	local f, msg = open(fname, "wb")
 	if f then
 		local numl = self:getN()
 		local n = 0
 		for lnr = 1, numl do
-			f:write(self:getLineText(lnr):get())
+			f:write(self:getLineString(lnr))
 			n = n + 1
 			if lnr < numl then
 				f:write("\n")
@@ -2080,9 +2091,8 @@ end
 
 function TextEdit:getText()
 	local t = { }
-	local d = self.Data
-	for lnr = 1, #d do
-		insert(t, d[lnr][1]:get())
+	for lnr = 1, self:getN() do
+		insert(t, self:getLineString(lnr))
 	end
 	return concat(t, "\n")
 end
@@ -2095,13 +2105,21 @@ function TextEdit:find(search)
 	local sx, sy = self:moveCursorPosition(self.CursorX, self.CursorY, 1, 0, 
 		true)
 	local numl = self:getN()
-	for y = 0, numl - 1 do
+	local y = 0
+	while y < numl do
 		local cy = ((sy - 1 + y) % numl) + 1
-		local line = self:getLineText(cy)
-		local cx = line:find(search, sx)
-		if cx then
-			self:setCursor(-1, cx, cy, 1)
-			return true
+		-- skip lines of a file not containing the search string:
+		local ny = self.Data:findItem(search, cy) or numl + 1
+		if ny > cy then
+			y = y + ny - cy
+		else
+			local line = self:getLineText(cy)
+			local cx = line:find(search, sx)
+			if cx then
+				self:setCursor(-1, cx, cy, 1)
+				return true
+			end
+			y = y + 1
 		end
 		sx = 1
 	end
@@ -2112,21 +2130,23 @@ end
 -------------------------------------------------------------------------------
 
 function TextEdit:clearMark()
-	local numl = self:getN()
-	for y = 1, numl do
-		local line = self:getLineText(y)
-		local damage
-		for x = 1, line:len() do
-			local _, meta = line:getval(x)
-			if meta then
-				line:setmetadata(0, x)
-				damage = true
+	-- only lines in memory can be marked:
+	self.Data:forEachLoaded(function(line, y)
+		if type(line) == "table" then
+			line = line[1]
+			local damage
+			for x = 1, line:len() do
+				local _, meta = line:getval(x)
+				if meta then
+					line:setmetadata(0, x)
+					damage = true
+				end
+			end
+			if damage then
+				self:damageLine(y)
 			end
 		end
-		if damage then
-			self:damageLine(y)
-		end
-	end	
+	end)
 end
 
 function TextEdit:mark(line, lnr, p0, p1)
@@ -2135,8 +2155,9 @@ end
 
 function TextEdit:markWord(text)
 	local marklen = String:new():set(text):len()
-	local numl = self:getN()
-	for y = 1, numl do
+	local d = self.Data
+	local y = d:findItem(text, 1)
+	while y do
 		local line = self:getLineText(y)
 		local p0 = 0
 		local damage
@@ -2151,6 +2172,7 @@ function TextEdit:markWord(text)
 		if damage then
 			self:damageLine(y)
 		end
+		y = d:findItem(text, y + 1)
 	end
 end
 